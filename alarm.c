@@ -0,0 +1,62 @@
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "alarm.h"
+
+// The alarms are evaluated in chunks: the new states of a
+// chunk are computed in a branch-free loop that the compiler
+// can vectorize, and only the (rare) chunks where some alarm
+// changed state are scanned for the transitions.
+#define ALARM_CHUNK 256
+
+int alarmSetInit(AlarmSet *alarmSet, size_t numAlarms, const int *values, int *state)
+{
+    alarmSet->numAlarms = numAlarms;
+    alarmSet->values = values;
+    alarmSet->state = state;
+    alarmSet->loThreshold = calloc((numAlarms + 1), sizeof (long));
+    alarmSet->hiThreshold = calloc((numAlarms + 1), sizeof (long));
+    alarmSet->transitions = calloc((numAlarms + 1), sizeof (AlarmTransition));
+
+    if ((alarmSet->loThreshold == NULL) || (alarmSet->hiThreshold == NULL) || (alarmSet->transitions == NULL)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+size_t alarmSetEval(AlarmSet *alarmSet)
+{
+    const int *values = alarmSet->values;
+    const long *loThreshold = alarmSet->loThreshold;
+    const long *hiThreshold = alarmSet->hiThreshold;
+    int *state = alarmSet->state;
+    size_t numTransitions = 0;
+
+    for (size_t base = 0; base < alarmSet->numAlarms; base += ALARM_CHUNK) {
+        size_t end = ((base + ALARM_CHUNK) < alarmSet->numAlarms) ? (base + ALARM_CHUNK) : alarmSet->numAlarms;
+        int newState[ALARM_CHUNK];
+        int changed = 0;
+
+        for (size_t n = base; n < end; n++) {
+            // Raise the alarm above hiThreshold, and keep it
+            // raised until the value drops below loThreshold.
+            int s = (values[n] > hiThreshold[n]) | (state[n] & (values[n] >= loThreshold[n]));
+            changed |= s ^ state[n];
+            newState[n - base] = s;
+        }
+
+        if (changed) {
+            for (size_t n = base; n < end; n++) {
+                if (newState[n - base] != state[n]) {
+                    state[n] = newState[n - base];
+                    alarmSet->transitions[numTransitions].index = n;
+                    alarmSet->transitions[numTransitions].state = state[n];
+                    numTransitions++;
+                }
+            }
+        }
+    }
+
+    return numTransitions;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+// A change in the state of the High Temperature alarm
+// of one of the values in an AlarmSet.
+typedef struct AlarmTransition {
+    uint32_t index;         // index of the value in the set
+    int state;              // new alarm state
+} AlarmTransition;
+
+// A set of High Temperature alarms, one per watched value,
+// each with its own pair of thresholds and hysteresis state:
+// the alarm is raised when the value goes above hiThreshold,
+// and it is cleared when the value goes below loThreshold.
+//
+// The thresholds are private copies, owned by the thread that
+// evaluates the set, so the evaluation pass doesn't race with
+// the SET requests that change them.
+typedef struct AlarmSet {
+    size_t numAlarms;
+    const int *values;          // watched values
+    long *loThreshold;
+    long *hiThreshold;
+    int *state;                 // 0=inactive 1=active
+    AlarmTransition *transitions;
+} AlarmSet;
+
+extern int alarmSetInit(AlarmSet *alarmSet, size_t numAlarms, const int *values, int *state);
+
+// Evaluate all the alarms in the set, and return the number
+// of alarms that changed state. The transitions are stored
+// in alarmSet->transitions[], in index order.
+extern size_t alarmSetEval(AlarmSet *alarmSet);
+
+__END_DECLS
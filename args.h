@@ -1,9 +1,24 @@
 #pragma once
 
+// Maximum number of --data-file options
+#define MAX_DATA_FILES  16
+
 typedef struct CmdArgs {
+    const char *agentxSocket;
     const char *configFile;
     bool daemon;
-    const char *dataFile;
+    const char *dataFiles[MAX_DATA_FILES];
+    unsigned numDataFiles;
+    const char *deltaFile;
+    bool eventLoop;
+    unsigned historyDepth;
+    int logLevel;
+    const char *objectFile;
+    const char *shmRing;
+    const char *stateFile;
     bool syslog;
+    unsigned trapBurst;
+    unsigned trapRate;
+    const char *updateSocket;
 } CmdArgs;
 
@@ -0,0 +1,606 @@
+#define _GNU_SOURCE     // accept4()
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "agentx.h"
+
+// The header of every PDU
+#define AGENTX_VERSION          1
+#define AGENTX_HEADER_LEN       20
+#define AGENTX_FLAG_NETWORK_BYTE_ORDER  0x10
+#define AGENTX_FLAG_NON_DEFAULT_CONTEXT 0x08
+
+#define AGENTX_MAX_PDU          (1024 * 1024)
+
+// The PDUs built by the master
+typedef struct PduBuf {
+    uint8_t data[65536];
+    size_t len;
+} PduBuf;
+
+// A PDU read from the subagent; its byte order is set by
+// the NETWORK_BYTE_ORDER flag of its header.
+typedef struct PduReader {
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+    bool bigEndian;
+    bool error;
+} PduReader;
+
+uint64_t agentxUsec(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t) now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+}
+
+int agentxOidParse(AgentxOid *oid, const char *str)
+{
+    oid->len = 0;
+
+    while (*str != '\0') {
+        char *end;
+        unsigned long subId = strtoul(str, &end, 10);
+
+        if ((end == str) || (subId > UINT32_MAX) || (oid->len == AGENTX_MAX_SUBIDS)) {
+            return -1;
+        }
+        oid->subIds[oid->len++] = subId;
+
+        if (*end == '.') {
+            end++;
+        } else if (*end != '\0') {
+            return -1;
+        }
+        str = end;
+    }
+
+    return (oid->len != 0) ? 0 : -1;
+}
+
+bool agentxOidUnder(const AgentxOid *oid, const AgentxOid *prefix)
+{
+    return (oid->len >= prefix->len) && (memcmp(oid->subIds, prefix->subIds, (prefix->len * sizeof (uint32_t))) == 0);
+}
+
+static void put8(PduBuf *buf, uint8_t val)
+{
+    if (buf->len < sizeof (buf->data)) {
+        buf->data[buf->len++] = val;
+    }
+}
+
+static void put16(PduBuf *buf, uint16_t val)
+{
+    put8(buf, (val >> 8));
+    put8(buf, val);
+}
+
+static void put32(PduBuf *buf, uint32_t val)
+{
+    put16(buf, (val >> 16));
+    put16(buf, val);
+}
+
+// Encode an OID, without the 1.3.6.1 prefix compression
+static void putOid(PduBuf *buf, const AgentxOid *oid)
+{
+    put8(buf, oid->len);
+    put8(buf, 0);       // prefix
+    put8(buf, 0);       // include
+    put8(buf, 0);       // reserved
+    for (size_t n = 0; n < oid->len; n++) {
+        put32(buf, oid->subIds[n]);
+    }
+}
+
+static void putNullOid(PduBuf *buf)
+{
+    put32(buf, 0);
+}
+
+// Start a PDU; the payload length is set by sendPdu()
+static void putHeader(PduBuf *buf, uint8_t type, uint32_t sessionId, uint32_t transactionId, uint32_t packetId)
+{
+    buf->len = 0;
+    put8(buf, AGENTX_VERSION);
+    put8(buf, type);
+    put8(buf, AGENTX_FLAG_NETWORK_BYTE_ORDER);
+    put8(buf, 0);
+    put32(buf, sessionId);
+    put32(buf, transactionId);
+    put32(buf, packetId);
+    put32(buf, 0);      // payload length
+}
+
+static int sendPdu(AgentxMaster *master, PduBuf *buf)
+{
+    uint32_t payloadLen = buf->len - AGENTX_HEADER_LEN;
+    size_t sent = 0;
+
+    if (buf->len == sizeof (buf->data)) {
+        fprintf(stderr, "%s: PDU too long!\n", __func__);
+        return -1;
+    }
+
+    buf->data[16] = (payloadLen >> 24);
+    buf->data[17] = (payloadLen >> 16);
+    buf->data[18] = (payloadLen >> 8);
+    buf->data[19] = payloadLen;
+
+    while (sent < buf->len) {
+        ssize_t s = send(master->fd, &buf->data[sent], (buf->len - sent), MSG_NOSIGNAL);
+
+        if (s < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        sent += s;
+    }
+
+    return 0;
+}
+
+static uint8_t get8(PduReader *rd)
+{
+    if ((rd->pos + 1) > rd->len) {
+        rd->error = true;
+        return 0;
+    }
+
+    return rd->data[rd->pos++];
+}
+
+static uint16_t get16(PduReader *rd)
+{
+    uint16_t hi = get8(rd);
+    uint16_t lo = get8(rd);
+
+    return rd->bigEndian ? ((hi << 8) | lo) : ((lo << 8) | hi);
+}
+
+static uint32_t get32(PduReader *rd)
+{
+    uint32_t hi = get16(rd);
+    uint32_t lo = get16(rd);
+
+    return rd->bigEndian ? ((hi << 16) | lo) : ((lo << 16) | hi);
+}
+
+static uint64_t get64(PduReader *rd)
+{
+    uint64_t hi = get32(rd);
+    uint64_t lo = get32(rd);
+
+    return rd->bigEndian ? ((hi << 32) | lo) : ((lo << 32) | hi);
+}
+
+static void getOid(PduReader *rd, AgentxOid *oid)
+{
+    uint8_t numSubIds = get8(rd);
+    uint8_t prefix = get8(rd);
+
+    get8(rd);   // include
+    get8(rd);   // reserved
+
+    oid->len = 0;
+    if (prefix != 0) {
+        static const uint32_t internet[] = { 1, 3, 6, 1 };
+
+        memcpy(oid->subIds, internet, sizeof (internet));
+        oid->subIds[4] = prefix;
+        oid->len = 5;
+    }
+
+    for (unsigned n = 0; n < numSubIds; n++) {
+        uint32_t subId = get32(rd);
+
+        if (oid->len < AGENTX_MAX_SUBIDS) {
+            oid->subIds[oid->len++] = subId;
+        } else {
+            rd->error = true;
+        }
+    }
+}
+
+// Skip an octet string, padded to a multiple of 4 bytes.
+// Returns its length.
+static uint32_t skipOctetString(PduReader *rd)
+{
+    uint32_t len = get32(rd);
+    size_t padded = ((size_t) len + 3) & ~(size_t) 3;
+
+    if ((rd->pos + padded) > rd->len) {
+        rd->error = true;
+        return 0;
+    }
+    rd->pos += padded;
+
+    return len;
+}
+
+static void getVarBind(PduReader *rd, AgentxVarBind *varBind)
+{
+    varBind->type = get16(rd);
+    get16(rd);  // reserved
+    getOid(rd, &varBind->name);
+    varBind->value = 0;
+    varBind->oidValue.len = 0;
+
+    switch (varBind->type) {
+    case AGENTX_INTEGER:
+    case AGENTX_COUNTER32:
+    case AGENTX_GAUGE32:
+    case AGENTX_TIME_TICKS:
+        varBind->value = get32(rd);
+        break;
+    case AGENTX_COUNTER64:
+        varBind->value = get64(rd);
+        break;
+    case AGENTX_OCTET_STRING:
+    case AGENTX_IP_ADDRESS:
+    case AGENTX_OPAQUE:
+        varBind->value = skipOctetString(rd);
+        break;
+    case AGENTX_OBJECT_ID:
+        getOid(rd, &varBind->oidValue);
+        break;
+    case AGENTX_NULL:
+    case AGENTX_NO_SUCH_OBJECT:
+    case AGENTX_NO_SUCH_INSTANCE:
+    case AGENTX_END_OF_MIB_VIEW:
+        break;
+    default:
+        rd->error = true;
+        break;
+    }
+}
+
+// Read the varbinds up to the end of the PDU. Returns their
+// number, or -1 on error.
+static int getVarBinds(PduReader *rd, AgentxVarBind *varBinds, size_t maxVarBinds)
+{
+    size_t numVarBinds = 0;
+
+    while (!rd->error && (rd->pos < rd->len)) {
+        AgentxVarBind varBind;
+
+        getVarBind(rd, (numVarBinds < maxVarBinds) ? &varBinds[numVarBinds] : &varBind);
+        numVarBinds++;
+    }
+
+    return (rd->error || (numVarBinds > maxVarBinds)) ? -1 : (int) numVarBinds;
+}
+
+// Ack a PDU of the subagent
+static int sendResponse(AgentxMaster *master, uint32_t sessionId, uint32_t transactionId, uint32_t packetId, uint16_t error)
+{
+    PduBuf buf;
+
+    putHeader(&buf, AGENTX_RESPONSE_PDU, sessionId, transactionId, packetId);
+    put32(&buf, ((agentxUsec() - master->startTime) / 10000));  // sysUpTime
+    put16(&buf, error);
+    put16(&buf, 0);     // index
+
+    return sendPdu(master, &buf);
+}
+
+// Serve one PDU of the subagent
+static int procPdu(AgentxMaster *master, const uint8_t *pdu, size_t len)
+{
+    PduReader rd = { .data = pdu, .len = len, .pos = AGENTX_HEADER_LEN };
+    uint8_t type = pdu[1];
+    uint8_t flags = pdu[2];
+    uint32_t sessionId, transactionId, packetId;
+
+    rd.bigEndian = (flags & AGENTX_FLAG_NETWORK_BYTE_ORDER) != 0;
+    rd.pos = 4;
+    sessionId = get32(&rd);
+    transactionId = get32(&rd);
+    packetId = get32(&rd);
+    rd.pos = AGENTX_HEADER_LEN;
+
+    // The non-default contexts aren't used by the benchmark,
+    // so just skip them
+    if ((flags & AGENTX_FLAG_NON_DEFAULT_CONTEXT) && (type != AGENTX_OPEN_PDU) && (type != AGENTX_RESPONSE_PDU)) {
+        skipOctetString(&rd);
+    }
+
+    switch (type) {
+    case AGENTX_OPEN_PDU:
+        master->sessionId++;
+        return sendResponse(master, master->sessionId, transactionId, packetId, 0);
+
+    case AGENTX_CLOSE_PDU:
+        sendResponse(master, sessionId, transactionId, packetId, 0);
+        return -1;
+
+    case AGENTX_REGISTER_PDU:
+        master->registered = true;
+        master->numRegisters++;
+        return sendResponse(master, sessionId, transactionId, packetId, 0);
+
+    case AGENTX_NOTIFY_PDU: {
+        static AgentxVarBind varBinds[AGENTX_MAX_VARBINDS];
+        uint64_t now = agentxUsec();
+        int numVarBinds = getVarBinds(&rd, varBinds, AGENTX_MAX_VARBINDS);
+
+        master->numNotifies++;
+        master->notified = true;
+        if ((numVarBinds >= 0) && (master->notifyFunc != NULL)) {
+            master->notifyFunc(master->notifyArg, varBinds, numVarBinds, now);
+        }
+        return sendResponse(master, sessionId, transactionId, packetId, 0);
+    }
+
+    case AGENTX_PING_PDU:
+        master->numPings++;
+        return sendResponse(master, sessionId, transactionId, packetId, 0);
+
+    case AGENTX_RESPONSE_PDU:
+        if ((master->varBinds != NULL) && (packetId == master->waitPacketId)) {
+            uint16_t error;
+
+            get32(&rd);     // sysUpTime
+            error = get16(&rd);
+            get16(&rd);     // index
+            master->numVarBinds = getVarBinds(&rd, master->varBinds, master->maxVarBinds);
+            if (error != 0) {
+                fprintf(stderr, "%s: request %u failed: error=%u\n", __func__, packetId, error);
+                master->numVarBinds = -2;
+            }
+            master->varBinds = NULL;
+            master->responded = true;
+        }
+        return 0;
+
+    default:
+        // Unregister, IndexAllocate, AddAgentCaps, ...
+        return sendResponse(master, sessionId, transactionId, packetId, 0);
+    }
+}
+
+// Read what the subagent sent, and serve the complete PDUs.
+// Returns -1 if the session was closed.
+static int procInput(AgentxMaster *master)
+{
+    size_t pos = 0;
+    ssize_t s;
+
+    if ((master->rxMax - master->rxLen) < 65536) {
+        uint8_t *rxBuf;
+
+        if ((rxBuf = realloc(master->rxBuf, (master->rxMax + 65536))) == NULL) {
+            return -1;
+        }
+        master->rxBuf = rxBuf;
+        master->rxMax += 65536;
+    }
+
+    if ((s = recv(master->fd, &master->rxBuf[master->rxLen], (master->rxMax - master->rxLen), 0)) <= 0) {
+        return ((s < 0) && (errno == EINTR)) ? 0 : -1;
+    }
+    master->rxLen += s;
+
+    while ((master->rxLen - pos) >= AGENTX_HEADER_LEN) {
+        const uint8_t *pdu = &master->rxBuf[pos];
+        bool bigEndian = (pdu[2] & AGENTX_FLAG_NETWORK_BYTE_ORDER) != 0;
+        uint32_t payloadLen = bigEndian ?
+            (((uint32_t) pdu[16] << 24) | ((uint32_t) pdu[17] << 16) | ((uint32_t) pdu[18] << 8) | pdu[19]) :
+            (((uint32_t) pdu[19] << 24) | ((uint32_t) pdu[18] << 16) | ((uint32_t) pdu[17] << 8) | pdu[16]);
+
+        if ((pdu[0] != AGENTX_VERSION) || (payloadLen > AGENTX_MAX_PDU)) {
+            fprintf(stderr, "%s: invalid PDU header!\n", __func__);
+            return -1;
+        }
+        if ((master->rxLen - pos) < (AGENTX_HEADER_LEN + payloadLen)) {
+            break;      // partial PDU
+        }
+
+        if (procPdu(master, pdu, (AGENTX_HEADER_LEN + payloadLen)) != 0) {
+            return -1;
+        }
+        pos += AGENTX_HEADER_LEN + payloadLen;
+    }
+
+    memmove(master->rxBuf, &master->rxBuf[pos], (master->rxLen - pos));
+    master->rxLen -= pos;
+
+    return 0;
+}
+
+// Wait for the PDUs of the subagent until the deadline (usec)
+// or the condition; returns -1 if the session was closed.
+static int waitInput(AgentxMaster *master, uint64_t deadline, bool *cond)
+{
+    while (!*cond) {
+        struct pollfd pfd = { .fd = master->fd, .events = POLLIN };
+        uint64_t now = agentxUsec();
+        int ret;
+
+        if (now >= deadline) {
+            break;
+        }
+
+        if ((ret = poll(&pfd, 1, ((deadline - now + 999) / 1000))) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        if ((ret > 0) && (procInput(master) != 0)) {
+            agentxDisconnect(master);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int listenSocket(AgentxMaster *master, const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+    if (strlen(path) >= sizeof (addr.sun_path)) {
+        fprintf(stderr, "%s: socket path too long: %s\n", __func__, path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    if (((master->listenFd = socket(AF_UNIX, (SOCK_STREAM | SOCK_CLOEXEC), 0)) == -1) ||
+        (bind(master->listenFd, (struct sockaddr *) &addr, sizeof (addr)) != 0) ||
+        (listen(master->listenFd, 4) != 0)) {
+        fprintf(stderr, "%s: can't listen on %s: %s\n", __func__, path, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+int agentxListen(AgentxMaster *master, const char *path)
+{
+    memset(master, 0, sizeof (*master));
+    master->fd = -1;
+    master->startTime = agentxUsec();
+
+    return listenSocket(master, path);
+}
+
+int agentxAccept(AgentxMaster *master, int timeout)
+{
+    uint64_t deadline = agentxUsec() + ((uint64_t) timeout * 1000);
+    struct pollfd pfd = { .fd = master->listenFd, .events = POLLIN };
+
+    while (master->fd == -1) {
+        uint64_t now = agentxUsec();
+        int ret;
+
+        if ((now >= deadline) ||
+            (((ret = poll(&pfd, 1, ((deadline - now + 999) / 1000))) < 0) && (errno != EINTR))) {
+            return -1;
+        }
+
+        if ((ret > 0) && ((master->fd = accept4(master->listenFd, NULL, NULL, SOCK_CLOEXEC)) == -1)) {
+            return -1;
+        }
+    }
+
+    master->registered = false;
+    master->rxLen = 0;
+
+    if ((waitInput(master, deadline, &master->registered) != 0) || !master->registered) {
+        return -1;
+    }
+
+    return 0;
+}
+
+void agentxDisconnect(AgentxMaster *master)
+{
+    if (master->fd != -1) {
+        close(master->fd);
+        master->fd = -1;
+    }
+    master->registered = false;
+    master->rxLen = 0;
+    master->varBinds = NULL;
+}
+
+void agentxStop(AgentxMaster *master, const char *path)
+{
+    agentxDisconnect(master);
+    if (master->listenFd != -1) {
+        close(master->listenFd);
+        master->listenFd = -1;
+    }
+    unlink(path);
+}
+
+int agentxRestart(AgentxMaster *master, const char *path)
+{
+    return listenSocket(master, path);
+}
+
+void agentxClose(AgentxMaster *master)
+{
+    agentxDisconnect(master);
+    if (master->listenFd != -1) {
+        close(master->listenFd);
+        master->listenFd = -1;
+    }
+    free(master->rxBuf);
+    master->rxBuf = NULL;
+    master->rxMax = 0;
+}
+
+int agentxRequest(AgentxMaster *master, uint8_t type, const AgentxOid *oids, size_t numOids,
+                  uint16_t maxRepetitions, AgentxVarBind *varBinds, size_t maxVarBinds, int timeout)
+{
+    static PduBuf buf;
+
+    if (master->fd == -1) {
+        return -1;
+    }
+
+    master->packetId++;
+    putHeader(&buf, type, master->sessionId, master->packetId, master->packetId);
+    if (type == AGENTX_GETBULK_PDU) {
+        put16(&buf, 0);     // non_repeaters
+        put16(&buf, maxRepetitions);
+    }
+    for (size_t n = 0; n < numOids; n++) {
+        putOid(&buf, &oids[n]);
+        putNullOid(&buf);   // no upper bound
+    }
+
+    master->waitPacketId = master->packetId;
+    master->varBinds = varBinds;
+    master->maxVarBinds = maxVarBinds;
+    master->numVarBinds = -1;
+    master->responded = false;
+
+    if (sendPdu(master, &buf) != 0) {
+        agentxDisconnect(master);
+        return -1;
+    }
+
+    if (waitInput(master, (agentxUsec() + ((uint64_t) timeout * 1000)), &master->responded) != 0) {
+        return -1;
+    }
+
+    if (!master->responded) {
+        fprintf(stderr, "%s: no response to request %u\n", __func__, master->packetId);
+        master->varBinds = NULL;
+        return -1;
+    }
+
+    return (master->numVarBinds >= 0) ? master->numVarBinds : -1;
+}
+
+int agentxPoll(AgentxMaster *master, int timeout, bool stopOnNotify)
+{
+    bool never = false;
+
+    if (master->fd == -1) {
+        return -1;
+    }
+
+    master->notified = false;
+
+    return waitInput(master, (agentxUsec() + ((uint64_t) timeout * 1000)), (stopOnNotify ? &master->notified : &never));
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+// A stand-in AgentX master agent (RFC 2741), just enough of it
+// to benchmark a subagent on one machine without snmpd: it
+// listens on a Unix socket, accepts one subagent session, acks
+// its Open, Register, Notify, and Ping PDUs, and sends it Get,
+// GetNext and GetBulk requests, one at a time.
+
+#define AGENTX_MAX_SUBIDS   128
+#define AGENTX_MAX_VARBINDS 1024
+
+// PDU types
+#define AGENTX_OPEN_PDU         1
+#define AGENTX_CLOSE_PDU        2
+#define AGENTX_REGISTER_PDU     3
+#define AGENTX_GET_PDU          5
+#define AGENTX_GETNEXT_PDU      6
+#define AGENTX_GETBULK_PDU      7
+#define AGENTX_NOTIFY_PDU       12
+#define AGENTX_PING_PDU         13
+#define AGENTX_RESPONSE_PDU     18
+
+// VarBind types
+#define AGENTX_INTEGER          2
+#define AGENTX_OCTET_STRING     4
+#define AGENTX_NULL             5
+#define AGENTX_OBJECT_ID        6
+#define AGENTX_IP_ADDRESS       64
+#define AGENTX_COUNTER32        65
+#define AGENTX_GAUGE32          66
+#define AGENTX_TIME_TICKS       67
+#define AGENTX_OPAQUE           68
+#define AGENTX_COUNTER64        70
+#define AGENTX_NO_SUCH_OBJECT   128
+#define AGENTX_NO_SUCH_INSTANCE 129
+#define AGENTX_END_OF_MIB_VIEW  130
+
+typedef struct AgentxOid {
+    uint32_t subIds[AGENTX_MAX_SUBIDS];
+    size_t len;
+} AgentxOid;
+
+typedef struct AgentxVarBind {
+    uint16_t type;
+    AgentxOid name;
+    uint64_t value;         // value of the integer types; length of the strings
+    AgentxOid oidValue;     // value of the OBJECT IDENTIFIER type
+} AgentxVarBind;
+
+// Called for each Notify PDU, with the time it was read
+typedef void (AgentxNotifyFunc)(void *arg, const AgentxVarBind *varBinds, size_t numVarBinds, uint64_t usec);
+
+typedef struct AgentxMaster {
+    int listenFd;
+    int fd;                 // -1 when no subagent is connected
+    uint32_t sessionId;
+    uint32_t packetId;
+    bool registered;        // the subagent registered a subtree
+    uint8_t *rxBuf;
+    size_t rxLen;
+    size_t rxMax;
+    uint64_t startTime;     // usec; for the sysUpTime of the responses
+    AgentxNotifyFunc *notifyFunc;
+    void *notifyArg;
+    unsigned long numRegisters;
+    unsigned long numNotifies;
+    unsigned long numPings;
+
+    // The request waiting for its response
+    uint32_t waitPacketId;
+    AgentxVarBind *varBinds;
+    size_t maxVarBinds;
+    int numVarBinds;        // of the response; negative on error
+    bool responded;         // the response was read
+    bool notified;          // a Notify PDU was read
+} AgentxMaster;
+
+// Time from CLOCK_MONOTONIC, in usec
+extern uint64_t agentxUsec(void);
+
+// Parse a dotted OID, e.g. "1.3.6.1.3.9999". Returns -1 if
+// it's invalid.
+extern int agentxOidParse(AgentxOid *oid, const char *str);
+
+// Is the OID under the prefix?
+extern bool agentxOidUnder(const AgentxOid *oid, const AgentxOid *prefix);
+
+extern int agentxListen(AgentxMaster *master, const char *path);
+
+// Wait, up to the timeout (msec), for a subagent to connect,
+// open its session, and register a subtree
+extern int agentxAccept(AgentxMaster *master, int timeout);
+
+// Drop the session, as a restarted master would
+extern void agentxDisconnect(AgentxMaster *master);
+
+// Drop the session and remove the socket, as a stopped master
+// would, so the subagent can't connect until agentxRestart()
+// listens on it again; the counters and callbacks are kept
+extern void agentxStop(AgentxMaster *master, const char *path);
+
+extern int agentxRestart(AgentxMaster *master, const char *path);
+
+extern void agentxClose(AgentxMaster *master);
+
+// Send a Get, GetNext, or GetBulk request for the OIDs, and
+// wait, up to the timeout (msec), for the response, while
+// serving the other PDUs of the subagent. For GetBulk, all
+// the OIDs are repeaters. Returns the number of varbinds of
+// the response, or -1 on error.
+extern int agentxRequest(AgentxMaster *master, uint8_t type, const AgentxOid *oids, size_t numOids,
+                         uint16_t maxRepetitions, AgentxVarBind *varBinds, size_t maxVarBinds, int timeout);
+
+// Serve the PDUs of the subagent for up to the timeout (msec),
+// or until the first Notify PDU if stopOnNotify. Returns -1
+// if the session was closed.
+extern int agentxPoll(AgentxMaster *master, int timeout, bool stopOnNotify);
+
+__END_DECLS
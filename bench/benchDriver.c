@@ -0,0 +1,925 @@
+// Benchmark of the snmpSubagent on one machine: it generates
+// the object and data files, starts the subagent against the
+// stand-in AgentX master of agentx.c, and then measures:
+// - the time it takes to register, and to serve the values;
+// - the latency of GET, GETNEXT and GETBULK requests;
+// - the time it takes to apply a rewrite of the data files
+//   with some of the values changed, and the CPU it costs;
+// - the time from the send of a batch of updates to the
+//   update socket to the moment they are served, and the
+//   throughput of a stream of batches;
+// - the time from a data file rewrite that raises an alarm
+//   to its trap;
+// - the time the subagent takes to register again, and to
+//   serve a GET, once a stopped master listens again, and
+//   the traps of the alarms raised while it was stopped;
+// - the RSS of the subagent.
+// The results are written to stdout as one JSON object.
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "agentx.h"
+#include "gen.h"
+#include "updateSocket.h"
+
+#define REQUEST_TIMEOUT     5000    // msec
+#define STARTUP_TIMEOUT     60000   // msec
+#define INGEST_TIMEOUT      30000   // msec
+#define TRAP_TIMEOUT        5000    // msec
+#define MAX_SUBAGENT_ARGS   64
+
+extern char **environ;
+
+static const char *help =
+        "SYNTAX:\n"
+        "    benchDriver [OPTIONS]\n"
+        "\n"
+        "OPTIONS:\n"
+        "    --subagent <path>          snmpSubagent binary (default ../snmpSubagent).\n"
+        "    --config-file <path>       Its --config-file (default: an empty one, so\n"
+        "                               that the subagent leaves snmpd.conf alone).\n"
+        "    --subagent-arg <arg>       Extra argument of the subagent; can be repeated.\n"
+        "    --label <text>             Label of the results, e.g. of a sweep.\n"
+        "    --dir <path>               Directory of the generated files, the AgentX\n"
+        "                               socket, and the subagent log (default: a new\n"
+        "                               /tmp/snmpBench.XXXXXX directory).\n"
+        "    --objects <num>            Number of objects (default 10000).\n"
+        "    --units <num>              Number of A/C units (default 100).\n"
+        "    --data-files <num>         Number of data files (default 1).\n"
+        "    --churn <percent>          Values changed by each data file rewrite (default 10).\n"
+        "    --requests <num>           Number of GET requests (default 10000).\n"
+        "    --walks <num>              Number of GETNEXT and GETBULK walks (default 1).\n"
+        "    --max-repetitions <num>    Of the GETBULK requests (default 50).\n"
+        "    --passes <num>             Number of data file rewrites (default 20).\n"
+        "    --socket-batches <num>     Number of batches sent to the update socket of the\n"
+        "                               subagent, one at a time, and then as a stream\n"
+        "                               (default 0: the update socket isn't used).\n"
+        "    --batch-size <num>         Updates per batch (default 100).\n"
+        "    --traps <num>              Number of alarm traps (default 20).\n"
+        "    --restarts <num>           Number of restarts of the AgentX master (default 0).\n"
+        "    --downtime <msec>          Time the master is stopped by each restart\n"
+        "                               (default 1000).\n"
+        "    --seed <num>               Seed of the random values (default 1).\n"
+        "\n";
+
+typedef struct BenchArgs {
+    const char *subagent;
+    const char *configFile;
+    const char *subagentArgs[MAX_SUBAGENT_ARGS];
+    size_t numSubagentArgs;
+    const char *label;
+    const char *dir;
+    size_t numObjects;
+    size_t numUnits;
+    size_t numFiles;
+    double churnPct;
+    size_t numRequests;
+    size_t numWalks;
+    unsigned maxRepetitions;
+    size_t numPasses;
+    size_t numBatches;
+    size_t batchSize;
+    size_t numTraps;
+    size_t numRestarts;
+    unsigned downtime;
+    unsigned seed;
+} BenchArgs;
+
+// Latencies of a phase
+typedef struct Latencies {
+    uint32_t *usec;
+    size_t num;
+    size_t max;
+    uint64_t startTime;
+    uint64_t endTime;
+    unsigned long errors;
+} Latencies;
+
+typedef struct Bench {
+    BenchArgs args;
+    GenSet set;
+    AgentxMaster master;
+    AgentxOid prefix;       // of the subtree of the subagent
+    pid_t pid;
+    char sockPath[4096 + 16];
+    char updateSockPath[4096 + 16];
+    int trapUnit;           // A/C unit of the last trap
+    uint64_t trapTime;
+} Bench;
+
+static AgentxVarBind varBinds[AGENTX_MAX_VARBINDS];
+
+static int latAdd(Latencies *lat, uint64_t usec)
+{
+    if (lat->num == lat->max) {
+        size_t max = (lat->max != 0) ? (lat->max * 2) : 1024;
+        uint32_t *buf;
+
+        if ((buf = realloc(lat->usec, (max * sizeof (uint32_t)))) == NULL) {
+            return -1;
+        }
+        lat->usec = buf;
+        lat->max = max;
+    }
+
+    lat->usec[lat->num++] = (usec > UINT32_MAX) ? UINT32_MAX : usec;
+
+    return 0;
+}
+
+static int cmpUint32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+static uint32_t latPercentile(const Latencies *lat, double p)
+{
+    size_t n = (size_t) (p * lat->num);
+
+    if (lat->num == 0) {
+        return 0;
+    }
+
+    return lat->usec[(n < lat->num) ? n : (lat->num - 1)];
+}
+
+// Print the percentiles of a phase, as the members of a JSON
+// object; the latencies are sorted.
+static void latPrint(Latencies *lat, const char *countName)
+{
+    double secs = (lat->endTime - lat->startTime) / 1e6;
+
+    qsort(lat->usec, lat->num, sizeof (uint32_t), cmpUint32);
+
+    printf("\"%s\": %zu, \"errors\": %lu, \"perSec\": %.1f, "
+           "\"p50Usec\": %u, \"p90Usec\": %u, \"p99Usec\": %u, \"p999Usec\": %u, \"maxUsec\": %u",
+           countName, lat->num, lat->errors, ((secs > 0) ? (lat->num / secs) : 0),
+           latPercentile(lat, 0.5), latPercentile(lat, 0.9), latPercentile(lat, 0.99), latPercentile(lat, 0.999),
+           ((lat->num != 0) ? lat->usec[lat->num - 1] : 0));
+}
+
+// Same as latPrint(), with the throughput of the walks
+static void walkPrint(Latencies *lat, size_t numWalks, long varBindsPerWalk)
+{
+    double secs = (lat->endTime - lat->startTime) / 1e6;
+
+    printf("\"walks\": %zu, \"varBindsPerWalk\": %ld, \"walkMsec\": %.3f, \"varBindsPerSec\": %.0f, ",
+           numWalks, varBindsPerWalk, ((numWalks != 0) ? ((secs * 1e3) / numWalks) : 0),
+           ((secs > 0) ? ((varBindsPerWalk * numWalks) / secs) : 0));
+    latPrint(lat, "requests");
+}
+
+static void latFree(Latencies *lat)
+{
+    free(lat->usec);
+    memset(lat, 0, sizeof (*lat));
+}
+
+// Get the RSS and peak RSS of the subagent, in KB
+static void procRss(pid_t pid, unsigned long *rss, unsigned long *maxRss)
+{
+    char path[64], line[256];
+    FILE *fp;
+
+    *rss = *maxRss = 0;
+
+    snprintf(path, sizeof (path), "/proc/%d/status", (int) pid);
+    if ((fp = fopen(path, "r")) == NULL) {
+        return;
+    }
+
+    while (fgets(line, sizeof (line), fp) != NULL) {
+        sscanf(line, "VmRSS: %lu", rss);
+        sscanf(line, "VmHWM: %lu", maxRss);
+    }
+
+    fclose(fp);
+}
+
+// Get the CPU time used by the subagent, in msec
+static double procCpuMsec(pid_t pid)
+{
+    char path[64], buf[1024];
+    unsigned long utime = 0, stime = 0;
+    const char *stat;
+    ssize_t len;
+    int fd;
+
+    snprintf(path, sizeof (path), "/proc/%d/stat", (int) pid);
+    if ((fd = open(path, O_RDONLY)) == -1) {
+        return 0;
+    }
+    len = read(fd, buf, (sizeof (buf) - 1));
+    close(fd);
+    if (len <= 0) {
+        return 0;
+    }
+    buf[len] = '\0';
+
+    // The fields after the command name, which may contain
+    // spaces; utime and stime are the 12th and 13th ones.
+    if (((stat = strrchr(buf, ')')) == NULL) ||
+        (sscanf(stat + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2)) {
+        return 0;
+    }
+
+    return ((utime + stime) * 1000.0) / sysconf(_SC_CLK_TCK);
+}
+
+static void objectOid(const Bench *bench, size_t index, AgentxOid *oid)
+{
+    agentxOidParse(oid, GEN_OBJECT_OID);
+    oid->subIds[oid->len++] = index + 1;
+    oid->subIds[oid->len++] = 0;
+}
+
+// GET the value of an object. Returns -1 on error, or if it's
+// not an Integer32.
+static int getObject(Bench *bench, size_t index, int *value)
+{
+    AgentxOid oid;
+
+    objectOid(bench, index, &oid);
+
+    if ((agentxRequest(&bench->master, AGENTX_GET_PDU, &oid, 1, 0, varBinds, AGENTX_MAX_VARBINDS, REQUEST_TIMEOUT) != 1) ||
+        (varBinds[0].type != AGENTX_INTEGER)) {
+        return -1;
+    }
+
+    *value = (int) (uint32_t) varBinds[0].value;
+
+    return 0;
+}
+
+// Wait until the subagent serves the value of the object.
+// Returns the time it took, in usec, or 0 on timeout.
+static uint64_t waitValue(Bench *bench, size_t index, int timeout, uint64_t startTime)
+{
+    uint64_t deadline = startTime + ((uint64_t) timeout * 1000);
+    int value;
+
+    while (agentxUsec() < deadline) {
+        if ((getObject(bench, index, &value) == 0) && (value == bench->set.values[index])) {
+            return agentxUsec() - startTime;
+        } else if (bench->master.fd == -1) {
+            break;
+        }
+        usleep(200);
+    }
+
+    return 0;
+}
+
+static void trapNotify(void *arg, const AgentxVarBind *varBinds, size_t numVarBinds, uint64_t usec)
+{
+    static const uint32_t unitOid[] = { 1, 3, 6, 1, 3, 9999, 6 };   // acHiTempAlarmUnit
+    Bench *bench = arg;
+
+    for (size_t n = 0; n < numVarBinds; n++) {
+        const AgentxOid *name = &varBinds[n].name;
+
+        if ((name->len >= 7) && (memcmp(name->subIds, unitOid, sizeof (unitOid)) == 0)) {
+            bench->trapUnit = (int) varBinds[n].value;
+            bench->trapTime = usec;
+        }
+    }
+}
+
+static int startSubagent(Bench *bench)
+{
+    const BenchArgs *args = &bench->args;
+    const char *argv[MAX_SUBAGENT_ARGS + 64];
+    char objectFile[4096 + 32], logFile[4096 + 32];
+    static char dataFiles[16][4096 + 32];
+    posix_spawn_file_actions_t actions;
+    size_t argc = 0;
+    int err;
+
+    snprintf(objectFile, sizeof (objectFile), "%s/objectFile.csv", args->dir);
+    snprintf(logFile, sizeof (logFile), "%s/subagent.log", args->dir);
+
+    argv[argc++] = args->subagent;
+    argv[argc++] = "--agentx-socket";
+    argv[argc++] = bench->sockPath;
+    argv[argc++] = "--config-file";
+    argv[argc++] = args->configFile;
+    argv[argc++] = "--object-file";
+    argv[argc++] = objectFile;
+    for (size_t n = 0; n < args->numFiles; n++) {
+        genDataFilePath(&bench->set, args->dir, n, dataFiles[n], sizeof (dataFiles[n]));
+        argv[argc++] = "--data-file";
+        argv[argc++] = dataFiles[n];
+    }
+    if (args->numBatches != 0) {
+        argv[argc++] = "--update-socket";
+        argv[argc++] = bench->updateSockPath;
+    }
+    argv[argc++] = "--trap-rate";       // measure the traps, not the rate limit
+    argv[argc++] = "0";
+    for (size_t n = 0; n < args->numSubagentArgs; n++) {
+        argv[argc++] = args->subagentArgs[n];
+    }
+    argv[argc] = NULL;
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, logFile, (O_WRONLY | O_CREAT | O_TRUNC), 0644);
+    posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+    err = posix_spawn(&bench->pid, args->subagent, &actions, NULL, (char **) argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (err != 0) {
+        fprintf(stderr, "%s: can't run %s: %s\n", __func__, args->subagent, strerror(err));
+        return -1;
+    }
+
+    return 0;
+}
+
+static int stopSubagent(Bench *bench, int *status)
+{
+    uint64_t deadline = agentxUsec() + (10 * 1000000);
+    pid_t ret;
+
+    kill(bench->pid, SIGTERM);
+
+    // Serve its Close PDU while it exits
+    while (((ret = waitpid(bench->pid, status, WNOHANG)) == 0) && (agentxUsec() < deadline)) {
+        if (agentxPoll(&bench->master, 10, false) != 0) {
+            usleep(10000);
+        }
+    }
+
+    if (ret == 0) {
+        fprintf(stderr, "%s: the subagent didn't exit; killing it\n", __func__);
+        kill(bench->pid, SIGKILL);
+        waitpid(bench->pid, status, 0);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Time for the subagent to open its AgentX session, and then
+// to serve the values of the data files
+static int benchStartup(Bench *bench, uint64_t *registerUsec, uint64_t *readyUsec)
+{
+    uint64_t startTime = agentxUsec();
+
+    if (startSubagent(bench) != 0) {
+        return -1;
+    }
+
+    if (agentxAccept(&bench->master, STARTUP_TIMEOUT) != 0) {
+        fprintf(stderr, "%s: the subagent didn't register (see %s/subagent.log)\n", __func__, bench->args.dir);
+        return -1;
+    }
+    *registerUsec = agentxUsec() - startTime;
+
+    if ((bench->set.numObjects != 0) &&
+        ((*readyUsec = waitValue(bench, (bench->set.numObjects - 1), STARTUP_TIMEOUT, startTime)) == 0)) {
+        fprintf(stderr, "%s: the subagent didn't serve the values\n", __func__);
+        return -1;
+    }
+
+    return 0;
+}
+
+// GET random objects, one at a time
+static int benchGet(Bench *bench, Latencies *lat)
+{
+    unsigned seed = bench->args.seed;
+
+    lat->startTime = agentxUsec();
+
+    for (size_t n = 0; (n < bench->args.numRequests) && (bench->set.numObjects != 0); n++) {
+        size_t index = rand_r(&seed) % bench->set.numObjects;
+        uint64_t start = agentxUsec();
+        int value;
+
+        if ((getObject(bench, index, &value) != 0) || (value != bench->set.values[index])) {
+            if (bench->master.fd == -1) {
+                return -1;
+            }
+            lat->errors++;
+        }
+        latAdd(lat, (agentxUsec() - start));
+    }
+
+    lat->endTime = agentxUsec();
+
+    return 0;
+}
+
+// Walk the subtree of the subagent, with GETNEXT or GETBULK
+// requests. Returns the number of varbinds, or -1 on error.
+static long benchWalk(Bench *bench, uint8_t type, Latencies *lat)
+{
+    AgentxOid oid = bench->prefix;
+    long numVarBinds = 0;
+
+    while (true) {
+        uint64_t start = agentxUsec();
+        int num = agentxRequest(&bench->master, type, &oid, 1, bench->args.maxRepetitions,
+                                varBinds, AGENTX_MAX_VARBINDS, REQUEST_TIMEOUT);
+
+        latAdd(lat, (agentxUsec() - start));
+
+        if (num <= 0) {
+            lat->errors++;
+            return -1;
+        }
+
+        for (int n = 0; n < num; n++) {
+            if ((varBinds[n].type == AGENTX_END_OF_MIB_VIEW) || !agentxOidUnder(&varBinds[n].name, &bench->prefix)) {
+                return numVarBinds;
+            }
+            oid = varBinds[n].name;
+            numVarBinds++;
+        }
+    }
+}
+
+// Rewrite the data files with some of the values changed, and
+// wait until the subagent serves one of the new values; the
+// values of a pass are published together.
+static int benchIngest(Bench *bench, Latencies *lat, unsigned long *numRecords, double *cpuMsec)
+{
+    double cpuStart = procCpuMsec(bench->pid);
+
+    *numRecords = 0;
+    lat->startTime = agentxUsec();
+
+    for (size_t pass = 0; pass < bench->args.numPasses; pass++) {
+        uint64_t start, usec;
+        size_t changed;
+
+        *numRecords += genChurn(&bench->set, bench->args.churnPct, &changed);
+
+        start = agentxUsec();
+        if (genWriteDataFiles(&bench->set, bench->args.dir) != 0) {
+            return -1;
+        }
+
+        if ((usec = waitValue(bench, changed, INGEST_TIMEOUT, start)) == 0) {
+            if (bench->master.fd == -1) {
+                return -1;
+            }
+            lat->errors++;
+            continue;
+        }
+        latAdd(lat, usec);
+    }
+
+    lat->endTime = agentxUsec();
+    *cpuMsec = procCpuMsec(bench->pid) - cpuStart;
+
+    return 0;
+}
+
+// Send a batch of updates of distinct objects to the update
+// socket. Returns the index of the last object of the batch.
+static ssize_t sendBatch(Bench *bench, int fd, const struct sockaddr_un *addr)
+{
+    static char buf[UPDATE_SOCKET_MSG_SIZE];
+    size_t numChanged = genChange(&bench->set, bench->args.batchSize);
+    size_t len = 0;
+
+    for (size_t n = 0; n < numChanged; n++) {
+        size_t index = bench->set.order[n];
+
+        len += snprintf(&buf[len], (sizeof (buf) - len), "benchObj%zu=%d\n", (index + 1), bench->set.values[index]);
+    }
+
+    if (sendto(fd, buf, len, 0, (const struct sockaddr *) addr, sizeof (*addr)) != (ssize_t) len) {
+        fprintf(stderr, "%s: can't send to %s: %s\n", __func__, addr->sun_path, strerror(errno));
+        return -1;
+    }
+
+    return bench->set.order[numChanged - 1];
+}
+
+// Send batches of updates to the update socket, one at a time,
+// and wait until each one is served; then send them as fast as
+// the socket takes them, and wait until the last one is served
+static int benchSocket(Bench *bench, Latencies *lat, uint64_t *streamUsec)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    uint64_t start;
+    ssize_t index = 0;
+    int fd;
+
+    if (bench->args.numBatches == 0) {
+        return 0;
+    }
+
+    if (strlen(bench->updateSockPath) >= sizeof (addr.sun_path)) {
+        fprintf(stderr, "%s: path too long: %s\n", __func__, bench->updateSockPath);
+        return -1;
+    }
+    strcpy(addr.sun_path, bench->updateSockPath);
+
+    if ((fd = socket(AF_UNIX, (SOCK_DGRAM | SOCK_CLOEXEC), 0)) == -1) {
+        return -1;
+    }
+
+    lat->startTime = agentxUsec();
+    for (size_t n = 0; n < bench->args.numBatches; n++) {
+        uint64_t usec;
+
+        start = agentxUsec();
+        if ((index = sendBatch(bench, fd, &addr)) < 0) {
+            close(fd);
+            return -1;
+        }
+
+        if ((usec = waitValue(bench, index, INGEST_TIMEOUT, start)) == 0) {
+            if (bench->master.fd == -1) {
+                close(fd);
+                return -1;
+            }
+            lat->errors++;
+            continue;
+        }
+        latAdd(lat, usec);
+    }
+    lat->endTime = agentxUsec();
+
+    start = agentxUsec();
+    for (size_t n = 0; n < bench->args.numBatches; n++) {
+        if ((index = sendBatch(bench, fd, &addr)) < 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    *streamUsec = waitValue(bench, index, INGEST_TIMEOUT, start);
+
+    close(fd);
+
+    return 0;
+}
+
+// Raise the alarm of a different A/C unit each time, so the
+// traps are never coalesced, and wait for its trap
+static int benchTraps(Bench *bench, Latencies *lat)
+{
+    size_t numTraps = (bench->args.numTraps < bench->set.numUnits) ? bench->args.numTraps : bench->set.numUnits;
+
+    bench->master.notifyFunc = trapNotify;
+    bench->master.notifyArg = bench;
+    lat->startTime = agentxUsec();
+
+    for (size_t n = 0; n < numTraps; n++) {
+        uint64_t start, deadline;
+
+        bench->set.unitTemps[n] = GEN_HI_THRESHOLD + 10;
+        bench->trapUnit = 0;
+
+        start = agentxUsec();
+        if (genWriteDataFiles(&bench->set, bench->args.dir) != 0) {
+            return -1;
+        }
+
+        deadline = start + (TRAP_TIMEOUT * 1000);
+        while ((bench->trapUnit != (int) (n + 1)) && (agentxUsec() < deadline)) {
+            if (agentxPoll(&bench->master, ((deadline - agentxUsec()) / 1000), true) != 0) {
+                return -1;
+            }
+        }
+
+        if (bench->trapUnit == (int) (n + 1)) {
+            latAdd(lat, (bench->trapTime - start));
+        } else {
+            lat->errors++;
+        }
+    }
+
+    lat->endTime = agentxUsec();
+    bench->master.notifyFunc = NULL;
+
+    return 0;
+}
+
+// Stop the master, raise the alarm of an A/C unit while it is
+// stopped, and listen again after the downtime. Each restart
+// measures the time to the new registration and to the first
+// GET that succeeds, both from the moment the master listens
+// again, and whether the trap of the alarm is sent once the
+// session is back.
+static int benchRestarts(Bench *bench, Latencies *registerLat, Latencies *getLat, unsigned long *heldTraps)
+{
+    const BenchArgs *args = &bench->args;
+    struct timespec downtime = { (args->downtime / 1000), ((args->downtime % 1000) * 1000000) };
+
+    bench->master.notifyFunc = trapNotify;
+    bench->master.notifyArg = bench;
+    registerLat->startTime = getLat->startTime = agentxUsec();
+
+    for (size_t n = 0; n < args->numRestarts; n++) {
+        // The units from the last one down, so they differ
+        // from the ones of benchTraps()
+        size_t unit = (n < bench->set.numUnits) ? (bench->set.numUnits - 1 - n) : bench->set.numUnits;
+        uint64_t start, deadline;
+        int value;
+
+        agentxStop(&bench->master, bench->sockPath);
+        bench->trapUnit = 0;
+        if (unit < bench->set.numUnits) {
+            bench->set.unitTemps[unit] = GEN_HI_THRESHOLD + 10;
+            if (genWriteDataFiles(&bench->set, args->dir) != 0) {
+                return -1;
+            }
+        }
+        nanosleep(&downtime, NULL);
+
+        start = agentxUsec();
+        if (agentxRestart(&bench->master, bench->sockPath) != 0) {
+            return -1;
+        }
+        if (agentxAccept(&bench->master, STARTUP_TIMEOUT) != 0) {
+            fprintf(stderr, "%s: the subagent didn't register again (see %s/subagent.log)\n", __func__, args->dir);
+            registerLat->errors++;
+            continue;
+        }
+        latAdd(registerLat, (agentxUsec() - start));
+
+        deadline = start + ((uint64_t) REQUEST_TIMEOUT * 1000);
+        while ((bench->set.numObjects != 0) && (getObject(bench, 0, &value) != 0) &&
+               (bench->master.fd != -1) && (agentxUsec() < deadline)) {
+            usleep(200);
+        }
+        if ((bench->set.numObjects != 0) && (agentxUsec() < deadline) && (bench->master.fd != -1)) {
+            latAdd(getLat, (agentxUsec() - start));
+        } else {
+            getLat->errors++;
+        }
+
+        if (unit < bench->set.numUnits) {
+            deadline = agentxUsec() + (TRAP_TIMEOUT * 1000);
+            while ((bench->trapUnit != (int) (unit + 1)) && (agentxUsec() < deadline)) {
+                if (agentxPoll(&bench->master, ((deadline - agentxUsec()) / 1000), true) != 0) {
+                    return -1;
+                }
+            }
+            *heldTraps += (bench->trapUnit == (int) (unit + 1));
+        }
+    }
+
+    registerLat->endTime = getLat->endTime = agentxUsec();
+    bench->master.notifyFunc = NULL;
+
+    return 0;
+}
+
+static int parseArgs(int argc, char *argv[], BenchArgs *args)
+{
+    for (int n = 1; n < argc; n++) {
+        const char *arg = argv[n];
+
+        if (strcmp(arg, "--help") == 0) {
+            printf("%s", help);
+            exit(0);
+        } else if (n + 1 == argc) {
+            fprintf(stderr, "ERROR: invalid argument \"%s\"\n\n%s", arg, help);
+            return -1;
+        }
+
+        if (strcmp(arg, "--subagent") == 0) {
+            args->subagent = argv[++n];
+        } else if (strcmp(arg, "--config-file") == 0) {
+            args->configFile = argv[++n];
+        } else if ((strcmp(arg, "--subagent-arg") == 0) && (args->numSubagentArgs < MAX_SUBAGENT_ARGS)) {
+            args->subagentArgs[args->numSubagentArgs++] = argv[++n];
+        } else if (strcmp(arg, "--label") == 0) {
+            args->label = argv[++n];
+        } else if (strcmp(arg, "--dir") == 0) {
+            args->dir = argv[++n];
+        } else if (strcmp(arg, "--objects") == 0) {
+            args->numObjects = strtoul(argv[++n], NULL, 0);
+        } else if (strcmp(arg, "--units") == 0) {
+            args->numUnits = strtoul(argv[++n], NULL, 0);
+        } else if (strcmp(arg, "--data-files") == 0) {
+            args->numFiles = strtoul(argv[++n], NULL, 0);
+        } else if (strcmp(arg, "--churn") == 0) {
+            args->churnPct = strtod(argv[++n], NULL);
+        } else if (strcmp(arg, "--requests") == 0) {
+            args->numRequests = strtoul(argv[++n], NULL, 0);
+        } else if (strcmp(arg, "--walks") == 0) {
+            args->numWalks = strtoul(argv[++n], NULL, 0);
+        } else if (strcmp(arg, "--max-repetitions") == 0) {
+            args->maxRepetitions = strtoul(argv[++n], NULL, 0);
+        } else if (strcmp(arg, "--passes") == 0) {
+            args->numPasses = strtoul(argv[++n], NULL, 0);
+        } else if (strcmp(arg, "--socket-batches") == 0) {
+            args->numBatches = strtoul(argv[++n], NULL, 0);
+        } else if (strcmp(arg, "--batch-size") == 0) {
+            args->batchSize = strtoul(argv[++n], NULL, 0);
+        } else if (strcmp(arg, "--traps") == 0) {
+            args->numTraps = strtoul(argv[++n], NULL, 0);
+        } else if (strcmp(arg, "--restarts") == 0) {
+            args->numRestarts = strtoul(argv[++n], NULL, 0);
+        } else if (strcmp(arg, "--downtime") == 0) {
+            args->downtime = strtoul(argv[++n], NULL, 0);
+        } else if (strcmp(arg, "--seed") == 0) {
+            args->seed = strtoul(argv[++n], NULL, 0);
+        } else {
+            fprintf(stderr, "ERROR: invalid argument \"%s\"\n\n%s", arg, help);
+            return -1;
+        }
+    }
+
+    if ((args->numFiles == 0) || (args->numFiles > 16) || (args->maxRepetitions == 0) ||
+        (args->maxRepetitions > AGENTX_MAX_VARBINDS) || (args->batchSize == 0) ||
+        ((args->batchSize * 32) > UPDATE_SOCKET_MSG_SIZE) || ((args->numBatches != 0) && (args->numObjects == 0))) {
+        fprintf(stderr, "ERROR: invalid --data-files, --max-repetitions or --batch-size\n\n%s", help);
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static Bench bench = {
+        .args = {
+            .subagent = "../snmpSubagent",
+            .numObjects = 10000,
+            .numUnits = 100,
+            .numFiles = 1,
+            .churnPct = 10,
+            .numRequests = 10000,
+            .numWalks = 1,
+            .maxRepetitions = 50,
+            .numPasses = 20,
+            .batchSize = 100,
+            .numTraps = 20,
+            .downtime = 1000,
+            .seed = 1,
+        },
+    };
+    BenchArgs *args = &bench.args;
+    Latencies getLat = { 0 }, getNextLat = { 0 }, getBulkLat = { 0 }, ingestLat = { 0 }, socketLat = { 0 }, trapLat = { 0 };
+    Latencies restartRegisterLat = { 0 }, restartGetLat = { 0 };
+    uint64_t registerUsec = 0, readyUsec = 0, streamUsec = 0;
+    unsigned long rss, maxRss, loadRss, numRecords = 0, heldTraps = 0;
+    long getNextVarBinds = 0, getBulkVarBinds = 0;
+    double cpuMsec = 0, totalCpuMsec;
+    char dirTemplate[] = "/tmp/snmpBench.XXXXXX";
+    char path[4096 + 32];
+    int status = 0;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    if (parseArgs(argc, argv, args) != 0) {
+        return 1;
+    }
+
+    if (args->dir == NULL) {
+        if ((args->dir = mkdtemp(dirTemplate)) == NULL) {
+            fprintf(stderr, "ERROR: can't create %s: %s\n", dirTemplate, strerror(errno));
+            return 1;
+        }
+    } else if ((mkdir(args->dir, 0755) != 0) && (errno != EEXIST)) {
+        fprintf(stderr, "ERROR: can't create %s: %s\n", args->dir, strerror(errno));
+        return 1;
+    }
+
+    agentxOidParse(&bench.prefix, "1.3.6.1.3.9999");
+    snprintf(bench.sockPath, sizeof (bench.sockPath), "%s/agentx.sock", args->dir);
+    snprintf(bench.updateSockPath, sizeof (bench.updateSockPath), "%s/update.sock", args->dir);
+    if (args->configFile == NULL) {
+        static char configFile[4096 + 32];
+        FILE *fp;
+
+        snprintf(configFile, sizeof (configFile), "%s/configFile.csv", args->dir);
+        if (((fp = fopen(configFile, "w")) == NULL) ||
+            (fprintf(fp, "# No snmpd.conf directives: snmpd.conf is left alone\n") < 0) || (fclose(fp) != 0)) {
+            fprintf(stderr, "ERROR: can't write %s\n", configFile);
+            return 1;
+        }
+        args->configFile = configFile;
+    }
+    snprintf(path, sizeof (path), "%s/objectFile.csv", args->dir);
+
+    if ((genInit(&bench.set, args->numObjects, args->numUnits, args->numFiles, args->seed) != 0) ||
+        (genWriteObjectFile(&bench.set, path) != 0) || (genWriteDataFiles(&bench.set, args->dir) != 0) ||
+        (agentxListen(&bench.master, bench.sockPath) != 0)) {
+        return 1;
+    }
+
+    if (benchStartup(&bench, &registerUsec, &readyUsec) != 0) {
+        if (bench.pid > 0) {
+            kill(bench.pid, SIGKILL);
+        }
+        return 1;
+    }
+    procRss(bench.pid, &loadRss, &maxRss);
+
+    if (benchGet(&bench, &getLat) != 0) {
+        fprintf(stderr, "ERROR: GET failed\n");
+        return 1;
+    }
+
+    getNextLat.startTime = agentxUsec();
+    for (size_t n = 0; n < args->numWalks; n++) {
+        if ((getNextVarBinds = benchWalk(&bench, AGENTX_GETNEXT_PDU, &getNextLat)) < 0) {
+            fprintf(stderr, "ERROR: GETNEXT walk failed\n");
+            return 1;
+        }
+    }
+    getNextLat.endTime = agentxUsec();
+
+    getBulkLat.startTime = agentxUsec();
+    for (size_t n = 0; n < args->numWalks; n++) {
+        if ((getBulkVarBinds = benchWalk(&bench, AGENTX_GETBULK_PDU, &getBulkLat)) < 0) {
+            fprintf(stderr, "ERROR: GETBULK walk failed\n");
+            return 1;
+        }
+    }
+    getBulkLat.endTime = agentxUsec();
+
+    if (benchIngest(&bench, &ingestLat, &numRecords, &cpuMsec) != 0) {
+        fprintf(stderr, "ERROR: the data file rewrites failed\n");
+        return 1;
+    }
+
+    if (benchSocket(&bench, &socketLat, &streamUsec) != 0) {
+        fprintf(stderr, "ERROR: the update socket batches failed\n");
+        return 1;
+    }
+
+    if (benchTraps(&bench, &trapLat) != 0) {
+        fprintf(stderr, "ERROR: the traps failed\n");
+        return 1;
+    }
+
+    if (benchRestarts(&bench, &restartRegisterLat, &restartGetLat, &heldTraps) != 0) {
+        fprintf(stderr, "ERROR: the restarts of the master failed\n");
+        return 1;
+    }
+
+    procRss(bench.pid, &rss, &maxRss);
+    totalCpuMsec = procCpuMsec(bench.pid);
+    stopSubagent(&bench, &status);
+
+    printf("{\n");
+    if (args->label != NULL) {
+        printf("  \"label\": \"%s\",\n", args->label);
+    }
+    printf("  \"objects\": %zu, \"units\": %zu, \"dataFiles\": %zu, \"churnPct\": %g, \"cpus\": %ld,\n",
+           args->numObjects, args->numUnits, args->numFiles, args->churnPct, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("  \"registerMsec\": %.3f, \"readyMsec\": %.3f, \"registrations\": %lu, \"loadRssKb\": %lu,\n",
+           (registerUsec / 1e3), (readyUsec / 1e3), bench.master.numRegisters, loadRss);
+    printf("  \"get\": { ");
+    latPrint(&getLat, "requests");
+    printf(" },\n  \"getNext\": { ");
+    walkPrint(&getNextLat, args->numWalks, getNextVarBinds);
+    printf(" },\n  \"getBulk\": { \"maxRepetitions\": %u, ", args->maxRepetitions);
+    walkPrint(&getBulkLat, args->numWalks, getBulkVarBinds);
+    printf(" },\n  \"ingest\": { \"recordsPerPass\": %lu, \"recordsPerSec\": %.1f, \"linesPerSec\": %.1f, \"cpuMsecPerPass\": %.3f, ",
+           ((args->numPasses != 0) ? (numRecords / args->numPasses) : 0),
+           ((ingestLat.num != 0) ? ((numRecords * 1e6 * ingestLat.num) / ((double) args->numPasses * (ingestLat.endTime - ingestLat.startTime))) : 0),
+           ((ingestLat.num != 0) ? ((args->numObjects * 1e6 * ingestLat.num) / (double) (ingestLat.endTime - ingestLat.startTime)) : 0),
+           ((args->numPasses != 0) ? (cpuMsec / args->numPasses) : 0));
+    latPrint(&ingestLat, "passes");
+    printf(" },\n  \"socket\": { \"batchSize\": %zu, \"streamBatchesPerSec\": %.1f, \"streamUpdatesPerSec\": %.1f, ",
+           args->batchSize, ((streamUsec != 0) ? ((args->numBatches * 1e6) / streamUsec) : 0),
+           ((streamUsec != 0) ? ((args->numBatches * args->batchSize * 1e6) / streamUsec) : 0));
+    latPrint(&socketLat, "batches");
+    printf(" },\n  \"trap\": { ");
+    latPrint(&trapLat, "traps");
+    printf(" },\n  \"restart\": { \"downtimeMsec\": %u, \"heldTraps\": %lu,\n    \"register\": { ", args->downtime, heldTraps);
+    latPrint(&restartRegisterLat, "restarts");
+    printf(" },\n    \"firstGet\": { ");
+    latPrint(&restartGetLat, "restarts");
+    printf(" } },\n");
+    printf("  \"rssKb\": %lu, \"maxRssKb\": %lu, \"cpuMsec\": %.1f, \"pings\": %lu, \"exitStatus\": %d, \"dir\": \"%s\"\n",
+           rss, maxRss, totalCpuMsec, bench.master.numPings, (WIFEXITED(status) ? WEXITSTATUS(status) : -1), args->dir);
+    printf("}\n");
+
+    latFree(&getLat);
+    latFree(&getNextLat);
+    latFree(&getBulkLat);
+    latFree(&ingestLat);
+    latFree(&socketLat);
+    latFree(&trapLat);
+    latFree(&restartRegisterLat);
+    latFree(&restartGetLat);
+    agentxClose(&bench.master);
+    genFree(&bench.set);
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+// Generate a synthetic object file and data files for the
+// snmpSubagent, and optionally keep rewriting the data files
+// with some of the values changed, e.g. to load a build that
+// is served by a real snmpd.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gen.h"
+
+static const char *help =
+        "SYNTAX:\n"
+        "    benchGen [OPTIONS] <dir>\n"
+        "\n"
+        "Writes <dir>/objectFile.csv, and <dir>/dataFile.csv, or\n"
+        "<dir>/dataFile<n>.csv with --data-files.\n"
+        "\n"
+        "OPTIONS:\n"
+        "    --objects <num>      Number of objects (default 10000).\n"
+        "    --units <num>        Number of A/C units (default 100).\n"
+        "    --data-files <num>   Number of data files (default 1).\n"
+        "    --churn <percent>    Percentage of the values changed by\n"
+        "                         each rewrite (default 10).\n"
+        "    --passes <num>       Number of rewrites (default 0).\n"
+        "    --interval <msec>    Time between rewrites (default 1000).\n"
+        "    --seed <num>         Seed of the random values (default 1).\n"
+        "\n";
+
+int main(int argc, char *argv[])
+{
+    size_t numObjects = 10000, numUnits = 100, numFiles = 1;
+    unsigned long numPasses = 0, interval = 1000;
+    double churnPct = 10;
+    unsigned seed = 1;
+    const char *dir = NULL;
+    char path[4096];
+    GenSet set;
+
+    for (int n = 1; n < argc; n++) {
+        const char *arg = argv[n];
+        const char *val = (n + 1 < argc) ? argv[n + 1] : NULL;
+
+        if ((strncmp(arg, "--", 2) == 0) && (val == NULL)) {
+            fprintf(stderr, "ERROR: missing value of %s\n\n%s", arg, help);
+            return 1;
+        }
+
+        if (strcmp(arg, "--objects") == 0) {
+            numObjects = strtoul(argv[++n], NULL, 0);
+        } else if (strcmp(arg, "--units") == 0) {
+            numUnits = strtoul(argv[++n], NULL, 0);
+        } else if (strcmp(arg, "--data-files") == 0) {
+            numFiles = strtoul(argv[++n], NULL, 0);
+        } else if (strcmp(arg, "--churn") == 0) {
+            churnPct = strtod(argv[++n], NULL);
+        } else if (strcmp(arg, "--passes") == 0) {
+            numPasses = strtoul(argv[++n], NULL, 0);
+        } else if (strcmp(arg, "--interval") == 0) {
+            interval = strtoul(argv[++n], NULL, 0);
+        } else if (strcmp(arg, "--seed") == 0) {
+            seed = strtoul(argv[++n], NULL, 0);
+        } else if ((arg[0] != '-') && (dir == NULL)) {
+            dir = arg;
+        } else {
+            fprintf(stderr, "ERROR: invalid argument \"%s\"\n\n%s", arg, help);
+            return 1;
+        }
+    }
+
+    if ((dir == NULL) || (numFiles == 0) || (numFiles > 16)) {
+        fprintf(stderr, "%s", help);
+        return 1;
+    }
+
+    if (genInit(&set, numObjects, numUnits, numFiles, seed) != 0) {
+        return 1;
+    }
+
+    snprintf(path, sizeof (path), "%s/objectFile.csv", dir);
+    if ((genWriteObjectFile(&set, path) != 0) || (genWriteDataFiles(&set, dir) != 0)) {
+        return 1;
+    }
+
+    for (unsigned long pass = 0; pass < numPasses; pass++) {
+        struct timespec delay = { (interval / 1000), ((interval % 1000) * 1000000) };
+        size_t changed;
+
+        nanosleep(&delay, NULL);
+        genChurn(&set, churnPct, &changed);
+        if (genWriteDataFiles(&set, dir) != 0) {
+            return 1;
+        }
+    }
+
+    genFree(&set);
+
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gen.h"
+
+#define GEN_MAX_VALUE   1000
+
+int genInit(GenSet *set, size_t numObjects, size_t numUnits, size_t numFiles, unsigned seed)
+{
+    memset(set, 0, sizeof (*set));
+    set->numObjects = numObjects;
+    set->numUnits = numUnits;
+    set->numFiles = (numFiles != 0) ? numFiles : 1;
+    set->seed = seed;
+
+    set->values = calloc((numObjects + 1), sizeof (int));
+    set->unitTemps = calloc((numUnits + 1), sizeof (int));
+    set->order = calloc((numObjects + 1), sizeof (size_t));
+    if ((set->values == NULL) || (set->unitTemps == NULL) || (set->order == NULL)) {
+        fprintf(stderr, "%s: failed to alloc %zu objects!\n", __func__, numObjects);
+        genFree(set);
+        return -1;
+    }
+
+    for (size_t n = 0; n < numObjects; n++) {
+        set->values[n] = rand_r(&set->seed) % GEN_MAX_VALUE;
+        set->order[n] = n;
+    }
+    for (size_t n = 0; n < numUnits; n++) {
+        set->unitTemps[n] = GEN_UNIT_TEMP;
+    }
+
+    return 0;
+}
+
+void genFree(GenSet *set)
+{
+    free(set->values);
+    free(set->unitTemps);
+    free(set->order);
+    free(set->buf);
+    memset(set, 0, sizeof (*set));
+}
+
+int genWriteObjectFile(const GenSet *set, const char *path)
+{
+    FILE *fp;
+
+    if ((fp = fopen(path, "w")) == NULL) {
+        fprintf(stderr, "%s: can't create %s: %s\n", __func__, path, strerror(errno));
+        return -1;
+    }
+
+    fprintf(fp, "# Generated by the benchmark: %zu objects and %zu A/C units\n", set->numObjects, set->numUnits);
+    for (size_t n = 0; n < set->numObjects; n++) {
+        fprintf(fp, "benchObj%zu,%s.%zu.0,Integer32,read-only\n", (n + 1), GEN_OBJECT_OID, (n + 1));
+    }
+    if (set->numUnits != 0) {
+        fprintf(fp, "acUnit,1-%zu,%d,%d\n", set->numUnits, GEN_LO_THRESHOLD, GEN_HI_THRESHOLD);
+    }
+
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "%s: can't write %s: %s\n", __func__, path, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+void genDataFilePath(const GenSet *set, const char *dir, size_t file, char *path, size_t len)
+{
+    if (set->numFiles == 1) {
+        snprintf(path, len, "%s/dataFile.csv", dir);
+    } else {
+        snprintf(path, len, "%s/dataFile%zu.csv", dir, file);
+    }
+}
+
+// Append a line to the text of the data file
+static int bufPrintf(GenSet *set, size_t *len, const char *name, size_t index, int value)
+{
+    int n;
+
+    if ((set->bufMax - *len) < 64) {
+        size_t max = (set->bufMax != 0) ? (set->bufMax * 2) : 65536;
+        char *buf;
+
+        if ((buf = realloc(set->buf, max)) == NULL) {
+            return -1;
+        }
+        set->buf = buf;
+        set->bufMax = max;
+    }
+
+    n = snprintf(&set->buf[*len], (set->bufMax - *len), "%s%zu,%d\n", name, index, value);
+    *len += n;
+
+    return 0;
+}
+
+static int writeDataFile(GenSet *set, const char *dir, size_t file)
+{
+    char path[4096], tmpPath[4096 + 8];
+    size_t len = 0;
+    FILE *fp;
+
+    for (size_t n = file; n < set->numObjects; n += set->numFiles) {
+        if (bufPrintf(set, &len, "benchObj", (n + 1), set->values[n]) != 0) {
+            return -1;
+        }
+    }
+    if (file == 0) {
+        for (size_t n = 0; n < set->numUnits; n++) {
+            if (bufPrintf(set, &len, "acUnitTemp.", (n + 1), set->unitTemps[n]) != 0) {
+                return -1;
+            }
+        }
+    }
+
+    genDataFilePath(set, dir, file, path, sizeof (path));
+    snprintf(tmpPath, sizeof (tmpPath), "%s.tmp", path);
+
+    if (((fp = fopen(tmpPath, "w")) == NULL) || (fwrite(set->buf, 1, len, fp) != len) || (fclose(fp) != 0) ||
+        (rename(tmpPath, path) != 0)) {
+        fprintf(stderr, "%s: can't write %s: %s\n", __func__, path, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+int genWriteDataFiles(GenSet *set, const char *dir)
+{
+    for (size_t file = 0; file < set->numFiles; file++) {
+        if (writeDataFile(set, dir, file) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+size_t genChange(GenSet *set, size_t numChanged)
+{
+    if (numChanged > set->numObjects) {
+        numChanged = set->numObjects;
+    }
+
+    // Pick distinct objects with a partial Fisher-Yates
+    // shuffle, and give each one a different value
+    for (size_t n = 0; n < numChanged; n++) {
+        size_t k = n + (rand_r(&set->seed) % (set->numObjects - n));
+        size_t index = set->order[k];
+
+        set->order[k] = set->order[n];
+        set->order[n] = index;
+        set->values[index] = (set->values[index] + 1 + (rand_r(&set->seed) % (GEN_MAX_VALUE - 1))) % GEN_MAX_VALUE;
+    }
+
+    return numChanged;
+}
+
+size_t genChurn(GenSet *set, double churnPct, size_t *changed)
+{
+    size_t numChanged = (size_t) ((set->numObjects * churnPct) / 100);
+
+    if (set->numObjects == 0) {
+        return 0;
+    }
+
+    numChanged = genChange(set, ((numChanged != 0) ? numChanged : 1));
+    *changed = set->order[0];
+
+    return numChanged;
+}
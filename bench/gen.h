@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+// Synthetic object files and data files: numObjects Integer32
+// objects, named benchObj<n> with the OID GEN_OBJECT_OID.<n>.0,
+// and numUnits rows of the acUnitTable, whose High Temperature
+// alarms are raised above GEN_HI_THRESHOLD. The values are
+// random, and each churn step changes a given percentage of
+// them.
+
+#define GEN_OBJECT_OID      "1.3.6.1.3.9999.1000"
+#define GEN_LO_THRESHOLD    25
+#define GEN_HI_THRESHOLD    30
+#define GEN_UNIT_TEMP       20      // initial temperature of the rows
+
+typedef struct GenSet {
+    size_t numObjects;
+    size_t numUnits;
+    size_t numFiles;        // data files the objects are spread over
+    int *values;
+    int *unitTemps;
+    size_t *order;          // for picking distinct objects to change
+    unsigned seed;
+    char *buf;              // text of a data file
+    size_t bufMax;
+} GenSet;
+
+extern int genInit(GenSet *set, size_t numObjects, size_t numUnits, size_t numFiles, unsigned seed);
+
+extern void genFree(GenSet *set);
+
+// Write the object file that defines the objects and rows
+extern int genWriteObjectFile(const GenSet *set, const char *path);
+
+// Path of the n-th data file in the directory
+extern void genDataFilePath(const GenSet *set, const char *dir, size_t file, char *path, size_t len);
+
+// Write the data files, each one to a temp file renamed into
+// place, so the subagent never reads a partial one. The
+// objects are spread over the files round-robin; the rows are
+// in the first one.
+extern int genWriteDataFiles(GenSet *set, const char *dir);
+
+// Change the values of numChanged objects, which are the
+// first ones of set->order[]. Returns the number changed.
+extern size_t genChange(GenSet *set, size_t numChanged);
+
+// Change the values of churnPct percent of the objects, at
+// least one. Returns the number changed, and the index of one
+// of them in *changed.
+extern size_t genChurn(GenSet *set, double churnPct, size_t *changed);
+
+__END_DECLS
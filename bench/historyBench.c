@@ -0,0 +1,145 @@
+// Microbenchmark of the sample history: the footprint of the
+// arena of 50000 values with 300 samples each, once all their
+// windows are full, and the cost of historyAdd() and
+// historyAggr() with depths from 10 to 10000 samples, which
+// must not grow with the depth. The results are written to
+// stdout as a JSON object.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "history.h"
+
+#define FOOTPRINT_VALUES    50000
+#define FOOTPRINT_DEPTH     300
+#define DEPTH_VALUES        1000
+#define NUM_UPDATES         20000000ul  // per depth
+
+static uint64_t nsecNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+// Resident set size of the process, in bytes
+static size_t rssBytes(void)
+{
+    unsigned long size, resident = 0;
+    FILE *fp;
+
+    if ((fp = fopen("/proc/self/statm", "r")) != NULL) {
+        if (fscanf(fp, "%lu %lu", &size, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(fp);
+    }
+
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+// A temperature-like random walk, so the min and max queues
+// hold a realistic number of candidates
+static int nextSample(int sample, unsigned *seed)
+{
+    return sample + (rand_r(seed) % 5) - 2;
+}
+
+static int benchFootprint(void)
+{
+    History history;
+    size_t rssBefore = rssBytes();
+    unsigned seed = 1;
+    int sample = 200;
+    uint64_t startTime;
+
+    if (historyInit(&history, FOOTPRINT_VALUES, FOOTPRINT_DEPTH) != 0) {
+        fprintf(stderr, "%s: failed to init the history\n", __func__);
+        return -1;
+    }
+
+    startTime = nsecNow();
+    for (unsigned n = 0; n < FOOTPRINT_DEPTH; n++) {
+        for (size_t v = 0; v < FOOTPRINT_VALUES; v++) {
+            sample = nextSample(sample, &seed);
+            historyAdd(&history, v, sample);
+        }
+    }
+
+    printf("  \"footprint\": { \"values\": %u, \"depth\": %u, \"arenaBytes\": %zu, \"bytesPerValue\": %zu, "
+           "\"rssGrowthBytes\": %zu, \"fillNsecPerAdd\": %.2f },\n",
+           FOOTPRINT_VALUES, FOOTPRINT_DEPTH, history.arenaSize, (history.arenaSize / FOOTPRINT_VALUES),
+           (rssBytes() - rssBefore), ((double) (nsecNow() - startTime) / (FOOTPRINT_VALUES * FOOTPRINT_DEPTH)));
+
+    return 0;
+}
+
+static int benchDepth(unsigned depth, int last)
+{
+    History history;
+    HistoryAggr aggr;
+    unsigned seed = depth;
+    int sample = 200;
+    long long check = 0;
+    uint64_t startTime;
+    double addNsec, aggrNsec;
+
+    if (historyInit(&history, DEPTH_VALUES, depth) != 0) {
+        fprintf(stderr, "%s: failed to init the history\n", __func__);
+        return -1;
+    }
+
+    // Fill the windows first, so each timed add also evicts
+    for (unsigned n = 0; n < depth; n++) {
+        for (size_t v = 0; v < DEPTH_VALUES; v++) {
+            sample = nextSample(sample, &seed);
+            historyAdd(&history, v, sample);
+        }
+    }
+
+    startTime = nsecNow();
+    for (unsigned long n = 0; n < NUM_UPDATES; n++) {
+        sample = nextSample(sample, &seed);
+        historyAdd(&history, (n % DEPTH_VALUES), sample);
+    }
+    addNsec = (double) (nsecNow() - startTime) / NUM_UPDATES;
+
+    startTime = nsecNow();
+    for (unsigned long n = 0; n < NUM_UPDATES; n++) {
+        historyAggr(&history, (n % DEPTH_VALUES), &aggr);
+        check += aggr.min + aggr.max + aggr.mean;
+    }
+    aggrNsec = (double) (nsecNow() - startTime) / NUM_UPDATES;
+
+    // The nextSample() calls are part of addNsec; they cost a
+    // few nsec, the same at every depth
+    printf("    { \"depth\": %u, \"addNsec\": %.2f, \"aggrNsec\": %.2f, \"check\": %lld }%s\n",
+           depth, addNsec, aggrNsec, check, (last ? "" : ","));
+
+    return 0;
+}
+
+int main(void)
+{
+    static const unsigned depths[] = { 10, 60, 300, 1000, 10000 };
+    size_t numDepths = sizeof (depths) / sizeof (depths[0]);
+
+    printf("{\n");
+    if (benchFootprint() != 0) {
+        return 1;
+    }
+
+    printf("  \"depths\": [\n");
+    for (size_t n = 0; n < numDepths; n++) {
+        if (benchDepth(depths[n], ((n + 1) == numDepths)) != 0) {
+            return 1;
+        }
+    }
+    printf("  ]\n}\n");
+
+    return 0;
+}
@@ -0,0 +1,136 @@
+// Microbenchmark of the lookup of the objects named by the
+// lines of a data file: the cost per line of finding the
+// object, and storing the value of the line, from 5 up to
+// 100000 objects, with the NameIndex of the snmpSubagent, and
+// with a linear scan of the names, as it was done before.
+// The results are written to stdout as a JSON array.
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "nameIndex.h"
+
+#define NUM_LINES       1000000
+#define LINEAR_BUDGET   500000000ull    // names compared by the linear scan
+
+typedef struct BenchObj {
+    char name[32];
+    int value;
+} BenchObj;
+
+static uint64_t nsecNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static BenchObj *linearFind(BenchObj *objs, size_t numObjs, const char *name, size_t len)
+{
+    for (size_t n = 0; n < numObjs; n++) {
+        if ((strncmp(objs[n].name, name, len) == 0) && (objs[n].name[len] == '\0')) {
+            return &objs[n];
+        }
+    }
+
+    return NULL;
+}
+
+// Apply the lines of the buffer, in place, like the data file
+// parser does. Returns the time per line, in nsec.
+static double applyLines(const char *buf, size_t len, size_t numLines, BenchObj *objs, size_t numObjs,
+                         const NameIndex *idx, unsigned long *numMissed)
+{
+    const char *end = buf + len;
+    const char *line = buf;
+    uint64_t startTime = nsecNow();
+
+    for (size_t n = 0; n < numLines; n++) {
+        const char *eol = memchr(line, '\n', (end - line));
+        const char *comma = memchr(line, ',', (eol - line));
+        BenchObj *obj;
+
+        if (idx != NULL) {
+            obj = nameIndexFind(idx, line, (comma - line));
+        } else {
+            obj = linearFind(objs, numObjs, line, (comma - line));
+        }
+
+        if (obj != NULL) {
+            obj->value = atoi(comma + 1);
+        } else {
+            (*numMissed)++;
+        }
+
+        line = eol + 1;
+    }
+
+    return (double) (nsecNow() - startTime) / numLines;
+}
+
+static int benchObjects(size_t numObjs, bool first)
+{
+    BenchObj *objs = calloc(numObjs, sizeof (BenchObj));
+    size_t numLinear = LINEAR_BUDGET / numObjs;
+    char *buf = malloc(NUM_LINES * 32);
+    unsigned long numMissed = 0;
+    unsigned seed = 1;
+    double indexNsec, linearNsec;
+    size_t len = 0;
+    NameIndex idx;
+
+    if ((objs == NULL) || (buf == NULL) || (nameIndexInit(&idx, numObjs) != 0)) {
+        fprintf(stderr, "%s: failed to alloc %zu objects!\n", __func__, numObjs);
+        return -1;
+    }
+
+    for (size_t n = 0; n < numObjs; n++) {
+        snprintf(objs[n].name, sizeof (objs[n].name), "benchObj%zu", (n + 1));
+        nameIndexAdd(&idx, objs[n].name, &objs[n]);
+    }
+
+    // The lines name the objects in a random order
+    for (size_t n = 0; n < NUM_LINES; n++) {
+        len += sprintf(&buf[len], "benchObj%zu,%d\n", ((rand_r(&seed) % numObjs) + 1), (rand_r(&seed) % 1000));
+    }
+
+    if (numLinear > NUM_LINES) {
+        numLinear = NUM_LINES;
+    } else if (numLinear < 100) {
+        numLinear = 100;
+    }
+
+    indexNsec = applyLines(buf, len, NUM_LINES, objs, numObjs, &idx, &numMissed);
+    linearNsec = applyLines(buf, len, numLinear, objs, numObjs, NULL, &numMissed);
+
+    printf("%s  { \"objects\": %zu, \"indexSlots\": %zu, \"indexNsecPerLine\": %.1f, \"linearNsecPerLine\": %.1f, "
+           "\"linearLines\": %zu, \"missed\": %lu }",
+           (first ? "" : ",\n"), numObjs, (idx.mask + 1), indexNsec, linearNsec, numLinear, numMissed);
+    fflush(stdout);
+
+    nameIndexFree(&idx);
+    free(objs);
+    free(buf);
+
+    return (numMissed == 0) ? 0 : -1;
+}
+
+int main(void)
+{
+    static const size_t numObjects[] = { 5, 50, 500, 5000, 50000, 100000 };
+    int ret = 0;
+
+    printf("[\n");
+    for (size_t n = 0; n < (sizeof (numObjects) / sizeof (numObjects[0])); n++) {
+        if (benchObjects(numObjects[n], (n == 0)) != 0) {
+            ret = 1;
+        }
+    }
+    printf("\n]\n");
+
+    return ret;
+}
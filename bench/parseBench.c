@@ -0,0 +1,239 @@
+// Benchmark of the data file parser: parse a data file of 1M
+// lines with the in place parser of the snmpSubagent (mmap(),
+// parseLines() and parseInt()), and with the fgets(), strchr()
+// and sscanf() loop that it replaced, and report the lines per
+// second of each one. Both look the names up with the same
+// NameIndex, so only the parsing differs. The results are
+// written to stdout as JSON.
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dataParse.h"
+#include "nameIndex.h"
+
+static const char *help =
+        "SYNTAX:\n"
+        "    parseBench [OPTIONS]\n"
+        "\n"
+        "OPTIONS:\n"
+        "    --lines <num>      Number of lines of the data file (default 1000000).\n"
+        "    --objects <num>    Number of objects they name (default 10000).\n"
+        "    --runs <num>       Parses of each kind; the fastest one is reported (default 5).\n"
+        "\n";
+
+typedef struct BenchObj {
+    char name[32];
+    int value;
+} BenchObj;
+
+typedef struct ParseState {
+    NameIndex *idx;
+    unsigned long numApplied;
+    long long sum;          // of the values, to compare the parsers
+} ParseState;
+
+static uint64_t nsecNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static void applyValue(ParseState *state, BenchObj *obj, int value)
+{
+    if (obj != NULL) {
+        obj->value = value;
+        state->numApplied++;
+        state->sum += value;
+    }
+}
+
+// The parser of the snmpSubagent before the in place parser
+static int parseFgets(const char *path, ParseState *state)
+{
+    FILE *fp;
+    char strBuf[256];
+
+    if ((fp = fopen(path, "r")) == NULL) {
+        return -1;
+    }
+
+    while (fgets(strBuf, sizeof (strBuf), fp) != NULL) {
+        if ((strBuf[0] != '#') && (strBuf[0] != '\0')) {
+            char *comma = strchr(strBuf, ',');
+            if (comma != NULL) {
+                int value;
+                *comma = '\0';
+                if (sscanf((comma + 1), "%d", &value) == 1) {
+                    applyValue(state, nameIndexFind(state->idx, strBuf, (comma - strBuf)), value);
+                }
+            }
+        }
+    }
+
+    fclose(fp);
+
+    return 0;
+}
+
+static void parseLine(void *arg, const char *line, const char *eol)
+{
+    ParseState *state = arg;
+    const char *comma = memchr(line, ',', (eol - line));
+    int value;
+
+    if ((comma != NULL) && parseInt((comma + 1), eol, &value)) {
+        applyValue(state, nameIndexFind(state->idx, line, (comma - line)), value);
+    }
+}
+
+// The in place parser of the snmpSubagent
+static int parseMmap(const char *path, ParseState *state)
+{
+    struct stat fileStat;
+    char *mapData;
+    int fd;
+
+    if ((fd = open(path, (O_RDONLY | O_CLOEXEC))) == -1) {
+        return -1;
+    }
+
+    if ((fstat(fd, &fileStat) != 0) ||
+        ((mapData = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)) {
+        close(fd);
+        return -1;
+    }
+    madvise(mapData, fileStat.st_size, MADV_SEQUENTIAL);
+
+    parseLines(mapData, fileStat.st_size, parseLine, state);
+
+    munmap(mapData, fileStat.st_size);
+    close(fd);
+
+    return 0;
+}
+
+// Run the parser, and return the time of the fastest run, in
+// nsec, or 0 on error
+static uint64_t benchParser(int (*parser)(const char *path, ParseState *state), const char *path, NameIndex *idx,
+                            unsigned long numRuns, ParseState *state)
+{
+    uint64_t bestTime = UINT64_MAX;
+
+    for (unsigned long run = 0; run < numRuns; run++) {
+        uint64_t startTime = nsecNow();
+
+        memset(state, 0, sizeof (*state));
+        state->idx = idx;
+        if (parser(path, state) != 0) {
+            fprintf(stderr, "%s: can't parse %s: %s\n", __func__, path, strerror(errno));
+            return 0;
+        }
+
+        if ((nsecNow() - startTime) < bestTime) {
+            bestTime = nsecNow() - startTime;
+        }
+    }
+
+    return bestTime;
+}
+
+static void printResult(const char *name, uint64_t nsec, unsigned long numLines, off_t size)
+{
+    printf("  \"%s\": { \"msec\": %.3f, \"linesPerSec\": %.0f, \"mbPerSec\": %.1f },\n",
+           name, (nsec / 1e6), ((numLines * 1e9) / nsec), ((size * 1e3) / nsec));
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long numLines = 1000000, numObjects = 10000, numRuns = 5;
+    char dir[] = "/tmp/parseBench.XXXXXX";
+    char path[sizeof (dir) + 16];
+    ParseState fgetsState, mmapState;
+    uint64_t fgetsTime, mmapTime;
+    unsigned seed = 1;
+    BenchObj *objs;
+    struct stat fileStat;
+    NameIndex idx;
+    FILE *fp;
+
+    for (int n = 1; n < argc; n++) {
+        if ((strcmp(argv[n], "--lines") == 0) && (n + 1 < argc)) {
+            numLines = strtoul(argv[++n], NULL, 0);
+        } else if ((strcmp(argv[n], "--objects") == 0) && (n + 1 < argc)) {
+            numObjects = strtoul(argv[++n], NULL, 0);
+        } else if ((strcmp(argv[n], "--runs") == 0) && (n + 1 < argc)) {
+            numRuns = strtoul(argv[++n], NULL, 0);
+        } else {
+            fprintf(stderr, "%s", help);
+            return 1;
+        }
+    }
+
+    if ((numObjects == 0) || (numRuns == 0)) {
+        fprintf(stderr, "%s", help);
+        return 1;
+    }
+
+    if (((objs = calloc(numObjects, sizeof (BenchObj))) == NULL) || (nameIndexInit(&idx, numObjects) != 0)) {
+        fprintf(stderr, "failed to alloc %lu objects!\n", numObjects);
+        return 1;
+    }
+    for (unsigned long n = 0; n < numObjects; n++) {
+        snprintf(objs[n].name, sizeof (objs[n].name), "benchObj%lu", (n + 1));
+        nameIndexAdd(&idx, objs[n].name, &objs[n]);
+    }
+
+    if (mkdtemp(dir) == NULL) {
+        fprintf(stderr, "can't create %s: %s\n", dir, strerror(errno));
+        return 1;
+    }
+    snprintf(path, sizeof (path), "%s/dataFile.csv", dir);
+
+    if ((fp = fopen(path, "w")) == NULL) {
+        fprintf(stderr, "can't create %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    fprintf(fp, "# %lu lines\n", numLines);
+    for (unsigned long n = 0; n < numLines; n++) {
+        fprintf(fp, "benchObj%lu,%d\n", ((n % numObjects) + 1), ((int) (rand_r(&seed) % 200000) - 100000));
+    }
+    if ((fclose(fp) != 0) || (stat(path, &fileStat) != 0)) {
+        fprintf(stderr, "can't write %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    fgetsTime = benchParser(parseFgets, path, &idx, numRuns, &fgetsState);
+    mmapTime = benchParser(parseMmap, path, &idx, numRuns, &mmapState);
+
+    unlink(path);
+    rmdir(dir);
+
+    if ((fgetsTime == 0) || (mmapTime == 0)) {
+        return 1;
+    }
+
+    printf("{\n");
+    printf("  \"lines\": %lu, \"objects\": %lu, \"bytes\": %lld, \"runs\": %lu,\n",
+           numLines, numObjects, (long long) fileStat.st_size, numRuns);
+    printResult("fgetsSscanf", fgetsTime, numLines, fileStat.st_size);
+    printResult("mmapParseInt", mmapTime, numLines, fileStat.st_size);
+    printf("  \"speedup\": %.2f, \"sameValues\": %s\n", ((double) fgetsTime / mmapTime),
+           (((fgetsState.numApplied == mmapState.numApplied) && (fgetsState.sum == mmapState.sum)) ? "true" : "false"));
+    printf("}\n");
+
+    nameIndexFree(&idx);
+    free(objs);
+
+    return ((fgetsState.numApplied == numLines) && (mmapState.numApplied == numLines) &&
+            (fgetsState.sum == mmapState.sum)) ? 0 : 1;
+}
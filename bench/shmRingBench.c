@@ -0,0 +1,172 @@
+// Throughput benchmark of the shared memory ingest channel:
+// 1, 2 and 4 producer threads, each with its own mapping of
+// the ring, as separate producer processes would have, add
+// records with shmRingPut() while the main thread drains them
+// with shmRingDrain() when the eventfd of the ring signals
+// them, as the MIB update task does. A producer that finds
+// the ring full yields, and retries. The results are written
+// to stdout as a JSON array.
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shmRing.h"
+
+#define NUM_RING_RECORDS    65536   // as in the subagent
+#define NUM_OBJECTS         1024
+#define MAX_PRODUCERS       16
+
+static const char *help =
+        "SYNTAX:\n"
+        "    shmRingBench [OPTIONS]\n"
+        "\n"
+        "OPTIONS:\n"
+        "    --records <num>    Records added per run (default 10000000).\n"
+        "\n";
+
+typedef struct Producer {
+    pthread_t thread;
+    const char *shmName;
+    uint64_t numRecords;
+    unsigned long numRetries;   // the ring was full
+    int ret;
+} Producer;
+
+static int32_t values[NUM_OBJECTS];
+static uint64_t numDrained;
+
+static uint64_t nsecNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static void *producerTask(void *arg)
+{
+    Producer *producer = arg;
+    ShmRingHdr *ring;
+
+    if ((ring = shmRingOpen(producer->shmName)) == NULL) {
+        producer->ret = -1;
+        return NULL;
+    }
+
+    for (uint64_t n = 0; n < producer->numRecords; n++) {
+        while (shmRingPut(ring, (n % NUM_OBJECTS), (int32_t) n, 0) != 0) {
+            producer->numRetries++;
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static void drainRecord(uint32_t objectId, int32_t value, uint64_t timestamp)
+{
+    values[objectId] = value;
+    numDrained++;
+}
+
+static int benchProducers(ShmRing *ring, int eventFd, const char *shmName, unsigned numProducers,
+                          uint64_t numRecords, bool first)
+{
+    Producer producers[MAX_PRODUCERS] = { 0 };
+    unsigned long numRetries = 0, numDrains = 0;
+    uint64_t startTime, elapsed;
+    struct pollfd pfd = { .fd = eventFd, .events = POLLIN };
+
+    numDrained = 0;
+    startTime = nsecNow();
+
+    for (unsigned n = 0; n < numProducers; n++) {
+        producers[n].shmName = shmName;
+        producers[n].numRecords = numRecords / numProducers;
+        if (pthread_create(&producers[n].thread, NULL, producerTask, &producers[n]) != 0) {
+            return -1;
+        }
+    }
+
+    while (numDrained < ((numRecords / numProducers) * numProducers)) {
+        if (poll(&pfd, 1, 1000) == 1) {
+            if (shmRingDrain(ring, drainRecord) != 0) {
+                numDrains++;
+            }
+        }
+    }
+    elapsed = nsecNow() - startTime;
+
+    for (unsigned n = 0; n < numProducers; n++) {
+        pthread_join(producers[n].thread, NULL);
+        if (producers[n].ret != 0) {
+            return -1;
+        }
+        numRetries += producers[n].numRetries;
+    }
+
+    printf("%s  { \"producers\": %u, \"records\": %llu, \"msec\": %.3f, \"recordsPerSec\": %.0f, "
+           "\"drains\": %lu, \"recordsPerDrain\": %.1f, \"ringFullRetries\": %lu }",
+           (first ? "" : ",\n"), numProducers, (unsigned long long) numDrained, (elapsed / 1e6),
+           ((numDrained * 1e9) / elapsed), numDrains, ((numDrains != 0) ? ((double) numDrained / numDrains) : 0),
+           numRetries);
+    fflush(stdout);
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static const unsigned numProducers[] = { 1, 2, 4 };
+    uint64_t numRecords = 10000000;
+    char shmName[64];
+    ShmRing *ring;
+    int eventFd, ret = 0;
+
+    for (int n = 1; n < argc; n++) {
+        if ((strcmp(argv[n], "--records") == 0) && (n + 1 < argc)) {
+            numRecords = strtoull(argv[++n], NULL, 0);
+        } else {
+            fprintf(stderr, "%s", help);
+            return 1;
+        }
+    }
+
+    snprintf(shmName, sizeof (shmName), "/shmRingBench.%d", (int) getpid());
+
+    if ((ring = shmRingCreate(shmName, NUM_RING_RECORDS, NUM_OBJECTS)) == NULL) {
+        fprintf(stderr, "can't create the shm ring %s\n", shmName);
+        return 1;
+    }
+    for (uint32_t n = 0; n < NUM_OBJECTS; n++) {
+        char name[32];
+
+        snprintf(name, sizeof (name), "benchObj%u", (n + 1));
+        shmRingSetObject(ring, n, name, n);
+    }
+    if ((eventFd = shmRingStart(ring)) == -1) {
+        fprintf(stderr, "can't start the shm ring\n");
+        shm_unlink(shmName);
+        return 1;
+    }
+
+    printf("[\n");
+    for (size_t n = 0; n < (sizeof (numProducers) / sizeof (numProducers[0])); n++) {
+        if (benchProducers(ring, eventFd, shmName, numProducers[n], numRecords, (n == 0)) != 0) {
+            fprintf(stderr, "can't run %u producers\n", numProducers[n]);
+            ret = 1;
+            break;
+        }
+    }
+    printf("\n]\n");
+
+    shm_unlink(shmName);
+
+    return ret;
+}
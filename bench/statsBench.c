@@ -0,0 +1,110 @@
+// Microbenchmark of the hot path of the self-monitoring
+// statistics: the cost of statsInc() and statsRecord() with
+// 1, 2, 4 and 8 threads, against a counter shared by all the
+// threads and updated with atomic_fetch_add(). The results are
+// written to stdout as a JSON array.
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "stats.h"
+
+#define NUM_UPDATES     20000000ul  // per run, spread over the threads
+#define MAX_THREADS     8
+
+typedef enum BenchKind {
+    BENCH_STATS_INC,
+    BENCH_STATS_RECORD,
+    BENCH_SHARED_ATOMIC,
+} BenchKind;
+
+typedef struct BenchThread {
+    pthread_t thread;
+    BenchKind kind;
+    unsigned long numUpdates;
+} BenchThread;
+
+static atomic_ulong sharedCounter;
+
+static uint64_t nsecNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static void *benchTask(void *arg)
+{
+    BenchThread *bt = arg;
+
+    switch (bt->kind) {
+    case BENCH_STATS_INC:
+        for (unsigned long n = 0; n < bt->numUpdates; n++) {
+            statsInc(STATS_GET_REQUESTS);
+        }
+        break;
+    case BENCH_STATS_RECORD:
+        for (unsigned long n = 0; n < bt->numUpdates; n++) {
+            statsRecord(STATS_REQUEST_TIME, (n & 1023));
+        }
+        break;
+    case BENCH_SHARED_ATOMIC:
+        for (unsigned long n = 0; n < bt->numUpdates; n++) {
+            atomic_fetch_add_explicit(&sharedCounter, 1, memory_order_relaxed);
+        }
+        break;
+    }
+
+    return NULL;
+}
+
+// Returns the time per update, in nsec of wall time
+static double benchThreads(BenchKind kind, unsigned numThreads)
+{
+    BenchThread threads[MAX_THREADS];
+    uint64_t startTime = nsecNow();
+
+    for (unsigned n = 0; n < numThreads; n++) {
+        threads[n].kind = kind;
+        threads[n].numUpdates = NUM_UPDATES / numThreads;
+        pthread_create(&threads[n].thread, NULL, benchTask, &threads[n]);
+    }
+    for (unsigned n = 0; n < numThreads; n++) {
+        pthread_join(threads[n].thread, NULL);
+    }
+
+    return (double) (nsecNow() - startTime) / NUM_UPDATES;
+}
+
+int main(void)
+{
+    static const unsigned numThreads[] = { 1, 2, 4, 8 };
+    StatsTotals *totals = malloc(sizeof (StatsTotals));
+    unsigned long expected = 0;
+
+    printf("[\n");
+    for (size_t n = 0; n < (sizeof (numThreads) / sizeof (numThreads[0])); n++) {
+        double incNsec = benchThreads(BENCH_STATS_INC, numThreads[n]);
+        double recordNsec = benchThreads(BENCH_STATS_RECORD, numThreads[n]);
+        double atomicNsec = benchThreads(BENCH_SHARED_ATOMIC, numThreads[n]);
+
+        expected += (NUM_UPDATES / numThreads[n]) * numThreads[n];
+        printf("%s  { \"threads\": %u, \"statsIncNsec\": %.2f, \"statsRecordNsec\": %.2f, \"sharedAtomicNsec\": %.2f }",
+               ((n == 0) ? "" : ",\n"), numThreads[n], incNsec, recordNsec, atomicNsec);
+        fflush(stdout);
+    }
+    printf("\n]\n");
+
+    statsRead(totals);
+    if (totals->counters[STATS_GET_REQUESTS] != expected) {
+        fprintf(stderr, "statsInc() lost updates: %lu of %lu\n", totals->counters[STATS_GET_REQUESTS], expected);
+        return 1;
+    }
+    free(totals);
+
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include <limits.h>
+#include <string.h>
+
+#include "dataParse.h"
+
+unsigned long parseLines(const char *buf, size_t len, ParseLineFunc *lineFunc, void *arg)
+{
+    const char *end = buf + len;
+    const char *line = buf;
+    unsigned long numLines = 0;
+
+    while (line < end) {
+        const char *eol = memchr(line, '\n', (end - line));
+
+        if (eol == NULL) {
+            eol = end;  // last line has no newline
+        }
+
+        if ((line != eol) && (*line != '#') && (*line != '\r')) {
+            lineFunc(arg, line, eol);
+            numLines++;
+        }
+
+        line = eol + 1;
+    }
+
+    return numLines;
+}
+
+bool parseInt(const char *str, const char *end, int *value)
+{
+    bool negative = false;
+    long long val = 0;
+    const char *digits;
+
+    while ((str < end) && ((*str == ' ') || (*str == '\t'))) {
+        str++;
+    }
+
+    if ((str < end) && ((*str == '-') || (*str == '+'))) {
+        negative = (*str++ == '-');
+    }
+
+    for (digits = str; (str < end) && ((unsigned) (*str - '0') <= 9); str++) {
+        val = (val * 10) + (*str - '0');
+        if (val > ((long long) INT_MAX + 1)) {
+            return false;   // overflow
+        }
+    }
+
+    if (str == digits) {
+        return false;       // no digits
+    }
+
+    while ((str < end) && ((*str == ' ') || (*str == '\t') || (*str == '\r'))) {
+        str++;
+    }
+
+    if ((str != end) || (!negative && (val > INT_MAX))) {
+        return false;
+    }
+
+    *value = negative ? (int) -val : (int) val;
+
+    return true;
+}
+
+bool parseUint(const char *str, const char *end, uint64_t maxValue, uint64_t *value)
+{
+    uint64_t val = 0;
+    const char *digits;
+
+    while ((str < end) && ((*str == ' ') || (*str == '\t'))) {
+        str++;
+    }
+
+    if ((str < end) && (*str == '+')) {
+        str++;
+    }
+
+    for (digits = str; (str < end) && ((unsigned) (*str - '0') <= 9); str++) {
+        unsigned digit = *str - '0';
+        if (val > ((maxValue - digit) / 10)) {
+            return false;   // overflow
+        }
+        val = (val * 10) + digit;
+    }
+
+    if (str == digits) {
+        return false;       // no digits
+    }
+
+    while ((str < end) && ((*str == ' ') || (*str == '\t') || (*str == '\r'))) {
+        str++;
+    }
+
+    if (str != end) {
+        return false;
+    }
+
+    *value = val;
+
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+// In place parsing of the text of the data files and of the
+// update socket messages: the buffers, e.g. the mapped data
+// file, are never copied, and have no length limit per line.
+
+// Called for each line of the buffer, without its newline
+typedef void (ParseLineFunc)(void *arg, const char *line, const char *eol);
+
+// Call lineFunc for each line of the buffer, except the empty
+// ones and the comments, which start with a '#'. The last line
+// need not end with a newline. The lines are located using
+// memchr(), which scans a machine word (or SIMD register) at a
+// time. Returns the number of lines passed to lineFunc.
+extern unsigned long parseLines(const char *buf, size_t len, ParseLineFunc *lineFunc, void *arg);
+
+// Decode a decimal Integer32 value, with optional leading
+// and trailing white space. This is much faster than using
+// sscanf("%d"), and it rejects trailing garbage and values
+// that overflow.
+extern bool parseInt(const char *str, const char *end, int *value);
+
+// Same as parseInt(), for the unsigned values up to maxValue
+extern bool parseUint(const char *str, const char *end, uint64_t maxValue, uint64_t *value);
+
+__END_DECLS
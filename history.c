@@ -0,0 +1,104 @@
+#include <sys/mman.h>
+
+#include "history.h"
+
+// Position of the i-th element of a queue, where both the
+// front and i are lower than depth
+static inline unsigned queuePos(unsigned front, unsigned i, unsigned depth)
+{
+    unsigned pos = front + i;
+
+    return (pos >= depth) ? (pos - depth) : pos;
+}
+
+int historyInit(History *history, size_t numValues, unsigned depth)
+{
+    size_t hdrsSize = numValues * sizeof (HistoryHdr);
+    size_t samplesSize = numValues * depth * sizeof (int);
+    size_t queueSize = numValues * depth * sizeof (uint16_t);
+    char *arena;
+
+    if ((depth == 0) || (depth > HISTORY_MAX_DEPTH)) {
+        return -1;
+    }
+
+    history->arenaSize = hdrsSize + samplesSize + (2 * queueSize);
+
+    // Anonymous pages are zero-filled, so all the
+    // windows start empty
+    if ((arena = mmap(NULL, history->arenaSize, (PROT_READ | PROT_WRITE), (MAP_PRIVATE | MAP_ANONYMOUS), -1, 0)) == MAP_FAILED) {
+        return -1;
+    }
+
+    history->numValues = numValues;
+    history->depth = depth;
+    history->arena = arena;
+    history->hdrs = (HistoryHdr *) arena;
+    history->samples = (int *) (arena + hdrsSize);
+    history->minQueue = (uint16_t *) (arena + hdrsSize + samplesSize);
+    history->maxQueue = (uint16_t *) (arena + hdrsSize + samplesSize + queueSize);
+
+    return 0;
+}
+
+void historyAdd(History *history, size_t n, int value)
+{
+    HistoryHdr *hdr = &history->hdrs[n];
+    unsigned depth = history->depth;
+    int *samples = &history->samples[n * depth];
+    uint16_t *minQueue = &history->minQueue[n * depth];
+    uint16_t *maxQueue = &history->maxQueue[n * depth];
+    unsigned slot = hdr->head;
+
+    if (hdr->count == depth) {
+        // Evict the oldest sample, which is the one in the
+        // slot about to be reused. If it is still a min or
+        // max candidate, it's the oldest one in the queue.
+        hdr->sum -= samples[slot];
+        if ((hdr->minLen != 0) && (minQueue[hdr->minFront] == slot)) {
+            hdr->minFront = queuePos(hdr->minFront, 1, depth);
+            hdr->minLen--;
+        }
+        if ((hdr->maxLen != 0) && (maxQueue[hdr->maxFront] == slot)) {
+            hdr->maxFront = queuePos(hdr->maxFront, 1, depth);
+            hdr->maxLen--;
+        }
+    } else {
+        hdr->count++;
+    }
+
+    samples[slot] = value;
+    hdr->sum += value;
+
+    // The candidates that are not lower (higher) than
+    // the new sample can never be the minimum (maximum)
+    // of the window again.
+    while ((hdr->minLen != 0) && (samples[minQueue[queuePos(hdr->minFront, (hdr->minLen - 1), depth)]] >= value)) {
+        hdr->minLen--;
+    }
+    minQueue[queuePos(hdr->minFront, hdr->minLen++, depth)] = slot;
+
+    while ((hdr->maxLen != 0) && (samples[maxQueue[queuePos(hdr->maxFront, (hdr->maxLen - 1), depth)]] <= value)) {
+        hdr->maxLen--;
+    }
+    maxQueue[queuePos(hdr->maxFront, hdr->maxLen++, depth)] = slot;
+
+    hdr->head = ((slot + 1) == depth) ? 0 : (slot + 1);
+}
+
+void historyAggr(const History *history, size_t n, HistoryAggr *aggr)
+{
+    const HistoryHdr *hdr = &history->hdrs[n];
+    const int *samples = &history->samples[n * history->depth];
+    int64_t half = hdr->count / 2;
+
+    if (hdr->count == 0) {
+        aggr->count = aggr->min = aggr->max = aggr->mean = 0;
+        return;
+    }
+
+    aggr->count = hdr->count;
+    aggr->min = samples[history->minQueue[(n * history->depth) + hdr->minFront]];
+    aggr->max = samples[history->maxQueue[(n * history->depth) + hdr->maxFront]];
+    aggr->mean = (int) ((hdr->sum >= 0) ? ((hdr->sum + half) / hdr->count) : ((hdr->sum - half) / hdr->count));
+}
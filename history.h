@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+// History of the recent samples of a set of values, with
+// their rolling aggregates over the whole window.
+//
+// Each value has a ring of the last depth samples, and two
+// monotonic queues, of the ring slots of its window minimum
+// and maximum candidates, so adding a sample and getting the
+// aggregates are both O(1) (amortized, for the queues). All
+// the rings and queues are carved out of a single arena,
+// allocated up front, so the footprint is fixed:
+//
+//     numValues * ((depth * 8) + sizeof (HistoryHdr))
+//
+// e.g. 50000 values with 300 samples each take about 116 MB.
+#define HISTORY_MAX_DEPTH   UINT16_MAX
+
+typedef struct HistoryHdr {
+    int64_t sum;            // of the samples in the window
+    uint16_t count;         // number of samples in the window
+    uint16_t head;          // ring slot of the next sample
+    uint16_t minFront;      // minimum queue
+    uint16_t minLen;
+    uint16_t maxFront;      // maximum queue
+    uint16_t maxLen;
+} HistoryHdr;
+
+typedef struct History {
+    size_t numValues;
+    unsigned depth;
+    void *arena;
+    size_t arenaSize;
+    HistoryHdr *hdrs;
+    int *samples;           // depth samples per value
+    uint16_t *minQueue;     // depth slots per value
+    uint16_t *maxQueue;     // depth slots per value
+} History;
+
+typedef struct HistoryAggr {
+    unsigned count;
+    int min;
+    int max;
+    int mean;               // rounded to the nearest integer
+} HistoryAggr;
+
+extern int historyInit(History *history, size_t numValues, unsigned depth);
+
+// Add a sample of a value, evicting its oldest sample if
+// the window is full
+extern void historyAdd(History *history, size_t n, int value);
+
+// Get the aggregates of the window of a value; all zero if
+// it has no samples yet
+extern void historyAggr(const History *history, size_t n, HistoryAggr *aggr);
+
+__END_DECLS
@@ -0,0 +1,209 @@
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "log.h"
+
+#define LOG_RING_SIZE   1024    // power of 2
+#define LOG_MSG_LEN     240
+
+typedef struct LogRecord {
+    _Atomic uint64_t seq;       // position + 1 when it holds a message
+    int priority;
+    char msg[LOG_MSG_LEN];
+} LogRecord;
+
+// Multi-producer ring of formatted messages, drained by the
+// writer thread. Same scheme as the shm ring: each slot has
+// a sequence number that tells whether it's free or holds a
+// message, so the producers need no locks.
+typedef struct LogRing {
+    LogRecord records[LOG_RING_SIZE];
+    _Atomic uint64_t tail __attribute__ ((aligned(64)));
+    atomic_ulong dropped;       // messages dropped because the ring was full
+    uint64_t head __attribute__ ((aligned(64)));
+    _Atomic uint32_t waiting;   // futex: the writer waits for messages
+    atomic_bool stop;
+    pthread_t thread;
+    atomic_bool running;        // the writer thread is running
+} LogRing;
+
+int logLevel = LOG_INFO;
+
+static LogRing logRing;
+
+static const char *logLevelNames[] = { "emerg", "alert", "crit", "err", "warning", "notice", "info", "debug" };
+
+int logLevelParse(const char *str)
+{
+    char *end;
+    long level;
+
+    for (int n = 0; n < (int) (sizeof (logLevelNames) / sizeof (logLevelNames[0])); n++) {
+        if (strcasecmp(str, logLevelNames[n]) == 0) {
+            return n;
+        }
+    }
+
+    level = strtol(str, &end, 10);
+    if ((end == str) || (*end != '\0') || (level < LOG_EMERG) || (level > LOG_DEBUG)) {
+        return -1;
+    }
+
+    return level;
+}
+
+void logPut(int priority, const char *fmt, ...)
+{
+    LogRing *ring = &logRing;
+    uint64_t pos;
+    LogRecord *rec;
+    va_list ap;
+    int len;
+
+    if (!atomic_load_explicit(&ring->running, memory_order_relaxed)) {
+        va_start(ap, fmt);
+        snmp_vlog(priority, fmt, ap);
+        va_end(ap);
+        return;
+    }
+
+    // Claim the slot at the tail of the ring
+    pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    while (true) {
+        int64_t diff;
+
+        rec = &ring->records[pos & (LOG_RING_SIZE - 1)];
+        diff = (int64_t) (atomic_load_explicit(&rec->seq, memory_order_acquire) - pos);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->tail, &pos, (pos + 1), memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // The writer is behind
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        }
+    }
+
+    va_start(ap, fmt);
+    len = vsnprintf(rec->msg, sizeof (rec->msg), fmt, ap);
+    va_end(ap);
+
+    // Keep the newline of a truncated message
+    if (len >= (int) sizeof (rec->msg)) {
+        rec->msg[sizeof (rec->msg) - 2] = '\n';
+    }
+
+    rec->priority = priority;
+    atomic_store_explicit(&rec->seq, (pos + 1), memory_order_release);
+
+    // Wake up the writer, if it's waiting. The fence pairs
+    // with the one in logWait().
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ring->waiting, memory_order_relaxed) &&
+        atomic_exchange_explicit(&ring->waiting, 0, memory_order_relaxed)) {
+        syscall(SYS_futex, &ring->waiting, FUTEX_WAKE, 1, NULL, NULL, 0);
+    }
+}
+
+static bool logRingEmpty(const LogRing *ring)
+{
+    return (atomic_load_explicit(&ring->records[ring->head & (LOG_RING_SIZE - 1)].seq, memory_order_acquire) != (ring->head + 1));
+}
+
+static void logDrain(LogRing *ring)
+{
+    unsigned long dropped;
+
+    while (!logRingEmpty(ring)) {
+        LogRecord *rec = &ring->records[ring->head & (LOG_RING_SIZE - 1)];
+
+        snmp_log(rec->priority, "%s", rec->msg);
+
+        // Free the slot for the next lap
+        atomic_store_explicit(&rec->seq, (ring->head + LOG_RING_SIZE), memory_order_release);
+        ring->head++;
+    }
+
+    if ((dropped = atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed)) != 0) {
+        snmp_log(LOG_WARNING, "%s: dropped %lu log messages\n", __func__, dropped);
+    }
+}
+
+static void logWait(LogRing *ring)
+{
+    atomic_store_explicit(&ring->waiting, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    // Check again, in case a message was added before
+    // the flag was set
+    if (logRingEmpty(ring) && !atomic_load(&ring->stop)) {
+        syscall(SYS_futex, &ring->waiting, FUTEX_WAIT, 1, NULL, NULL, 0);
+    }
+
+    atomic_store_explicit(&ring->waiting, 0, memory_order_relaxed);
+}
+
+static void *logWriter(void *arg)
+{
+    LogRing *ring = arg;
+
+    while (!atomic_load(&ring->stop)) {
+        logDrain(ring);
+        logWait(ring);
+    }
+
+    return NULL;
+}
+
+int logStart(void)
+{
+    LogRing *ring = &logRing;
+
+    for (uint64_t pos = 0; pos < LOG_RING_SIZE; pos++) {
+        atomic_init(&ring->records[pos].seq, pos);
+    }
+
+    atomic_store(&ring->running, true);
+
+    if (pthread_create(&ring->thread, NULL, logWriter, ring) != 0) {
+        atomic_store(&ring->running, false);
+        snmp_log(LOG_ERR, "%s: failed to create the log writer thread!\n", __func__);
+        return -1;
+    }
+
+    return 0;
+}
+
+void logStop(void)
+{
+    LogRing *ring = &logRing;
+
+    if (!atomic_load(&ring->running)) {
+        return;
+    }
+
+    atomic_store(&ring->stop, true);
+    atomic_store_explicit(&ring->waiting, 0, memory_order_relaxed);
+    syscall(SYS_futex, &ring->waiting, FUTEX_WAKE, 1, NULL, NULL, 0);
+    pthread_join(ring->thread, NULL);
+
+    // The messages logged from now on are synchronous;
+    // log the ones still in the ring.
+    atomic_store(&ring->running, false);
+    logDrain(ring);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <sys/cdefs.h>
+#include <syslog.h>
+#include <time.h>
+
+__BEGIN_DECLS
+
+// Asynchronous logging. The messages are formatted by the
+// calling thread into a lock-free ring, and a background
+// writer thread passes them on to snmp_log(), so that the
+// MIB update work and the request handler never block on
+// stderr or syslog. Before logStart() and after logStop()
+// the messages are logged synchronously.
+//
+// Messages above the log level are skipped without even
+// evaluating their arguments:
+//
+//     logMsg(LOG_DEBUG, "%s: val=%d\n", __func__, value);
+//
+// and logMsgLimited() drops the messages of a call site that
+// exceed a rate, reporting how many were dropped the next
+// time one gets through:
+//
+//     logMsgLimited(LOG_INFO, 10, "%s: alarmState=%d\n", __func__, state);
+
+// The most verbose priority that gets logged; LOG_INFO by
+// default.
+extern int logLevel;
+
+#define logEnabled(priority)    ((priority) <= logLevel)
+
+#define logMsg(priority, ...) \
+    do { \
+        if (logEnabled(priority)) { \
+            logPut((priority), __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define logMsgLimited(priority, perSec, ...) \
+    do { \
+        static LogRateLimit _logRate; \
+        if (logEnabled(priority) && logRateCheck(&_logRate, (perSec), (priority), __func__)) { \
+            logPut((priority), __VA_ARGS__); \
+        } \
+    } while (0)
+
+// Rate limit state of a call site
+typedef struct LogRateLimit {
+    atomic_long second;
+    atomic_uint count;          // messages in the current second
+    atomic_uint suppressed;     // messages dropped since the last report
+} LogRateLimit;
+
+extern void logPut(int priority, const char *fmt, ...) __attribute__ ((format (printf, 2, 3)));
+
+static inline bool logRateCheck(LogRateLimit *rate, unsigned perSec, int priority, const char *func)
+{
+    struct timespec now;
+    unsigned suppressed;
+
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+
+    // The races between threads that start a new second
+    // can only let a few extra messages through.
+    if (atomic_load_explicit(&rate->second, memory_order_relaxed) != now.tv_sec) {
+        atomic_store_explicit(&rate->second, now.tv_sec, memory_order_relaxed);
+        atomic_store_explicit(&rate->count, 0, memory_order_relaxed);
+    }
+
+    if (atomic_fetch_add_explicit(&rate->count, 1, memory_order_relaxed) >= perSec) {
+        atomic_fetch_add_explicit(&rate->suppressed, 1, memory_order_relaxed);
+        return false;
+    }
+
+    if ((suppressed = atomic_exchange_explicit(&rate->suppressed, 0, memory_order_relaxed)) != 0) {
+        logPut(priority, "%s: %u similar messages suppressed\n", func, suppressed);
+    }
+
+    return true;
+}
+
+// Parse a log level, either a number (0-7) or a syslog
+// priority name without the "LOG_" prefix (e.g. "warning").
+// Returns -1 if it's invalid.
+extern int logLevelParse(const char *str);
+
+// Start the writer thread
+extern int logStart(void);
+
+// Log the pending messages, and stop the writer thread
+extern void logStop(void);
+
+__END_DECLS
@@ -1,10 +1,18 @@
 #include <net-snmp/net-snmp-config.h>
 #include <net-snmp/net-snmp-includes.h>
 #include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
 
 #include "args.h"
+#include "log.h"
 #include "mib.h"
 
 static bool keepRunning = true;
@@ -26,6 +34,10 @@ static const char *help =
         "    snmpSubagent [OPTIONS]\n"
         "\n"
         "OPTIONS:\n"
+        "    --agentx-socket <path>\n"
+        "        Path of the Unix socket of the AgentX master agent.\n"
+        "        The default value is the one of net-snmp, usually\n"
+        "        /var/agentx/master.\n"
         "    --config-file <path>\n"
         "        Path to the CSV file used to generate the snmpd.conf\n"
         "        file. The default value is: configFile.csv.\n"
@@ -33,12 +45,55 @@ static const char *help =
         "        Run in the background.\n"
         "    --data-file <path>\n"
         "        Path to the CSV file used to update the value of the\n"
-        "        SUBAGENT-EXAMPLE-MIB objects. The default value is: \n"
-        "        dataFile.csv.\n"
+        "        SUBAGENT-EXAMPLE-MIB objects. It can be repeated, up to\n"
+        "        16 times, to read several files, each one parsed by its\n"
+        "        own worker thread. The default value is: dataFile.csv.\n"
+        "    --delta-file <path>\n"
+        "        Path to an append-only CSV file, with lines of the form\n"
+        "        <seq>,<name>,<value>, used to update only the objects\n"
+        "        that changed. By default no delta file is used.\n"
+        "    --event-loop\n"
+        "        Run the MIB update work in the main thread, in a single\n"
+        "        epoll event loop with the AgentX session and signals,\n"
+        "        instead of in its own thread.\n"
         "    --help\n"
         "        Show this help and exit.\n"
+        "    --history-depth <num>\n"
+        "        Number of samples, taken once per second, kept for each\n"
+        "        read-only value, to serve their min, max, and mean in\n"
+        "        the sensorHistoryTable; e.g. 300 for the last 5 minutes.\n"
+        "        The default value is 0, which disables the history.\n"
+        "    --log-level <level>\n"
+        "        Most verbose level of the messages logged: emerg, alert,\n"
+        "        crit, err, warning, notice, info, or debug (or 0-7).\n"
+        "        The messages above it are not even formatted. The\n"
+        "        default value is: info.\n"
+        "    --object-file <path>\n"
+        "        Path to the CSV file that defines additional read-only\n"
+        "        objects to be served, besides the ones defined in the\n"
+        "        SUBAGENT-EXAMPLE-MIB. By default no additional objects\n"
+        "        are loaded.\n"
+        "    --shm-ring <name>\n"
+        "        Name of the POSIX shared memory ring used by high-rate\n"
+        "        producers to update the read-only objects (see the\n"
+        "        shmRing.h header). By default no ring is created.\n"
+        "    --state-file <path>\n"
+        "        Path to the file used to keep the thresholds set with\n"
+        "        snmpset, the alarm states, and the last known values\n"
+        "        across restarts; a journal of the recent changes is\n"
+        "        kept in <path>.journal. By default nothing is kept.\n"
         "    --syslog\n"
         "        Use syslog for logging.\n"
+        "    --trap-burst <num>\n"
+        "        Maximum number of traps sent back-to-back, before the\n"
+        "        --trap-rate limit kicks in. The default value is: 20.\n"
+        "    --trap-rate <num>\n"
+        "        Maximum number of traps sent per second; 0 means no\n"
+        "        limit. The default value is: 10.\n"
+        "    --update-socket <path>\n"
+        "        Path of the Unix datagram socket used by collectors to\n"
+        "        stream batches of <name>=<value> lines, one batch per\n"
+        "        datagram. By default no socket is created.\n"
         "\n";
 
 
@@ -52,19 +107,58 @@ static int parseCmdArgs(int argc, char *argv[], CmdArgs *cmdArgs)
 
         arg = argv[n];
 
-        if (strcmp(arg, "--config-file") == 0) {
+        if (strcmp(arg, "--agentx-socket") == 0) {
+            val = argv[++n];
+            cmdArgs->agentxSocket = strdup(val);
+        } else if (strcmp(arg, "--config-file") == 0) {
             val = argv[++n];
             cmdArgs->configFile = strdup(val);
         } else if (strcmp(arg, "--daemon") == 0) {
             cmdArgs->daemon = true;
         } else if (strcmp(arg, "--data-file") == 0) {
             val = argv[++n];
-            cmdArgs->dataFile = strdup(val);
+            if (cmdArgs->numDataFiles == MAX_DATA_FILES) {
+                fprintf(stderr, "ERROR: too many data files (max %d)\n\n", MAX_DATA_FILES);
+                return -1;
+            }
+            cmdArgs->dataFiles[cmdArgs->numDataFiles++] = strdup(val);
+        } else if (strcmp(arg, "--delta-file") == 0) {
+            val = argv[++n];
+            cmdArgs->deltaFile = strdup(val);
+        } else if (strcmp(arg, "--event-loop") == 0) {
+            cmdArgs->eventLoop = true;
         } else if (strcmp(arg, "--help") == 0) {
             printf("%s\n", help);
             exit(0);
+        } else if (strcmp(arg, "--history-depth") == 0) {
+            val = argv[++n];
+            cmdArgs->historyDepth = strtoul(val, NULL, 0);
+        } else if (strcmp(arg, "--log-level") == 0) {
+            val = argv[++n];
+            if ((cmdArgs->logLevel = logLevelParse(val)) < 0) {
+                fprintf(stderr, "ERROR: invalid log level \"%s\"\n\n", val);
+                return -1;
+            }
+        } else if (strcmp(arg, "--object-file") == 0) {
+            val = argv[++n];
+            cmdArgs->objectFile = strdup(val);
+        } else if (strcmp(arg, "--shm-ring") == 0) {
+            val = argv[++n];
+            cmdArgs->shmRing = strdup(val);
+        } else if (strcmp(arg, "--state-file") == 0) {
+            val = argv[++n];
+            cmdArgs->stateFile = strdup(val);
         } else if (strcmp(arg, "--syslog") == 0) {
             cmdArgs->syslog = true;
+        } else if (strcmp(arg, "--trap-burst") == 0) {
+            val = argv[++n];
+            cmdArgs->trapBurst = strtoul(val, NULL, 0);
+        } else if (strcmp(arg, "--trap-rate") == 0) {
+            val = argv[++n];
+            cmdArgs->trapRate = strtoul(val, NULL, 0);
+        } else if (strcmp(arg, "--update-socket") == 0) {
+            val = argv[++n];
+            cmdArgs->updateSocket = strdup(val);
         } else {
             fprintf(stderr, "ERROR: invalid argument \"%s\n\n", arg);
             return -1;
@@ -75,18 +169,176 @@ static int parseCmdArgs(int argc, char *argv[], CmdArgs *cmdArgs)
         cmdArgs->configFile = "configFile.csv"; // default
     }
 
-    if (cmdArgs->dataFile == NULL) {
-        cmdArgs->dataFile = "dataFile.csv";     // default
+    if (cmdArgs->numDataFiles == 0) {
+        cmdArgs->dataFiles[cmdArgs->numDataFiles++] = "dataFile.csv";   // default
     }
 
     return 0;
 }
 
 
+// Tags of the epoll events: the type in the upper 32 bits,
+// and the fd, or the MIB fd index, in the lower 32 bits
+#define EV_SIGNAL       0
+#define EV_SNMP         1
+#define EV_MIB          2
+#define EV_DATA(t, n)   (((uint64_t) (t) << 32) | (uint32_t) (n))
+
+#define MAX_EVENTS      32
+#define MAX_MIB_FDS     8
+
+static void procSignals(int sigFd)
+{
+    struct signalfd_siginfo sigInfo;
+
+    while (read(sigFd, &sigInfo, sizeof (sigInfo)) == sizeof (sigInfo)) {
+        if (sigInfo.ssi_signo == SIGUSR1) {
+            // Need to update snmpd.conf
+            snmpdConfigChange = true;
+        } else {
+            // Terminate the main work loop...
+            keepRunning = false;
+        }
+    }
+}
+
+// Keep the epoll set in sync with the net-snmp fds, which
+// change when the AgentX session is reopened.
+static void syncSnmpFds(int epollFd, fd_set *epollFds, int *epollNumFds, fd_set *readFds, int numFds)
+{
+    int maxFds = (numFds > *epollNumFds) ? numFds : *epollNumFds;
+
+    for (int fd = 0; fd < maxFds; fd++) {
+        struct epoll_event event = { .events = EPOLLIN, .data.u64 = EV_DATA(EV_SNMP, fd) };
+
+        if ((fd < numFds) && FD_ISSET(fd, readFds)) {
+            // A closed fd is dropped from the epoll set, and
+            // its number may have been reused, so make sure
+            // it's (still) in the set.
+            if ((epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) != 0) &&
+                (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0)) {
+                logMsg(LOG_ERR, "%s: failed to add fd %d to the epoll set!\n", __func__, fd);
+            }
+            FD_SET(fd, epollFds);
+        } else if (FD_ISSET(fd, epollFds)) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+            FD_CLR(fd, epollFds);
+        }
+    }
+
+    *epollNumFds = numFds;
+}
+
+// The event loop mode: the AgentX session, the sources of
+// MIB updates, and the signals are all multiplexed in one
+// epoll instance, in the main thread. The net-snmp alarms
+// (e.g. the AgentX ping) set the epoll_wait() timeout, so
+// there are no periodic wake ups when there is nothing to
+// do.
+static int eventLoop(const sigset_t *sigMask)
+{
+    struct epoll_event event = { .events = EPOLLIN };
+    int mibFds[MAX_MIB_FDS];
+    int epollFd, sigFd, numMibFds;
+    fd_set epollFds;    // the net-snmp fds in the epoll set
+    int epollNumFds = 0;
+
+    if ((epollFd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+        logMsg(LOG_ERR, "%s: epoll_create1() failed!\n", __func__);
+        return -1;
+    }
+
+    if ((sigFd = signalfd(-1, sigMask, (SFD_NONBLOCK | SFD_CLOEXEC))) == -1) {
+        logMsg(LOG_ERR, "%s: signalfd() failed!\n", __func__);
+        return -1;
+    }
+
+    event.data.u64 = EV_DATA(EV_SIGNAL, sigFd);
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, sigFd, &event) != 0) {
+        logMsg(LOG_ERR, "%s: failed to add the signalfd to the epoll set!\n", __func__);
+        return -1;
+    }
+
+    numMibFds = mibEventFds(mibFds, MAX_MIB_FDS);
+    for (int n = 0; n < numMibFds; n++) {
+        event.data.u64 = EV_DATA(EV_MIB, n);
+        if ((mibFds[n] != -1) && (epoll_ctl(epollFd, EPOLL_CTL_ADD, mibFds[n], &event) != 0)) {
+            logMsg(LOG_ERR, "%s: failed to add fd %d to the epoll set!\n", __func__, mibFds[n]);
+            return -1;
+        }
+    }
+
+    FD_ZERO(&epollFds);
+
+    // Do the initial pass of the MIB update work
+    mibEventRun();
+
+    while (keepRunning) {
+        struct epoll_event events[MAX_EVENTS];
+        struct timeval timeout = { LONG_MAX, 0 };
+        fd_set readFds;
+        int numFds = 0, block = 0, msec, count;
+        bool snmpReady = false;
+
+        FD_ZERO(&readFds);
+        snmp_select_info(&numFds, &readFds, &timeout, &block);
+        syncSnmpFds(epollFd, &epollFds, &epollNumFds, &readFds, numFds);
+
+        // Block forever if there are no net-snmp alarms
+        if (block) {
+            msec = -1;
+        } else if (timeout.tv_sec >= (INT_MAX / 1000)) {
+            msec = INT_MAX;
+        } else {
+            msec = (timeout.tv_sec * 1000) + ((timeout.tv_usec + 999) / 1000);
+        }
+
+        if (((count = epoll_wait(epollFd, events, MAX_EVENTS, msec)) == -1) && (errno != EINTR)) {
+            logMsg(LOG_ERR, "%s: epoll_wait() failed!\n", __func__);
+            break;
+        }
+
+        FD_ZERO(&readFds);
+        for (int n = 0; n < count; n++) {
+            uint32_t data = (uint32_t) events[n].data.u64;
+
+            switch (events[n].data.u64 >> 32) {
+            case EV_SIGNAL:
+                procSignals(sigFd);
+                break;
+            case EV_SNMP:
+                FD_SET(data, &readFds);
+                snmpReady = true;
+                break;
+            case EV_MIB:
+                mibEventReady(data);
+                break;
+            }
+        }
+
+        // Same as agent_check_and_process()
+        if (snmpReady) {
+            snmp_read(&readFds);
+        } else if (count == 0) {
+            snmp_timeout();
+        }
+        run_alarms();
+        netsnmp_check_outstanding_agent_requests();
+
+        mibEventRun();
+    }
+
+    close(sigFd);
+    close(epollFd);
+
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
     const char *snmpSubagent = "snmpSubagent";
-    CmdArgs cmdArgs = { 0 };
+    CmdArgs cmdArgs = { .logLevel = LOG_INFO, .trapBurst = 20, .trapRate = 10 };
+    sigset_t sigMask;
 
     if (parseCmdArgs(argc, argv, &cmdArgs) != 0){
         return -1;
@@ -97,62 +349,95 @@ int main(int argc, char *argv[])
     else
         snmp_enable_stderrlog();
 
+    logLevel = cmdArgs.logLevel;
+
     if (netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_ROLE, 1) != SNMPERR_SUCCESS) {
-        snmp_log(LOG_ERR, "Can't set NETSNMP_DS_AGENT_ROLE!\n");
+        logMsg(LOG_ERR, "Can't set NETSNMP_DS_AGENT_ROLE!\n");
+        return -1;
+    }
+
+    sigemptyset(&sigMask);
+    sigaddset(&sigMask, SIGUSR1);
+    sigaddset(&sigMask, SIGTERM);
+    sigaddset(&sigMask, SIGINT);
+
+    // In the event loop mode the signals are read from a
+    // signalfd, so they must be blocked, in this thread and
+    // in all the threads it creates.
+    if (cmdArgs.eventLoop && (pthread_sigmask(SIG_BLOCK, &sigMask, NULL) != 0)) {
+        logMsg(LOG_ERR, "Failed to block the signals!\n");
         return -1;
     }
 
     // Catch USR1 signal, used to indicate a change in
     // the snmpd.conf file...
     if (signal(SIGUSR1, sigUsr1Handler) == SIG_ERR) {
-        snmp_log(LOG_ERR, "Failed to set SIGUSR1 handler!\n");
+        logMsg(LOG_ERR, "Failed to set SIGUSR1 handler!\n");
         return -1;
     }
 
     // Catch TERMINATE and INTERRUPR signals, which are
     // used to gracefully exit the snmpSubagent...
     if (signal(SIGTERM, stopSubagent) == SIG_ERR) {
-        snmp_log(LOG_ERR, "Failed to set SIGTERM handler!\n");
+        logMsg(LOG_ERR, "Failed to set SIGTERM handler!\n");
         return -1;
     }
     if (signal(SIGINT, stopSubagent) == SIG_ERR) {
-        snmp_log(LOG_ERR, "Failed to set SIGINT handler!\n");
+        logMsg(LOG_ERR, "Failed to set SIGINT handler!\n");
+        return -1;
+    }
+
+    if ((cmdArgs.agentxSocket != NULL) &&
+        (netsnmp_ds_set_string(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_X_SOCKET, cmdArgs.agentxSocket) != SNMPERR_SUCCESS)) {
+        logMsg(LOG_ERR, "Can't set NETSNMP_DS_AGENT_X_SOCKET!\n");
         return -1;
     }
 
     if (cmdArgs.daemon) {
         // Run in the background
         if (netsnmp_daemonize(true, !cmdArgs.syslog) != 0) {
-            snmp_log(LOG_ERR, "Can't become daemon!\n");
+            logMsg(LOG_ERR, "Can't become daemon!\n");
             return -1;
         }
     }
 
     if (init_agent(snmpSubagent) != 0) {
-        snmp_log(LOG_ERR, "Subagent initialization failed!\n");
+        logMsg(LOG_ERR, "Subagent initialization failed!\n");
         return -1;
     }
 
-    mibInit(&cmdArgs);
+    // From now on, the messages are written by the log
+    // writer thread. It's started before mibInit() creates
+    // the other threads, since the net-snmp logging they'd
+    // fall back to isn't thread safe.
+    logStart();
 
-    init_snmp(snmpSubagent);
-
-    // Change the default 15 sec AgentX reconnect period to
-    // a faster 5 sec period ...
-    if (netsnmp_ds_set_int(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_AGENTX_PING_INTERVAL, 5) != SNMPERR_SUCCESS) {
-        snmp_log(LOG_WARNING, "Can't set AGENTX_PING_INTERVAL!\n");
+    if (mibInit(&cmdArgs) != 0) {
+        logMsg(LOG_ERR, "MIB initialization failed!\n");
+        logStop();
+        return -1;
     }
 
-    snmp_log(LOG_INFO, "%s running: configFile=%s dataFile=%s\n", snmpSubagent, cmdArgs.configFile, cmdArgs.dataFile);
+    init_snmp(snmpSubagent);
+
+    logMsg(LOG_INFO, "%s running: configFile=%s dataFile=%s numDataFiles=%u\n", snmpSubagent, cmdArgs.configFile, cmdArgs.dataFiles[0], cmdArgs.numDataFiles);
 
     // Main work loop...
-    while (keepRunning) {
-        agent_check_and_process(1);
+    if (cmdArgs.eventLoop) {
+        eventLoop(&sigMask);
+    } else {
+        while (keepRunning) {
+            agent_check_and_process(1);
+        }
     }
 
+    mibShutdown();
+
+    logStop();
+
     snmp_shutdown(snmpSubagent);
 
-    snmp_log(LOG_INFO, "%s terminated!\n", snmpSubagent);
+    logMsg(LOG_INFO, "%s terminated!\n", snmpSubagent);
 
     return 0;
 }
@@ -4,524 +4,4824 @@
 #include <net-snmp/agent/agent_trap.h>
 
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
 #include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
+#include "alarm.h"
+#include "dataParse.h"
+#include "history.h"
+#include "log.h"
 #include "mib.h"
+#include "mibDefs.h"
+#include "nameIndex.h"
+#include "persist.h"
+#include "provider.h"
+#include "shmRing.h"
+#include "stats.h"
+#include "timerWheel.h"
+#include "trapQueue.h"
+#include "updateSocket.h"
+#include "valueStore.h"
+
+// Maximum number of messages logged per second for the alarm
+// transitions and traps, and for the rejected data records,
+// so that a storm of them doesn't flood the log.
+#define LOG_ALARMS_PER_SEC      10
+#define LOG_REJECTED_PER_SEC    10
 
 // SUBAGENT-EXAMPLE-MIB Object Handlers
 
-// ac1Temp OBJECT-TYPE
-//     SYNTAX      Integer32
-//     MAX-ACCESS  read-only
-//     STATUS      current
-//     DESCRIPTION "The current value (in degrees Celsius) of the A/C
-//                  Unit #1 temperature sensor."
-//     ::= { subagentExampleMIB 1 }
-static const oid ac1TempOid[] = { 1, 3, 6, 1, 3, 9999, 1, 0 };
-static int ac1Temp = 0;
-
-// ac2Temp OBJECT-TYPE
-//     SYNTAX      Integer32
-//     MAX-ACCESS  read-only
-//     STATUS      current
-//     DESCRIPTION "The current value (in degrees Celsius) of the A/C
-//                  Unit #2 temperature sensor."
-//     ::= { subagentExampleMIB 2 }
-static const oid ac2TempOid[] = { 1, 3, 6, 1, 3, 9999, 2, 0 };
-static int ac2Temp = 0;
-
-// ac3Temp OBJECT-TYPE
-//     SYNTAX      Integer32
-//     MAX-ACCESS  read-only
-//     STATUS      current
-//     DESCRIPTION "The current value (in degrees Celsius) of the A/C
-//                  Unit #3 temperature sensor."
-//     ::= { subagentExampleMIB 3 }
-static const oid ac3TempOid[] = { 1, 3, 6, 1, 3, 9999, 3, 0 };
-static int ac3Temp = 0;
-
-// loTempThreshold OBJECT-TYPE
-//     SYNTAX      Integer32
-//     MAX-ACCESS  read-write
-//     STATUS      current
-//     DESCRIPTION "The temperature value (in degrees Celsius) below
-//                  which to clear an A/C Unit High Temperature alarm."
-//     DEFVAL      { 28 }
-//     ::= { subagentExampleMIB 4 }
-static const oid loTempThresholdOid[] = { 1, 3, 6, 1, 3, 9999, 4, 0 };
-static long loTempThreshold = 28;
-
-// hiTempThreshold OBJECT-TYPE
-//     SYNTAX      Integer32
-//     MAX-ACCESS  read-write
-//     STATUS      current
-//     DESCRIPTION "The temperature value (in degrees Celsius) above
-//                  which to raise an A/C Unit High Temperature alarm."
-//     DEFVAL      { 30 }
-//     ::= { subagentExampleMIB 4 }
-static const oid hiTempThresholdOid[] = { 1, 3, 6, 1, 3, 9999, 5, 0 };
-static long hiTempThreshold = 30;
-
-// acHiTempAlarmUnit OBJECT-TYPE
-//     SYNTAX      Integer32
-//     MAX-ACCESS  accessible-for-notify
-//     STATUS      current
-//     DESCRIPTION "The A/C Unit that raised a High Temperature alarm."
-//     ::= { subagentExampleMIB 5 }
-static const oid acHiTempAlarmUnitOid[] = { 1, 3, 6, 1, 3, 9999, 6 };
-
-// acHiTempAlarmState OBJECT-TYPE
-//     SYNTAX      Integer32
-//     MAX-ACCESS  accessible-for-notify
-//     STATUS      current
-//     DESCRIPTION "Indicates the current state of the High Temperature
-//                  alarm: 0 means the alarm is inactive and 1 indicates
-//                  the alarm is active."
-//     ::= { subagentExampleMIB 6 }
-static const oid acHiTempAlarmStateOid[] = { 1, 3, 6, 1, 3, 9999, 7 };
-static int acHiTempAlarmState = 0;
-
-// acHiTempAlarmNotification NOTIFICATION-TYPE
-//     OBJECTS     { acHiTempUnit }
-//     STATUS      current
-//     DESCRIPTION "Trap to notify a High Temperature alarm on one of
-//                  the A/C Units."
-//     ::= { subagentExampleMIB 7 }
-static const oid acHiTempAlarmNotificationOid[] = { 1, 3, 6, 1, 3, 9999, 8 };
-
-// SET callback handlers
-
-static int loTempThresholdCb(netsnmp_mib_handler *handler,
-                     netsnmp_handler_registration *reginfo,
-                     netsnmp_agent_request_info *reqinfo,
-                     netsnmp_request_info *requests)
-{
-    netsnmp_variable_list *varBind = requests->requestvb;
-    long value = *varBind->val.integer;
-    snmp_log(LOG_INFO, "%s: type=%u val=%ld\n", __func__, varBind->type, value);
+// The OIDs of the MIB objects, the table columns, and the
+// list of the scalars served from mibObjTbl[], are generated
+// from SUBAGENT-EXAMPLE-MIB.txt by mibgen at build time, in
+// mibDefs.h (see mibgen.c), so they always match the MIB.
+
+// The values of the read-write scalars
+static long loTempThreshold = DEFVAL_LOTEMPTHRESHOLD;
+static long hiTempThreshold = DEFVAL_HITEMPTHRESHOLD;
+
+// The thresholds are written by the AgentX thread when
+// processing a SET request, and read by the MIB update
+// task, so they are always accessed atomically.
+static __inline__ long getThreshold(const long *threshold)
+{
+    return __atomic_load_n(threshold, __ATOMIC_RELAXED);
+}
+
+// SET callback handlers: called to check the new value
+// of a read-write object before it is applied.
+
+static int loTempThresholdCb(long value)
+{
+    long hiThreshold = getThreshold(&hiTempThreshold);
+
+    logMsg(LOG_INFO, "%s: val=%ld\n", __func__, value);
 
     // Make sure the value is lower than hiTempThreshold
-    if (value >= hiTempThreshold) {
-        snmp_log(LOG_ERR, "%s: loTempThreshold=%ld MUST be lower than hiTempThreshold=%ld !\n", __func__, value, hiTempThreshold);
+    if (value >= hiThreshold) {
+        logMsg(LOG_ERR, "%s: loTempThreshold=%ld MUST be lower than hiTempThreshold=%ld !\n", __func__, value, hiThreshold);
         return SNMP_ERR_INCONSISTENTVALUE;
     }
 
-    // TODO: Does this change in the loTempThreshold value
-    // affect the status of the alarm?
+    // The change in the loTempThreshold value causes
+    // all the alarms to be re-evaluated; see
+    // mibThresholdsChanged().
 
     return SNMP_ERR_NOERROR;
 }
 
-static int hiTempThresholdCb(netsnmp_mib_handler *handler,
-                     netsnmp_handler_registration *reginfo,
-                     netsnmp_agent_request_info *reqinfo,
-                     netsnmp_request_info *requests)
+static int hiTempThresholdCb(long value)
 {
-    netsnmp_variable_list *varBind = requests->requestvb;
-    long value = *varBind->val.integer;
-    snmp_log(LOG_INFO, "%s: type=%u val=%ld\n", __func__, varBind->type, *varBind->val.integer);
+    long loThreshold = getThreshold(&loTempThreshold);
+
+    logMsg(LOG_INFO, "%s: val=%ld\n", __func__, value);
 
     // Make sure the value is higher than loTempThreshold
-    if (value <= loTempThreshold) {
-        snmp_log(LOG_ERR, "%s: hiTempThreshold=%ld MUST be higher than loTempThreshold=%ld !\n", __func__, value, loTempThreshold);
+    if (value <= loThreshold) {
+        logMsg(LOG_ERR, "%s: hiTempThreshold=%ld MUST be higher than loTempThreshold=%ld !\n", __func__, value, loThreshold);
         return SNMP_ERR_INCONSISTENTVALUE;
     }
 
-    // TODO: Does this change in the hiTempThreshold value
-    // affect the status of the alarm?
+    // The change in the hiTempThreshold value causes
+    // all the alarms to be re-evaluated; see
+    // mibThresholdsChanged().
 
     return SNMP_ERR_NOERROR;
 }
 
+typedef int (MibObjSetCb)(long value);
+
+// The values of the read-only objects are kept in one dense
+// column per storage type: the Integer32 ones in mibValueTbl[],
+// and the others in the typed columns (see MibTypedColumn).
+typedef enum MibColumn {
+    MIB_COLUMN_INT32 = -1,  // Integer32
+    MIB_COLUMN_UINT32,      // Gauge32, Counter32, TimeTicks
+    MIB_COLUMN_UINT64,      // Counter64
+    MIB_COLUMN_STRING,      // OCTET STRING
+    NUM_MIB_COLUMNS
+} MibColumn;
 
 typedef struct MibObj {
     const char *varName;
     const oid *varOid;
     size_t varOidLen;
-    int *varValue;
+    u_char varType;         // ASN type of the value
+    MibColumn column;       // column of the value of a read-only object
+    int *varValue;          // value of a read-only Integer32 object
+    long *rwValue;          // value of a read-write object
+    size_t valueIndex;      // index of the value in a typed column
     bool readOnly;
-    Netsnmp_Node_Handler *varCbFunc;
+    MibObjSetCb *varCbFunc;
+    bool hasAlarm;          // the value has a High Temperature alarm
+    bool ownThresholds;     // use the thresholds below instead of the global ones
+    long loThreshold;
+    long hiThreshold;
+    long undoValue;         // value before the SET being processed
+    int acUnit;             // A/C unit reported in the alarm traps; 0 if none
+    Provider *provider;     // lazy value provider; NULL if none
 } MibObj;
 
 // This table contains one entry for each read-only or
-// read-write object in the MIB.
-static MibObj mibObjTbl[] = {
-        { "ac1Temp", ac1TempOid, OID_LENGTH(ac1TempOid), &ac1Temp, true, NULL },
-        { "ac2Temp", ac2TempOid, OID_LENGTH(ac2TempOid), &ac2Temp, true, NULL },
-        { "ac3Temp", ac3TempOid, OID_LENGTH(ac3TempOid), &ac3Temp, true, NULL },
-        { "loTempThreshold", loTempThresholdOid, OID_LENGTH(loTempThresholdOid), (int *) &loTempThreshold, false, loTempThresholdCb },
-        { "hiTempThreshold", hiTempThresholdOid, OID_LENGTH(hiTempThresholdOid), (int *) &hiTempThreshold, false, hiTempThresholdCb },
-        { NULL, NULL, 0, NULL, NULL }
+// read-write object defined in SUBAGENT-EXAMPLE-MIB. The
+// value of each read-only object is allocated in the
+// mibValueStore by mibInit().
+// A read-write object named x keeps its value in the
+// variable x, and its SET callback is xCb().
+#define BUILTIN_RO(x)   { #x, x##Oid, OID_LENGTH(x##Oid), ASN_INTEGER, MIB_COLUMN_INT32, NULL, NULL, 0, true, NULL },
+#define BUILTIN_RW(x)   { #x, x##Oid, OID_LENGTH(x##Oid), ASN_INTEGER, MIB_COLUMN_INT32, NULL, &x, 0, false, x##Cb },
+
+static const MibObj builtinObjTbl[] = {
+        MIB_BUILTIN_OBJS(BUILTIN_RO, BUILTIN_RW)
+        { NULL }
+};
+
+// The alarms of the built-in read-only objects: each acNTemp
+// is the temperature sensor of A/C unit #N, as described in
+// the MIB, and uses the global thresholds. The object file
+// can bind them differently.
+typedef struct BuiltinAlarm {
+    const char *varName;
+    int acUnit;
+} BuiltinAlarm;
+
+static const BuiltinAlarm builtinAlarmTbl[] = {
+    { "ac1Temp", 1 },
+    { "ac2Temp", 2 },
+    { "ac3Temp", 3 },
+    { NULL }
 };
 
-static int sendHiTempAlarmTrap(const char *varName)
+// This table contains one entry for each object served by
+// the subagent: the built-in objects, followed by the ones
+// loaded from the object file. The table is terminated by
+// an entry with a NULL varName.
+static MibObj *mibObjTbl;
+static size_t mibObjCount;
+static size_t mibObjTblSize;
+
+// The values of all the read-only Integer32 objects are kept
+// in this contiguous array, in the same order as in mibObjTbl[],
+// so that the update pass touches as few cache lines as possible.
+// This is the MIB update task's working copy of the values;
+// the AgentX thread reads the snapshots published through
+// the mibValueStore.
+static ValueStore mibValueStore;
+static int *mibValueTbl;
+static size_t mibValueCount;
+static bool mibValuesDirty;
+static MibObj **mibValueObj;    // value index to read-only object
+
+// Set the n-th value, and mark it for the next publish
+static inline void mibValueSet(size_t n, int value)
 {
-    netsnmp_variable_list *varList = NULL;
-    const oid snmpTrapOid[] = { 1, 3, 6, 1, 6, 3, 1, 1, 4, 1, 0 };
-    int acUnit = 0;
+    mibValueTbl[n] = value;
+    valueStoreMark(&mibValueStore, n);
+    mibValuesDirty = true;
+}
 
-    // Extract the A/C unit number
-    if (sscanf(varName, "ac%dTemp", &acUnit) != 1) {
-        snmp_log(LOG_ERR, "%s: Invalid A/C unit: %s\n", __func__, varName);
-        return -1;
-    }
+// The values of the OCTET STRING objects are kept in fixed
+// size slots, so that the string column is a flat arena like
+// the others, and setting a value never allocates.
+#define MIB_STRING_SIZE     64
 
-    // Add varbind: snmpTrapOID = acHiTempAlarmNotificationOid
-    snmp_varlist_add_variable(&varList,
-            snmpTrapOid, OID_LENGTH(snmpTrapOid),
-            ASN_OBJECT_ID,
-            acHiTempAlarmNotificationOid, OID_LENGTH(acHiTempAlarmNotificationOid) * sizeof (oid));
+typedef struct MibString {
+    uint8_t len;
+    char text[MIB_STRING_SIZE - 1];
+} MibString;
 
-    // Add varbind: acHiTempAlarmUnit = acUnit
-    snmp_varlist_add_variable(&varList,
-            acHiTempAlarmUnitOid, OID_LENGTH(acHiTempAlarmUnitOid),
-            ASN_INTEGER,
-            &acUnit, sizeof (acUnit));
+// The values of the read-only objects of the other types are
+// kept in one contiguous array per storage type: the columns
+// of the mibValueStore after the Integer32 one, which are all
+// published together, as one generation.
+// They are only set from the data files, and the update socket:
+// the alarms, the history, the poll intervals, the providers,
+// the shared memory ring, and the --state-file only cover the
+// Integer32 values.
+typedef struct MibTypedColumn {
+    const char *name;
+    size_t valueSize;
+    size_t numValues;
+    bool dirty;
+} MibTypedColumn;
 
-    // Add varbind: acHiTempAlarmState = alarmState
-    snmp_varlist_add_variable(&varList,
-            acHiTempAlarmStateOid, OID_LENGTH(acHiTempAlarmStateOid),
-            ASN_INTEGER,
-            &acHiTempAlarmState, sizeof (acHiTempAlarmState));
+// Column of the mibValueStore holding the values of a MibColumn
+#define MIB_STORE_COLUMN(column)    ((unsigned) ((column) + 1))
 
-    snmp_log(LOG_ERR, "%s: Sending trap for: %s\n", __func__, varName);
+static MibTypedColumn mibTypedColumns[NUM_MIB_COLUMNS] = {
+    [MIB_COLUMN_UINT32] = { "uint32", sizeof (uint32_t) },
+    [MIB_COLUMN_UINT64] = { "uint64", sizeof (uint64_t) },
+    [MIB_COLUMN_STRING] = { "string", sizeof (MibString) },
+};
 
-    send_v2trap(varList);
+// The object types supported in the object file, and the
+// column that holds their values
+typedef struct MibType {
+    const char *name;
+    u_char varType;
+    MibColumn column;
+} MibType;
 
-    snmp_free_varbind(varList );
+static const MibType mibTypes[] = {
+    { "Integer32", ASN_INTEGER, MIB_COLUMN_INT32 },
+    { "Gauge32", ASN_GAUGE, MIB_COLUMN_UINT32 },
+    { "Counter32", ASN_COUNTER, MIB_COLUMN_UINT32 },
+    { "TimeTicks", ASN_TIMETICKS, MIB_COLUMN_UINT32 },
+    { "Counter64", ASN_COUNTER64, MIB_COLUMN_UINT64 },
+    { "OCTET STRING", ASN_OCTET_STR, MIB_COLUMN_STRING },
+    { "DisplayString", ASN_OCTET_STR, MIB_COLUMN_STRING },
+};
 
-    return 0;
-}
+#define NUM_MIB_TYPES   (sizeof (mibTypes) / sizeof (mibTypes[0]))
 
-// This flag is set by the SIGUSR1 handler to
-// indicate that the file snmpd.conf needs to
-// be updated and the snmpd service restarted.
-bool snmpdConfigChange = false;
+// A snapshot of all the value columns
+typedef struct MibValues {
+    const int *int32;
+    const uint32_t *uint32;
+    const uint64_t *uint64;
+    const MibString *string;
+} MibValues;
 
-typedef struct SnmpdConf {
-    char dataBuf[65536];    // 65 KB big enough?
-    size_t dataLen;
-    bool restartSnmpd;
-} SnmpdConf;
+// GET requests are served from a snapshot of the values,
+// which is pinned for the duration of each request PDU, so
+// that all the objects in a multi-varbind GET come from the
+// same generation, whatever their types.
+static const MibValues *mibValueSnapshot(netsnmp_agent_request_info *reqinfo)
+{
+    static MibValues snapshot;
+    static long snapshotReqId;
+    long reqId = ((reqinfo->asp != NULL) && (reqinfo->asp->pdu != NULL)) ? reqinfo->asp->pdu->reqid : 0;
 
-static int setConfigValue(const char *tag, const char *val, SnmpdConf *snmpdConf)
+    if ((snapshot.int32 == NULL) || (reqId == 0) || (reqId != snapshotReqId)) {
+        snapshot.int32 = valueStoreSnapshot(&mibValueStore);
+        snapshot.uint32 = valueStoreColumn(&mibValueStore, MIB_STORE_COLUMN(MIB_COLUMN_UINT32));
+        snapshot.uint64 = valueStoreColumn(&mibValueStore, MIB_STORE_COLUMN(MIB_COLUMN_UINT64));
+        snapshot.string = valueStoreColumn(&mibValueStore, MIB_STORE_COLUMN(MIB_COLUMN_STRING));
+        snapshotReqId = reqId;
+    }
+
+    return &snapshot;
+}
+
+// Add the typed columns to the mibValueStore, and allocate
+// the values of the objects stored in them
+static int mibTypedColumnsInit(void)
 {
-    char *buf = snmpdConf->dataBuf + snmpdConf->dataLen;
-    size_t len = sizeof (snmpdConf->dataBuf) - snmpdConf->dataLen;
-    int n = 0;
-
-    if (strcmp(tag, "agentAddress") == 0) {
-        // TODO: validate the syntax of the value string
-        n = snprintf(buf, len, "agentaddress %s", val);
-        snmpdConf->restartSnmpd = true;
-    } else if (strcmp(tag, "readOnlyCommunity") == 0) {
-        n = snprintf(buf, len, "rocommunity %s", val);
-        snmpdConf->restartSnmpd = true;
-    } else if (strcmp(tag, "readWriteCommunity") == 0) {
-        n = snprintf(buf, len, "rwcommunity %s", val);
-        snmpdConf->restartSnmpd = true;
-    } else if (strcmp(tag, "trapReceiver") == 0) {
-        // TODO: validate the syntax of the value string
-        n = snprintf(buf, len, "trap2sink %s", val);
-        snmpdConf->restartSnmpd = true;
-    } else if (strcmp(tag, "sysContact") == 0) {
-        n = snprintf(buf, len, "sysContact %s", val);
-        snmpdConf->restartSnmpd = true;
-    } else if (strcmp(tag, "sysLocation") == 0) {
-        n = snprintf(buf, len, "sysLocation %s", val);
-        snmpdConf->restartSnmpd = true;
-    } else {
-        snmp_log(LOG_WARNING, "%s: unsupported config tag \"%s\"\n", __func__, tag);
+    for (MibObj *mibObj = &mibObjTbl[0]; mibObj->varName != NULL; mibObj++) {
+        if (mibObj->readOnly && (mibObj->column != MIB_COLUMN_INT32)) {
+            mibObj->valueIndex = mibTypedColumns[mibObj->column].numValues++;
+        }
     }
 
-    snmpdConf->dataLen += n;
+    for (int n = 0; n < NUM_MIB_COLUMNS; n++) {
+        MibTypedColumn *col = &mibTypedColumns[n];
+
+        if (valueStoreAddColumn(&mibValueStore, col->numValues, col->valueSize) != (int) MIB_STORE_COLUMN(n)) {
+            logMsg(LOG_ERR, "%s: failed to alloc %zu %s values!\n", __func__, col->numValues, col->name);
+            return -1;
+        }
+    }
 
     return 0;
 }
 
-static int procConfigFile(const char *configFile)
+// Publish the values of all the columns, if any of them
+// changed. Returns true if they were published.
+static bool mibValuesPublish(void)
 {
-    static SnmpdConf snmpdConf;
-    FILE *rdFp;
-    char strBuf[256];
-
-    // Clear the flag!
-    snmpdConfigChange = false;
+    bool dirty = mibValuesDirty;
 
-    // Init the SnmpdConf buffer
-    snmpdConf.dataLen = 0;
-    snmpdConf.restartSnmpd = false;
+    for (int n = 0; n < NUM_MIB_COLUMNS; n++) {
+        dirty |= mibTypedColumns[n].dirty;
+        mibTypedColumns[n].dirty = false;
+    }
 
-    // Open the configFile in read-only mode
-    if ((rdFp = fopen(configFile, "r")) == NULL) {
-        snmp_log(LOG_ERR, "%s: failed to open config file \"%s\"\n", __func__, configFile);
-        return -1;
+    if (!dirty) {
+        return false;
     }
 
-    // Read one line at a time. Lines that start
-    // with a '#' are comments and are skipped.
-    while (fgets(strBuf, sizeof (strBuf), rdFp) != NULL) {
-        if ((strBuf[0] != '#') && (strBuf[0] != '\0')) {
-            char *comma = strchr(strBuf, ',');
-            if (comma != NULL) {
-                *comma = '\0';  // null-terminate tag string
-                setConfigValue(strBuf, (comma + 1), &snmpdConf);
-            }
-        }
+    valueStorePublish(&mibValueStore);
+    mibValuesDirty = false;
+
+    return true;
+}
+
+// Set when a SET request changes any of the alarm thresholds,
+// so that the MIB update task re-evaluates all the alarms.
+static atomic_bool mibThresholdsDirty = true;
+
+// Used to wake up the MIB update task
+static int mibUpdateWakeFd = -1;
+
+// The MIB update task, when it runs in its own thread; it's
+// stopped, and joined, by mibShutdown().
+static pthread_t mibUpdateThread;
+static bool mibUpdateThreadStarted = false;
+static atomic_bool mibUpdateStop = false;
+
+// Set when a lazy value provider read a new value, so that
+// the MIB update task applies it to the mibValueStore, and
+// evaluates its alarm.
+static atomic_bool mibProvidersDirty = false;
+
+static void mibThresholdsChanged(void)
+{
+    const uint64_t one = 1;
+
+    atomic_store(&mibThresholdsDirty, true);
+
+    if (write(mibUpdateWakeFd, &one, sizeof (one)) != sizeof (one)) {
+        logMsg(LOG_WARNING, "%s: failed to wake up the MIB update task\n", __func__);
     }
+}
 
-    // Done with the configFile!
-    fclose(rdFp);
+// Runs in the provider worker thread
+static void mibProvidersChanged(void)
+{
+    const uint64_t one = 1;
 
-    // Do we need to regenerate snmpd.conf and
-    // restart the snmpd service?
-    if (snmpdConf.restartSnmpd) {
-        FILE *wrFp;
-        time_t now = time(NULL);
-        struct tm brkDwnTime;
-        static char tsBuf[32];  // YYYY-MM-DDTHH:MM:SS
+    atomic_store(&mibProvidersDirty, true);
 
-        strftime(tsBuf, sizeof (tsBuf), "%Y-%m-%d %H:%M:%S", gmtime_r(&now, &brkDwnTime));    // %H means 24-hour time
+    if (write(mibUpdateWakeFd, &one, sizeof (one)) != sizeof (one)) {
+        logMsg(LOG_WARNING, "%s: failed to wake up the MIB update task\n", __func__);
+    }
+}
 
-        // Open the snmpd.conf file in read-write mode
-        if ((wrFp = fopen("/etc/snmp/snmpd.conf", "w+")) == NULL) {
-            snmp_log(LOG_ERR, "%s: failed to open snmpd.conf file\n", __func__);
-            return -1;
-        }
+// The rows of the acUnitTable are kept in a columnar store,
+// sorted by acUnitIndex, so that walking a whole column only
+// touches the cache lines of that column. The acUnitTemp and
+// acUnitHiTempAlarmState columns are updated by the MIB update
+// task, so they live in the mibValueStore, right after the
+// values of the read-only scalar objects.
+typedef struct AcUnitTbl {
+    size_t numRows;
+    oid *unitIndex;             // acUnitIndex column
+    long *loTempThreshold;      // acUnitLoTempThreshold column
+    long *hiTempThreshold;      // acUnitHiTempThreshold column
+    long *undoValue;            // value before the SET being processed
+    size_t tempBase;            // acUnitTemp column in mibValueTbl[]
+    size_t alarmStateBase;      // acUnitHiTempAlarmState column in mibValueTbl[]
+} AcUnitTbl;
 
-        // Add an informational line
-        fprintf(wrFp, "# This file was autogenerated by snmpSubagent on: %s\n", tsBuf);
-        // AgentX support is always enabled
-        fprintf(wrFp, "master agentx\n");
-        // Append the rest of the configuration data
-        fprintf(wrFp, "%s", snmpdConf.dataBuf);
+static AcUnitTbl acUnitTbl;
 
-        // Done with snmpd.conf!
-        fclose(wrFp);
+// Prefix of the names of the acUnitTemp values, as used in
+// the data file
+static const char acUnitTempPrefix[] = "acUnitTemp.";
+static const int acUnitTempPrefixLen = sizeof (acUnitTempPrefix) - 1;
 
-        snmp_log(LOG_INFO, "%s: Restarting snmpd service to pick up the new config...\n", __func__);
+// Find the first row whose index is greater than (or equal
+// to, if inclusive is set) the given index.
+static size_t acUnitRowSearch(oid unitIndex, bool inclusive)
+{
+    size_t lo = 0, hi = acUnitTbl.numRows;
 
-        // Now restart the "snmpd" service to pick up the
-        // config changes.
-        if (system("systemctl restart snmpd") == -1) {
-            int errNo = errno;
-            snmp_log(LOG_ERR, "%s: Failed to exec \"systemctl restart snmpd\": %s (%d)\n", __func__, strerror(errNo), errNo);
-            return -1;
+    while (lo < hi) {
+        size_t mid = lo + ((hi - lo) / 2);
+        if ((acUnitTbl.unitIndex[mid] < unitIndex) || ((acUnitTbl.unitIndex[mid] == unitIndex) && !inclusive)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
     }
 
-    return 0;
+    return lo;
 }
 
-static int setReadOnlyValue(const char *varName, int value)
+// Find the row with the given index. Returns -1 if the
+// row doesn't exist.
+static ssize_t acUnitRowFind(oid unitIndex)
 {
-    for (MibObj *mibObj = &mibObjTbl[0]; mibObj->varName != NULL; mibObj++) {
-        if (strcmp(varName, mibObj->varName) == 0) {
-            // Make sure it is a read-only object
-            if (!mibObj->readOnly) {
-                snmp_log(LOG_ERR, "%s: MIB object \"%s\" is not read-only !\n", __func__, varName);
-                return -1;
-            }
+    size_t row = acUnitRowSearch(unitIndex, true);
 
-            // Has the value changed?
-            if (value != *mibObj->varValue) {
-                // Yes! Update the value
-                snmp_log(LOG_INFO, "%s: varName=%s oldValue=%d newValue=%d\n", __func__, varName, *mibObj->varValue, value);
-                *mibObj->varValue = value;
-
-                // Do we need to send a hiTempAlarm trap?
-                if ((acHiTempAlarmState == 0) && (value > hiTempThreshold)) {
-                    snmp_log(LOG_INFO, "%s: varName=%s newValue=%d is greater than hiTempThreshold=%ld !\n", __func__, varName, value, hiTempThreshold);
-                    acHiTempAlarmState = 1; // raise the alarm
-                    sendHiTempAlarmTrap(varName);
-                } else if ((acHiTempAlarmState == 1) && (value < loTempThreshold)) {
-                    snmp_log(LOG_INFO, "%s: varName=%s newValue=%d is lower than loTempThreshold=%ld !\n", __func__, varName, value, loTempThreshold);
-                    acHiTempAlarmState = 0; // clear the alarm
-                    sendHiTempAlarmTrap(varName);
-                }
-            }
+    if ((row < acUnitTbl.numRows) && (acUnitTbl.unitIndex[row] == unitIndex)) {
+        return row;
+    }
 
-            return 0;
-        }
+    return -1;
+}
+
+// Find the acUnitTable cell with the given OID
+static bool acUnitCellFind(const oid *varOid, size_t varOidLen, int *column, size_t *row)
+{
+    const size_t entryOidLen = OID_LENGTH(acUnitEntryOid);
+    ssize_t r;
+
+    if ((varOidLen != (entryOidLen + 2)) ||
+        (snmp_oid_ncompare(varOid, varOidLen, acUnitEntryOid, entryOidLen, entryOidLen) != 0) ||
+        (varOid[entryOidLen] < COLUMN_ACUNITTEMP) || (varOid[entryOidLen] > COLUMN_ACUNITHITEMPALARMSTATE) ||
+        ((r = acUnitRowFind(varOid[entryOidLen + 1])) < 0)) {
+        return false;
     }
 
-    snmp_log(LOG_WARNING, "%s: Unsupported MIB object \"%s\" !\n", __func__, varName);
+    *column = varOid[entryOidLen];
+    *row = r;
 
-    return -1;
+    return true;
 }
 
-// Read the latest MIB object values from the data file
-static int procDataFile(const char *dataFile)
+// Find the first acUnitTable cell whose OID is greater than
+// (or equal to, if inclusive is set) the given OID. The table
+// is walked column by column.
+static bool acUnitCellNext(const oid *varOid, size_t varOidLen, bool inclusive, int *column, size_t *row)
 {
-    FILE *fp;
-    char strBuf[256];
+    const size_t entryOidLen = OID_LENGTH(acUnitEntryOid);
+    int cmp = snmp_oid_ncompare(varOid, varOidLen, acUnitEntryOid, entryOidLen, entryOidLen);
+    oid col = COLUMN_ACUNITTEMP;
+    size_t r = 0;
 
-    // Open the dataFile in read-only mode
-    if ((fp = fopen(dataFile, "r")) == NULL) {
-        snmp_log(LOG_WARNING, "%s: failed to open data file \"%s\"\n", __func__, dataFile);
-        return -1;
+    if (acUnitTbl.numRows == 0) {
+        return false;
     }
 
-    // Read one line at a time. Lines that start
-    // with a '#' are comments and are skipped.
-    while (fgets(strBuf, sizeof (strBuf), fp) != NULL) {
-        if ((strBuf[0] != '#') && (strBuf[0] != '\0')) {
-            char *comma = strchr(strBuf, ',');
-            if (comma != NULL) {
-                int value;
-                *comma = '\0';
-                if (sscanf((comma + 1), "%d", &value) == 1) {
-                    setReadOnlyValue(strBuf, value);
-                }
+    if (cmp > 0) {
+        return false;   // past the table
+    }
+
+    if ((cmp == 0) && (varOidLen > entryOidLen)) {
+        if (varOid[entryOidLen] >= COLUMN_ACUNITTEMP) {
+            col = varOid[entryOidLen];
+            if (varOidLen > (entryOidLen + 1)) {
+                // Only an exact match of the instance
+                // OID is included.
+                r = acUnitRowSearch(varOid[entryOidLen + 1], (inclusive && (varOidLen == (entryOidLen + 2))));
             }
         }
+        if (r == acUnitTbl.numRows) {
+            col++;
+            r = 0;
+        }
     }
 
-    // Done with the dataFile!
-    fclose(fp);
+    if (col > COLUMN_ACUNITHITEMPALARMSTATE) {
+        return false;
+    }
 
-    return 0;
-}
+    *column = col;
+    *row = r;
 
-static const __syscall_slong_t oneBillion = 1000000000; // 10^9
+    return true;
+}
 
-// Normalize a timespec value
-static __inline__ void tvNorm(struct timespec *t)
+static void getAcUnitValue(int column, size_t row, const int *values, netsnmp_variable_list *varBind)
 {
-    if (t->tv_nsec >= oneBillion) {
-        t->tv_sec += (t->tv_nsec / oneBillion);
-        t->tv_nsec = (t->tv_nsec % oneBillion);
+    long value = 0;
+
+    switch (column) {
+    case COLUMN_ACUNITTEMP:
+        value = values[acUnitTbl.tempBase + row];
+        break;
+    case COLUMN_ACUNITLOTEMPTHRESHOLD:
+        value = getThreshold(&acUnitTbl.loTempThreshold[row]);
+        break;
+    case COLUMN_ACUNITHITEMPTHRESHOLD:
+        value = getThreshold(&acUnitTbl.hiTempThreshold[row]);
+        break;
+    case COLUMN_ACUNITHITEMPALARMSTATE:
+        value = values[acUnitTbl.alarmStateBase + row];
+        break;
     }
+
+    snmp_set_var_typed_integer(varBind, ASN_INTEGER, value);
 }
 
-// Subtract two timespec values: result = x - y
-static void tvSub(struct timespec *result, const struct timespec *x, const struct timespec *y)
+static void setAcUnitCellOid(int column, size_t row, netsnmp_variable_list *varBind)
 {
-    struct timespec X = *x;
-    struct timespec Y = *y;
+    oid cellOid[OID_LENGTH(acUnitEntryOid) + 2];
 
-    tvNorm(&X);
-    tvNorm(&Y);
+    memcpy(cellOid, acUnitEntryOid, sizeof (acUnitEntryOid));
+    cellOid[OID_LENGTH(acUnitEntryOid)] = column;
+    cellOid[OID_LENGTH(acUnitEntryOid) + 1] = acUnitTbl.unitIndex[row];
 
-    if (X.tv_nsec < Y.tv_nsec) {
-        X.tv_sec -= 1;
-        X.tv_nsec += oneBillion;
-    }
-    result->tv_sec = X.tv_sec - Y.tv_sec;
-    result->tv_nsec = X.tv_nsec - Y.tv_nsec;
+    snmp_set_var_objid(varBind, cellOid, OID_LENGTH(cellOid));
 }
 
-// Compare two timespec values
-static int tvCmp(const struct timespec *x, const struct timespec *y)
+// Set the error of a varbind, and count it
+static void setRequestError(netsnmp_agent_request_info *reqinfo, netsnmp_request_info *request, int err)
 {
-    struct timespec X = *x;
-    struct timespec Y = *y;
+    statsInc(STATS_REQUEST_ERRORS);
+    netsnmp_set_request_error(reqinfo, request, err);
+}
 
-    tvNorm(&X);
-    tvNorm(&Y);
+// Handle the SET request modes for the read-write
+// columns of the acUnitTable
+static void setAcUnitValue(netsnmp_agent_request_info *reqinfo, netsnmp_request_info *request)
+{
+    netsnmp_variable_list *varBind = request->requestvb;
+    int column;
+    size_t row;
+    long *threshold;
 
-    if (x->tv_sec > y->tv_sec) {
-        return 1;
-    } else if (x->tv_sec < y->tv_sec) {
-        return -1;
-    } else if (x->tv_nsec > y->tv_nsec) {
-        return 1;
-    } else if (x->tv_nsec < y->tv_nsec) {
-        return -1;
+    if (!acUnitCellFind(varBind->name, varBind->name_length, &column, &row)) {
+        if (reqinfo->mode == MODE_SET_RESERVE1) {
+            setRequestError(reqinfo, request, SNMP_ERR_NOCREATION);
+        }
+        return;
     }
 
-    return 0;
+    if ((column != COLUMN_ACUNITLOTEMPTHRESHOLD) && (column != COLUMN_ACUNITHITEMPTHRESHOLD)) {
+        if (reqinfo->mode == MODE_SET_RESERVE1) {
+            setRequestError(reqinfo, request, SNMP_ERR_NOTWRITABLE);
+        }
+        return;
+    }
+
+    threshold = (column == COLUMN_ACUNITLOTEMPTHRESHOLD) ? &acUnitTbl.loTempThreshold[row] : &acUnitTbl.hiTempThreshold[row];
+
+    switch (reqinfo->mode) {
+    case MODE_SET_RESERVE1:
+        if (varBind->type != ASN_INTEGER) {
+            setRequestError(reqinfo, request, SNMP_ERR_WRONGTYPE);
+        }
+        break;
+
+    case MODE_SET_RESERVE2:
+        // Make sure acUnitLoTempThreshold stays lower
+        // than acUnitHiTempThreshold
+        if (((column == COLUMN_ACUNITLOTEMPTHRESHOLD) && (*varBind->val.integer >= getThreshold(&acUnitTbl.hiTempThreshold[row]))) ||
+            ((column == COLUMN_ACUNITHITEMPTHRESHOLD) && (*varBind->val.integer <= getThreshold(&acUnitTbl.loTempThreshold[row])))) {
+            logMsg(LOG_ERR, "%s: acUnitLoTempThreshold.%lu MUST be lower than acUnitHiTempThreshold.%lu !\n", __func__,
+                   acUnitTbl.unitIndex[row], acUnitTbl.unitIndex[row]);
+            setRequestError(reqinfo, request, SNMP_ERR_INCONSISTENTVALUE);
+        }
+        break;
+
+    case MODE_SET_ACTION:
+        acUnitTbl.undoValue[row] = getThreshold(threshold);
+        __atomic_store_n(threshold, *varBind->val.integer, __ATOMIC_RELAXED);
+        mibThresholdsChanged();
+        break;
+
+    case MODE_SET_UNDO:
+        __atomic_store_n(threshold, acUnitTbl.undoValue[row], __ATOMIC_RELAXED);
+        mibThresholdsChanged();
+        break;
+
+    default:
+        break;
+    }
 }
 
+// The self-monitoring objects, in the subagentStats subtree,
+// are served by the subagent itself (see stats.h).
+static bool isStatsOid(const oid *varOid, size_t varOidLen)
+{
+    return (varOidLen >= OID_LENGTH(subagentStatsOid)) &&
+           (snmp_oid_ncompare(varOid, varOidLen, subagentStatsOid, OID_LENGTH(subagentStatsOid), OID_LENGTH(subagentStatsOid)) == 0);
+}
 
-// This task is used to update the values of the MIB objects; e.g.
-// as when the value is obtained from reading an environmental
-// sensor.
-static void *mibUpdateTask(void *arg)
+static bool isHistoryOid(const oid *varOid, size_t varOidLen)
 {
-    const CmdArgs *cmdArgs = arg;
+    return (varOidLen >= OID_LENGTH(sensorHistoryTableOid)) &&
+           (snmp_oid_ncompare(varOid, varOidLen, sensorHistoryTableOid, OID_LENGTH(sensorHistoryTableOid), OID_LENGTH(sensorHistoryTableOid)) == 0);
+}
 
-    while (true) {
-        const struct timespec pollTime = { .tv_sec = 1, .tv_nsec = 0 };
-        struct timespec startTime, endTime, deltaTime;
-        struct tm brkDwnTime;
-        static char tsBuf[32];  // YYYY-MM-DDTHH:MM:SS
+// All the objects served by the subagent, sorted by OID, so
+// that GET can be resolved with a binary search, and GETNEXT
+// (and hence GETBULK, which the agent splits into GETNEXT's)
+// can walk the array in order.
+static MibObj **mibObjSorted;
 
-        clock_gettime(CLOCK_REALTIME, &startTime);
+static int cmpMibObjOid(const void *a, const void *b)
+{
+    const MibObj *objA = *(const MibObj * const *) a;
+    const MibObj *objB = *(const MibObj * const *) b;
 
-        strftime(tsBuf, sizeof (tsBuf), "%Y-%m-%d %H:%M:%S", gmtime_r(&startTime.tv_sec, &brkDwnTime));    // %H means 24-hour time
+    return snmp_oid_compare(objA->varOid, objA->varOidLen, objB->varOid, objB->varOidLen);
+}
 
-        snmp_log(LOG_INFO, "%s: Updating MIB data from %s at %s ...\n", __func__, cmdArgs->dataFile, tsBuf);
+static int mibObjSortedInit(void)
+{
+    size_t n = 0;
 
-        // Process the data file
-        procDataFile(cmdArgs->dataFile);
+    if ((mibObjSorted = calloc(mibObjCount, sizeof (MibObj *))) == NULL) {
+        logMsg(LOG_ERR, "%s: failed to alloc %zu objects!\n", __func__, mibObjCount);
+        return -1;
+    }
 
-        // Was there a config change?
-        if (snmpdConfigChange) {
-            procConfigFile(cmdArgs->configFile);
+    for (MibObj *mibObj = &mibObjTbl[0]; mibObj->varName != NULL; mibObj++) {
+        // All the objects MUST be in our subtree
+        if ((mibObj->varOidLen <= OID_LENGTH(subagentExampleMIBOid)) ||
+            (snmp_oid_ncompare(mibObj->varOid, mibObj->varOidLen, subagentExampleMIBOid, OID_LENGTH(subagentExampleMIBOid), OID_LENGTH(subagentExampleMIBOid)) != 0)) {
+            logMsg(LOG_ERR, "%s: MIB object \"%s\" is not under the subagent's subtree !\n", __func__, mibObj->varName);
+            return -1;
+        }
+        if ((mibObj->varOidLen >= OID_LENGTH(acUnitEntryOid)) &&
+            (snmp_oid_ncompare(mibObj->varOid, mibObj->varOidLen, acUnitEntryOid, OID_LENGTH(acUnitEntryOid), (OID_LENGTH(acUnitEntryOid) - 1)) == 0)) {
+            logMsg(LOG_ERR, "%s: MIB object \"%s\" is inside the acUnitTable !\n", __func__, mibObj->varName);
+            return -1;
+        }
+        if (isStatsOid(mibObj->varOid, mibObj->varOidLen)) {
+            logMsg(LOG_ERR, "%s: MIB object \"%s\" is inside the subagentStats subtree !\n", __func__, mibObj->varName);
+            return -1;
         }
+        if (isHistoryOid(mibObj->varOid, mibObj->varOidLen)) {
+            logMsg(LOG_ERR, "%s: MIB object \"%s\" is inside the sensorHistoryTable !\n", __func__, mibObj->varName);
+            return -1;
+        }
+        mibObjSorted[n++] = mibObj;
+    }
 
-        clock_gettime(CLOCK_REALTIME, &endTime);
+    // The objects defined by the MIB are already in OID
+    // order; only the ones from the object file need sorting.
+    if (mibObjCount > NUM_BUILTIN_OBJS) {
+        qsort(mibObjSorted, mibObjCount, sizeof (MibObj *), cmpMibObjOid);
+    }
 
-        // Calculate the time we spent processing
-        // all the events in this pass of the work
-        // loop...
-        tvSub(&deltaTime, &endTime, &startTime);
+    for (n = 1; n < mibObjCount; n++) {
+        if (cmpMibObjOid(&mibObjSorted[n - 1], &mibObjSorted[n]) == 0) {
+            logMsg(LOG_ERR, "%s: MIB objects \"%s\" and \"%s\" have the same OID !\n", __func__, mibObjSorted[n - 1]->varName, mibObjSorted[n]->varName);
+            return -1;
+        }
+    }
 
-        // Figure out how long to sleep to achieve
-        // the desired poll period. If deltaTime is
-        // greater or equal to pollTime, there's no
-        // need to sleep.
-        if (tvCmp(&deltaTime, &pollTime) < 0) {
-            // Sleep until the next poll period
-            struct timespec sleepTime;
-            tvSub(&sleepTime, &pollTime, &deltaTime);
-            //snmp_log(LOG_INFO, "%s: sleepTime=%ld.%09ld\n", __func__, sleepTime.tv_sec, sleepTime.tv_nsec);
-            nanosleep(&sleepTime, NULL);
+    return 0;
+}
+
+// Find the index of the first object whose OID is greater
+// than (or equal to, if inclusive is set) the given OID.
+static size_t mibObjSearch(const oid *varOid, size_t varOidLen, bool inclusive)
+{
+    size_t lo = 0, hi = mibObjCount;
+
+    while (lo < hi) {
+        size_t mid = lo + ((hi - lo) / 2);
+        int cmp = snmp_oid_compare(mibObjSorted[mid]->varOid, mibObjSorted[mid]->varOidLen, varOid, varOidLen);
+        if ((cmp < 0) || ((cmp == 0) && !inclusive)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
     }
 
-    return NULL;
+    return lo;
 }
 
-int mibInit(const CmdArgs *cmdArgs)
+// Find the object with the given OID
+static MibObj *mibObjFind(const oid *varOid, size_t varOidLen)
 {
-    pthread_t thread;
+    size_t n = mibObjSearch(varOid, varOidLen, true);
 
-    // Register with the Master Agent each of the Integer32
-    // read-only and read-write objects in our MIB...
-    for (MibObj *mibObj = &mibObjTbl[0]; mibObj->varName != NULL; mibObj++) {
-        int s;
+    if ((n < mibObjCount) && (snmp_oid_compare(mibObjSorted[n]->varOid, mibObjSorted[n]->varOidLen, varOid, varOidLen) == 0)) {
+        return mibObjSorted[n];
+    }
 
-        snmp_log(LOG_INFO, "Registering object: varName=\"%s\" readOnly=%d ...\n", mibObj->varName, mibObj->readOnly);
+    return NULL;
+}
 
-        if (mibObj->readOnly) {
-            s = netsnmp_register_read_only_int_instance(mibObj->varName,
-                                                        mibObj->varOid,
-                                                        mibObj->varOidLen,
-                                                        mibObj->varValue,
-                                                        mibObj->varCbFunc);
-        } else {
-            s = netsnmp_register_long_instance(mibObj->varName,
-                                              mibObj->varOid,
-                                              mibObj->varOidLen,
-                                              (long int *) mibObj->varValue,
-                                              mibObj->varCbFunc);
-        }
+static void getMibObjValue(const MibObj *mibObj, const MibValues *values, netsnmp_variable_list *varBind)
+{
+    struct counter64 counter64;
+    const MibString *str;
+    uint64_t value64;
+    int value;
 
-        if (s != 0) {
-            snmp_log(LOG_ERR, "Failed to register \"%s\" !\n", mibObj->varName);
-            return -1;
-        }
+    // The value of a provider is served from its cache,
+    // which gets refreshed in the background when stale.
+    if ((mibObj->provider != NULL) && providerGet(mibObj->provider, &value)) {
+        snmp_set_var_typed_integer(varBind, ASN_INTEGER, value);
+        return;
     }
 
-    // Start the MIB update task
-    if (pthread_create(&thread, NULL, mibUpdateTask, (void *) cmdArgs)) {
-        snmp_log(LOG_ERR, "Failed to create MIB update task!\n");
-        return -1;
+    if (!mibObj->readOnly) {
+        snmp_set_var_typed_integer(varBind, ASN_INTEGER, getThreshold(mibObj->rwValue));
+        return;
     }
 
-    return 0;
+    switch (mibObj->column) {
+    case MIB_COLUMN_INT32:
+        snmp_set_var_typed_integer(varBind, ASN_INTEGER, values->int32[mibObj->varValue - mibValueTbl]);
+        break;
+    case MIB_COLUMN_UINT32:
+        snmp_set_var_typed_integer(varBind, mibObj->varType, values->uint32[mibObj->valueIndex]);
+        break;
+    case MIB_COLUMN_UINT64:
+        value64 = values->uint64[mibObj->valueIndex];
+        counter64.high = value64 >> 32;
+        counter64.low = value64 & 0xffffffff;
+        snmp_set_var_typed_value(varBind, ASN_COUNTER64, &counter64, sizeof (counter64));
+        break;
+    case MIB_COLUMN_STRING:
+        str = &values->string[mibObj->valueIndex];
+        snmp_set_var_typed_value(varBind, ASN_OCTET_STR, str->text, str->len);
+        break;
+    default:
+        break;
+    }
+}
+
+// The self-monitoring objects. They are generated from the
+// current statistics when a request needs them, and pinned
+// for the rest of the request PDU, like the values snapshot.
+
+#define STATS_COUNTER_ENTRY         1   // statsCounterTable.1
+#define STATS_HIST_BUCKET_ENTRY     2   // statsHistBucketTable.1
+#define STATS_HIST_ENTRY            3   // statsHistTable.1
+#define STATS_LAST_ERROR            4
+#define STATS_LAST_ERROR_TIME       5
+
+// The trap queue keeps its own counters; they are served
+// as extra rows of the statsCounterTable.
+static const char *trapCounterNames[] = { "trapsQueued", "trapsSent", "trapsCoalesced", "trapsDropped" };
+
+#define NUM_TRAP_COUNTERS   (sizeof (trapCounterNames) / sizeof (trapCounterNames[0]))
+#define NUM_COUNTER_ROWS    (NUM_STATS_COUNTERS + NUM_TRAP_COUNTERS)
+
+typedef struct StatsVar {
+    oid varOid[OID_LENGTH(subagentStatsOid) + 4];
+    size_t varOidLen;
+    u_char type;
+    uint64_t value;
+    const char *str;
+} StatsVar;
+
+typedef struct StatsVars {
+    StatsVar *vars;
+    size_t numVars;
+    size_t maxVars;
+    StatsTotals totals;
+    char lastError[256];
+} StatsVars;
+
+static StatsVar *statsVarAdd(StatsVars *sv, u_char type, size_t numSubIds, ...)
+{
+    StatsVar *var = &sv->vars[sv->numVars++];
+    va_list ap;
+
+    memcpy(var->varOid, subagentStatsOid, sizeof (subagentStatsOid));
+    var->varOidLen = OID_LENGTH(subagentStatsOid);
+    va_start(ap, numSubIds);
+    while (numSubIds-- > 0) {
+        var->varOid[var->varOidLen++] = va_arg(ap, unsigned);
+    }
+    va_end(ap);
+    var->type = type;
+    var->value = 0;
+    var->str = NULL;
+
+    return var;
+}
+
+// Generate all the self-monitoring objects, in OID order
+static void statsVarsBuild(StatsVars *sv)
+{
+    StatsTotals *totals = &sv->totals;
+    TrapQueueStats trapStats;
+    unsigned long trapCounters[NUM_TRAP_COUNTERS];
+    time_t lastErrorTime;
+    size_t numVars = (NUM_COUNTER_ROWS * 2) + (NUM_STATS_HISTS * 3) + 2;
+
+    statsRead(totals);
+    trapQueueGetStats(&trapStats);
+    trapCounters[0] = trapStats.queued;
+    trapCounters[1] = trapStats.sent;
+    trapCounters[2] = trapStats.coalesced;
+    trapCounters[3] = trapStats.dropped;
+    statsLastError(sv->lastError, sizeof (sv->lastError), &lastErrorTime);
+
+    for (int h = 0; h < NUM_STATS_HISTS; h++) {
+        for (int b = 0; b < STATS_NUM_BUCKETS; b++) {
+            numVars += (totals->buckets[h][b] != 0) ? 2 : 0;
+        }
+    }
+
+    if (numVars > sv->maxVars) {
+        StatsVar *vars;
+        if ((vars = realloc(sv->vars, numVars * sizeof (StatsVar))) == NULL) {
+            logMsg(LOG_ERR, "%s: failed to alloc %zu stats objects!\n", __func__, numVars);
+            sv->numVars = 0;
+            return;
+        }
+        sv->vars = vars;
+        sv->maxVars = numVars;
+    }
+
+    sv->numVars = 0;
+
+    // statsCounterTable
+    for (unsigned n = 0; n < NUM_COUNTER_ROWS; n++) {
+        statsVarAdd(sv, ASN_OCTET_STR, 4, STATS_COUNTER_ENTRY, 1, COLUMN_STATSCOUNTERNAME, (n + 1))->str =
+            (n < NUM_STATS_COUNTERS) ? statsCounterNames[n] : trapCounterNames[n - NUM_STATS_COUNTERS];
+    }
+    for (unsigned n = 0; n < NUM_COUNTER_ROWS; n++) {
+        statsVarAdd(sv, ASN_COUNTER64, 4, STATS_COUNTER_ENTRY, 1, COLUMN_STATSCOUNTERVALUE, (n + 1))->value =
+            (n < NUM_STATS_COUNTERS) ? totals->counters[n] : trapCounters[n - NUM_STATS_COUNTERS];
+    }
+
+    // statsHistBucketTable, indexed by {histogram, bucket};
+    // only the buckets with a non-zero count are included.
+    for (unsigned column = COLUMN_STATSHISTBUCKETLOW; column <= COLUMN_STATSHISTBUCKETCOUNT; column++) {
+        for (unsigned h = 0; h < NUM_STATS_HISTS; h++) {
+            for (unsigned b = 0; b < STATS_NUM_BUCKETS; b++) {
+                if (totals->buckets[h][b] != 0) {
+                    statsVarAdd(sv, ((column == COLUMN_STATSHISTBUCKETLOW) ? ASN_UNSIGNED : ASN_COUNTER64), 5,
+                                STATS_HIST_BUCKET_ENTRY, 1, column, (h + 1), (b + 1))->value =
+                        (column == COLUMN_STATSHISTBUCKETLOW) ? statsBucketLow(b) : totals->buckets[h][b];
+                }
+            }
+        }
+    }
+
+    // statsHistTable
+    for (unsigned h = 0; h < NUM_STATS_HISTS; h++) {
+        statsVarAdd(sv, ASN_OCTET_STR, 4, STATS_HIST_ENTRY, 1, COLUMN_STATSHISTNAME, (h + 1))->str = statsHistNames[h];
+    }
+    for (unsigned h = 0; h < NUM_STATS_HISTS; h++) {
+        statsVarAdd(sv, ASN_COUNTER64, 4, STATS_HIST_ENTRY, 1, COLUMN_STATSHISTCOUNT, (h + 1))->value = totals->counts[h];
+    }
+    for (unsigned h = 0; h < NUM_STATS_HISTS; h++) {
+        statsVarAdd(sv, ASN_COUNTER64, 4, STATS_HIST_ENTRY, 1, COLUMN_STATSHISTSUM, (h + 1))->value = totals->sums[h];
+    }
+
+    statsVarAdd(sv, ASN_OCTET_STR, 2, STATS_LAST_ERROR, 0)->str = sv->lastError;
+    statsVarAdd(sv, ASN_UNSIGNED, 2, STATS_LAST_ERROR_TIME, 0)->value = lastErrorTime;
+}
+
+static const StatsVars *statsVarsSnapshot(netsnmp_agent_request_info *reqinfo)
+{
+    static StatsVars statsVars;
+    static long statsReqId;
+    static bool statsBuilt;
+    long reqId = ((reqinfo->asp != NULL) && (reqinfo->asp->pdu != NULL)) ? reqinfo->asp->pdu->reqid : 0;
+
+    if (!statsBuilt || (reqId == 0) || (reqId != statsReqId)) {
+        statsVarsBuild(&statsVars);
+        statsReqId = reqId;
+        statsBuilt = true;
+    }
+
+    return &statsVars;
+}
+
+// Find the first stats object whose OID is greater than (or
+// equal to, if inclusive is set) the given OID. Returns NULL
+// if there is none.
+static const StatsVar *statsVarSearch(const StatsVars *sv, const oid *varOid, size_t varOidLen, bool inclusive)
+{
+    size_t lo = 0, hi = sv->numVars;
+
+    while (lo < hi) {
+        size_t mid = lo + ((hi - lo) / 2);
+        int cmp = snmp_oid_compare(sv->vars[mid].varOid, sv->vars[mid].varOidLen, varOid, varOidLen);
+        if ((cmp < 0) || ((cmp == 0) && !inclusive)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return (lo < sv->numVars) ? &sv->vars[lo] : NULL;
+}
+
+static const StatsVar *statsVarFind(const StatsVars *sv, const oid *varOid, size_t varOidLen)
+{
+    const StatsVar *var = statsVarSearch(sv, varOid, varOidLen, true);
+
+    if ((var != NULL) && (snmp_oid_compare(var->varOid, var->varOidLen, varOid, varOidLen) == 0)) {
+        return var;
+    }
+
+    return NULL;
+}
+
+static void getStatsValue(const StatsVar *var, netsnmp_variable_list *varBind)
+{
+    struct counter64 c64;
+
+    switch (var->type) {
+    case ASN_OCTET_STR:
+        snmp_set_var_typed_value(varBind, ASN_OCTET_STR, var->str, strlen(var->str));
+        break;
+    case ASN_COUNTER64:
+        c64.high = var->value >> 32;
+        c64.low = var->value & 0xffffffff;
+        snmp_set_var_typed_value(varBind, ASN_COUNTER64, &c64, sizeof (c64));
+        break;
+    default:
+        snmp_set_var_typed_integer(varBind, var->type, var->value);
+        break;
+    }
+}
+
+// History of the read-only values: the scalars and the
+// acUnitTemp column, sampled every HISTORY_INTERVAL msec by
+// the MIB update task. After each sample the aggregates of
+// the window of each value are published to the AgentX
+// thread through their own ValueStore, and served as the
+// columns of the sensorHistoryTable, whose rows are indexed
+// by the value index + 1.
+#define HISTORY_INTERVAL    1000    // msec
+
+// Aggregates published for each value
+enum { HISTORY_SAMPLES, HISTORY_MIN, HISTORY_MAX, HISTORY_MEAN, NUM_HISTORY_AGGRS };
+
+typedef struct MibHistory {
+    size_t numValues;           // 0 if the history is disabled
+    History history;
+    ValueStore store;           // NUM_HISTORY_AGGRS per value
+    uint64_t nextSample;        // msec
+} MibHistory;
+
+static MibHistory mibHistory;
+
+static uint64_t historyNow(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t) now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+static int mibHistoryInit(unsigned depth)
+{
+    MibHistory *hist = &mibHistory;
+    size_t numValues = mibValueCount + acUnitTbl.numRows;
+
+    if ((depth == 0) || (numValues == 0)) {
+        return 0;
+    }
+
+    if (depth > HISTORY_MAX_DEPTH) {
+        logMsg(LOG_ERR, "%s: the history depth can't be greater than %u !\n", __func__, HISTORY_MAX_DEPTH);
+        return -1;
+    }
+
+    if ((historyInit(&hist->history, numValues, depth) != 0) ||
+        (valueStoreInit(&hist->store, (numValues * NUM_HISTORY_AGGRS), sizeof (int)) != 0)) {
+        logMsg(LOG_ERR, "%s: failed to alloc the history of %zu values!\n", __func__, numValues);
+        return -1;
+    }
+
+    hist->numValues = numValues;
+    hist->nextSample = historyNow();
+
+    logMsg(LOG_INFO, "%s: Keeping %u samples of %zu values in %zu KB\n", __func__, depth, numValues, (hist->history.arenaSize / 1024));
+
+    return 0;
+}
+
+// Take a sample of all the values, if it's due
+static void mibHistoryRun(void)
+{
+    MibHistory *hist = &mibHistory;
+    int *aggrs = valueStoreWork(&hist->store, 0);
+    uint64_t now;
+
+    if ((hist->numValues == 0) || ((now = historyNow()) < hist->nextSample)) {
+        return;
+    }
+
+    for (size_t n = 0; n < hist->numValues; n++) {
+        HistoryAggr aggr;
+
+        historyAdd(&hist->history, n, mibValueTbl[n]);
+        historyAggr(&hist->history, n, &aggr);
+
+        aggrs[(n * NUM_HISTORY_AGGRS) + HISTORY_SAMPLES] = aggr.count;
+        aggrs[(n * NUM_HISTORY_AGGRS) + HISTORY_MIN] = aggr.min;
+        aggrs[(n * NUM_HISTORY_AGGRS) + HISTORY_MAX] = aggr.max;
+        aggrs[(n * NUM_HISTORY_AGGRS) + HISTORY_MEAN] = aggr.mean;
+    }
+
+    // All the aggregates change with each sample
+    valueStoreMarkAll(&hist->store);
+    valueStorePublish(&hist->store);
+
+    // If the samples fell behind, e.g. because a
+    // pass took too long, skip the missed ones.
+    hist->nextSample += HISTORY_INTERVAL;
+    if (hist->nextSample <= now) {
+        hist->nextSample = now + HISTORY_INTERVAL;
+    }
+}
+
+// Get the time, in msec, until the next sample is due,
+// or -1 if the history is disabled.
+static int mibHistoryTimeout(void)
+{
+    uint64_t now = historyNow();
+
+    if (mibHistory.numValues == 0) {
+        return -1;
+    }
+
+    return (mibHistory.nextSample > now) ? (int) (mibHistory.nextSample - now) : 0;
+}
+
+// Same as mibValueSnapshot(), for the history aggregates
+static const int *mibHistorySnapshot(netsnmp_agent_request_info *reqinfo)
+{
+    static const int *snapshot;
+    static long snapshotReqId;
+    long reqId = ((reqinfo->asp != NULL) && (reqinfo->asp->pdu != NULL)) ? reqinfo->asp->pdu->reqid : 0;
+
+    if ((snapshot == NULL) || (reqId == 0) || (reqId != snapshotReqId)) {
+        snapshot = valueStoreSnapshot(&mibHistory.store);
+        snapshotReqId = reqId;
+    }
+
+    return snapshot;
+}
+
+// Find the sensorHistoryTable cell with the given OID
+static bool historyCellFind(const oid *varOid, size_t varOidLen, int *column, size_t *row)
+{
+    const size_t entryOidLen = OID_LENGTH(sensorHistoryEntryOid);
+
+    if ((mibHistory.numValues == 0) || (varOidLen != (entryOidLen + 2)) ||
+        (snmp_oid_ncompare(varOid, varOidLen, sensorHistoryEntryOid, entryOidLen, entryOidLen) != 0) ||
+        (varOid[entryOidLen] < COLUMN_SENSORHISTORYNAME) || (varOid[entryOidLen] > COLUMN_SENSORHISTORYMEAN) ||
+        (varOid[entryOidLen + 1] < 1) || (varOid[entryOidLen + 1] > mibHistory.numValues)) {
+        return false;
+    }
+
+    *column = varOid[entryOidLen];
+    *row = varOid[entryOidLen + 1] - 1;
+
+    return true;
+}
+
+// Find the first sensorHistoryTable cell whose OID is greater
+// than (or equal to, if inclusive is set) the given OID. The
+// table is walked column by column.
+static bool historyCellNext(const oid *varOid, size_t varOidLen, bool inclusive, int *column, size_t *row)
+{
+    const size_t entryOidLen = OID_LENGTH(sensorHistoryEntryOid);
+    int cmp = snmp_oid_ncompare(varOid, varOidLen, sensorHistoryEntryOid, entryOidLen, entryOidLen);
+    oid col = COLUMN_SENSORHISTORYNAME;
+    oid r = 0;
+
+    if ((mibHistory.numValues == 0) || (cmp > 0)) {
+        return false;
+    }
+
+    if ((cmp == 0) && (varOidLen > entryOidLen)) {
+        if (varOid[entryOidLen] >= COLUMN_SENSORHISTORYNAME) {
+            col = varOid[entryOidLen];
+            if (varOidLen > (entryOidLen + 1)) {
+                // The rows are indexed 1..numValues, so the
+                // next row after index i is the row i; only
+                // an exact match of the instance OID is
+                // included.
+                r = varOid[entryOidLen + 1];
+                if (inclusive && (varOidLen == (entryOidLen + 2)) && (r != 0)) {
+                    r--;
+                }
+            }
+        }
+        if (r >= mibHistory.numValues) {
+            col++;
+            r = 0;
+        }
+    }
+
+    if (col > COLUMN_SENSORHISTORYMEAN) {
+        return false;
+    }
+
+    *column = col;
+    *row = r;
+
+    return true;
+}
+
+static void getHistoryValue(int column, size_t row, const int *aggrs, netsnmp_variable_list *varBind)
+{
+    char name[64];
+
+    switch (column) {
+    case COLUMN_SENSORHISTORYNAME:
+        if (row < mibValueCount) {
+            snprintf(name, sizeof (name), "%s", mibValueObj[row]->varName);
+        } else {
+            snprintf(name, sizeof (name), "%s%lu", acUnitTempPrefix, acUnitTbl.unitIndex[row - acUnitTbl.tempBase]);
+        }
+        snmp_set_var_typed_value(varBind, ASN_OCTET_STR, name, strlen(name));
+        break;
+    case COLUMN_SENSORHISTORYSAMPLES:
+        snmp_set_var_typed_integer(varBind, ASN_UNSIGNED, aggrs[(row * NUM_HISTORY_AGGRS) + HISTORY_SAMPLES]);
+        break;
+    case COLUMN_SENSORHISTORYMIN:
+        snmp_set_var_typed_integer(varBind, ASN_INTEGER, aggrs[(row * NUM_HISTORY_AGGRS) + HISTORY_MIN]);
+        break;
+    case COLUMN_SENSORHISTORYMAX:
+        snmp_set_var_typed_integer(varBind, ASN_INTEGER, aggrs[(row * NUM_HISTORY_AGGRS) + HISTORY_MAX]);
+        break;
+    case COLUMN_SENSORHISTORYMEAN:
+        snmp_set_var_typed_integer(varBind, ASN_INTEGER, aggrs[(row * NUM_HISTORY_AGGRS) + HISTORY_MEAN]);
+        break;
+    }
+}
+
+static void setHistoryCellOid(int column, size_t row, netsnmp_variable_list *varBind)
+{
+    oid cellOid[OID_LENGTH(sensorHistoryEntryOid) + 2];
+
+    memcpy(cellOid, sensorHistoryEntryOid, sizeof (sensorHistoryEntryOid));
+    cellOid[OID_LENGTH(sensorHistoryEntryOid)] = column;
+    cellOid[OID_LENGTH(sensorHistoryEntryOid) + 1] = row + 1;
+
+    snmp_set_var_objid(varBind, cellOid, OID_LENGTH(cellOid));
+}
+
+// Handler for the whole subagentExampleMIB subtree. A single
+// registration covers all the objects, so the master agent
+// passes all the varbinds of a request that fall within our
+// subtree in one call.
+static int mibSubtreeHandler(netsnmp_mib_handler *handler,
+                             netsnmp_handler_registration *reginfo,
+                             netsnmp_agent_request_info *reqinfo,
+                             netsnmp_request_info *requests)
+{
+    const MibValues *values = NULL;
+    const StatsVar *statsVar;
+    struct timespec startTime, endTime;
+
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+    switch (reqinfo->mode) {
+    case MODE_GET:
+        statsInc(STATS_GET_REQUESTS);
+        values = mibValueSnapshot(reqinfo);
+        break;
+    case MODE_GETNEXT:
+        statsInc(STATS_GETNEXT_REQUESTS);
+        values = mibValueSnapshot(reqinfo);
+        break;
+    case MODE_SET_RESERVE1:
+        statsInc(STATS_SET_REQUESTS);
+        break;
+    default:
+        break;
+    }
+
+    for (netsnmp_request_info *request = requests; request != NULL; request = request->next) {
+        netsnmp_variable_list *varBind = request->requestvb;
+        MibObj *mibObj;
+        long *varLong;
+        int column;
+        size_t n, row;
+        int err;
+
+        if (request->processed) {
+            continue;
+        }
+
+        // The acUnitTable cells have their own handling
+        if ((reqinfo->mode != MODE_GET) && (reqinfo->mode != MODE_GETNEXT) &&
+            acUnitCellFind(varBind->name, varBind->name_length, &column, &row)) {
+            setAcUnitValue(reqinfo, request);
+            continue;
+        }
+
+        switch (reqinfo->mode) {
+        case MODE_GET:
+            if ((mibObj = mibObjFind(varBind->name, varBind->name_length)) != NULL) {
+                getMibObjValue(mibObj, values, varBind);
+            } else if (acUnitCellFind(varBind->name, varBind->name_length, &column, &row)) {
+                getAcUnitValue(column, row, values->int32, varBind);
+            } else if (isStatsOid(varBind->name, varBind->name_length) &&
+                       ((statsVar = statsVarFind(statsVarsSnapshot(reqinfo), varBind->name, varBind->name_length)) != NULL)) {
+                getStatsValue(statsVar, varBind);
+            } else if (historyCellFind(varBind->name, varBind->name_length, &column, &row)) {
+                getHistoryValue(column, row, mibHistorySnapshot(reqinfo), varBind);
+            } else {
+                setRequestError(reqinfo, request, SNMP_NOSUCHOBJECT);
+            }
+            break;
+
+        case MODE_GETNEXT:
+            // The next object is the first, in OID order, of
+            // the next scalar, and the next object of each of
+            // the acUnitTable, the subagentStats subtree, and
+            // the sensorHistoryTable. The scalars can't be
+            // inside any of these, which come in this order,
+            // so each one is only searched if the previous
+            // ones have nothing left, and the stats objects are
+            // only generated if the OID is not past them.
+            n = mibObjSearch(varBind->name, varBind->name_length, request->inclusive);
+            mibObj = (n < mibObjCount) ? mibObjSorted[n] : NULL;
+            if (acUnitCellNext(varBind->name, varBind->name_length, request->inclusive, &column, &row) &&
+                ((mibObj == NULL) || (snmp_oid_compare(mibObj->varOid, mibObj->varOidLen, acUnitEntryOid, OID_LENGTH(acUnitEntryOid)) > 0))) {
+                setAcUnitCellOid(column, row, varBind);
+                getAcUnitValue(column, row, values->int32, varBind);
+            } else if ((mibObj != NULL) && (snmp_oid_compare(mibObj->varOid, mibObj->varOidLen, subagentStatsOid, OID_LENGTH(subagentStatsOid)) < 0)) {
+                snmp_set_var_objid(varBind, mibObj->varOid, mibObj->varOidLen);
+                getMibObjValue(mibObj, values, varBind);
+            } else if ((snmp_oid_ncompare(varBind->name, varBind->name_length, subagentStatsOid, OID_LENGTH(subagentStatsOid), OID_LENGTH(subagentStatsOid)) <= 0) &&
+                       ((statsVar = statsVarSearch(statsVarsSnapshot(reqinfo), varBind->name, varBind->name_length, request->inclusive)) != NULL)) {
+                snmp_set_var_objid(varBind, statsVar->varOid, statsVar->varOidLen);
+                getStatsValue(statsVar, varBind);
+            } else if (historyCellNext(varBind->name, varBind->name_length, request->inclusive, &column, &row)) {
+                setHistoryCellOid(column, row, varBind);
+                getHistoryValue(column, row, mibHistorySnapshot(reqinfo), varBind);
+            } else if (mibObj != NULL) {
+                snmp_set_var_objid(varBind, mibObj->varOid, mibObj->varOidLen);
+                getMibObjValue(mibObj, values, varBind);
+            } else {
+                netsnmp_set_request_error(reqinfo, request, SNMP_ENDOFMIBVIEW);
+            }
+            break;
+
+        case MODE_SET_RESERVE1:
+            if ((mibObj = mibObjFind(varBind->name, varBind->name_length)) == NULL) {
+                setRequestError(reqinfo, request, ((isStatsOid(varBind->name, varBind->name_length) ||
+                                                    historyCellFind(varBind->name, varBind->name_length, &column, &row)) ?
+                                                   SNMP_ERR_NOTWRITABLE : SNMP_ERR_NOCREATION));
+            } else if (mibObj->readOnly) {
+                setRequestError(reqinfo, request, SNMP_ERR_NOTWRITABLE);
+            } else if (varBind->type != ASN_INTEGER) {
+                setRequestError(reqinfo, request, SNMP_ERR_WRONGTYPE);
+            }
+            break;
+
+        case MODE_SET_RESERVE2:
+            mibObj = mibObjFind(varBind->name, varBind->name_length);
+            if ((mibObj->varCbFunc != NULL) && ((err = mibObj->varCbFunc(*varBind->val.integer)) != SNMP_ERR_NOERROR)) {
+                setRequestError(reqinfo, request, err);
+            }
+            break;
+
+        case MODE_SET_ACTION:
+            mibObj = mibObjFind(varBind->name, varBind->name_length);
+            varLong = mibObj->rwValue;
+            mibObj->undoValue = __atomic_load_n(varLong, __ATOMIC_RELAXED);
+            __atomic_store_n(varLong, *varBind->val.integer, __ATOMIC_RELAXED);
+            mibThresholdsChanged();
+            break;
+
+        case MODE_SET_UNDO:
+            mibObj = mibObjFind(varBind->name, varBind->name_length);
+            varLong = mibObj->rwValue;
+            __atomic_store_n(varLong, mibObj->undoValue, __ATOMIC_RELAXED);
+            mibThresholdsChanged();
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &endTime);
+    statsRecord(STATS_REQUEST_TIME, statsUsec(&startTime, &endTime));
+
+    return SNMP_ERR_NOERROR;
+}
+
+// Name to object index, so that the lookup of the object
+// named in each line of the data file doesn't require a
+// linear scan of mibObjTbl[]. The objects defined by the MIB,
+// which are the first NUM_BUILTIN_OBJS entries of mibObjTbl[],
+// are found by the perfect hash generated by mibgen; the ones
+// loaded from the object file by a NameIndex, built once by
+// mibInit().
+static NameIndex mibObjIndex;
+
+// 64-bit FNV-1a hash of the value text. The value 0 is
+// reserved to mean "unknown".
+static uint64_t hashText(const char *text, size_t len)
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    for (size_t n = 0; n < len; n++) {
+        hash ^= (unsigned char) text[n];
+        hash *= 1099511628211ull;
+    }
+
+    return (hash != 0) ? hash : 1;
+}
+
+static int mibObjIndexInit(void)
+{
+    size_t numObjs = 0;
+
+    for (MibObj *mibObj = &mibObjTbl[NUM_BUILTIN_OBJS]; mibObj->varName != NULL; mibObj++) {
+        numObjs++;
+    }
+
+    if (numObjs == 0) {
+        return 0;   // nothing to index
+    }
+
+    if (nameIndexInit(&mibObjIndex, numObjs) != 0) {
+        logMsg(LOG_ERR, "%s: failed to alloc the index of %zu objects!\n", __func__, numObjs);
+        return -1;
+    }
+
+    for (MibObj *mibObj = &mibObjTbl[NUM_BUILTIN_OBJS]; mibObj->varName != NULL; mibObj++) {
+        if ((builtinObjIndex(mibObj->varName, strlen(mibObj->varName)) != -1) ||
+            (nameIndexAdd(&mibObjIndex, mibObj->varName, mibObj) != 0)) {
+            logMsg(LOG_ERR, "%s: duplicate MIB object \"%s\" !\n", __func__, mibObj->varName);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// Find the MIB object with the given name. The name need
+// not be null-terminated, so that it can be looked up in
+// place in the data file buffer.
+static MibObj *mibObjLookup(const char *varName, size_t len)
+{
+    int index;
+
+    if ((index = builtinObjIndex(varName, len)) != -1) {
+        return &mibObjTbl[index];
+    }
+
+    return nameIndexFind(&mibObjIndex, varName, len);
+}
+
+// The traps are queued by the MIB update task and sent by
+// the AgentX thread every TRAP_DRAIN_PERIOD msec. In the
+// event loop mode they are sent right after each pass of
+// the MIB update work, and the ones held back by the rate
+// limit TRAP_DRAIN_PERIOD msec later. Alarm state
+// transitions of the same A/C unit that happen within
+// TRAP_COALESCE_WINDOW msec are coalesced.
+#define TRAP_DRAIN_PERIOD       100     // msec
+#define TRAP_COALESCE_WINDOW    1000    // msec
+
+static int sendHiTempAlarmTrap(int acUnit, int alarmState)
+{
+    netsnmp_variable_list *varList = NULL;
+    const oid snmpTrapOid[] = { 1, 3, 6, 1, 6, 3, 1, 1, 4, 1, 0 };
+
+    // Add varbind: snmpTrapOID = acHiTempAlarmNotificationOid
+    snmp_varlist_add_variable(&varList,
+            snmpTrapOid, OID_LENGTH(snmpTrapOid),
+            ASN_OBJECT_ID,
+            acHiTempAlarmNotificationOid, OID_LENGTH(acHiTempAlarmNotificationOid) * sizeof (oid));
+
+    // Add varbind: acHiTempAlarmUnit = acUnit
+    snmp_varlist_add_variable(&varList,
+            acHiTempAlarmUnitOid, OID_LENGTH(acHiTempAlarmUnitOid),
+            ASN_INTEGER,
+            &acUnit, sizeof (acUnit));
+
+    // Add varbind: acHiTempAlarmState = alarmState
+    snmp_varlist_add_variable(&varList,
+            acHiTempAlarmStateOid, OID_LENGTH(acHiTempAlarmStateOid),
+            ASN_INTEGER,
+            &alarmState, sizeof (alarmState));
+
+    logMsgLimited(LOG_INFO, LOG_ALARMS_PER_SEC, "%s: Sending trap for A/C unit %d alarmState=%d\n", __func__, acUnit, alarmState);
+
+    send_v2trap(varList);
+
+    snmp_free_varbind(varList );
+
+    return 0;
+}
+
+static bool mibEventLoop;           // event loop mode
+static unsigned trapDrainAlarm;     // pending one-shot drain alarm
+static netsnmp_session *agentxSession;  // NULL when not connected
+
+static void trapQueueDrainCb(unsigned int clientreg, void *clientarg);
+
+// Runs in the AgentX thread to send the traps queued by
+// the MIB update task.
+static void drainTraps(void)
+{
+    TrapQueueStats stats;
+    static unsigned long lastDropped = 0;
+    size_t pending;
+
+    // While the AgentX session is down the traps stay
+    // queued, and are sent once it's reopened
+    if (agentxSession == NULL) {
+        return;
+    }
+
+    pending = trapQueueDrain(sendHiTempAlarmTrap);
+
+    trapQueueGetStats(&stats);
+    if (stats.dropped != lastDropped) {
+        logMsg(LOG_WARNING, "%s: dropped %lu traps: queued=%lu sent=%lu coalesced=%lu\n", __func__,
+               (stats.dropped - lastDropped), stats.queued, stats.sent, stats.coalesced);
+        lastDropped = stats.dropped;
+    }
+
+    // In the event loop mode, the traps held back by the
+    // rate limit are sent by a one-shot alarm, so an idle
+    // subagent doesn't wake up every TRAP_DRAIN_PERIOD.
+    if (mibEventLoop && (pending != 0) && (trapDrainAlarm == 0)) {
+        struct timeval drainPeriod = { 0, (TRAP_DRAIN_PERIOD * 1000) };
+        trapDrainAlarm = snmp_alarm_register_hr(drainPeriod, 0, trapQueueDrainCb, NULL);
+    }
+}
+
+// The AgentX session with snmpd is checked, and reopened if
+// snmpd dropped it, by the subagent itself rather than by the
+// ping alarm of net-snmp, so the check can be run right away
+// after snmpd is reloaded or restarted. The session is
+// tracked through the INDEX_START/STOP callbacks, which
+// net-snmp calls when it opens and closes the session; it
+// closes it as soon as it reads EOF on the AgentX socket, so
+// the loss of snmpd is seen right away, and the session is
+// reopened with a backoff that starts at AGENTX_BACKOFF_MIN
+// msec. The single subtree registration is replayed by
+// net-snmp when the session is reopened.
+//
+// This needs agentx_check_session() and agentx_reopen_session(),
+// which libnetsnmpagent exports but its headers don't declare;
+// the Makefile only defines HAVE_AGENTX_REOPEN if they can be
+// linked. Otherwise the session is left to the ping alarm of
+// net-snmp, which pings snmpd, and reopens the session, every
+// AGENTX_CHECK_PERIOD sec.
+#define AGENTX_CHECK_PERIOD     5       // sec
+#define AGENTX_BACKOFF_MIN      10      // msec
+#define AGENTX_BACKOFF_MAX      2000    // msec
+
+#ifdef HAVE_AGENTX_REOPEN
+extern void agentx_check_session(unsigned int clientreg, void *clientarg);
+extern int agentx_reopen_session(unsigned int clientreg, void *clientarg);
+#endif
+
+static atomic_bool agentxRecheck;           // set by the MIB update task
+static struct timespec agentxLostTime;
+
+#ifdef HAVE_AGENTX_REOPEN
+static unsigned agentxReopenAlarm;          // pending one-shot reopen alarm
+static unsigned agentxBackoff = AGENTX_BACKOFF_MIN;
+
+static void agentxReopenSchedule(void);
+
+static void agentxReopenCb(unsigned int clientreg, void *clientarg)
+{
+    agentxReopenAlarm = 0;      // one-shot alarm fired
+
+    if (agentxSession == NULL) {
+        agentx_reopen_session(0, NULL);
+    }
+
+    if (agentxSession == NULL) {
+        agentxReopenSchedule();
+    } else {
+        drainTraps();           // send the traps queued meanwhile
+    }
+}
+
+static void agentxReopenSchedule(void)
+{
+    struct timeval delay = { (agentxBackoff / 1000), ((agentxBackoff % 1000) * 1000) };
+
+    if (agentxReopenAlarm != 0) {
+        return;
+    }
+
+    if ((agentxReopenAlarm = snmp_alarm_register_hr(delay, 0, agentxReopenCb, NULL)) == 0) {
+        logMsg(LOG_ERR, "%s: failed to register the AgentX reopen alarm!\n", __func__);
+        return;
+    }
+
+    agentxBackoff *= 2;
+    if (agentxBackoff > AGENTX_BACKOFF_MAX) {
+        agentxBackoff = AGENTX_BACKOFF_MAX;
+    }
+}
+#endif
+
+static int agentxIndexStartCb(int majorID, int minorID, void *serverarg, void *clientarg)
+{
+    struct timespec now;
+
+    agentxSession = serverarg;
+
+#ifdef HAVE_AGENTX_REOPEN
+    agentxBackoff = AGENTX_BACKOFF_MIN;
+    if (agentxReopenAlarm != 0) {
+        snmp_alarm_unregister(agentxReopenAlarm);
+        agentxReopenAlarm = 0;
+    }
+#endif
+
+    if (agentxLostTime.tv_sec != 0) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        logMsg(LOG_INFO, "%s: AgentX session reopened after %lu msec\n", __func__,
+               (unsigned long) (statsUsec(&agentxLostTime, &now) / 1000));
+        agentxLostTime.tv_sec = 0;
+    } else {
+        logMsg(LOG_INFO, "%s: AgentX session opened\n", __func__);
+    }
+
+    return 0;
+}
+
+static int agentxIndexStopCb(int majorID, int minorID, void *serverarg, void *clientarg)
+{
+    agentxSession = NULL;
+    clock_gettime(CLOCK_MONOTONIC, &agentxLostTime);
+    logMsg(LOG_WARNING, "%s: AgentX session closed\n", __func__);
+
+#ifdef HAVE_AGENTX_REOPEN
+    // Reopen it once this callback returns, and
+    // net-snmp is done closing it
+    agentxReopenSchedule();
+#endif
+
+    return 0;
+}
+
+// Runs in the AgentX thread: ping snmpd, which closes and
+// reopens the session if snmpd doesn't answer, or start
+// reopening the session if it's closed.
+static void agentxSessionCheck(void)
+{
+#ifdef HAVE_AGENTX_REOPEN
+    if (agentxSession != NULL) {
+        agentx_check_session(0, agentxSession);
+    } else if (agentxReopenAlarm == 0) {
+        agentxReopenCb(0, NULL);
+    }
+#endif
+}
+
+#ifdef HAVE_AGENTX_REOPEN
+static void agentxCheckCb(unsigned int clientreg, void *clientarg)
+{
+    agentxSessionCheck();
+}
+#endif
+
+// Called after snmpd is reloaded or restarted. In the event
+// loop mode this runs in the AgentX thread, so the session is
+// checked right away; otherwise the check is run by the next
+// trap queue alarm.
+static void agentxSessionRecheck(void)
+{
+    if (mibEventLoop) {
+        agentxSessionCheck();
+    } else {
+        atomic_store_explicit(&agentxRecheck, true, memory_order_release);
+    }
+}
+
+static int agentxInit(void)
+{
+    if ((snmp_register_callback(SNMP_CALLBACK_APPLICATION, SNMPD_CALLBACK_INDEX_START, agentxIndexStartCb, NULL) != SNMPERR_SUCCESS) ||
+        (snmp_register_callback(SNMP_CALLBACK_APPLICATION, SNMPD_CALLBACK_INDEX_STOP, agentxIndexStopCb, NULL) != SNMPERR_SUCCESS)) {
+        logMsg(LOG_ERR, "%s: failed to register the AgentX session callbacks!\n", __func__);
+        return -1;
+    }
+
+#ifdef HAVE_AGENTX_REOPEN
+    // Turn off the ping and reopen alarms of net-snmp
+    // before init_snmp() opens the session
+    if (netsnmp_ds_set_int(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_AGENTX_PING_INTERVAL, 0) != SNMPERR_SUCCESS) {
+        logMsg(LOG_WARNING, "%s: can't set AGENTX_PING_INTERVAL!\n", __func__);
+    }
+
+    if (snmp_alarm_register(AGENTX_CHECK_PERIOD, SA_REPEAT, agentxCheckCb, NULL) == 0) {
+        logMsg(LOG_ERR, "%s: failed to register the AgentX check alarm!\n", __func__);
+        return -1;
+    }
+#else
+    if (netsnmp_ds_set_int(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_AGENTX_PING_INTERVAL, AGENTX_CHECK_PERIOD) != SNMPERR_SUCCESS) {
+        logMsg(LOG_WARNING, "%s: can't set AGENTX_PING_INTERVAL!\n", __func__);
+    }
+#endif
+
+    return 0;
+}
+
+static void trapQueueDrainCb(unsigned int clientreg, void *clientarg)
+{
+    if (mibEventLoop) {
+        trapDrainAlarm = 0;     // one-shot alarm fired
+    }
+
+    if (atomic_load_explicit(&agentxRecheck, memory_order_relaxed) &&
+        atomic_exchange_explicit(&agentxRecheck, false, memory_order_acquire)) {
+        agentxSessionCheck();
+    }
+
+    drainTraps();
+}
+
+static int trapsInit(const CmdArgs *cmdArgs)
+{
+    size_t numUnits = acUnitTbl.numRows;
+    struct timeval drainPeriod = { 0, (TRAP_DRAIN_PERIOD * 1000) };
+
+    for (const MibObj *mibObj = &mibObjTbl[0]; mibObj->varName != NULL; mibObj++) {
+        if (mibObj->acUnit != 0) {
+            numUnits++;
+        }
+    }
+
+    // Each A/C unit has at most one pending trap,
+    // so the queue can never overflow...
+    if (trapQueueInit((numUnits + 1), numUnits, cmdArgs->trapRate, cmdArgs->trapBurst, TRAP_COALESCE_WINDOW) != 0) {
+        logMsg(LOG_ERR, "%s: failed to alloc the trap queue!\n", __func__);
+        return -1;
+    }
+
+    if (!cmdArgs->eventLoop &&
+        (snmp_alarm_register_hr(drainPeriod, SA_REPEAT, trapQueueDrainCb, NULL) == 0)) {
+        logMsg(LOG_ERR, "%s: failed to register the trap queue alarm!\n", __func__);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int addMibObj(const MibObj *mibObj)
+{
+    // Make room for the new entry and the NULL
+    // terminator entry...
+    if ((mibObjCount + 2) > mibObjTblSize) {
+        size_t tblSize = (mibObjTblSize != 0) ? (2 * mibObjTblSize) : 64;
+        MibObj *tbl;
+
+        if ((tbl = realloc(mibObjTbl, tblSize * sizeof (MibObj))) == NULL) {
+            logMsg(LOG_ERR, "%s: failed to alloc %zu objects!\n", __func__, tblSize);
+            return -1;
+        }
+        mibObjTbl = tbl;
+        mibObjTblSize = tblSize;
+    }
+
+    mibObjTbl[mibObjCount++] = *mibObj;
+    memset(&mibObjTbl[mibObjCount], 0, sizeof (MibObj));
+
+    return 0;
+}
+
+// Parse a numeric OID string, such as "1.3.6.1.3.9999.100.0"
+static oid *parseOid(const char *str, size_t *oidLen)
+{
+    oid oidBuf[MAX_OID_LEN];
+    size_t len = 0;
+    oid *varOid;
+
+    while (*str != '\0') {
+        char *end;
+
+        if ((len == MAX_OID_LEN) || (*str < '0') || (*str > '9')) {
+            return NULL;
+        }
+        oidBuf[len++] = strtoul(str, &end, 10);
+        if (*end == '.') {
+            end++;
+        } else if (*end != '\0') {
+            return NULL;
+        }
+        str = end;
+    }
+
+    if ((len < 2) || ((varOid = malloc(len * sizeof (oid))) == NULL)) {
+        return NULL;
+    }
+    memcpy(varOid, oidBuf, len * sizeof (oid));
+    *oidLen = len;
+
+    return varOid;
+}
+
+// Rows of the acUnitTable defined in the object file, in
+// the order they were found. They are sorted and copied to
+// the acUnitTbl by acUnitTblInit().
+typedef struct AcUnitDef {
+    oid unitIndex;
+    long loTempThreshold;
+    long hiTempThreshold;
+} AcUnitDef;
+
+static AcUnitDef *acUnitDefs;
+static size_t numAcUnitDefs;
+
+// Parse the definition of a range of rows of the acUnitTable:
+//
+//   acUnit,<first>[-<last>][,<loThreshold>,<hiThreshold>]
+static int setAcUnitDef(char *fields[], int numFields, int lineNum)
+{
+    AcUnitDef acUnitDef = { 0, getThreshold(&loTempThreshold), getThreshold(&hiTempThreshold) };
+    unsigned long first, last;
+    char *end;
+
+    if ((numFields != 2) && (numFields != 4)) {
+        logMsg(LOG_ERR, "%s: line %d: expected 2 or 4 fields !\n", __func__, lineNum);
+        return -1;
+    }
+
+    first = last = strtoul(fields[1], &end, 10);
+    if (*end == '-') {
+        last = strtoul((end + 1), &end, 10);
+    }
+    if ((*end != '\0') || (first == 0) || (last < first) || (last > INT32_MAX)) {
+        logMsg(LOG_ERR, "%s: line %d: invalid A/C unit range \"%s\" !\n", __func__, lineNum, fields[1]);
+        return -1;
+    }
+
+    if (numFields == 4) {
+        acUnitDef.loTempThreshold = strtol(fields[2], NULL, 10);
+        acUnitDef.hiTempThreshold = strtol(fields[3], NULL, 10);
+        if (acUnitDef.loTempThreshold >= acUnitDef.hiTempThreshold) {
+            logMsg(LOG_ERR, "%s: line %d: loThreshold=%ld MUST be lower than hiThreshold=%ld !\n", __func__, lineNum, acUnitDef.loTempThreshold, acUnitDef.hiTempThreshold);
+            return -1;
+        }
+    }
+
+    for (unsigned long unit = first; unit <= last; unit++) {
+        AcUnitDef *defs;
+
+        // Grow the array by powers of 2
+        if ((numAcUnitDefs & (numAcUnitDefs - 1)) == 0) {
+            if ((defs = realloc(acUnitDefs, ((numAcUnitDefs != 0) ? (2 * numAcUnitDefs) : 64) * sizeof (AcUnitDef))) == NULL) {
+                logMsg(LOG_ERR, "%s: failed to alloc %zu A/C units!\n", __func__, numAcUnitDefs);
+                return -1;
+            }
+            acUnitDefs = defs;
+        }
+
+        acUnitDef.unitIndex = unit;
+        acUnitDefs[numAcUnitDefs++] = acUnitDef;
+    }
+
+    return 0;
+}
+
+// Poll intervals defined in the object file, in the order
+// they were found. They are applied by schedInit().
+typedef struct PollIntervalDef {
+    char *pattern;      // object name, or name prefix ending with '*'
+    unsigned msec;
+} PollIntervalDef;
+
+static PollIntervalDef *pollIntervalDefs;
+static size_t numPollIntervalDefs;
+
+// Parse the definition of the poll interval of an object, or
+// of a group of objects:
+//
+//   pollInterval,<name>[*],<msec>
+static int setPollIntervalDef(char *fields[], int numFields, int lineNum)
+{
+    PollIntervalDef *defs;
+    char *end;
+    unsigned long msec;
+
+    if (numFields != 3) {
+        logMsg(LOG_ERR, "%s: line %d: expected 3 fields !\n", __func__, lineNum);
+        return -1;
+    }
+
+    msec = strtoul(fields[2], &end, 10);
+    if ((*end != '\0') || (msec > (24 * 3600 * 1000))) {
+        logMsg(LOG_ERR, "%s: line %d: invalid poll interval \"%s\" !\n", __func__, lineNum, fields[2]);
+        return -1;
+    }
+
+    if ((defs = realloc(pollIntervalDefs, ((numPollIntervalDefs + 1) * sizeof (PollIntervalDef)))) == NULL) {
+        return -1;
+    }
+    pollIntervalDefs = defs;
+
+    if ((defs[numPollIntervalDefs].pattern = strdup(fields[1])) == NULL) {
+        return -1;
+    }
+    defs[numPollIntervalDefs++].msec = msec;
+
+    return 0;
+}
+
+// Alarm and provider bindings defined in the object file, in
+// the order they were found. They name objects that may not
+// be defined yet, so they are kept until the whole file is
+// parsed, and then resolved through the name index by
+// objectDefsBind().
+typedef struct AlarmDef {
+    char *varName;
+    int lineNum;
+    int acUnit;
+    bool ownThresholds;
+    long loThreshold;
+    long hiThreshold;
+} AlarmDef;
+
+static AlarmDef *alarmDefs;
+static size_t numAlarmDefs;
+
+typedef struct ProviderDef {
+    char *varName;
+    int lineNum;
+    ProviderReadFunc *readFunc;
+    char *arg;
+    unsigned long ttlMsec;
+    unsigned long timeoutMsec;
+} ProviderDef;
+
+static ProviderDef *providerDefs;
+static size_t numProviderDefs;
+
+// Make room for one more definition in an array grown by
+// powers of 2
+static int growDefs(void **defs, size_t numDefs, size_t defSize)
+{
+    void *newDefs;
+
+    if ((numDefs & (numDefs - 1)) == 0) {
+        if ((newDefs = realloc(*defs, ((numDefs != 0) ? (2 * numDefs) : 64) * defSize)) == NULL) {
+            return -1;
+        }
+        *defs = newDefs;
+    }
+
+    return 0;
+}
+
+// Bind the High Temperature alarm of an object to the A/C
+// unit reported in its traps:
+//
+//   alarm,<name>,<acUnit>[,<loThreshold>,<hiThreshold>]
+//
+// Without thresholds, the alarm uses the ones given in the
+// definition of the object, if any, or else the global ones.
+static int setAlarmDef(char *fields[], int numFields, int lineNum)
+{
+    AlarmDef alarmDef = { .lineNum = lineNum };
+    unsigned long acUnit;
+    char *end;
+
+    if ((numFields != 3) && (numFields != 5)) {
+        logMsg(LOG_ERR, "%s: line %d: expected 3 or 5 fields !\n", __func__, lineNum);
+        return -1;
+    }
+
+    acUnit = strtoul(fields[2], &end, 10);
+    if ((*end != '\0') || (acUnit == 0) || (acUnit > INT32_MAX)) {
+        logMsg(LOG_ERR, "%s: line %d: invalid A/C unit \"%s\" !\n", __func__, lineNum, fields[2]);
+        return -1;
+    }
+    alarmDef.acUnit = acUnit;
+
+    if (numFields == 5) {
+        long loThreshold = strtol(fields[3], NULL, 10);
+        long hiThreshold = strtol(fields[4], NULL, 10);
+        if (loThreshold >= hiThreshold) {
+            logMsg(LOG_ERR, "%s: line %d: loThreshold=%ld MUST be lower than hiThreshold=%ld !\n", __func__, lineNum, loThreshold, hiThreshold);
+            return -1;
+        }
+        alarmDef.ownThresholds = true;
+        alarmDef.loThreshold = loThreshold;
+        alarmDef.hiThreshold = hiThreshold;
+    }
+
+    if ((growDefs((void **) &alarmDefs, numAlarmDefs, sizeof (AlarmDef)) != 0) ||
+        ((alarmDef.varName = strdup(fields[1])) == NULL)) {
+        logMsg(LOG_ERR, "%s: line %d: failed to alloc alarm!\n", __func__, lineNum);
+        return -1;
+    }
+    alarmDefs[numAlarmDefs++] = alarmDef;
+
+    return 0;
+}
+
+// Parse the binding of a read-only object to a lazy value
+// provider:
+//
+//   provider,<name>,<ttl>[:<timeout>],command,<command>
+//   provider,<name>,<ttl>,file,<path>
+//
+// The command, or path, is the rest of the line, so it may
+// contain commas. The <ttl> is in msec, and so is the
+// <timeout> of the command, which defaults to
+// PROVIDER_TIMEOUT.
+#define PROVIDER_TIMEOUT    1000    // msec
+
+static int setProviderDef(char *strBuf, int lineNum)
+{
+    ProviderDef providerDef = { .lineNum = lineNum, .timeoutMsec = PROVIDER_TIMEOUT };
+    char *savePtr = NULL;
+    char *name, *ttl, *type, *arg, *end;
+
+    strtok_r(strBuf, ",", &savePtr);    // "provider"
+    name = strtok_r(NULL, ",", &savePtr);
+    ttl = strtok_r(NULL, ",", &savePtr);
+    type = strtok_r(NULL, ",", &savePtr);
+    arg = strtok_r(NULL, "\r\n", &savePtr);
+
+    if (arg == NULL) {
+        logMsg(LOG_ERR, "%s: line %d: expected 5 fields !\n", __func__, lineNum);
+        return -1;
+    }
+
+    providerDef.ttlMsec = strtoul(ttl, &end, 10);
+    if (*end == ':') {
+        providerDef.timeoutMsec = strtoul((end + 1), &end, 10);
+    }
+    if ((*end != '\0') || (providerDef.timeoutMsec == 0)) {
+        logMsg(LOG_ERR, "%s: line %d: invalid TTL \"%s\" !\n", __func__, lineNum, ttl);
+        return -1;
+    }
+
+    if (strcmp(type, "command") == 0) {
+        providerDef.readFunc = providerReadCommand;
+    } else if (strcmp(type, "file") == 0) {
+        providerDef.readFunc = providerReadFile;
+    } else {
+        logMsg(LOG_ERR, "%s: line %d: unsupported provider type \"%s\" !\n", __func__, lineNum, type);
+        return -1;
+    }
+
+    if ((growDefs((void **) &providerDefs, numProviderDefs, sizeof (ProviderDef)) != 0) ||
+        ((providerDef.varName = strdup(name)) == NULL) || ((providerDef.arg = strdup(arg)) == NULL)) {
+        logMsg(LOG_ERR, "%s: line %d: failed to alloc provider!\n", __func__, lineNum);
+        return -1;
+    }
+    providerDefs[numProviderDefs++] = providerDef;
+
+    return 0;
+}
+
+// Bind the alarms and the providers of the object file to
+// their objects, looked up in the name index
+static int objectDefsBind(void)
+{
+    int ret = 0;
+
+    for (size_t n = 0; (n < numAlarmDefs) && (ret == 0); n++) {
+        const AlarmDef *def = &alarmDefs[n];
+        MibObj *mibObj = mibObjLookup(def->varName, strlen(def->varName));
+
+        if ((mibObj == NULL) || !mibObj->readOnly || (mibObj->column != MIB_COLUMN_INT32)) {
+            logMsg(LOG_ERR, "%s: line %d: unknown read-only Integer32 object \"%s\" !\n", __func__, def->lineNum, def->varName);
+            ret = -1;
+            break;
+        }
+
+        if (def->ownThresholds) {
+            mibObj->ownThresholds = true;
+            mibObj->loThreshold = def->loThreshold;
+            mibObj->hiThreshold = def->hiThreshold;
+        }
+        mibObj->hasAlarm = true;
+        mibObj->acUnit = def->acUnit;
+    }
+
+    for (size_t n = 0; (n < numProviderDefs) && (ret == 0); n++) {
+        ProviderDef *def = &providerDefs[n];
+        MibObj *mibObj = mibObjLookup(def->varName, strlen(def->varName));
+
+        if ((mibObj == NULL) || !mibObj->readOnly) {
+            logMsg(LOG_ERR, "%s: line %d: unknown read-only object \"%s\" !\n", __func__, def->lineNum, def->varName);
+            ret = -1;
+            break;
+        }
+
+        // The providers read integer values
+        if (mibObj->column != MIB_COLUMN_INT32) {
+            logMsg(LOG_ERR, "%s: line %d: object \"%s\" is not an Integer32 !\n", __func__, def->lineNum, def->varName);
+            ret = -1;
+            break;
+        }
+
+        // The provider owns its argument from now on
+        if ((mibObj->provider = providerCreate(def->readFunc, def->arg, def->ttlMsec, def->timeoutMsec)) == NULL) {
+            logMsg(LOG_ERR, "%s: line %d: failed to alloc provider!\n", __func__, def->lineNum);
+            ret = -1;
+            break;
+        }
+        def->arg = NULL;
+    }
+
+    // Done with the definitions!
+    for (size_t n = 0; n < numAlarmDefs; n++) {
+        free(alarmDefs[n].varName);
+    }
+    for (size_t n = 0; n < numProviderDefs; n++) {
+        free(providerDefs[n].varName);
+        free(providerDefs[n].arg);
+    }
+    free(alarmDefs);
+    free(providerDefs);
+    alarmDefs = NULL;
+    providerDefs = NULL;
+    numAlarmDefs = numProviderDefs = 0;
+
+    return ret;
+}
+
+static int cmpAcUnitDef(const void *a, const void *b)
+{
+    const AcUnitDef *defA = a;
+    const AcUnitDef *defB = b;
+
+    return (defA->unitIndex > defB->unitIndex) - (defA->unitIndex < defB->unitIndex);
+}
+
+// Build the columnar acUnitTable store from the rows defined in
+// the object file. The values of the acUnitTemp and alarm state
+// columns are allocated in the mibValueStore, starting at the
+// specified value index.
+static int acUnitTblInit(size_t valueBase)
+{
+    size_t numRows = numAcUnitDefs;
+
+    qsort(acUnitDefs, numRows, sizeof (AcUnitDef), cmpAcUnitDef);
+
+    acUnitTbl.numRows = numRows;
+    acUnitTbl.unitIndex = calloc((numRows + 1), sizeof (oid));
+    acUnitTbl.loTempThreshold = calloc((numRows + 1), sizeof (long));
+    acUnitTbl.hiTempThreshold = calloc((numRows + 1), sizeof (long));
+    acUnitTbl.undoValue = calloc((numRows + 1), sizeof (long));
+    if ((acUnitTbl.unitIndex == NULL) || (acUnitTbl.loTempThreshold == NULL) || (acUnitTbl.hiTempThreshold == NULL) ||
+        (acUnitTbl.undoValue == NULL)) {
+        logMsg(LOG_ERR, "%s: failed to alloc %zu A/C units!\n", __func__, numRows);
+        return -1;
+    }
+
+    for (size_t row = 0; row < numRows; row++) {
+        if ((row != 0) && (acUnitDefs[row].unitIndex == acUnitDefs[row - 1].unitIndex)) {
+            logMsg(LOG_ERR, "%s: duplicate A/C unit %lu !\n", __func__, acUnitDefs[row].unitIndex);
+            return -1;
+        }
+        acUnitTbl.unitIndex[row] = acUnitDefs[row].unitIndex;
+        acUnitTbl.loTempThreshold[row] = acUnitDefs[row].loTempThreshold;
+        acUnitTbl.hiTempThreshold[row] = acUnitDefs[row].hiTempThreshold;
+    }
+
+    acUnitTbl.tempBase = valueBase;
+    acUnitTbl.alarmStateBase = valueBase + numRows;
+
+    // Done with the definitions!
+    free(acUnitDefs);
+    acUnitDefs = NULL;
+    numAcUnitDefs = 0;
+
+    return 0;
+}
+
+// Parse one line of the object file:
+//
+//   <name>,<oid>,<type>,<access>[,<loThreshold>,<hiThreshold>]
+//
+// or, to define rows of the acUnitTable:
+//
+//   acUnit,<first>[-<last>][,<loThreshold>,<hiThreshold>]
+//
+// or, to set the poll interval of objects:
+//
+//   pollInterval,<name>[*],<msec>
+//
+// or, to bind the alarm of an object to an A/C unit:
+//
+//   alarm,<name>,<acUnit>[,<loThreshold>,<hiThreshold>]
+//
+// or, to bind an object to a lazy value provider:
+//
+//   provider,<name>,<ttl>,<type>,<arg>
+static int setObjectDef(char *strBuf, int lineNum)
+{
+    char *fields[6] = { NULL };
+    int numFields = 0;
+    char *savePtr = NULL;
+    MibObj mibObj = { 0 };
+    const MibType *mibType = NULL;
+
+    if (strncmp(strBuf, "provider,", 9) == 0) {
+        return setProviderDef(strBuf, lineNum);
+    }
+
+    for (char *tok = strtok_r(strBuf, ",\r\n", &savePtr); tok != NULL; tok = strtok_r(NULL, ",\r\n", &savePtr)) {
+        if (numFields == 6) {
+            numFields++;
+            break;
+        }
+        fields[numFields++] = tok;
+    }
+
+    if ((numFields != 0) && (strcmp(fields[0], "acUnit") == 0)) {
+        return setAcUnitDef(fields, numFields, lineNum);
+    }
+
+    if ((numFields != 0) && (strcmp(fields[0], "pollInterval") == 0)) {
+        return setPollIntervalDef(fields, numFields, lineNum);
+    }
+
+    if ((numFields != 0) && (strcmp(fields[0], "alarm") == 0)) {
+        return setAlarmDef(fields, numFields, lineNum);
+    }
+
+    if ((numFields != 4) && (numFields != 6)) {
+        logMsg(LOG_ERR, "%s: line %d: expected 4 or 6 fields !\n", __func__, lineNum);
+        return -1;
+    }
+
+    for (size_t n = 0; n < NUM_MIB_TYPES; n++) {
+        if (strcmp(fields[2], mibTypes[n].name) == 0) {
+            mibType = &mibTypes[n];
+            break;
+        }
+    }
+
+    if (mibType == NULL) {
+        logMsg(LOG_ERR, "%s: line %d: unsupported type \"%s\" !\n", __func__, lineNum, fields[2]);
+        return -1;
+    }
+
+    // Read-write objects need a SET handler, so
+    // only the built-in ones are supported.
+    if (strcmp(fields[3], "read-only") != 0) {
+        logMsg(LOG_ERR, "%s: line %d: unsupported access \"%s\" !\n", __func__, lineNum, fields[3]);
+        return -1;
+    }
+
+    if (numFields == 6) {
+        // Only the Integer32 values have alarms
+        if (mibType->column != MIB_COLUMN_INT32) {
+            logMsg(LOG_ERR, "%s: line %d: thresholds are only supported for Integer32 objects !\n", __func__, lineNum);
+            return -1;
+        }
+        mibObj.hasAlarm = true;
+        mibObj.ownThresholds = true;
+        mibObj.loThreshold = strtol(fields[4], NULL, 10);
+        mibObj.hiThreshold = strtol(fields[5], NULL, 10);
+        if (mibObj.loThreshold >= mibObj.hiThreshold) {
+            logMsg(LOG_ERR, "%s: line %d: loThreshold=%ld MUST be lower than hiThreshold=%ld !\n", __func__, lineNum, mibObj.loThreshold, mibObj.hiThreshold);
+            return -1;
+        }
+    }
+
+    if ((mibObj.varOid = parseOid(fields[1], &mibObj.varOidLen)) == NULL) {
+        logMsg(LOG_ERR, "%s: line %d: invalid OID \"%s\" !\n", __func__, lineNum, fields[1]);
+        return -1;
+    }
+
+    if ((mibObj.varName = strdup(fields[0])) == NULL) {
+        return -1;
+    }
+    mibObj.varType = mibType->varType;
+    mibObj.column = mibType->column;
+    mibObj.readOnly = true;
+
+    return addMibObj(&mibObj);
+}
+
+// Load the definitions of the additional MIB objects
+// from the object file
+static int procObjectFile(const char *objectFile)
+{
+    FILE *fp;
+    char strBuf[256];
+    int lineNum = 0;
+    int s = 0;
+
+    // Open the objectFile in read-only mode
+    if ((fp = fopen(objectFile, "r")) == NULL) {
+        logMsg(LOG_ERR, "%s: failed to open object file \"%s\"\n", __func__, objectFile);
+        return -1;
+    }
+
+    // Read one line at a time. Lines that start
+    // with a '#' are comments and are skipped.
+    while ((s == 0) && (fgets(strBuf, sizeof (strBuf), fp) != NULL)) {
+        lineNum++;
+        if ((strBuf[0] != '#') && (strBuf[0] != '\n') && (strBuf[0] != '\0')) {
+            s = setObjectDef(strBuf, lineNum);
+        }
+    }
+
+    // Done with the objectFile!
+    fclose(fp);
+
+    return s;
+}
+
+// This flag is set by the SIGUSR1 handler to
+// indicate that the file snmpd.conf needs to
+// be updated, and the snmpd service reloaded.
+bool snmpdConfigChange = false;
+
+#define SNMPD_CONF_FILE     "/etc/snmp/snmpd.conf"
+#define SNMPD_CONF_HEADER   "# This file was autogenerated by snmpSubagent on: "
+
+// The snmpd.conf directive of each config tag. snmpd picks
+// up most of them on a reload (SIGHUP), which keeps its
+// AgentX sessions, and the in-flight requests, alive; the
+// listening address however is only bound at startup, so
+// changing it requires a restart.
+typedef struct ConfigTag {
+    const char *tag;
+    const char *directive;
+    bool needsRestart;
+} ConfigTag;
+
+static const ConfigTag configTags[] = {
+    { "agentAddress", "agentaddress", true },   // TODO: validate the syntax of the value string
+    { "readOnlyCommunity", "rocommunity", false },
+    { "readWriteCommunity", "rwcommunity", false },
+    { "trapReceiver", "trap2sink", false },     // TODO: validate the syntax of the value string
+    { "sysContact", "sysContact", false },
+    { "sysLocation", "sysLocation", false },
+};
+
+#define NUM_CONFIG_TAGS (sizeof (configTags) / sizeof (configTags[0]))
+
+typedef struct SnmpdConf {
+    char dataBuf[65536];    // 65 KB big enough?
+    size_t dataLen;
+    size_t numDirectives;
+    char curBuf[65536];     // current contents of snmpd.conf
+} SnmpdConf;
+
+static int setConfigValue(const char *tag, const char *val, SnmpdConf *snmpdConf)
+{
+    char *buf = snmpdConf->dataBuf + snmpdConf->dataLen;
+    size_t len = sizeof (snmpdConf->dataBuf) - snmpdConf->dataLen;
+    int n;
+
+    for (n = 0; n < (int) NUM_CONFIG_TAGS; n++) {
+        if (strcmp(tag, configTags[n].tag) == 0) {
+            break;
+        }
+    }
+
+    if (n == (int) NUM_CONFIG_TAGS) {
+        logMsg(LOG_WARNING, "%s: unsupported config tag \"%s\"\n", __func__, tag);
+        return -1;
+    }
+
+    if ((n = snprintf(buf, len, "%s %s", configTags[n].directive, val)) >= (int) len) {
+        logMsg(LOG_ERR, "%s: config data too long!\n", __func__);
+        return -1;
+    }
+
+    snmpdConf->dataLen += n;
+    snmpdConf->numDirectives++;
+
+    return 0;
+}
+
+// Read the current snmpd.conf, skipping our autogenerated
+// header line, so that the timestamp doesn't count as a
+// change. Returns the length read, or -1 on error.
+static ssize_t readSnmpdConf(char *buf, size_t size)
+{
+    FILE *fp;
+    size_t len;
+
+    if ((fp = fopen(SNMPD_CONF_FILE, "r")) == NULL) {
+        return -1;
+    }
+
+    len = fread(buf, 1, (size - 1), fp);
+    fclose(fp);
+    buf[len] = '\0';
+
+    if (strncmp(buf, SNMPD_CONF_HEADER, strlen(SNMPD_CONF_HEADER)) == 0) {
+        char *eol = strchr(buf, '\n');
+        size_t hdrLen = (eol != NULL) ? (size_t) (eol + 1 - buf) : len;
+        memmove(buf, (buf + hdrLen), (len - hdrLen + 1));
+        len -= hdrLen;
+    }
+
+    return len;
+}
+
+// Check whether the lines of a directive are the same in
+// both versions of snmpd.conf
+static bool sameDirective(const char *oldConf, const char *newConf, const char *directive)
+{
+    size_t dirLen = strlen(directive);
+
+    while (true) {
+        // Find the next line of the directive in each one
+        while ((*oldConf != '\0') && ((strncmp(oldConf, directive, dirLen) != 0) || (oldConf[dirLen] != ' '))) {
+            oldConf += strcspn(oldConf, "\n");
+            oldConf += (*oldConf == '\n');
+        }
+        while ((*newConf != '\0') && ((strncmp(newConf, directive, dirLen) != 0) || (newConf[dirLen] != ' '))) {
+            newConf += strcspn(newConf, "\n");
+            newConf += (*newConf == '\n');
+        }
+
+        if ((*oldConf == '\0') || (*newConf == '\0')) {
+            return ((*oldConf == '\0') && (*newConf == '\0'));
+        }
+
+        size_t oldLen = strcspn(oldConf, "\n");
+        size_t newLen = strcspn(newConf, "\n");
+        if ((oldLen != newLen) || (memcmp(oldConf, newConf, oldLen) != 0)) {
+            return false;
+        }
+
+        oldConf += oldLen + (oldConf[oldLen] == '\n');
+        newConf += newLen + (newConf[newLen] == '\n');
+    }
+}
+
+// Replace snmpd.conf atomically: write the new contents to
+// a temp file in the same directory, and rename it over the
+// old one, so snmpd never reads a partially written file.
+static int writeSnmpdConf(const char *conf)
+{
+    const char *tmpFile = SNMPD_CONF_FILE ".tmp";
+    time_t now = time(NULL);
+    struct tm brkDwnTime;
+    char tsBuf[32];         // YYYY-MM-DDTHH:MM:SS
+    struct stat fileStat;
+    mode_t mode = 0600;
+    FILE *wrFp;
+    int fd;
+
+    // Keep the permissions of the current file
+    if (stat(SNMPD_CONF_FILE, &fileStat) == 0) {
+        mode = fileStat.st_mode & 0777;
+    }
+
+    if (((fd = open(tmpFile, (O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC), mode)) == -1) ||
+        ((wrFp = fdopen(fd, "w")) == NULL)) {
+        int errNo = errno;
+        logMsg(LOG_ERR, "%s: failed to create \"%s\": %s (%d)\n", __func__, tmpFile, strerror(errNo), errNo);
+        if (fd != -1) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    strftime(tsBuf, sizeof (tsBuf), "%Y-%m-%d %H:%M:%S", gmtime_r(&now, &brkDwnTime));    // %H means 24-hour time
+
+    // Add an informational line, and the configuration data
+    fprintf(wrFp, "%s%s\n", SNMPD_CONF_HEADER, tsBuf);
+    fprintf(wrFp, "%s", conf);
+
+    if ((fflush(wrFp) != 0) || (fsync(fd) != 0) || (fclose(wrFp) != 0) || (rename(tmpFile, SNMPD_CONF_FILE) != 0)) {
+        int errNo = errno;
+        logMsg(LOG_ERR, "%s: failed to write \"%s\": %s (%d)\n", __func__, SNMPD_CONF_FILE, strerror(errNo), errNo);
+        unlink(tmpFile);
+        return -1;
+    }
+
+    return 0;
+}
+
+// The systemctl command that reloads, or restarts, snmpd runs
+// in the background, so that the AgentX requests are served
+// while snmpd restarts. Its exit is reported by a pidfd, kept
+// in an epoll instance of its own, so that the set of fds
+// watched by the MIB update task doesn't change; without
+// pidfds (Linux < 5.3) the command is polled.
+typedef struct SnmpdCtl {
+    pid_t pid;                  // -1 if none is running
+    int pidFd;
+    int epollFd;
+    bool restart;               // the command is a restart
+} SnmpdCtl;
+
+static SnmpdCtl snmpdCtl = { .pid = -1, .pidFd = -1, .epollFd = -1 };
+
+#define SNMPD_CTL_POLL      100         // msec
+
+extern char **environ;
+
+static int snmpdCtlInit(void)
+{
+    if ((snmpdCtl.epollFd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+        logMsg(LOG_ERR, "%s: epoll_create1() failed!\n", __func__);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Run "systemctl reload|restart snmpd". Returns -1 on error.
+static int snmpdCtlStart(bool restart)
+{
+    char *argv[] = { "systemctl", (restart ? "restart" : "reload"), "snmpd", NULL };
+    posix_spawnattr_t attr;
+    sigset_t sigMask, sigDefault;
+    int err;
+
+    // The command must not inherit the signals blocked for
+    // the signalfd of the event loop mode, nor the ones we
+    // ignore.
+    sigemptyset(&sigMask);
+    sigemptyset(&sigDefault);
+    sigaddset(&sigDefault, SIGUSR1);
+    sigaddset(&sigDefault, SIGTERM);
+    sigaddset(&sigDefault, SIGINT);
+    sigaddset(&sigDefault, SIGPIPE);
+    sigaddset(&sigDefault, SIGCHLD);
+
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, (POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF));
+    posix_spawnattr_setsigmask(&attr, &sigMask);
+    posix_spawnattr_setsigdefault(&attr, &sigDefault);
+
+    err = posix_spawnp(&snmpdCtl.pid, argv[0], NULL, &attr, argv, environ);
+    posix_spawnattr_destroy(&attr);
+
+    if (err != 0) {
+        logMsg(LOG_ERR, "%s: Failed to exec \"systemctl %s snmpd\": %s (%d)\n", __func__, argv[1], strerror(err), err);
+        snmpdCtl.pid = -1;
+        return -1;
+    }
+
+    snmpdCtl.restart = restart;
+
+#ifdef SYS_pidfd_open
+    if ((snmpdCtl.pidFd = syscall(SYS_pidfd_open, snmpdCtl.pid, 0)) != -1) {
+        struct epoll_event event = { .events = EPOLLIN };
+
+        if (epoll_ctl(snmpdCtl.epollFd, EPOLL_CTL_ADD, snmpdCtl.pidFd, &event) != 0) {
+            close(snmpdCtl.pidFd);
+            snmpdCtl.pidFd = -1;
+        }
+    }
+#endif
+
+    return 0;
+}
+
+// Get the time, in msec, until the systemctl command is due
+// to be polled, or -1 if it isn't.
+static int snmpdCtlTimeout(void)
+{
+    return ((snmpdCtl.pid != -1) && (snmpdCtl.pidFd == -1)) ? SNMPD_CTL_POLL : -1;
+}
+
+// Reap the systemctl command, if it exited, and act on its
+// exit status: a failed reload is followed by a restart.
+static void snmpdCtlCheck(void)
+{
+    const char *action = snmpdCtl.restart ? "restart" : "reload";
+    char statusBuf[64];
+    int status;
+    pid_t pid;
+
+    if ((snmpdCtl.pid == -1) || ((pid = waitpid(snmpdCtl.pid, &status, WNOHANG)) == 0)) {
+        return;     // none, or still running
+    }
+
+    // Closing the pidfd also removes it from the epoll set
+    if (snmpdCtl.pidFd != -1) {
+        close(snmpdCtl.pidFd);
+        snmpdCtl.pidFd = -1;
+    }
+    snmpdCtl.pid = -1;
+
+    if ((pid != -1) && WIFEXITED(status) && (WEXITSTATUS(status) == 0)) {
+        // Get the AgentX session back right away,
+        // if snmpd dropped it
+        agentxSessionRecheck();
+        return;
+    }
+
+    if (pid == -1) {
+        snprintf(statusBuf, sizeof (statusBuf), "%s", strerror(errno));
+    } else if (WIFEXITED(status)) {
+        snprintf(statusBuf, sizeof (statusBuf), "exit status %d", WEXITSTATUS(status));
+    } else {
+        snprintf(statusBuf, sizeof (statusBuf), "signal %d", WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+    }
+
+    if (snmpdCtl.restart) {
+        logMsg(LOG_ERR, "%s: \"systemctl %s snmpd\" failed (%s)\n", __func__, action, statusBuf);
+        return;
+    }
+
+    logMsg(LOG_WARNING, "%s: \"systemctl %s snmpd\" failed (%s); restarting it instead\n", __func__, action, statusBuf);
+    logMsg(LOG_INFO, "%s: Restarting snmpd service to pick up the new config...\n", __func__);
+
+    snmpdCtlStart(true);
+}
+
+static int procConfigFile(const char *configFile)
+{
+    static SnmpdConf snmpdConf;
+    static char newConf[sizeof (snmpdConf.dataBuf) + 32];
+    FILE *rdFp;
+    char strBuf[256];
+    ssize_t curLen;
+    bool restart;
+
+    // Clear the flag!
+    snmpdConfigChange = false;
+
+    // Init the SnmpdConf buffer
+    snmpdConf.dataLen = 0;
+    snmpdConf.dataBuf[0] = '\0';
+    snmpdConf.numDirectives = 0;
+
+    // Open the configFile in read-only mode
+    if ((rdFp = fopen(configFile, "r")) == NULL) {
+        logMsg(LOG_ERR, "%s: failed to open config file \"%s\"\n", __func__, configFile);
+        return -1;
+    }
+
+    // Read one line at a time. Lines that start
+    // with a '#' are comments and are skipped.
+    while (fgets(strBuf, sizeof (strBuf), rdFp) != NULL) {
+        if ((strBuf[0] != '#') && (strBuf[0] != '\0')) {
+            char *comma = strchr(strBuf, ',');
+            if (comma != NULL) {
+                *comma = '\0';  // null-terminate tag string
+                setConfigValue(strBuf, (comma + 1), &snmpdConf);
+            }
+        }
+    }
+
+    // Done with the configFile!
+    fclose(rdFp);
+
+    if (snmpdConf.numDirectives == 0) {
+        return 0;
+    }
+
+    // AgentX support is always enabled
+    snprintf(newConf, sizeof (newConf), "master agentx\n%s", snmpdConf.dataBuf);
+
+    // Nothing to do if snmpd.conf already has
+    // this configuration
+    curLen = readSnmpdConf(snmpdConf.curBuf, sizeof (snmpdConf.curBuf));
+    if ((curLen >= 0) && (strcmp(snmpdConf.curBuf, newConf) == 0)) {
+        logMsg(LOG_INFO, "%s: snmpd config unchanged\n", __func__);
+        return 0;
+    }
+
+    // A reload is enough, unless a directive
+    // that requires a restart changed
+    restart = (curLen < 0);
+    for (size_t n = 0; (n < NUM_CONFIG_TAGS) && !restart; n++) {
+        if (configTags[n].needsRestart && !sameDirective(snmpdConf.curBuf, newConf, configTags[n].directive)) {
+            restart = true;
+        }
+    }
+
+    if (writeSnmpdConf(newConf) != 0) {
+        return -1;
+    }
+
+    if (restart) {
+        logMsg(LOG_INFO, "%s: Restarting snmpd service to pick up the new config...\n", __func__);
+    } else {
+        logMsg(LOG_INFO, "%s: Reloading snmpd service to pick up the new config...\n", __func__);
+    }
+
+    // The command is reaped by snmpdCtlCheck()
+    return snmpdCtlStart(restart);
+}
+
+// Objects with a poll interval are refreshed at most once per
+// interval: the new values read in between are only staged,
+// and the latest one is applied when the object is due. The
+// due times are kept in a timer wheel, so each tick only
+// visits the objects that are due, and the phase of each
+// object within its interval is spread by a hash of its value
+// index, so objects with the same interval don't all become
+// due in the same tick. An object's first value is applied
+// right away.
+//
+// The workers of the data files don't parse the records of
+// the objects that aren't due: they only report that the line
+// changed, and read the file again when the object is due, to
+// apply its latest line.
+#define SCHED_TICK  10      // msec
+
+typedef struct MibSched {
+    size_t numValues;           // scalar values + acUnitTemp column
+    size_t numScheduled;        // values with a poll interval
+    uint32_t *interval;         // in ticks; 0 means not scheduled
+    int *pendingValue;
+    uint8_t *state;             // SCHED_*
+    atomic_bool *hold;          // the value isn't due; read by the workers
+    uint32_t *deferredSources;  // data sources that skipped a line of the value
+    unsigned rereadSources;     // data sources to read again
+    TimerWheel wheel;
+    uint64_t startTick;
+} MibSched;
+
+#define SCHED_PRIMED    0x1     // the first value was applied
+#define SCHED_PENDING   0x2     // a value is staged
+#define SCHED_ARMED     0x4     // the timer is armed
+#define SCHED_DEFERRED  0x8     // a data file line was skipped
+#define SCHED_DUE       0x10    // the next value is applied right away
+
+static MibSched mibSched;
+
+static void dataSourcesReread(unsigned sources);
+
+static uint64_t schedNow(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t) now.tv_sec * (1000 / SCHED_TICK)) + (now.tv_nsec / (SCHED_TICK * 1000000));
+}
+
+// Arm the timer of a scheduled object, if it's not armed yet
+static void schedArm(size_t value)
+{
+    MibSched *sched = &mibSched;
+
+    if (!(sched->state[value] & SCHED_ARMED)) {
+        // Due at the next tick of the form:
+        // (n * interval) + phase
+        uint32_t interval = sched->interval[value];
+        uint64_t now = sched->wheel.now;
+        uint32_t phase = ((uint32_t) value * 2654435761u) % interval;
+        uint64_t offset = (now + interval - phase) % interval;
+
+        sched->state[value] |= SCHED_ARMED;
+        timerWheelArm(&sched->wheel, value, (now + interval - offset));
+    }
+}
+
+// Stage the new value of a scheduled object. Returns false
+// if the value is to be applied right away.
+static bool schedStage(size_t value, int newValue)
+{
+    MibSched *sched = &mibSched;
+
+    if ((value >= sched->numValues) || (sched->interval[value] == 0)) {
+        return false;
+    }
+
+    if (!(sched->state[value] & SCHED_PRIMED) || (sched->state[value] & SCHED_DUE)) {
+        if (sched->state[value] & SCHED_DUE) {
+            statsInc(STATS_SCHED_REFRESHES);
+        }
+        sched->state[value] = (sched->state[value] | SCHED_PRIMED) & ~SCHED_DUE;
+        atomic_store_explicit(&sched->hold[value], true, memory_order_relaxed);
+        return false;
+    }
+
+    if (sched->state[value] & SCHED_PENDING) {
+        statsInc(STATS_SCHED_COALESCED);
+    } else {
+        sched->state[value] |= SCHED_PENDING;
+        schedArm(value);
+    }
+
+    sched->pendingValue[value] = newValue;
+
+    return true;
+}
+
+// A worker skipped a changed line of a scheduled object, in
+// the data file of the source
+static void schedDefer(size_t value, unsigned source)
+{
+    MibSched *sched = &mibSched;
+
+    sched->deferredSources[value] |= (1u << source);
+
+    if (sched->state[value] & SCHED_DUE) {
+        // Became due while the line was read
+        dataSourcesReread(sched->deferredSources[value]);
+        sched->deferredSources[value] = 0;
+    } else {
+        sched->state[value] |= SCHED_DEFERRED;
+        schedArm(value);
+    }
+}
+
+// Apply the staged value of an object that is due, and have
+// the workers read the lines they skipped
+static void schedFire(uint32_t value)
+{
+    MibSched *sched = &mibSched;
+
+    sched->state[value] &= ~SCHED_ARMED;
+
+    if (sched->state[value] & SCHED_PENDING) {
+        sched->state[value] &= ~SCHED_PENDING;
+        statsInc(STATS_SCHED_REFRESHES);
+
+        if (mibValueTbl[value] != sched->pendingValue[value]) {
+            mibValueSet(value, sched->pendingValue[value]);
+        }
+    }
+
+    if (sched->state[value] & SCHED_DEFERRED) {
+        sched->state[value] = (sched->state[value] & ~SCHED_DEFERRED) | SCHED_DUE;
+        atomic_store_explicit(&sched->hold[value], false, memory_order_relaxed);
+        sched->rereadSources |= sched->deferredSources[value];
+        sched->deferredSources[value] = 0;
+    }
+}
+
+// Apply the staged values of the objects that are due
+static void schedRun(void)
+{
+    if (mibSched.numScheduled != 0) {
+        timerWheelAdvance(&mibSched.wheel, schedNow(), schedFire);
+    }
+
+    if (mibSched.rereadSources != 0) {
+        dataSourcesReread(mibSched.rereadSources);
+        mibSched.rereadSources = 0;
+    }
+}
+
+// Get the time, in msec, until the next object is due,
+// or -1 if there's none.
+static int schedTimeout(void)
+{
+    uint64_t ticks;
+
+    if ((mibSched.numScheduled == 0) || ((ticks = timerWheelTimeout(&mibSched.wheel)) == UINT64_MAX)) {
+        return -1;
+    }
+
+    // Account for the time elapsed since the wheel
+    // was last advanced
+    ticks += mibSched.wheel.now;
+    ticks = (ticks > schedNow()) ? (ticks - schedNow()) : 0;
+
+    return (ticks > (INT_MAX / SCHED_TICK)) ? INT_MAX : (int) (ticks * SCHED_TICK);
+}
+
+static int setReadOnlyValue(MibObj *mibObj, int value)
+{
+    // Is the object refreshed on its own schedule?
+    if (schedStage((mibObj->varValue - mibValueTbl), value)) {
+        return 0;
+    }
+
+    // Has the value changed?
+    if (value != *mibObj->varValue) {
+        // Yes! Update the value
+        logMsg(LOG_DEBUG, "%s: varName=%s oldValue=%d newValue=%d\n", __func__, mibObj->varName, *mibObj->varValue, value);
+        mibValueSet((mibObj->varValue - mibValueTbl), value);
+    }
+
+    return 0;
+}
+
+// Update the temperature of an A/C unit
+static void setAcUnitTemp(size_t row, int value)
+{
+    int *temp = &mibValueTbl[acUnitTbl.tempBase + row];
+
+    // Is the row refreshed on its own schedule?
+    if (schedStage((acUnitTbl.tempBase + row), value)) {
+        return;
+    }
+
+    // Has the value changed?
+    if (value != *temp) {
+        logMsg(LOG_DEBUG, "%s: acUnitTemp.%lu oldValue=%d newValue=%d\n", __func__, acUnitTbl.unitIndex[row], *temp, value);
+        mibValueSet((acUnitTbl.tempBase + row), value);
+    }
+}
+
+// The High Temperature alarms of the read-only scalar objects
+// and of the rows of the acUnitTable. They are evaluated by the
+// MIB update task, in one pass over the values, after each
+// pass over the data files that changed any value, and after
+// any change to the thresholds.
+static AlarmSet mibObjAlarms;
+static AlarmSet acUnitAlarms;
+
+// The state kept across restarts in the --state-file (see
+// persist.h): the thresholds set with snmpset, the alarm
+// state of each value, so a restart doesn't send the traps
+// of the alarms that were already active again, and the last
+// known values, served until the data files are read again.
+// The changes to the thresholds and alarm states are added
+// to the journal, which is flushed PERSIST_FLUSH_DELAY msec
+// after the first pending change, so a burst of SET requests
+// only costs one fdatasync(); the values are only saved by
+// the snapshots, taken every PERSIST_SNAPSHOT_PERIOD msec,
+// or when the journal grows past PERSIST_JOURNAL_MAX bytes.
+#define PERSIST_FLUSH_DELAY         200         // msec
+#define PERSIST_SNAPSHOT_PERIOD     60000       // msec
+#define PERSIST_JOURNAL_MAX         (1024 * 1024)
+
+typedef struct MibPersist {
+    bool enabled;
+    PersistStore store;
+    size_t numValues;           // including the acUnitTemp column
+    int32_t *valueSlot;         // per value
+    int32_t *alarmSlot;         // per value
+    int32_t *loSlot;            // per acUnitTable row
+    int32_t *hiSlot;            // per acUnitTable row
+    int32_t loTempSlot;
+    int32_t hiTempSlot;
+    long *loSaved;              // last saved thresholds
+    long *hiSaved;
+    long loTempSaved;
+    long hiTempSaved;
+    uint64_t flushTime;         // when the pending changes are flushed; 0 if none
+    uint64_t nextSnapshot;
+} MibPersist;
+
+static MibPersist mibPersist;
+
+// Save the thresholds changed by SET requests
+static void mibPersistThresholds(void)
+{
+    MibPersist *mp = &mibPersist;
+    long threshold;
+
+    if (!mp->enabled) {
+        return;
+    }
+
+    if ((threshold = getThreshold(&loTempThreshold)) != mp->loTempSaved) {
+        persistPut(&mp->store, mp->loTempSlot, threshold);
+        mp->loTempSaved = threshold;
+    }
+    if ((threshold = getThreshold(&hiTempThreshold)) != mp->hiTempSaved) {
+        persistPut(&mp->store, mp->hiTempSlot, threshold);
+        mp->hiTempSaved = threshold;
+    }
+
+    for (size_t row = 0; row < acUnitTbl.numRows; row++) {
+        if ((threshold = getThreshold(&acUnitTbl.loTempThreshold[row])) != mp->loSaved[row]) {
+            persistPut(&mp->store, mp->loSlot[row], threshold);
+            mp->loSaved[row] = threshold;
+        }
+        if ((threshold = getThreshold(&acUnitTbl.hiTempThreshold[row])) != mp->hiSaved[row]) {
+            persistPut(&mp->store, mp->hiSlot[row], threshold);
+            mp->hiSaved[row] = threshold;
+        }
+    }
+}
+
+// Save the alarm state of the n-th value
+static void mibPersistAlarm(size_t n, int state)
+{
+    if (mibPersist.enabled) {
+        persistPut(&mibPersist.store, mibPersist.alarmSlot[n], state);
+    }
+}
+
+// Refresh the private copies of the alarm thresholds
+static void refreshAlarmThresholds(void)
+{
+    long loThreshold = getThreshold(&loTempThreshold);
+    long hiThreshold = getThreshold(&hiTempThreshold);
+
+    // Objects loaded from the object file may have
+    // their own thresholds; the values without an
+    // alarm get thresholds they can never cross.
+    for (size_t n = 0; n < mibObjAlarms.numAlarms; n++) {
+        const MibObj *mibObj = mibValueObj[n];
+        if (!mibObj->hasAlarm) {
+            mibObjAlarms.loThreshold[n] = LONG_MAX;
+            mibObjAlarms.hiThreshold[n] = LONG_MAX;
+        } else {
+            mibObjAlarms.loThreshold[n] = mibObj->ownThresholds ? mibObj->loThreshold : loThreshold;
+            mibObjAlarms.hiThreshold[n] = mibObj->ownThresholds ? mibObj->hiThreshold : hiThreshold;
+        }
+    }
+
+    for (size_t row = 0; row < acUnitAlarms.numAlarms; row++) {
+        acUnitAlarms.loThreshold[row] = getThreshold(&acUnitTbl.loTempThreshold[row]);
+        acUnitAlarms.hiThreshold[row] = getThreshold(&acUnitTbl.hiTempThreshold[row]);
+    }
+}
+
+static void evalAlarms(void)
+{
+    bool thresholdsDirty = atomic_exchange(&mibThresholdsDirty, false);
+    size_t numTransitions;
+
+    if (thresholdsDirty) {
+        refreshAlarmThresholds();
+        mibPersistThresholds();
+    } else if (!mibValuesDirty) {
+        return;     // nothing changed
+    }
+
+    numTransitions = alarmSetEval(&mibObjAlarms);
+    for (size_t n = 0; n < numTransitions; n++) {
+        const AlarmTransition *transition = &mibObjAlarms.transitions[n];
+        const MibObj *mibObj = mibValueObj[transition->index];
+
+        logMsgLimited(LOG_INFO, LOG_ALARMS_PER_SEC, "%s: varName=%s value=%d alarmState=%d\n", __func__, mibObj->varName, *mibObj->varValue, transition->state);
+
+        if (mibObj->acUnit != 0) {
+            trapQueuePut(transition->index, mibObj->acUnit, transition->state);
+        }
+
+        mibPersistAlarm(transition->index, transition->state);
+    }
+
+    numTransitions = alarmSetEval(&acUnitAlarms);
+    for (size_t n = 0; n < numTransitions; n++) {
+        const AlarmTransition *transition = &acUnitAlarms.transitions[n];
+
+        logMsgLimited(LOG_INFO, LOG_ALARMS_PER_SEC, "%s: acUnit=%lu value=%d alarmState=%d\n", __func__,
+                      acUnitTbl.unitIndex[transition->index], acUnitAlarms.values[transition->index], transition->state);
+
+        trapQueuePut((acUnitTbl.tempBase + transition->index), acUnitTbl.unitIndex[transition->index], transition->state);
+
+        mibPersistAlarm((acUnitTbl.tempBase + transition->index), transition->state);
+
+        // The alarm state of the A/C units is visible
+        // in the acUnitTable.
+        valueStoreMark(&mibValueStore, (acUnitTbl.alarmStateBase + transition->index));
+        mibValuesDirty = true;
+    }
+}
+
+static int alarmsInit(void)
+{
+    if ((mibValueObj = calloc((mibValueCount + 1), sizeof (MibObj *))) == NULL) {
+        return -1;
+    }
+
+    for (MibObj *mibObj = &mibObjTbl[0]; mibObj->varName != NULL; mibObj++) {
+        if (mibObj->varValue != NULL) {
+            mibValueObj[mibObj->varValue - mibValueTbl] = mibObj;
+        }
+    }
+
+    if ((alarmSetInit(&mibObjAlarms, mibValueCount, mibValueTbl, calloc((mibValueCount + 1), sizeof (int))) != 0) ||
+        (mibObjAlarms.state == NULL) ||
+        (alarmSetInit(&acUnitAlarms, acUnitTbl.numRows, &mibValueTbl[acUnitTbl.tempBase], &mibValueTbl[acUnitTbl.alarmStateBase]) != 0)) {
+        logMsg(LOG_ERR, "%s: failed to alloc the alarm sets!\n", __func__);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int32_t mibPersistSlot(const char *kind, const char *name, unsigned long index)
+{
+    char key[256];
+    int len = (index != 0) ? snprintf(key, sizeof (key), "%s:%s%lu", kind, name, index)
+                           : snprintf(key, sizeof (key), "%s:%s", kind, name);
+
+    return persistSlot(&mibPersist.store, hashText(key, len));
+}
+
+// Open the state file, and restore the saved state. Returns
+// -1 on error.
+static int mibPersistInit(const char *stateFile)
+{
+    MibPersist *mp = &mibPersist;
+    size_t numRows = acUnitTbl.numRows;
+    size_t numRestored = 0;
+    struct timespec startTime, endTime;
+    int32_t value, loValue, hiValue;
+
+    if (stateFile == NULL) {
+        return 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+    mp->numValues = mibValueCount + numRows;
+    if (persistOpen(&mp->store, stateFile, ((2 * mp->numValues) + (2 * numRows) + 2)) != 0) {
+        int errNo = errno;
+        logMsg(LOG_ERR, "%s: failed to open state file \"%s\": %s (%d)\n", __func__, stateFile, strerror(errNo), errNo);
+        return -1;
+    }
+
+    mp->valueSlot = calloc((mp->numValues + 1), sizeof (int32_t));
+    mp->alarmSlot = calloc((mp->numValues + 1), sizeof (int32_t));
+    mp->loSlot = calloc((numRows + 1), sizeof (int32_t));
+    mp->hiSlot = calloc((numRows + 1), sizeof (int32_t));
+    mp->loSaved = calloc((numRows + 1), sizeof (long));
+    mp->hiSaved = calloc((numRows + 1), sizeof (long));
+    if ((mp->valueSlot == NULL) || (mp->alarmSlot == NULL) || (mp->loSlot == NULL) ||
+        (mp->hiSlot == NULL) || (mp->loSaved == NULL) || (mp->hiSaved == NULL)) {
+        logMsg(LOG_ERR, "%s: failed to alloc the state of %zu values!\n", __func__, mp->numValues);
+        return -1;
+    }
+
+    // Look up the slots; the store was sized
+    // for all of them, so none fails.
+    mp->loTempSlot = mibPersistSlot("threshold", "loTempThreshold", 0);
+    mp->hiTempSlot = mibPersistSlot("threshold", "hiTempThreshold", 0);
+    for (size_t n = 0; n < mp->numValues; n++) {
+        const char *name = (n < mibValueCount) ? mibValueObj[n]->varName : acUnitTempPrefix;
+        unsigned long index = (n < mibValueCount) ? 0 : acUnitTbl.unitIndex[n - acUnitTbl.tempBase];
+
+        mp->valueSlot[n] = mibPersistSlot("value", name, index);
+        mp->alarmSlot[n] = mibPersistSlot("alarm", name, index);
+    }
+    for (size_t row = 0; row < numRows; row++) {
+        mp->loSlot[row] = mibPersistSlot("threshold", "acUnitLoTempThreshold.", acUnitTbl.unitIndex[row]);
+        mp->hiSlot[row] = mibPersistSlot("threshold", "acUnitHiTempThreshold.", acUnitTbl.unitIndex[row]);
+    }
+
+    // The thresholds are only restored in pairs
+    // that keep the low one below the high one
+    if (persistGet(&mp->store, mp->loTempSlot, &loValue) && persistGet(&mp->store, mp->hiTempSlot, &hiValue) &&
+        (loValue < hiValue)) {
+        loTempThreshold = loValue;
+        hiTempThreshold = hiValue;
+        numRestored += 2;
+    }
+    mp->loTempSaved = loTempThreshold;
+    mp->hiTempSaved = hiTempThreshold;
+
+    for (size_t row = 0; row < numRows; row++) {
+        if (persistGet(&mp->store, mp->loSlot[row], &loValue) && persistGet(&mp->store, mp->hiSlot[row], &hiValue) &&
+            (loValue < hiValue)) {
+            acUnitTbl.loTempThreshold[row] = loValue;
+            acUnitTbl.hiTempThreshold[row] = hiValue;
+            numRestored += 2;
+        }
+        mp->loSaved[row] = acUnitTbl.loTempThreshold[row];
+        mp->hiSaved[row] = acUnitTbl.hiTempThreshold[row];
+    }
+
+    for (size_t n = 0; n < mp->numValues; n++) {
+        if (persistGet(&mp->store, mp->valueSlot[n], &value)) {
+            mibValueTbl[n] = value;
+            numRestored++;
+        }
+
+        if (persistGet(&mp->store, mp->alarmSlot[n], &value)) {
+            if (n < mibValueCount) {
+                mibObjAlarms.state[n] = value;
+            } else {
+                acUnitAlarms.state[n - acUnitTbl.tempBase] = value;
+            }
+            numRestored++;
+        }
+    }
+
+    // Serve the restored values right away
+    valueStoreMarkAll(&mibValueStore);
+    valueStorePublish(&mibValueStore);
+
+    mp->enabled = true;
+    mp->nextSnapshot = historyNow() + PERSIST_SNAPSHOT_PERIOD;
+
+    clock_gettime(CLOCK_MONOTONIC, &endTime);
+
+    logMsg(LOG_INFO, "%s: Restored %zu of %zu values from %s in %lu usec\n", __func__,
+           numRestored, ((2 * mp->numValues) + (2 * numRows) + 2), stateFile, (unsigned long) statsUsec(&startTime, &endTime));
+
+    return 0;
+}
+
+// Save the current values, and take a snapshot; the pending
+// changes are part of it.
+static void mibPersistSave(void)
+{
+    MibPersist *mp = &mibPersist;
+
+    for (size_t n = 0; n < mp->numValues; n++) {
+        persistSet(&mp->store, mp->valueSlot[n], mibValueTbl[n]);
+    }
+
+    if (persistSnapshot(&mp->store) != 0) {
+        int errNo = errno;
+        logMsg(LOG_ERR, "%s: failed to write the state file: %s (%d)\n", __func__, strerror(errNo), errNo);
+    }
+
+    mp->flushTime = 0;
+}
+
+// Flush the journal, and take a snapshot, when they are due
+static void mibPersistRun(void)
+{
+    MibPersist *mp = &mibPersist;
+    uint64_t now;
+
+    if (!mp->enabled) {
+        return;
+    }
+
+    now = historyNow();
+
+    if ((now >= mp->nextSnapshot) || (mp->store.journalLen > PERSIST_JOURNAL_MAX)) {
+        mibPersistSave();
+        mp->nextSnapshot = now + PERSIST_SNAPSHOT_PERIOD;
+        return;
+    }
+
+    if (mp->store.numPending == 0) {
+        return;
+    }
+
+    if (mp->flushTime == 0) {
+        mp->flushTime = now + PERSIST_FLUSH_DELAY;
+    } else if (now >= mp->flushTime) {
+        if (persistFlush(&mp->store) != 0) {
+            int errNo = errno;
+            logMsg(LOG_ERR, "%s: failed to write the state journal: %s (%d)\n", __func__, strerror(errNo), errNo);
+        }
+        mp->flushTime = 0;
+    }
+}
+
+// Get the time, in msec, until the pending changes are due
+// to be flushed, or -1 if there are none.
+static int mibPersistTimeout(void)
+{
+    uint64_t now = historyNow();
+
+    if (mibPersist.flushTime == 0) {
+        return -1;
+    }
+
+    return (mibPersist.flushTime > now) ? (int) (mibPersist.flushTime - now) : 0;
+}
+
+static bool pollIntervalMatch(const char *pattern, const char *name)
+{
+    size_t len = strlen(pattern);
+
+    if ((len != 0) && (pattern[len - 1] == '*')) {
+        return (strncmp(pattern, name, (len - 1)) == 0);
+    }
+
+    return (strcmp(pattern, name) == 0);
+}
+
+// Set the poll interval of the read-only values, using the
+// definitions of the object file; the last one that matches
+// the name of a value wins.
+static int schedInit(void)
+{
+    MibSched *sched = &mibSched;
+    size_t numValues = acUnitTbl.tempBase + acUnitTbl.numRows;
+
+    if (numPollIntervalDefs == 0) {
+        return 0;   // nothing to schedule
+    }
+
+    sched->numValues = numValues;
+    sched->interval = calloc((numValues + 1), sizeof (uint32_t));
+    sched->pendingValue = calloc((numValues + 1), sizeof (int));
+    sched->state = calloc((numValues + 1), sizeof (uint8_t));
+    sched->hold = calloc((numValues + 1), sizeof (atomic_bool));
+    sched->deferredSources = calloc((numValues + 1), sizeof (uint32_t));
+    if ((sched->interval == NULL) || (sched->pendingValue == NULL) || (sched->state == NULL) ||
+        (sched->hold == NULL) || (sched->deferredSources == NULL) ||
+        (timerWheelInit(&sched->wheel, numValues, schedNow()) != 0)) {
+        logMsg(LOG_ERR, "%s: failed to alloc the schedule of %zu values!\n", __func__, numValues);
+        return -1;
+    }
+    sched->startTick = sched->wheel.now;
+
+    for (size_t value = 0; value < numValues; value++) {
+        char name[64];
+
+        if (value < acUnitTbl.tempBase) {
+            snprintf(name, sizeof (name), "%s", mibValueObj[value]->varName);
+        } else {
+            snprintf(name, sizeof (name), "%s%lu", acUnitTempPrefix, acUnitTbl.unitIndex[value - acUnitTbl.tempBase]);
+        }
+
+        for (size_t n = 0; n < numPollIntervalDefs; n++) {
+            if (pollIntervalMatch(pollIntervalDefs[n].pattern, name)) {
+                sched->interval[value] = (pollIntervalDefs[n].msec + SCHED_TICK - 1) / SCHED_TICK;
+            }
+        }
+
+        if (sched->interval[value] != 0) {
+            sched->numScheduled++;
+        }
+    }
+
+    logMsg(LOG_INFO, "%s: %zu values have a poll interval\n", __func__, sched->numScheduled);
+
+    // Done with the definitions!
+    for (size_t n = 0; n < numPollIntervalDefs; n++) {
+        free(pollIntervalDefs[n].pattern);
+    }
+    free(pollIntervalDefs);
+    pollIntervalDefs = NULL;
+    numPollIntervalDefs = 0;
+
+    return 0;
+}
+
+// Log a rejected data record, count it, and keep the message
+// as the last error reported by the subagentStats objects.
+static void logRejected(int priority, const char *fmt, ...)
+{
+    char msg[256];
+    size_t len;
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(msg, sizeof (msg), fmt, ap);
+    va_end(ap);
+
+    logMsgLimited(priority, LOG_REJECTED_PER_SEC, "%s", msg);
+    statsInc(STATS_RECORDS_REJECTED);
+
+    if (((len = strlen(msg)) > 0) && (msg[len - 1] == '\n')) {
+        msg[len - 1] = '\0';
+    }
+    statsError(msg);
+}
+
+// A record of the data files, the delta file, or the update
+// socket, decoded: the value it sets, and its new value. The
+// decoding (the lookup of the name, and the parsing of the
+// value) doesn't touch the values, so it can be done by the
+// workers of the data files; only dataRecordApply() must run
+// in the MIB update task.
+typedef struct DataRecord {
+    MibObj *mibObj;         // NULL for the acUnitTemp of a row
+    size_t row;             // row of the acUnitTable
+    int value;              // Integer32 value
+    uint64_t value64;       // value of the other types; index of the OCTET STRING
+    bool deferred;          // not parsed: the object isn't due
+} DataRecord;
+
+// Index of the value of a record in the hashes of a data
+// source: the objects, in mibObjTbl[] order, followed by the rows of the
+// acUnitTable
+static size_t dataRecordSlot(const DataRecord *dataRec)
+{
+    return (dataRec->mibObj != NULL) ? (size_t) (dataRec->mibObj - mibObjTbl) : (mibObjCount + dataRec->row);
+}
+
+// Is the value set by a record refreshed on its own schedule,
+// and not due? Called by the workers of the data files.
+static bool dataRecordHeld(const DataRecord *dataRec)
+{
+    size_t value;
+
+    if (mibSched.numScheduled == 0) {
+        return false;
+    } else if (dataRec->mibObj == NULL) {
+        value = acUnitTbl.tempBase + dataRec->row;
+    } else if (dataRec->mibObj->column == MIB_COLUMN_INT32) {
+        value = dataRec->mibObj->varValue - mibValueTbl;
+    } else {
+        return false;
+    }
+
+    return (value < mibSched.numValues) && atomic_load_explicit(&mibSched.hold[value], memory_order_relaxed);
+}
+
+// Find the value set by a "<name><sep><value>" record.
+// Returns the start of the value text, or NULL if the record
+// is rejected.
+static const char *dataRecordFind(const char *rec, const char *eol, char sep, DataRecord *dataRec)
+{
+    const char *comma = memchr(rec, sep, (eol - rec));
+
+    if (comma == NULL) {
+        logRejected(LOG_WARNING, "%s: Invalid data record \"%.*s\" !\n", __func__, (int) (eol - rec), rec);
+        return NULL;
+    }
+
+    dataRec->mibObj = NULL;
+    dataRec->row = 0;
+
+    // Rows of the acUnitTable are updated using
+    // records of the form "acUnitTemp.<unit>,<value>"
+    if (((comma - rec) > acUnitTempPrefixLen) && (memcmp(rec, acUnitTempPrefix, acUnitTempPrefixLen) == 0)) {
+        const char *unit = rec + acUnitTempPrefixLen;
+        oid unitIndex = 0;
+        ssize_t row;
+
+        for (const char *p = unit; p < comma; p++) {
+            if ((unsigned) (*p - '0') > 9) {
+                unitIndex = 0;  // invalid
+                break;
+            }
+            unitIndex = (unitIndex * 10) + (*p - '0');
+        }
+
+        if ((unitIndex == 0) || ((row = acUnitRowFind(unitIndex)) < 0)) {
+            logRejected(LOG_WARNING, "%s: Unsupported A/C unit \"%.*s\" !\n", __func__, (int) (comma - unit), unit);
+            return NULL;
+        }
+
+        dataRec->row = row;
+        return (comma + 1);
+    }
+
+    if ((dataRec->mibObj = mibObjLookup(rec, (comma - rec))) == NULL) {
+        logRejected(LOG_WARNING, "%s: Unsupported MIB object \"%.*s\" !\n", __func__, (int) (comma - rec), rec);
+        return NULL;
+    }
+
+    // Make sure it is a read-only object
+    if (!dataRec->mibObj->readOnly) {
+        logRejected(LOG_ERR, "%s: MIB object \"%s\" is not read-only !\n", __func__, dataRec->mibObj->varName);
+        return NULL;
+    }
+
+    return (comma + 1);
+}
+
+// Parse the value text of a record, according to the type of
+// the value it sets. An OCTET STRING is copied to str, and its
+// index is left for the caller to set. Returns false if the
+// value is rejected.
+static bool dataRecordParse(DataRecord *dataRec, const char *val, const char *eol, MibString *str)
+{
+    MibColumn column = (dataRec->mibObj != NULL) ? dataRec->mibObj->column : MIB_COLUMN_INT32;
+    bool valid = false;
+
+    switch (column) {
+    case MIB_COLUMN_INT32:
+        valid = parseInt(val, eol, &dataRec->value);
+        break;
+    case MIB_COLUMN_UINT32:
+        valid = parseUint(val, eol, UINT32_MAX, &dataRec->value64);
+        break;
+    case MIB_COLUMN_UINT64:
+        valid = parseUint(val, eol, UINT64_MAX, &dataRec->value64);
+        break;
+    case MIB_COLUMN_STRING:
+        // The string is the rest of the line, as is
+        if ((eol > val) && (eol[-1] == '\r')) {
+            eol--;
+        }
+        if ((valid = ((eol - val) <= (ssize_t) sizeof (str->text)))) {
+            str->len = eol - val;
+            memcpy(str->text, val, str->len);
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (!valid && (dataRec->mibObj != NULL)) {
+        logRejected(LOG_WARNING, "%s: Invalid value \"%.*s\" for MIB object \"%s\" !\n", __func__, (int) (eol - val), val, dataRec->mibObj->varName);
+    } else if (!valid) {
+        logRejected(LOG_WARNING, "%s: Invalid value \"%.*s\" for A/C unit %lu !\n", __func__, (int) (eol - val), val, acUnitTbl.unitIndex[dataRec->row]);
+    }
+
+    return valid;
+}
+
+// Update the value of a read-only object stored in one of
+// the typed columns
+static void setTypedValue(const MibObj *mibObj, uint64_t val, const MibString *str)
+{
+    MibTypedColumn *col = &mibTypedColumns[mibObj->column];
+    unsigned column = MIB_STORE_COLUMN(mibObj->column);
+    void *work = valueStoreWork(&mibValueStore, column);
+    uint32_t *value32;
+    uint64_t *value64;
+    MibString *value;
+
+    switch (mibObj->column) {
+    case MIB_COLUMN_UINT32:
+        value32 = (uint32_t *) work + mibObj->valueIndex;
+        if (val != *value32) {
+            *value32 = val;
+            valueStoreMarkColumn(&mibValueStore, column, mibObj->valueIndex);
+            col->dirty = true;
+        }
+        break;
+
+    case MIB_COLUMN_UINT64:
+        value64 = (uint64_t *) work + mibObj->valueIndex;
+        if (val != *value64) {
+            *value64 = val;
+            valueStoreMarkColumn(&mibValueStore, column, mibObj->valueIndex);
+            col->dirty = true;
+        }
+        break;
+
+    case MIB_COLUMN_STRING:
+        value = (MibString *) work + mibObj->valueIndex;
+        if ((value->len != str->len) || (memcmp(value->text, str->text, str->len) != 0)) {
+            *value = *str;
+            valueStoreMarkColumn(&mibValueStore, column, mibObj->valueIndex);
+            col->dirty = true;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+// Apply a decoded record; strings holds the OCTET STRING
+// values of its batch.
+static void dataRecordApply(const DataRecord *dataRec, const MibString *strings)
+{
+    MibObj *mibObj = dataRec->mibObj;
+
+    if (mibObj == NULL) {
+        setAcUnitTemp(dataRec->row, dataRec->value);
+    } else if (mibObj->column == MIB_COLUMN_INT32) {
+        setReadOnlyValue(mibObj, dataRec->value);
+    } else {
+        setTypedValue(mibObj, dataRec->value64, ((mibObj->column == MIB_COLUMN_STRING) ? &strings[dataRec->value64] : NULL));
+    }
+}
+
+// Process one "<name><sep><value>" record of the delta file,
+// or of the update socket. A value set this way makes the
+// workers of the data files apply the line that sets it again
+// the next time they read it.
+static void setDataValue(const char *rec, const char *eol, char sep)
+{
+    DataRecord dataRec;
+    MibString str;
+    const char *val;
+
+    if (((val = dataRecordFind(rec, eol, sep, &dataRec)) == NULL) || !dataRecordParse(&dataRec, val, eol, &str)) {
+        return;
+    }
+
+    if ((dataRec.mibObj != NULL) && (dataRec.mibObj->column == MIB_COLUMN_STRING)) {
+        dataRec.value64 = 0;    // index of str
+    }
+    dataRecordApply(&dataRec, &str);
+}
+
+// Parse a batch of updates received on the update socket.
+// Each line has the form "<name>=<value>".
+static unsigned long mibUpdateSocketMsgs;
+static size_t mibUpdateSocketTruncated;
+
+static void updateMsgLine(void *arg, const char *line, const char *eol)
+{
+    setDataValue(line, ((eol[-1] == '\r') ? (eol - 1) : eol), '=');
+}
+
+static void parseUpdateMsg(const char *buf, size_t len)
+{
+    parseLines(buf, len, updateMsgLine, NULL);
+
+    mibUpdateSocketMsgs++;
+    statsInc(STATS_SOCKET_MSGS);
+}
+
+// The delta file is an append-only log of the values that
+// changed, written by producers that don't want to rewrite
+// the whole data file. Each line has the form:
+//
+//   <seq>,<name>,<value>
+//
+// where <seq> is a sequence number that increases by one
+// with each record. Records are processed at most once,
+// and only the bytes appended since the previous pass are
+// parsed, so the cost of a pass is proportional to the
+// number of changes.
+typedef struct DeltaFileState {
+    dev_t dev;
+    ino_t ino;
+    off_t offset;               // offset of the first unprocessed record
+    unsigned long lastSeq;      // seq number of the last record processed
+} DeltaFileState;
+
+static DeltaFileState deltaFileState;
+
+static size_t parseDeltaBuf(const char *buf, size_t len, void *arg)
+{
+    DeltaFileState *state = arg;
+    const char *end = buf + len;
+    const char *line = buf;
+    unsigned long numRecords = 0;
+
+    while (line < end) {
+        const char *eol = memchr(line, '\n', (end - line));
+        const char *rec;
+        unsigned long seq = 0;
+
+        if (eol == NULL) {
+            break;      // partial record: wait until it is complete
+        }
+
+        if ((line != eol) && (*line != '#') && (*line != '\r')) {
+            numRecords++;
+            for (rec = line; (rec < eol) && ((unsigned) (*rec - '0') <= 9); rec++) {
+                seq = (seq * 10) + (*rec - '0');
+            }
+
+            if ((rec == line) || (rec == eol) || (*rec != ',')) {
+                logRejected(LOG_WARNING, "%s: Invalid delta record \"%.*s\" !\n", __func__, (int) (eol - line), line);
+            } else if (seq > state->lastSeq) {
+                if ((state->lastSeq != 0) && (seq != (state->lastSeq + 1))) {
+                    logMsg(LOG_WARNING, "%s: Missing delta records: lastSeq=%lu seq=%lu\n", __func__, state->lastSeq, seq);
+                }
+                setDataValue((rec + 1), eol, ',');
+                state->lastSeq = seq;
+            }
+        }
+
+        line = eol + 1;
+    }
+
+    statsAdd(STATS_DATA_RECORDS, numRecords);
+
+    return (line - buf);
+}
+
+// A producer that truncates the data file while it is being
+// parsed causes a SIGBUS when the mapped pages beyond the new
+// EOF are accessed. The handler jumps back to parseFile(),
+// which abandons the pass.
+static __thread sigjmp_buf *sigBusJmpBuf;
+
+static void sigBusHandler(int sig)
+{
+    if (sigBusJmpBuf != NULL) {
+        siglongjmp(*sigBusJmpBuf, 1);
+    }
+
+    // Not ours: restore the default action and
+    // let it kill the process.
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+// Map the file contents from the given offset to EOF, and
+// run the parser on it. Returns the number of bytes consumed
+// by the parser, or -1 on error.
+static ssize_t parseFile(int fd, off_t offset, off_t fileSize, const char *fileName,
+                         size_t (*parser)(const char *buf, size_t len, void *arg), void *arg)
+{
+    off_t mapOffset = offset & ~((off_t) sysconf(_SC_PAGESIZE) - 1);
+    size_t mapLen = fileSize - mapOffset;
+    char *mapData;
+    sigjmp_buf jmpBuf;
+    ssize_t consumed = -1;
+
+    // The mapping stays valid after the file
+    // descriptor is closed.
+    if ((mapData = mmap(NULL, mapLen, PROT_READ, MAP_PRIVATE, fd, mapOffset)) == MAP_FAILED) {
+        int errNo = errno;
+        logMsg(LOG_WARNING, "%s: failed to map file \"%s\": %s (%d)\n", __func__, fileName, strerror(errNo), errNo);
+        return -1;
+    }
+    madvise(mapData, mapLen, MADV_SEQUENTIAL);
+
+    if (sigsetjmp(jmpBuf, 1) == 0) {
+        sigBusJmpBuf = &jmpBuf;
+        consumed = parser((mapData + (offset - mapOffset)), (fileSize - offset), arg);
+    } else {
+        logMsg(LOG_WARNING, "%s: file \"%s\" was truncated while being parsed !\n", __func__, fileName);
+    }
+    sigBusJmpBuf = NULL;
+
+    munmap(mapData, mapLen);
+
+    return consumed;
+}
+
+// Identity and version of the data file read by the last
+// pass; used to skip passes when the file hasn't changed.
+typedef struct FileFingerprint {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+} FileFingerprint;
+
+// Each data file is a separate data source, parsed by its own
+// worker thread into a private batch of decoded records, so
+// that the files are parsed in parallel, and a slow, or
+// missing, file doesn't delay the others. The MIB update task
+// only merges the batches that are ready: it takes each one
+// with a pointer swap, and applies its records, which were
+// already looked up and parsed, in one short commit per pass.
+#define DATA_BATCH_MIN_RECORDS  256
+
+typedef struct DataBatch {
+    DataRecord *records;
+    size_t numRecords;
+    size_t maxRecords;
+    MibString *strings;         // values of the OCTET STRING records
+    size_t numStrings;
+    size_t maxStrings;
+} DataBatch;
+
+// What the worker last read for each value: the hash of the
+// value text
+typedef struct DataSourceHash {
+    uint64_t rawHash;
+} DataSourceHash;
+
+typedef struct DataSource {
+    const char *path;
+    unsigned index;
+    unsigned bit;               // bit of the file in the mask of changes
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool requested;             // the file changed; protected by lock
+    bool reread;                // read the file even if it didn't change; protected by lock
+    bool stop;                  // protected by lock
+    DataBatch *ready;           // batch to merge; protected by lock
+    DataBatch *work;            // owned by the worker
+    DataBatch *merge;           // owned by the MIB update task
+    DataBatch batches[3];
+    FileFingerprint fingerprint;    // owned by the worker
+    DataSourceHash *hashes;     // owned by the worker; see dataRecordSlot()
+} DataSource;
+
+static DataSource mibDataSources[MAX_DATA_FILES];
+static size_t mibNumDataSources;
+
+// Bits of the data sources that have a batch ready
+static atomic_uint mibDataSourcesReady;
+
+// Grow an array by powers of 2, to hold at least numItems
+// items. Returns -1 on error.
+static int growArray(void **items, size_t *maxItems, size_t numItems, size_t itemSize)
+{
+    size_t max = (*maxItems != 0) ? *maxItems : DATA_BATCH_MIN_RECORDS;
+    void *newItems;
+
+    if (numItems <= *maxItems) {
+        return 0;
+    }
+
+    while (max < numItems) {
+        max *= 2;
+    }
+
+    if ((newItems = realloc(*items, (max * itemSize))) == NULL) {
+        return -1;
+    }
+
+    *items = newItems;
+    *maxItems = max;
+
+    return 0;
+}
+
+// Make room in the batch for the specified number of
+// records and strings
+static int dataBatchReserve(DataBatch *batch, size_t numRecords, size_t numStrings)
+{
+    if ((growArray((void **) &batch->records, &batch->maxRecords, (batch->numRecords + numRecords), sizeof (DataRecord)) != 0) ||
+        (growArray((void **) &batch->strings, &batch->maxStrings, (batch->numStrings + numStrings), sizeof (MibString)) != 0)) {
+        logMsg(LOG_ERR, "%s: failed to alloc %zu records!\n", __func__, (batch->numRecords + numRecords));
+        return -1;
+    }
+
+    return 0;
+}
+
+// Add the records of a batch to the end of another one
+static int dataBatchAppend(DataBatch *batch, const DataBatch *from)
+{
+    if (dataBatchReserve(batch, from->numRecords, from->numStrings) != 0) {
+        return -1;
+    }
+
+    for (size_t n = 0; n < from->numRecords; n++) {
+        DataRecord *dataRec = &batch->records[batch->numRecords++];
+
+        *dataRec = from->records[n];
+        if ((dataRec->mibObj != NULL) && (dataRec->mibObj->column == MIB_COLUMN_STRING)) {
+            dataRec->value64 += batch->numStrings;
+        }
+    }
+
+    memcpy(&batch->strings[batch->numStrings], from->strings, (from->numStrings * sizeof (MibString)));
+    batch->numStrings += from->numStrings;
+
+    return 0;
+}
+
+// Decode one "<name>,<value>" record of a data file into the
+// worker's batch. The record is skipped if the value text is
+// the same as the last time the worker read it, so that an
+// unchanged line costs only a hash. This also keeps a newer
+// value, set from the delta file or the update socket, from
+// being reverted to the (unchanged) value of the line when
+// the file is parsed again because of a change elsewhere.
+static void dataSourceRecord(void *arg, const char *line, const char *eol)
+{
+    DataSource *src = arg;
+    DataBatch *batch = src->work;
+    DataRecord *dataRec;
+    DataSourceHash *hash;
+    const char *val;
+    uint64_t rawHash;
+
+    if (dataBatchReserve(batch, 1, 1) != 0) {
+        return;
+    }
+
+    dataRec = &batch->records[batch->numRecords];
+    if ((val = dataRecordFind(line, eol, ',', dataRec)) == NULL) {
+        return;
+    }
+
+    hash = &src->hashes[dataRecordSlot(dataRec)];
+    rawHash = hashText(val, (eol - val));
+    if (rawHash == hash->rawHash) {
+        return;     // unchanged
+    }
+
+    // Is the object refreshed on its own schedule, and not due?
+    // Then only report that the line changed; it's read again,
+    // and parsed, when the object is due.
+    dataRec->deferred = dataRecordHeld(dataRec);
+    if (dataRec->deferred) {
+        statsInc(STATS_SCHED_DEFERRED);
+        batch->numRecords++;
+        return;
+    }
+
+    if (!dataRecordParse(dataRec, val, eol, &batch->strings[batch->numStrings])) {
+        return;
+    }
+
+    if ((dataRec->mibObj != NULL) && (dataRec->mibObj->column == MIB_COLUMN_STRING)) {
+        dataRec->value64 = batch->numStrings++;
+    }
+    batch->numRecords++;
+
+    hash->rawHash = rawHash;
+}
+
+// Parse the contents of a data file. Each line has the form
+// "<name>,<value>"; lines that start with a '#' are comments
+// and are skipped. The buffer is parsed in place.
+static size_t parseDataBuf(const char *buf, size_t len, void *arg)
+{
+    statsAdd(STATS_DATA_RECORDS, parseLines(buf, len, dataSourceRecord, arg));
+
+    return len;
+}
+
+// Read the latest MIB object values from the data file of
+// the source, into the worker's batch
+static int procDataFile(DataSource *src)
+{
+    int fd;
+    struct stat fileStat;
+    FileFingerprint fingerprint = { 0 };
+    ssize_t s = 0;
+
+    // Open the dataFile in read-only mode
+    if ((fd = open(src->path, (O_RDONLY | O_CLOEXEC))) == -1) {
+        logMsg(LOG_WARNING, "%s: failed to open data file \"%s\"\n", __func__, src->path);
+        return -1;
+    }
+
+    if (fstat(fd, &fileStat) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    // Skip the pass if the file hasn't changed
+    // since the last time it was read.
+    fingerprint.dev = fileStat.st_dev;
+    fingerprint.ino = fileStat.st_ino;
+    fingerprint.size = fileStat.st_size;
+    fingerprint.mtime = fileStat.st_mtim;
+    if (memcmp(&fingerprint, &src->fingerprint, sizeof (fingerprint)) == 0) {
+        close(fd);
+        return 0;
+    }
+
+    if (fileStat.st_size != 0) {
+        struct timespec startTime, endTime;
+
+        clock_gettime(CLOCK_MONOTONIC, &startTime);
+        s = parseFile(fd, 0, fileStat.st_size, src->path, parseDataBuf, src);
+        clock_gettime(CLOCK_MONOTONIC, &endTime);
+
+        statsInc(STATS_DATA_PASSES);
+        statsRecord(STATS_PARSE_TIME, statsUsec(&startTime, &endTime));
+    }
+
+    // Done with the dataFile!
+    close(fd);
+
+    if (s < 0) {
+        return -1;
+    }
+
+    src->fingerprint = fingerprint;
+
+    return 0;
+}
+
+// Hand the worker's batch over to the MIB update task. If the
+// previous batch hasn't been merged yet, the new records are
+// added to it, so the newer values still win.
+static void dataSourcePost(DataSource *src)
+{
+    const uint64_t one = 1;
+    DataBatch *batch;
+
+    pthread_mutex_lock(&src->lock);
+    if (src->ready->numRecords == 0) {
+        batch = src->ready;
+        src->ready = src->work;
+        src->work = batch;
+    } else if (dataBatchAppend(src->ready, src->work) != 0) {
+        // The values of the records are dropped; read
+        // their lines again next time.
+        memset(&src->fingerprint, 0, sizeof (src->fingerprint));
+        memset(src->hashes, 0, ((mibObjCount + acUnitTbl.numRows) * sizeof (DataSourceHash)));
+    }
+    pthread_mutex_unlock(&src->lock);
+
+    src->work->numRecords = 0;
+    src->work->numStrings = 0;
+
+    atomic_fetch_or(&mibDataSourcesReady, (1u << src->index));
+
+    if (write(mibUpdateWakeFd, &one, sizeof (one)) != sizeof (one)) {
+        logMsg(LOG_WARNING, "%s: failed to wake up the MIB update task\n", __func__);
+    }
+}
+
+// The worker of a data source: parses the data file each time
+// the MIB update task reports it changed
+static void *dataSourceTask(void *arg)
+{
+    DataSource *src = arg;
+
+    while (true) {
+        pthread_mutex_lock(&src->lock);
+        while (!src->requested && !src->stop) {
+            pthread_cond_wait(&src->cond, &src->lock);
+        }
+        if (src->stop) {
+            pthread_mutex_unlock(&src->lock);
+            break;
+        }
+        if (src->reread) {
+            // Read the lines of the objects that are due
+            memset(&src->fingerprint, 0, sizeof (src->fingerprint));
+        }
+        src->requested = false;
+        src->reread = false;
+        pthread_mutex_unlock(&src->lock);
+
+        procDataFile(src);
+
+        if (src->work->numRecords != 0) {
+            dataSourcePost(src);
+        }
+    }
+
+    return NULL;
+}
+
+// Have the worker of the data source read its file. The
+// requests made while it is busy are coalesced into one.
+static void dataSourceRequest(DataSource *src)
+{
+    pthread_mutex_lock(&src->lock);
+    src->requested = true;
+    pthread_cond_signal(&src->cond);
+    pthread_mutex_unlock(&src->lock);
+}
+
+// Have the workers of the data sources read their files
+// again, to parse the lines they skipped
+static void dataSourcesReread(unsigned sources)
+{
+    for (size_t n = 0; (sources != 0) && (n < mibNumDataSources); n++) {
+        DataSource *src = &mibDataSources[n];
+
+        if (sources & (1u << n)) {
+            pthread_mutex_lock(&src->lock);
+            src->requested = true;
+            src->reread = true;
+            pthread_cond_signal(&src->cond);
+            pthread_mutex_unlock(&src->lock);
+        }
+    }
+}
+
+// Apply the batches of the data sources that are ready
+static void dataSourcesMerge(void)
+{
+    unsigned ready = atomic_exchange(&mibDataSourcesReady, 0);
+
+    for (size_t n = 0; (ready != 0) && (n < mibNumDataSources); n++) {
+        DataSource *src = &mibDataSources[n];
+        DataBatch *batch;
+
+        if ((ready & (1u << n)) == 0) {
+            continue;
+        }
+
+        pthread_mutex_lock(&src->lock);
+        batch = src->ready;
+        src->ready = src->merge;
+        src->merge = batch;
+        pthread_mutex_unlock(&src->lock);
+
+        for (size_t r = 0; r < batch->numRecords; r++) {
+            DataRecord *dataRec = &batch->records[r];
+
+            if (!dataRec->deferred) {
+                dataRecordApply(dataRec, batch->strings);
+            } else if (dataRec->mibObj == NULL) {
+                schedDefer((acUnitTbl.tempBase + dataRec->row), n);
+            } else {
+                schedDefer((dataRec->mibObj->varValue - mibValueTbl), n);
+            }
+        }
+
+        batch->numRecords = 0;
+        batch->numStrings = 0;
+    }
+}
+
+// Stop the workers of the data files
+static void dataSourcesStop(void)
+{
+    for (size_t n = 0; n < mibNumDataSources; n++) {
+        DataSource *src = &mibDataSources[n];
+
+        pthread_mutex_lock(&src->lock);
+        src->stop = true;
+        pthread_cond_signal(&src->cond);
+        pthread_mutex_unlock(&src->lock);
+
+        pthread_join(src->thread, NULL);
+    }
+}
+
+// Start the workers of the data files
+static int dataSourcesInit(const CmdArgs *cmdArgs)
+{
+    size_t numSlots = mibObjCount + acUnitTbl.numRows;
+
+    for (unsigned n = 0; n < cmdArgs->numDataFiles; n++) {
+        DataSource *src = &mibDataSources[n];
+
+        src->path = cmdArgs->dataFiles[n];
+        src->index = n;
+        src->work = &src->batches[0];
+        src->ready = &src->batches[1];
+        src->merge = &src->batches[2];
+        pthread_mutex_init(&src->lock, NULL);
+        pthread_cond_init(&src->cond, NULL);
+
+        if ((src->hashes = calloc((numSlots + 1), sizeof (DataSourceHash))) == NULL) {
+            logMsg(LOG_ERR, "%s: failed to alloc data source \"%s\"!\n", __func__, src->path);
+            return -1;
+        }
+
+        if (pthread_create(&src->thread, NULL, dataSourceTask, src) != 0) {
+            logMsg(LOG_ERR, "%s: failed to create the worker of data source \"%s\"!\n", __func__, src->path);
+            return -1;
+        }
+
+        mibNumDataSources++;
+    }
+
+    return 0;
+}
+
+// Read the records appended to the delta file since
+// the last pass
+static int procDeltaFile(const char *deltaFile)
+{
+    DeltaFileState *state = &deltaFileState;
+    int fd;
+    struct stat fileStat;
+    ssize_t consumed;
+
+    if ((fd = open(deltaFile, (O_RDONLY | O_CLOEXEC))) == -1) {
+        return -1;  // the producer has not created it yet
+    }
+
+    if (fstat(fd, &fileStat) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    // Start over if the file was replaced or truncated
+    if ((fileStat.st_dev != state->dev) || (fileStat.st_ino != state->ino) || (fileStat.st_size < state->offset)) {
+        logMsg(LOG_INFO, "%s: Reading new delta file \"%s\"\n", __func__, deltaFile);
+        state->dev = fileStat.st_dev;
+        state->ino = fileStat.st_ino;
+        state->offset = 0;
+        state->lastSeq = 0;
+    }
+
+    if (fileStat.st_size == state->offset) {
+        close(fd);
+        return 0;   // nothing new
+    }
+
+    consumed = parseFile(fd, state->offset, fileStat.st_size, deltaFile, parseDeltaBuf, state);
+
+    close(fd);
+
+    if (consumed < 0) {
+        return -1;
+    }
+
+    state->offset += consumed;
+
+    return 0;
+}
+
+static const __syscall_slong_t oneBillion = 1000000000; // 10^9
+
+// Normalize a timespec value
+static __inline__ void tvNorm(struct timespec *t)
+{
+    if (t->tv_nsec >= oneBillion) {
+        t->tv_sec += (t->tv_nsec / oneBillion);
+        t->tv_nsec = (t->tv_nsec % oneBillion);
+    }
+}
+
+// Subtract two timespec values: result = x - y
+static void tvSub(struct timespec *result, const struct timespec *x, const struct timespec *y)
+{
+    struct timespec X = *x;
+    struct timespec Y = *y;
+
+    tvNorm(&X);
+    tvNorm(&Y);
+
+    if (X.tv_nsec < Y.tv_nsec) {
+        X.tv_sec -= 1;
+        X.tv_nsec += oneBillion;
+    }
+    result->tv_sec = X.tv_sec - Y.tv_sec;
+    result->tv_nsec = X.tv_nsec - Y.tv_nsec;
+}
+
+// Compare two timespec values
+static int tvCmp(const struct timespec *x, const struct timespec *y)
+{
+    struct timespec X = *x;
+    struct timespec Y = *y;
+
+    tvNorm(&X);
+    tvNorm(&Y);
+
+    if (x->tv_sec > y->tv_sec) {
+        return 1;
+    } else if (x->tv_sec < y->tv_sec) {
+        return -1;
+    } else if (x->tv_nsec > y->tv_nsec) {
+        return 1;
+    } else if (x->tv_nsec < y->tv_nsec) {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+// High-rate producers can update the values of the read-only
+// objects through a shared memory ring, instead of the data
+// file. The objectId of a record is the index of the value in
+// the mibValueStore; the producers get it from the directory
+// stored in the ring, using the names of the data file.
+#define SHM_RING_RECORDS    65536
+
+static ShmRing *mibShmRing;
+static int mibShmRingFd = -1;
+static unsigned long mibShmRingBadIds;
+
+// Apply a record drained from the shared memory ring
+static void setShmRingValue(uint32_t objectId, int32_t value, uint64_t timestamp)
+{
+    // The values of the read-only scalar objects are followed
+    // by the acUnitTemp column of the acUnitTable
+    if (objectId >= (acUnitTbl.tempBase + acUnitTbl.numRows)) {
+        mibShmRingBadIds++;
+    } else if (schedStage(objectId, value)) {
+        return;     // refreshed on its own schedule
+    } else if (mibValueTbl[objectId] != value) {
+        mibValueSet(objectId, value);
+    }
+}
+
+static int shmRingInit(const char *shmName)
+{
+    size_t numObjects = mibValueCount + acUnitTbl.numRows;
+    uint32_t n = 0;
+
+    if ((mibShmRing = shmRingCreate(shmName, SHM_RING_RECORDS, numObjects)) == NULL) {
+        int errNo = errno;
+        logMsg(LOG_ERR, "%s: failed to create shm ring \"%s\": %s (%d)\n", __func__, shmName, strerror(errNo), errNo);
+        return -1;
+    }
+
+    for (size_t value = 0; value < mibValueCount; value++) {
+        shmRingSetObject(mibShmRing, n++, mibValueObj[value]->varName, value);
+    }
+    for (size_t row = 0; row < acUnitTbl.numRows; row++) {
+        char name[SHM_RING_NAME_LEN];
+        snprintf(name, sizeof (name), "%s%lu", acUnitTempPrefix, acUnitTbl.unitIndex[row]);
+        shmRingSetObject(mibShmRing, n++, name, (acUnitTbl.tempBase + row));
+    }
+
+    if ((mibShmRingFd = shmRingStart(mibShmRing)) == -1) {
+        logMsg(LOG_ERR, "%s: failed to start shm ring \"%s\"!\n", __func__, shmName);
+        return -1;
+    }
+
+    logMsg(LOG_INFO, "%s: Created shm ring \"%s\" with %u objects\n", __func__, shmName, n);
+
+    return 0;
+}
+
+// The data files are watched using inotify, so that they are
+// only processed when they actually change. The watch is set on
+// the directory containing each file, rather than on the file
+// itself, so that producers that atomically replace the file
+// (i.e. write a temp file and rename it) are also detected.
+#define MAX_WATCHED_FILES   24
+
+typedef struct WatchedFile {
+    int wd;                 // watch descriptor of the file's directory
+    const char *fileName;   // file name, without the directory
+} WatchedFile;
+
+typedef struct DataFileWatch {
+    int inotifyFd;          // -1 means inotify is not available
+    int numFiles;
+    WatchedFile files[MAX_WATCHED_FILES];
+} DataFileWatch;
+
+static int dataFileWatchInit(DataFileWatch *watch)
+{
+    watch->numFiles = 0;
+
+    if ((watch->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1) {
+        int errNo = errno;
+        logMsg(LOG_WARNING, "%s: inotify_init1() failed: %s (%d)\n", __func__, strerror(errNo), errNo);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Start watching the specified file. Returns the bit
+// that represents the file in the mask returned by
+// dataFileWatchWait().
+static unsigned dataFileWatchAdd(DataFileWatch *watch, const char *filePath)
+{
+    const char *slash = strrchr(filePath, '/');
+    WatchedFile *file = &watch->files[watch->numFiles];
+    char dirName[PATH_MAX];
+
+    if (watch->numFiles == MAX_WATCHED_FILES) {
+        logMsg(LOG_ERR, "%s: too many watched files !\n", __func__);
+        return 0;
+    }
+
+    file->fileName = (slash != NULL) ? (slash + 1) : filePath;
+
+    if (slash == NULL) {
+        strcpy(dirName, ".");
+    } else if (slash == filePath) {
+        strcpy(dirName, "/");
+    } else {
+        snprintf(dirName, sizeof (dirName), "%.*s", (int) (slash - filePath), filePath);
+    }
+
+    if ((watch->inotifyFd != -1) &&
+        ((file->wd = inotify_add_watch(watch->inotifyFd, dirName, (IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE))) == -1)) {
+        int errNo = errno;
+        logMsg(LOG_WARNING, "%s: failed to watch directory \"%s\": %s (%d)\n", __func__, dirName, strerror(errNo), errNo);
+        close(watch->inotifyFd);
+        watch->inotifyFd = -1;
+    }
+
+    return (1u << watch->numFiles++);
+}
+
+// Bits set in the mask of changes when the shm ring has
+// records to drain, and when datagrams are pending on the
+// update socket
+#define SHM_RING_BIT        (1u << 31)
+#define UPDATE_SOCKET_BIT   (1u << 30)
+
+static int mibUpdateSocketFd = -1;
+
+// The sources of updates, polled by the MIB update task or,
+// in the event loop mode, by the caller's event loop
+enum {
+    UPDATE_FD_WAKE,
+    UPDATE_FD_INOTIFY,
+    UPDATE_FD_SHM_RING,
+    UPDATE_FD_SOCKET,
+    UPDATE_FD_SNMPD_CTL,
+    UPDATE_FD_TIMER,        // event loop mode only
+    UPDATE_FD_SCHED,        // event loop mode only
+    NUM_UPDATE_FDS
+};
+
+static const CmdArgs *mibCmdArgs;
+static DataFileWatch mibWatch;
+static unsigned deltaFileBit;
+static unsigned mibUpdateChanged = ~0u;     // always do an initial pass
+static const struct timespec pollTime = { .tv_sec = 1, .tv_nsec = 0 };
+
+// In the event loop mode, when inotify is not available,
+// this timer sets the period at which the data files are
+// polled.
+static int mibUpdateTimerFd = -1;
+
+// In the event loop mode, this one-shot timer expires when
+// the next object with a poll interval, or the next history
+// sample, is due
+static int mibSchedTimerFd = -1;
+
+static int mibUpdateFd(int n)
+{
+    switch (n) {
+    case UPDATE_FD_WAKE:
+        return mibUpdateWakeFd;
+    case UPDATE_FD_INOTIFY:
+        return mibWatch.inotifyFd;
+    case UPDATE_FD_SHM_RING:
+        return mibShmRingFd;
+    case UPDATE_FD_SOCKET:
+        return mibUpdateSocketFd;
+    case UPDATE_FD_SNMPD_CTL:
+        return snmpdCtl.epollFd;
+    case UPDATE_FD_TIMER:
+        return mibUpdateTimerFd;
+    case UPDATE_FD_SCHED:
+        return mibSchedTimerFd;
+    default:
+        return -1;
+    }
+}
+
+// Drain all the pending inotify events, so that a burst of
+// writes results in a single pass over each file. Returns
+// the mask of the files that changed.
+static unsigned dataFileWatchRead(const DataFileWatch *watch)
+{
+    unsigned changed = 0;
+
+    while (true) {
+        char evBuf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+        ssize_t len = read(watch->inotifyFd, evBuf, sizeof (evBuf));
+
+        if (len <= 0) {
+            break;
+        }
+
+        for (char *p = evBuf; p < (evBuf + len); ) {
+            const struct inotify_event *event = (const struct inotify_event *) p;
+            for (int n = 0; (event->len != 0) && (n < watch->numFiles); n++) {
+                if ((event->wd == watch->files[n].wd) && (strcmp(event->name, watch->files[n].fileName) == 0)) {
+                    changed |= (1u << n);
+                }
+            }
+            p += sizeof (struct inotify_event) + event->len;
+        }
+    }
+
+    return changed;
+}
+
+// Handle the readiness of one of the sources of updates.
+// Returns the mask of the changes to process.
+static unsigned mibUpdateFdRead(int n)
+{
+    uint64_t count;
+
+    switch (n) {
+    case UPDATE_FD_WAKE:
+        if (read(mibUpdateWakeFd, &count, sizeof (count)) < 0) {
+            logMsg(LOG_WARNING, "%s: failed to read wake up event\n", __func__);
+        }
+        return 0;
+    case UPDATE_FD_INOTIFY:
+        return dataFileWatchRead(&mibWatch);
+    case UPDATE_FD_SHM_RING:
+        return SHM_RING_BIT;
+    case UPDATE_FD_SOCKET:
+        return UPDATE_SOCKET_BIT;
+    case UPDATE_FD_SNMPD_CTL:
+        return 0;   // the command is reaped by every pass
+    case UPDATE_FD_TIMER:
+        if (read(mibUpdateTimerFd, &count, sizeof (count)) < 0) {
+            return 0;
+        }
+        return ~0u;     // poll all the data files
+    case UPDATE_FD_SCHED:
+        if (read(mibSchedTimerFd, &count, sizeof (count)) < 0) {
+            logMsg(LOG_WARNING, "%s: failed to read the schedule timer\n", __func__);
+        }
+        return 0;       // the due objects are refreshed by every pass
+    default:
+        return 0;
+    }
+}
+
+// Wait up to timeout msec for any of the watched files to
+// change, for the shm ring or the update socket to have
+// updates, or for the task to be woken up. Returns the mask
+// of the changes. If inotify is not available, it reports
+// all the files as changed when the timeout expires.
+static unsigned dataFileWatchWait(int timeout)
+{
+    // poll() ignores the negative file descriptors
+    struct pollfd pollFds[UPDATE_FD_TIMER];
+    unsigned changed = 0;
+    int n;
+
+    for (n = 0; n < UPDATE_FD_TIMER; n++) {
+        pollFds[n].fd = mibUpdateFd(n);
+        pollFds[n].events = POLLIN;
+        pollFds[n].revents = 0;
+    }
+
+    if (poll(pollFds, UPDATE_FD_TIMER, timeout) == 0) {
+        return (mibWatch.inotifyFd == -1) ? ~0u : 0;
+    }
+
+    for (n = 0; n < UPDATE_FD_TIMER; n++) {
+        if (pollFds[n].revents & POLLIN) {
+            changed |= mibUpdateFdRead(n);
+        }
+    }
+
+    return changed;
+}
+
+static void mibUpdateInit(const CmdArgs *cmdArgs)
+{
+    mibCmdArgs = cmdArgs;
+
+    dataFileWatchInit(&mibWatch);
+    for (size_t n = 0; n < mibNumDataSources; n++) {
+        mibDataSources[n].bit = dataFileWatchAdd(&mibWatch, mibDataSources[n].path);
+    }
+    if (cmdArgs->deltaFile != NULL) {
+        deltaFileBit = dataFileWatchAdd(&mibWatch, cmdArgs->deltaFile);
+    }
+
+    // If inotify is not available fall back to
+    // polling the data files.
+    if (mibWatch.inotifyFd == -1) {
+        logMsg(LOG_WARNING, "%s: Polling the data files every %ld sec\n", __func__, pollTime.tv_sec);
+
+        if (cmdArgs->eventLoop) {
+            struct itimerspec timerSpec = { .it_interval = pollTime, .it_value = pollTime };
+            if (((mibUpdateTimerFd = timerfd_create(CLOCK_MONOTONIC, (TFD_NONBLOCK | TFD_CLOEXEC))) == -1) ||
+                (timerfd_settime(mibUpdateTimerFd, 0, &timerSpec, NULL) != 0)) {
+                logMsg(LOG_ERR, "%s: failed to create the poll timer!\n", __func__);
+            }
+        }
+    }
+
+    if (cmdArgs->eventLoop && ((mibSched.numScheduled != 0) || (mibHistory.numValues != 0) || mibPersist.enabled) &&
+        ((mibSchedTimerFd = timerfd_create(CLOCK_MONOTONIC, (TFD_NONBLOCK | TFD_CLOEXEC))) == -1)) {
+        logMsg(LOG_ERR, "%s: failed to create the schedule timer!\n", __func__);
+    }
+}
+
+// Get the time, in msec, until the next scheduled object,
+// history sample, or journal flush is due, or -1 if there's
+// none.
+static int mibTimerTimeout(void)
+{
+    int timeouts[] = { schedTimeout(), mibHistoryTimeout(), mibPersistTimeout(), snmpdCtlTimeout() };
+    int timeout = -1;
+
+    for (size_t n = 0; n < (sizeof (timeouts) / sizeof (timeouts[0])); n++) {
+        if ((timeout == -1) || ((timeouts[n] != -1) && (timeouts[n] < timeout))) {
+            timeout = timeouts[n];
+        }
+    }
+
+    return timeout;
+}
+
+// Process all the changes in one pass of the MIB update work
+static void mibUpdatePass(unsigned changed)
+{
+    const CmdArgs *cmdArgs = mibCmdArgs;
+    struct timespec passTime, publishTime;
+
+    clock_gettime(CLOCK_MONOTONIC, &passTime);
+
+    // Apply the staged values of the objects that are
+    // due; this also brings the schedule up to date for
+    // the values staged in this pass.
+    schedRun();
+
+    // Apply the new values read by the providers
+    if (atomic_exchange(&mibProvidersDirty, false)) {
+        for (MibObj *mibObj = &mibObjTbl[0]; mibObj->varName != NULL; mibObj++) {
+            if ((mibObj->provider != NULL) && atomic_exchange(&mibObj->provider->fresh, false)) {
+                setReadOnlyValue(mibObj, atomic_load(&mibObj->provider->value));
+            }
+        }
+    }
+
+    for (size_t n = 0; n < mibNumDataSources; n++) {
+        DataSource *src = &mibDataSources[n];
+
+        if ((changed & src->bit) == 0) {
+            continue;
+        }
+
+        // Don't bother formatting the time
+        // if the message is not logged
+        if (logEnabled(LOG_INFO)) {
+            struct timespec now;
+            struct tm brkDwnTime;
+            char tsBuf[32];     // YYYY-MM-DDTHH:MM:SS
+
+            clock_gettime(CLOCK_REALTIME, &now);
+            strftime(tsBuf, sizeof (tsBuf), "%Y-%m-%d %H:%M:%S", gmtime_r(&now.tv_sec, &brkDwnTime));    // %H means 24-hour time
+
+            logMsg(LOG_INFO, "%s: Updating MIB data from %s at %s ...\n", __func__, src->path, tsBuf);
+        }
+
+        // Have the worker process the data file
+        dataSourceRequest(src);
+    }
+
+    // Apply the data files parsed by the workers
+    dataSourcesMerge();
+
+    if (changed & deltaFileBit) {
+        // Process the new records in the delta file
+        procDeltaFile(cmdArgs->deltaFile);
+    }
+
+    if ((changed & SHM_RING_BIT) && (mibShmRing != NULL)) {
+        // Apply the records added by the shm producers
+        statsAdd(STATS_SHM_RECORDS, shmRingDrain(mibShmRing, setShmRingValue));
+    }
+
+    if ((changed & UPDATE_SOCKET_BIT) && (mibUpdateSocketFd != -1)) {
+        // Apply the batches sent by the collectors
+        if (updateSocketRecv(mibUpdateSocketFd, parseUpdateMsg, &mibUpdateSocketTruncated) < 0) {
+            int errNo = errno;
+            logMsg(LOG_ERR, "%s: failed to read the update socket: %s (%d)\n", __func__, strerror(errNo), errNo);
+        }
+    }
+
+    // Evaluate the alarms of the objects
+    // whose values, or thresholds, changed
+    evalAlarms();
+
+    // Add the current values to their history,
+    // if a sample is due
+    mibHistoryRun();
+
+    // Save the state changes, if they are due
+    mibPersistRun();
+
+    // Make the new values visible to the
+    // AgentX thread
+    if (mibValuesPublish()) {
+        clock_gettime(CLOCK_MONOTONIC, &publishTime);
+        statsInc(STATS_PUBLISHES);
+        statsRecord(STATS_UPDATE_LATENCY, statsUsec(&passTime, &publishTime));
+    }
+
+    // Did the systemctl command exit?
+    if (snmpdCtl.pid != -1) {
+        snmpdCtlCheck();
+    }
+
+    // Was there a config change? It waits for the
+    // running systemctl command, if any.
+    if (snmpdConfigChange && (snmpdCtl.pid == -1)) {
+        procConfigFile(cmdArgs->configFile);
+    }
+}
+
+// This task is used to update the values of the MIB objects; e.g.
+// as when the value is obtained from reading an environmental
+// sensor.
+static void *mibUpdateTask(void *arg)
+{
+    const CmdArgs *cmdArgs = arg;
+    unsigned changed = mibUpdateChanged;
+
+    mibUpdateInit(cmdArgs);
+
+    while (!atomic_load(&mibUpdateStop)) {
+        struct timespec startTime, endTime, deltaTime;
+
+        clock_gettime(CLOCK_REALTIME, &startTime);
+
+        mibUpdatePass(changed);
+
+        clock_gettime(CLOCK_REALTIME, &endTime);
+
+        // Calculate the time we spent processing
+        // all the events in this pass of the work
+        // loop...
+        tvSub(&deltaTime, &endTime, &startTime);
+
+        // Wait for the data files to change. When
+        // inotify is available, the poll period is
+        // only used to check for config changes;
+        // otherwise it is the period at which the
+        // data files are polled. If deltaTime is
+        // greater or equal to pollTime, there's no
+        // need to wait.
+        if ((mibWatch.inotifyFd != -1) || (tvCmp(&deltaTime, &pollTime) < 0)) {
+            struct timespec sleepTime = pollTime;
+            if (mibWatch.inotifyFd == -1) {
+                tvSub(&sleepTime, &pollTime, &deltaTime);
+            }
+            int timeout = (sleepTime.tv_sec * 1000) + (sleepTime.tv_nsec / 1000000);
+            int schedTime = mibTimerTimeout();
+
+            // Wake up when the next scheduled object,
+            // history sample, or journal flush is due
+            if ((schedTime != -1) && (schedTime < timeout)) {
+                timeout = schedTime;
+            }
+
+            changed = dataFileWatchWait(timeout);
+        } else {
+            changed = ~0u;
+        }
+    }
+
+    return NULL;
+}
+
+int mibEventFds(int *fds, int maxFds)
+{
+    int numFds = 0;
+
+    for (int n = 0; (n < NUM_UPDATE_FDS) && (numFds < maxFds); n++) {
+        fds[numFds++] = mibUpdateFd(n);
+    }
+
+    return numFds;
+}
+
+void mibEventReady(int n)
+{
+    mibUpdateChanged |= mibUpdateFdRead(n);
+}
+
+void mibEventRun(void)
+{
+    mibUpdatePass(mibUpdateChanged);
+    mibUpdateChanged = 0;
+
+    // Set the schedule timer to expire when the next
+    // object, history sample, or journal flush is due
+    if (mibSchedTimerFd != -1) {
+        int schedTime = mibTimerTimeout();
+        struct itimerspec timerSpec = { { 0, 0 }, { 0, 0 } };
+
+        if (schedTime != -1) {
+            // A zero it_value would disarm the timer
+            schedTime = (schedTime != 0) ? schedTime : 1;
+            timerSpec.it_value.tv_sec = schedTime / 1000;
+            timerSpec.it_value.tv_nsec = (schedTime % 1000) * 1000000;
+        }
+
+        timerfd_settime(mibSchedTimerFd, 0, &timerSpec, NULL);
+    }
+
+    drainTraps();
+}
+
+int mibInit(const CmdArgs *cmdArgs)
+{
+    netsnmp_handler_registration *reginfo;
+    struct timespec startTime, endTime, deltaTime;
+    struct rusage rusage;
+
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+    // Start with the objects defined by the MIB...
+    for (const MibObj *mibObj = &builtinObjTbl[0]; mibObj->varName != NULL; mibObj++) {
+        if (addMibObj(mibObj) != 0) {
+            return -1;
+        }
+    }
+    for (const BuiltinAlarm *alarm = &builtinAlarmTbl[0]; alarm->varName != NULL; alarm++) {
+        MibObj *mibObj = mibObjLookup(alarm->varName, strlen(alarm->varName));
+        if (mibObj != NULL) {
+            mibObj->hasAlarm = true;
+            mibObj->acUnit = alarm->acUnit;
+        }
+    }
+
+    // ... and add the ones from the object file
+    if ((cmdArgs->objectFile != NULL) && (procObjectFile(cmdArgs->objectFile) != 0)) {
+        return -1;
+    }
+
+    // Build the name to object index, used to bind the alarms
+    // and providers of the object file, and by the data file
+    // parser
+    if ((mibObjIndexInit() != 0) || (objectDefsBind() != 0)) {
+        return -1;
+    }
+
+    // Allocate the values of the read-only Integer32
+    // objects in one contiguous array
+    for (MibObj *mibObj = &mibObjTbl[0]; mibObj->varName != NULL; mibObj++) {
+        if (mibObj->readOnly && (mibObj->column == MIB_COLUMN_INT32)) {
+            mibValueCount++;
+        }
+    }
+    // Each row of the acUnitTable has two values: the
+    // temperature and the alarm state
+    if (valueStoreInit(&mibValueStore, (mibValueCount + (2 * numAcUnitDefs)), sizeof (int)) != 0) {
+        logMsg(LOG_ERR, "%s: failed to alloc %zu values!\n", __func__, mibValueCount);
+        return -1;
+    }
+    mibValueTbl = valueStoreWork(&mibValueStore, 0);
+    mibValueCount = 0;
+    for (MibObj *mibObj = &mibObjTbl[0]; mibObj->varName != NULL; mibObj++) {
+        if (mibObj->readOnly && (mibObj->column == MIB_COLUMN_INT32)) {
+            mibObj->varValue = &mibValueTbl[mibValueCount++];
+        }
+    }
+    if (acUnitTblInit(mibValueCount) != 0) {
+        return -1;
+    }
+
+    // ... and the values of the other types in their
+    // own columns
+    if (mibTypedColumnsInit() != 0) {
+        return -1;
+    }
+
+    if (alarmsInit() != 0) {
+        return -1;
+    }
+
+    if (mibPersistInit(cmdArgs->stateFile) != 0) {
+        return -1;
+    }
+
+    if (trapsInit(cmdArgs) != 0) {
+        return -1;
+    }
+
+    if (agentxInit() != 0) {
+        return -1;
+    }
+
+    if (schedInit() != 0) {
+        return -1;
+    }
+
+    if (mibHistoryInit(cmdArgs->historyDepth) != 0) {
+        return -1;
+    }
+
+    if ((cmdArgs->shmRing != NULL) && (shmRingInit(cmdArgs->shmRing) != 0)) {
+        return -1;
+    }
+
+    if ((cmdArgs->updateSocket != NULL) && ((mibUpdateSocketFd = updateSocketOpen(cmdArgs->updateSocket)) == -1)) {
+        int errNo = errno;
+        logMsg(LOG_ERR, "%s: failed to open update socket \"%s\": %s (%d)\n", __func__, cmdArgs->updateSocket, strerror(errNo), errNo);
+        return -1;
+    }
+
+    if ((mibUpdateWakeFd = eventfd(0, (EFD_NONBLOCK | EFD_CLOEXEC))) == -1) {
+        logMsg(LOG_ERR, "%s: failed to create eventfd!\n", __func__);
+        return -1;
+    }
+
+    if (snmpdCtlInit() != 0) {
+        return -1;
+    }
+
+    // Sort the objects by OID, for the subtree handler
+    if (mibObjSortedInit() != 0) {
+        return -1;
+    }
+
+    // Start the workers of the data files
+    if (dataSourcesInit(cmdArgs) != 0) {
+        return -1;
+    }
+
+    // Register with the Master Agent a single handler for
+    // the whole subtree, which serves all the read-only and
+    // read-write objects in our MIB...
+    logMsg(LOG_INFO, "Registering subtree: %zu objects ...\n", mibObjCount);
+    reginfo = netsnmp_create_handler_registration("subagentExampleMIB",
+                                                  mibSubtreeHandler,
+                                                  subagentExampleMIBOid,
+                                                  OID_LENGTH(subagentExampleMIBOid),
+                                                  HANDLER_CAN_RWRITE);
+    if ((reginfo == NULL) || (netsnmp_register_handler(reginfo) != 0)) {
+        logMsg(LOG_ERR, "Failed to register subagentExampleMIB subtree!\n");
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &endTime);
+    tvSub(&deltaTime, &endTime, &startTime);
+    getrusage(RUSAGE_SELF, &rusage);
+
+    logMsg(LOG_INFO, "%s: Registered %zu objects (%zu values) and %zu A/C units in %ld.%03ld sec, maxRSS=%ld KB\n", __func__,
+           mibObjCount, mibValueCount, acUnitTbl.numRows, deltaTime.tv_sec, (deltaTime.tv_nsec / 1000000), rusage.ru_maxrss);
+
+    // Catch the SIGBUS raised when the data file
+    // is truncated while being parsed...
+    if (signal(SIGBUS, sigBusHandler) == SIG_ERR) {
+        logMsg(LOG_ERR, "Failed to set SIGBUS handler!\n");
+        return -1;
+    }
+
+    // Start the worker of the lazy value providers, if any
+    for (const MibObj *mibObj = &mibObjTbl[0]; mibObj->varName != NULL; mibObj++) {
+        if (mibObj->provider != NULL) {
+            if (providerStart(mibProvidersChanged) != 0) {
+                logMsg(LOG_ERR, "Failed to start the value providers!\n");
+                return -1;
+            }
+            break;
+        }
+    }
+
+    // In the event loop mode, the MIB update work is
+    // driven by the caller's event loop...
+    if (cmdArgs->eventLoop) {
+        mibEventLoop = true;
+        mibUpdateInit(cmdArgs);
+        return 0;
+    }
+
+    // ... otherwise start the MIB update task
+    if (pthread_create(&mibUpdateThread, NULL, mibUpdateTask, (void *) cmdArgs)) {
+        logMsg(LOG_ERR, "Failed to create MIB update task!\n");
+        return -1;
+    }
+    mibUpdateThreadStarted = true;
+
+    return 0;
+}
+
+void mibShutdown(void)
+{
+    TrapQueueStats stats;
+
+    // Stop the MIB update task, and the workers of the data
+    // files, so that from now on this thread is the only one
+    // using the MIB state.
+    if (mibUpdateThreadStarted) {
+        const uint64_t one = 1;
+
+        atomic_store(&mibUpdateStop, true);
+        if (write(mibUpdateWakeFd, &one, sizeof (one)) != sizeof (one)) {
+            logMsg(LOG_WARNING, "%s: failed to wake up the MIB update task\n", __func__);
+        }
+        pthread_join(mibUpdateThread, NULL);
+        mibUpdateThreadStarted = false;
+    }
+    dataSourcesStop();
+
+    trapQueueGetStats(&stats);
+
+    logMsg(LOG_INFO, "%s: traps queued=%lu sent=%lu coalesced=%lu dropped=%lu\n", __func__,
+           stats.queued, stats.sent, stats.coalesced, stats.dropped);
+
+    // Compare the refreshes of the scheduled objects with
+    // the ones of refreshing all of them once per second
+    if (mibSched.numScheduled != 0) {
+        uint64_t secs = ((schedNow() - mibSched.startTick) * SCHED_TICK) / 1000;
+        long flat = (long) (secs * mibSched.numScheduled);
+        static StatsTotals totals;
+
+        statsRead(&totals);
+        logMsg(LOG_INFO, "%s: scheduled values=%zu refreshes=%lu coalesced=%lu deferred=%lu skipped=%ld (vs 1 Hz)\n", __func__,
+               mibSched.numScheduled, totals.counters[STATS_SCHED_REFRESHES], totals.counters[STATS_SCHED_COALESCED],
+               totals.counters[STATS_SCHED_DEFERRED], (flat - (long) totals.counters[STATS_SCHED_REFRESHES]));
+    }
+
+    if (mibShmRing != NULL) {
+        logMsg(LOG_INFO, "%s: shm ring badIds=%lu\n", __func__, mibShmRingBadIds);
+    }
+
+    if (mibUpdateSocketFd != -1) {
+        logMsg(LOG_INFO, "%s: update socket msgs=%lu truncated=%zu\n", __func__, mibUpdateSocketMsgs, mibUpdateSocketTruncated);
+    }
+
+    // Don't lose the last changes
+    if (mibPersist.enabled) {
+        mibPersistSave();
+    }
 }
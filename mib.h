@@ -8,5 +8,21 @@ extern bool snmpdConfigChange;
 
 extern int mibInit(const CmdArgs *cmdArgs);
 
+extern void mibShutdown(void);
+
+// Event loop mode (--event-loop): the MIB update work runs in
+// the caller's event loop, instead of its own thread.
+
+// Get the file descriptors to watch for input; the unused
+// ones are set to -1. Returns the number of entries set.
+extern int mibEventFds(int *fds, int maxFds);
+
+// Called when the n-th file descriptor is readable
+extern void mibEventReady(int n);
+
+// Process the updates, and send the pending traps. Called
+// once per iteration of the event loop.
+extern void mibEventRun(void);
+
 __END_DECLS
 
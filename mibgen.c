@@ -0,0 +1,505 @@
+// mibgen: generate the C definitions of the SUBAGENT-EXAMPLE-MIB
+// objects from the MIB module, so the OIDs used by the subagent
+// can't drift apart from the MIB.
+//
+//     ./mibgen SUBAGENT-EXAMPLE-MIB.txt > mibDefs.h
+//
+// The generated header has:
+//
+// - The OID of each node of the module, as <name>Oid[]; the OID
+//   of a read-only or read-write scalar includes its .0 instance.
+// - The DEFVAL of each scalar that has one, as DEFVAL_<NAME>.
+// - The column number of each table column, as COLUMN_<NAME>.
+// - MIB_BUILTIN_OBJS(RO, RW), which expands RO(name) or RW(name)
+//   for each read-only or read-write scalar right under the
+//   module identity, in OID order, and NUM_BUILTIN_OBJS.
+// - builtinObjIndex(), a perfect hash of the names of
+//   those scalars, that maps a name to its position in the
+//   MIB_BUILTIN_OBJS list, or -1 if it's not one of them.
+//
+// It's built and run by the Makefile, so it only understands
+// the subset of SMIv2 used by the module: MODULE-IDENTITY,
+// OBJECT-TYPE, NOTIFICATION-TYPE and OBJECT IDENTIFIER
+// assignments under the experimental subtree.
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_TOKENS      16384
+#define MAX_NODES       512
+#define MAX_OID_LEN     32
+#define MAX_NAME_LEN    64
+
+typedef enum NodeKind {
+    NODE_IDENTITY,          // MODULE-IDENTITY or OBJECT IDENTIFIER
+    NODE_SCALAR,
+    NODE_TABLE,
+    NODE_ENTRY,
+    NODE_COLUMN,
+    NODE_NOTIFICATION,
+} NodeKind;
+
+typedef struct Node {
+    char name[MAX_NAME_LEN];
+    const char *keyword;        // MODULE-IDENTITY, OBJECT-TYPE, ...
+    NodeKind kind;
+    bool isModule;
+    const char *syntax;
+    const char *access;
+    const char *defVal;
+    const char *parent;
+    unsigned long subId;
+    unsigned long oid[MAX_OID_LEN];
+    size_t oidLen;
+    bool resolved;
+} Node;
+
+static char *tokens[MAX_TOKENS];
+static size_t numTokens;
+static Node nodes[MAX_NODES];
+static size_t numNodes;
+
+// The roots the module can be registered under
+static const struct {
+    const char *name;
+    unsigned long oid[6];
+    size_t oidLen;
+} roots[] = {
+    { "internet", { 1, 3, 6, 1 }, 4 },
+    { "experimental", { 1, 3, 6, 1, 3 }, 5 },
+    { "enterprises", { 1, 3, 6, 1, 4, 1 }, 6 },
+};
+
+static void tokenize(const char *text)
+{
+    const char *p = text;
+
+    while (*p != '\0') {
+        const char *start = p;
+
+        if (isspace((unsigned char) *p)) {
+            p++;
+            continue;
+        }
+
+        if ((p[0] == '-') && (p[1] == '-')) {
+            // Comment, up to the end of the line
+            p += strcspn(p, "\n");
+            continue;
+        }
+
+        if (*p == '"') {
+            // Quoted string; only kept as a placeholder
+            p = strchr((p + 1), '"');
+            p = (p != NULL) ? (p + 1) : (start + strlen(start));
+        } else if (strncmp(p, "::=", 3) == 0) {
+            p += 3;
+        } else if (strncmp(p, "..", 2) == 0) {
+            p += 2;
+        } else if (isalnum((unsigned char) *p)) {
+            while (isalnum((unsigned char) *p) || (*p == '-') || (*p == '_')) {
+                p++;
+            }
+        } else {
+            p++;
+        }
+
+        if (numTokens == MAX_TOKENS) {
+            fprintf(stderr, "mibgen: too many tokens!\n");
+            exit(1);
+        }
+        tokens[numTokens++] = strndup(start, (p - start));
+    }
+}
+
+static bool tokenIs(size_t n, const char *str)
+{
+    return (n < numTokens) && (strcmp(tokens[n], str) == 0);
+}
+
+static Node *findNode(const char *name)
+{
+    for (size_t n = 0; n < numNodes; n++) {
+        if (strcmp(nodes[n].name, name) == 0) {
+            return &nodes[n];
+        }
+    }
+
+    return NULL;
+}
+
+// Parse the clauses of the node that starts at token n, up to
+// and including its "::= { parent subId }" value. Returns the
+// index of the token that follows it.
+static size_t parseNode(size_t n, Node *node)
+{
+    for (; n < numTokens; n++) {
+        if (tokenIs(n, "SYNTAX")) {
+            node->syntax = tokens[++n];
+            if (strcmp(node->syntax, "SEQUENCE") == 0) {
+                node->kind = NODE_TABLE;
+            }
+        } else if (tokenIs(n, "MAX-ACCESS")) {
+            node->access = tokens[++n];
+        } else if (tokenIs(n, "DEFVAL") && tokenIs((n + 1), "{")) {
+            node->defVal = tokens[n + 2];
+            n += 3;
+        } else if (tokenIs(n, "INDEX")) {
+            node->kind = NODE_ENTRY;
+        } else if (tokenIs(n, "::=")) {
+            if (!tokenIs((n + 1), "{") || ((n + 4) >= numTokens) || !tokenIs((n + 4), "}") ||
+                !isdigit((unsigned char) tokens[n + 3][0])) {
+                fprintf(stderr, "mibgen: %s: unsupported OID value!\n", node->name);
+                exit(1);
+            }
+            node->parent = tokens[n + 2];
+            node->subId = strtoul(tokens[n + 3], NULL, 10);
+            return (n + 5);
+        }
+    }
+
+    fprintf(stderr, "mibgen: %s: missing OID value!\n", node->name);
+    exit(1);
+}
+
+static void parse(void)
+{
+    size_t n = 0;
+
+    while (n < numTokens) {
+        const char *keyword = NULL;
+        size_t next = n + 2;
+
+        // Skip the IMPORTS, which list the macro names
+        if (tokenIs(n, "IMPORTS")) {
+            while ((n < numTokens) && !tokenIs(n, ";")) {
+                n++;
+            }
+            continue;
+        }
+
+        if (tokenIs((n + 1), "MODULE-IDENTITY") || tokenIs((n + 1), "OBJECT-TYPE") ||
+            tokenIs((n + 1), "NOTIFICATION-TYPE") || tokenIs((n + 1), "OBJECT-IDENTITY")) {
+            keyword = tokens[n + 1];
+        } else if (tokenIs((n + 1), "OBJECT") && tokenIs((n + 2), "IDENTIFIER") && tokenIs((n + 3), "::=")) {
+            keyword = "OBJECT IDENTIFIER";
+            next = n + 3;
+        }
+
+        if ((keyword == NULL) || !islower((unsigned char) tokens[n][0])) {
+            n++;
+            continue;
+        }
+
+        if ((numNodes == MAX_NODES) || (strlen(tokens[n]) >= MAX_NAME_LEN)) {
+            fprintf(stderr, "mibgen: too many nodes, or name too long: %s\n", tokens[n]);
+            exit(1);
+        }
+
+        Node *node = &nodes[numNodes++];
+        strcpy(node->name, tokens[n]);
+        node->keyword = keyword;
+        node->isModule = (strcmp(keyword, "MODULE-IDENTITY") == 0);
+        node->kind = (strcmp(keyword, "OBJECT-TYPE") == 0) ? NODE_SCALAR :
+                     (strcmp(keyword, "NOTIFICATION-TYPE") == 0) ? NODE_NOTIFICATION : NODE_IDENTITY;
+
+        n = parseNode(next, node);
+    }
+}
+
+static void resolve(Node *node, unsigned depth)
+{
+    Node *parent;
+
+    if (node->resolved) {
+        return;
+    }
+
+    if (depth > MAX_NODES) {
+        fprintf(stderr, "mibgen: %s: OID loop!\n", node->name);
+        exit(1);
+    }
+
+    if ((parent = findNode(node->parent)) != NULL) {
+        resolve(parent, (depth + 1));
+        memcpy(node->oid, parent->oid, (parent->oidLen * sizeof (unsigned long)));
+        node->oidLen = parent->oidLen;
+
+        // The objects of a table entry are its columns
+        if ((node->kind == NODE_SCALAR) && (parent->kind == NODE_ENTRY)) {
+            node->kind = NODE_COLUMN;
+        }
+    } else {
+        size_t r;
+        for (r = 0; r < (sizeof (roots) / sizeof (roots[0])); r++) {
+            if (strcmp(roots[r].name, node->parent) == 0) {
+                memcpy(node->oid, roots[r].oid, (roots[r].oidLen * sizeof (unsigned long)));
+                node->oidLen = roots[r].oidLen;
+                break;
+            }
+        }
+        if (r == (sizeof (roots) / sizeof (roots[0]))) {
+            fprintf(stderr, "mibgen: %s: unknown parent %s!\n", node->name, node->parent);
+            exit(1);
+        }
+    }
+
+    if (node->oidLen == MAX_OID_LEN) {
+        fprintf(stderr, "mibgen: %s: OID too long!\n", node->name);
+        exit(1);
+    }
+    node->oid[node->oidLen++] = node->subId;
+    node->resolved = true;
+}
+
+static int cmpNodeOid(const void *a, const void *b)
+{
+    const Node *nodeA = a;
+    const Node *nodeB = b;
+
+    for (size_t n = 0; (n < nodeA->oidLen) && (n < nodeB->oidLen); n++) {
+        if (nodeA->oid[n] != nodeB->oid[n]) {
+            return (nodeA->oid[n] < nodeB->oid[n]) ? -1 : 1;
+        }
+    }
+
+    return (nodeA->oidLen > nodeB->oidLen) - (nodeA->oidLen < nodeB->oidLen);
+}
+
+static bool isAccessible(const Node *node)
+{
+    return (node->access != NULL) &&
+           ((strcmp(node->access, "read-only") == 0) || (strcmp(node->access, "read-write") == 0));
+}
+
+// A scalar served from the object table of the subagent
+static bool isBuiltinObj(const Node *node)
+{
+    const Node *parent = findNode(node->parent);
+
+    return (node->kind == NODE_SCALAR) && isAccessible(node) && (parent != NULL) && parent->isModule;
+}
+
+static const char *upper(const char *name)
+{
+    static char buf[MAX_NAME_LEN];
+    size_t n;
+
+    for (n = 0; name[n] != '\0'; n++) {
+        buf[n] = toupper((unsigned char) name[n]);
+    }
+    buf[n] = '\0';
+
+    return buf;
+}
+
+// Same hash as builtinObjIndex() in the generated code
+static uint32_t hashName(uint32_t seed, const char *name)
+{
+    uint32_t hash = seed;
+
+    for (size_t n = 0; name[n] != '\0'; n++) {
+        hash = (hash ^ (unsigned char) name[n]) * 16777619u;
+    }
+
+    return hash;
+}
+
+// The hash of a name selects one of HASH_SLOTS(numNames) slots,
+// a power of 2 at least twice the number of names, so a seed
+// without collisions is found quickly. Each table size is given
+// SEED_TRIES seeds before it's doubled, up to MAX_HASH_SLOTS.
+#define HASH_SLOTS_MIN      16
+#define MAX_HASH_SLOTS      65536
+#define SEED_TRIES          100000
+#define SLOT_EMPTY          UINT8_MAX
+
+// Find a seed, and the number of slots, for which the hashes
+// of the names fall into different slots. Returns -1 if there's
+// none within the bounds above.
+static int findSeed(const char **names, size_t numNames, uint8_t *slots, size_t *numSlots, uint32_t *seed)
+{
+    static uint32_t usedBy[MAX_HASH_SLOTS];   // try that last used the slot
+    uint32_t try = 0;
+
+    for (*numSlots = HASH_SLOTS_MIN; *numSlots < (2 * numNames); *numSlots *= 2) {
+        ;
+    }
+
+    for (; *numSlots <= MAX_HASH_SLOTS; *numSlots *= 2) {
+        memset(usedBy, 0, sizeof (usedBy));
+
+        for (uint32_t n = 0; n < SEED_TRIES; n++) {
+            size_t i;
+
+            *seed = 2166136261u + (++try);
+            for (i = 0; i < numNames; i++) {
+                uint32_t slot = hashName(*seed, names[i]) & (*numSlots - 1);
+                if (usedBy[slot] == try) {
+                    break;
+                }
+                usedBy[slot] = try;
+            }
+
+            if (i == numNames) {
+                memset(slots, SLOT_EMPTY, *numSlots);
+                for (i = 0; i < numNames; i++) {
+                    slots[hashName(*seed, names[i]) & (*numSlots - 1)] = i;
+                }
+                return 0;
+            }
+        }
+    }
+
+    return -1;
+}
+
+static void generate(const char *mibFile)
+{
+    const char *names[MAX_NODES];
+    static uint8_t slots[MAX_HASH_SLOTS];
+    size_t numNames = 0;
+    size_t numSlots;
+    uint32_t seed;
+
+    printf("// Generated by mibgen from %s; DO NOT EDIT.\n", mibFile);
+    printf("#pragma once\n\n");
+    printf("#include <stdint.h>\n");
+    printf("#include <string.h>\n\n");
+
+    // The OIDs
+    for (size_t n = 0; n < numNodes; n++) {
+        const Node *node = &nodes[n];
+        bool instance = (node->kind == NODE_SCALAR) && isAccessible(node);
+
+        printf("// %s %s", node->name, node->keyword);
+        if (node->syntax != NULL) {
+            printf(" %s%s", node->syntax, (node->kind == NODE_TABLE) ? " OF" : "");
+        }
+        if (node->access != NULL) {
+            printf(" %s", node->access);
+        }
+        printf(" ::= { %s %lu }\n", node->parent, node->subId);
+
+        printf("static const oid %sOid[] __attribute__ ((unused)) = {", node->name);
+        for (size_t i = 0; i < node->oidLen; i++) {
+            printf("%s %lu", ((i == 0) ? "" : ","), node->oid[i]);
+        }
+        printf("%s };\n", (instance ? ", 0" : ""));
+
+        if (node->defVal != NULL) {
+            printf("#define DEFVAL_%s %s\n", upper(node->name), node->defVal);
+        }
+        printf("\n");
+    }
+
+    // The table columns
+    for (size_t n = 0; n < numNodes; n++) {
+        if (nodes[n].kind == NODE_COLUMN) {
+            printf("#define COLUMN_%s %lu\n", upper(nodes[n].name), nodes[n].subId);
+        }
+    }
+    printf("\n");
+
+    // The scalars served from the object table, in OID order
+    printf("// The read-only and read-write scalars, in OID order\n");
+    printf("#define MIB_BUILTIN_OBJS(RO, RW) \\\n");
+    for (size_t n = 0; n < numNodes; n++) {
+        if (isBuiltinObj(&nodes[n])) {
+            printf("    %s(%s) \\\n", ((strcmp(nodes[n].access, "read-only") == 0) ? "RO" : "RW"), nodes[n].name);
+            names[numNames++] = nodes[n].name;
+        }
+    }
+    printf("\n");
+    printf("#define NUM_BUILTIN_OBJS %zu\n\n", numNames);
+
+    if (numNames >= SLOT_EMPTY) {
+        fprintf(stderr, "mibgen: too many scalars!\n");
+        exit(1);
+    }
+
+    if (numNames == 0) {
+        printf("static inline int builtinObjIndex(const char *name, size_t len)\n{\n    return -1;\n}\n");
+        return;
+    }
+
+    // The perfect hash of their names
+    if (findSeed(names, numNames, slots, &numSlots, &seed) != 0) {
+        fprintf(stderr, "mibgen: no perfect hash of the %zu scalar names within %d slots!\n", numNames, MAX_HASH_SLOTS);
+        exit(1);
+    }
+
+    printf("static const char *const builtinObjNames[NUM_BUILTIN_OBJS] = {\n");
+    for (size_t n = 0; n < numNames; n++) {
+        printf("    \"%s\",\n", names[n]);
+    }
+    printf("};\n\n");
+
+    printf("#define BUILTIN_OBJ_SLOTS %zu\n\n", numSlots);
+    printf("static const uint8_t builtinObjSlots[BUILTIN_OBJ_SLOTS] = {");
+    for (size_t n = 0; n < numSlots; n++) {
+        printf("%s%s%u", ((n == 0) ? "" : ","), (((n % 16) == 0) ? "\n   " : " "), slots[n]);
+    }
+    printf("\n};\n\n");
+
+    printf("// Get the position of the named scalar in MIB_BUILTIN_OBJS, or -1 if\n");
+    printf("// it's not one of them. The name need not be null-terminated.\n");
+    printf("static inline int builtinObjIndex(const char *name, size_t len)\n");
+    printf("{\n");
+    printf("    uint32_t hash = %uu;\n", seed);
+    printf("    int index;\n\n");
+    printf("    for (size_t n = 0; n < len; n++) {\n");
+    printf("        hash = (hash ^ (unsigned char) name[n]) * 16777619u;\n");
+    printf("    }\n\n");
+    printf("    if ((index = builtinObjSlots[hash & (BUILTIN_OBJ_SLOTS - 1)]) == %u) {\n", SLOT_EMPTY);
+    printf("        return -1;\n");
+    printf("    }\n\n");
+    printf("    return ((strncmp(builtinObjNames[index], name, len) == 0) && (builtinObjNames[index][len] == '\\0')) ? index : -1;\n");
+    printf("}\n");
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *fp;
+    char *text;
+    long size;
+
+    if (argc != 2) {
+        fprintf(stderr, "SYNTAX: mibgen <mibFile>\n");
+        return 1;
+    }
+
+    if (((fp = fopen(argv[1], "r")) == NULL) || (fseek(fp, 0, SEEK_END) != 0) || ((size = ftell(fp)) < 0) ||
+        (fseek(fp, 0, SEEK_SET) != 0) || ((text = calloc((size + 1), 1)) == NULL) ||
+        (fread(text, 1, size, fp) != (size_t) size)) {
+        fprintf(stderr, "mibgen: can't read %s\n", argv[1]);
+        return 1;
+    }
+    fclose(fp);
+
+    tokenize(text);
+    parse();
+
+    for (size_t n = 0; n < numNodes; n++) {
+        resolve(&nodes[n], 0);
+    }
+
+    // Keep the nodes in OID order, so are the objects in
+    // MIB_BUILTIN_OBJS
+    qsort(nodes, numNodes, sizeof (Node), cmpNodeOid);
+
+    for (size_t n = 1; n < numNodes; n++) {
+        if (cmpNodeOid(&nodes[n - 1], &nodes[n]) == 0) {
+            fprintf(stderr, "mibgen: %s and %s have the same OID!\n", nodes[n - 1].name, nodes[n].name);
+            return 1;
+        }
+    }
+
+    generate(argv[1]);
+
+    return 0;
+}
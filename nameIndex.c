@@ -0,0 +1,65 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "nameIndex.h"
+
+uint32_t nameHash(const char *name, size_t len)
+{
+    uint32_t hash = 2166136261u;
+
+    for (size_t n = 0; n < len; n++) {
+        hash ^= (unsigned char) name[n];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+int nameIndexInit(NameIndex *idx, size_t maxNames)
+{
+    size_t numSlots = 8;
+
+    memset(idx, 0, sizeof (*idx));
+
+    // Keep the load factor at or below 50%
+    while (numSlots < (2 * maxNames)) {
+        numSlots *= 2;
+    }
+
+    if ((idx->slots = calloc(numSlots, sizeof (NameIndexSlot))) == NULL) {
+        return -1;
+    }
+    idx->mask = numSlots - 1;
+    idx->maxNames = maxNames;
+
+    return 0;
+}
+
+void nameIndexFree(NameIndex *idx)
+{
+    free(idx->slots);
+    memset(idx, 0, sizeof (*idx));
+}
+
+int nameIndexAdd(NameIndex *idx, const char *name, void *item)
+{
+    uint32_t hash = nameHash(name, strlen(name));
+    size_t n;
+
+    if (idx->numNames == idx->maxNames) {
+        return -1;      // full
+    }
+
+    for (n = (hash & idx->mask); idx->slots[n].name != NULL; n = ((n + 1) & idx->mask)) {
+        if ((idx->slots[n].hash == hash) && (strcmp(idx->slots[n].name, name) == 0)) {
+            return -1;  // duplicate
+        }
+    }
+
+    idx->slots[n].hash = hash;
+    idx->slots[n].name = name;
+    idx->slots[n].item = item;
+    idx->numNames++;
+
+    return 0;
+}
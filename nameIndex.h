@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+// Name to item index: an open addressing hash table with
+// linear probing, built once for a known maximum number of
+// names, and kept at most half full, so that a lookup costs
+// one hash of the name and, on average, less than two probes,
+// however many names there are. The names are not copied,
+// and the names looked up need not be null-terminated, so
+// that they can be looked up in place in a data file buffer.
+typedef struct NameIndexSlot {
+    uint32_t hash;
+    const char *name;   // NULL means the slot is empty
+    void *item;
+} NameIndexSlot;
+
+typedef struct NameIndex {
+    NameIndexSlot *slots;
+    size_t mask;        // number of slots - 1
+    size_t numNames;
+    size_t maxNames;
+} NameIndex;
+
+// FNV-1a hash of the name
+extern uint32_t nameHash(const char *name, size_t len);
+
+extern int nameIndexInit(NameIndex *idx, size_t maxNames);
+
+extern void nameIndexFree(NameIndex *idx);
+
+// Add a name. Returns -1 if the name is already in the index,
+// or if it already holds maxNames names.
+extern int nameIndexAdd(NameIndex *idx, const char *name, void *item);
+
+// Find the item of a name; NULL if it's not in the index
+static inline void *nameIndexFind(const NameIndex *idx, const char *name, size_t len)
+{
+    uint32_t hash;
+
+    if (idx->slots == NULL) {
+        return NULL;
+    }
+
+    hash = nameHash(name, len);
+    for (size_t n = (hash & idx->mask); idx->slots[n].name != NULL; n = ((n + 1) & idx->mask)) {
+        const NameIndexSlot *slot = &idx->slots[n];
+        if ((slot->hash == hash) && (strncmp(slot->name, name, len) == 0) && (slot->name[len] == '\0')) {
+            return slot->item;
+        }
+    }
+
+    return NULL;
+}
+
+__END_DECLS
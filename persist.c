@@ -0,0 +1,443 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "persist.h"
+
+#define PERSIST_MIN_CAPACITY    64
+#define PERSIST_MIN_PENDING     256
+
+static size_t tableSize(uint32_t capacity)
+{
+    return sizeof (PersistHdr) + ((size_t) capacity * sizeof (PersistSlot));
+}
+
+static uint32_t recordCheck(uint64_t key, int32_t value)
+{
+    uint64_t hash = (key ^ ((uint64_t) (uint32_t) value << 1)) * 0x9e3779b97f4a7c15ull;
+
+    return (uint32_t) (hash >> 32) ^ PERSIST_MAGIC;
+}
+
+// Find the slot of the key, adding it if requested. The table
+// is kept at most 3/4 full, so the probe always ends at an
+// empty slot.
+static int32_t findSlot(PersistHdr *hdr, PersistSlot *slots, uint64_t key, bool add)
+{
+    uint32_t mask = hdr->capacity - 1;
+
+    for (uint32_t n = (uint32_t) key & mask; ; n = (n + 1) & mask) {
+        if (slots[n].key == key) {
+            return n;
+        }
+
+        if (slots[n].key == 0) {
+            if (!add || ((hdr->count + 1) > ((hdr->capacity / 4) * 3))) {
+                return -1;
+            }
+            slots[n].key = key;
+            slots[n].valid = 0;
+            hdr->count++;
+            return n;
+        }
+    }
+}
+
+// Map the snapshot file, if it exists and is valid. Returns
+// NULL otherwise.
+static PersistHdr *mapSnapshot(const char *path, size_t *size)
+{
+    PersistHdr *hdr;
+    struct stat statBuf;
+    int fd;
+
+    if ((fd = open(path, (O_RDONLY | O_CLOEXEC))) == -1) {
+        return NULL;
+    }
+
+    if ((fstat(fd, &statBuf) != 0) || (statBuf.st_size < (off_t) sizeof (PersistHdr))) {
+        close(fd);
+        return NULL;
+    }
+
+    hdr = mmap(NULL, statBuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (hdr == MAP_FAILED) {
+        return NULL;
+    }
+
+    if ((hdr->magic != PERSIST_MAGIC) || (hdr->version != PERSIST_VERSION) ||
+        (hdr->capacity == 0) || ((hdr->capacity & (hdr->capacity - 1)) != 0) ||
+        (tableSize(hdr->capacity) != (size_t) statBuf.st_size)) {
+        munmap(hdr, statBuf.st_size);
+        return NULL;
+    }
+
+    *size = statBuf.st_size;
+
+    return hdr;
+}
+
+// Create the in-memory table with at least the specified
+// capacity, holding the keys and values of the snapshot, if
+// any. The snapshot is copied as is if it's large enough, and
+// rehashed otherwise.
+static PersistHdr *newTable(uint32_t capacity, const PersistHdr *oldHdr)
+{
+    PersistHdr *hdr;
+
+    if ((oldHdr != NULL) && (oldHdr->capacity >= capacity)) {
+        if ((hdr = malloc(tableSize(oldHdr->capacity))) != NULL) {
+            memcpy(hdr, oldHdr, tableSize(oldHdr->capacity));
+        }
+        return hdr;
+    }
+
+    // All the slots start out empty
+    if ((hdr = calloc(1, tableSize(capacity))) == NULL) {
+        return NULL;
+    }
+
+    hdr->magic = PERSIST_MAGIC;
+    hdr->version = PERSIST_VERSION;
+    hdr->capacity = capacity;
+    hdr->count = 0;
+    hdr->generation = 0;
+
+    if (oldHdr != NULL) {
+        const PersistSlot *oldSlots = (const PersistSlot *) (oldHdr + 1);
+        PersistSlot *slots = (PersistSlot *) (hdr + 1);
+
+        for (uint32_t n = 0; n < oldHdr->capacity; n++) {
+            int32_t slot;
+            if ((oldSlots[n].key != 0) && ((slot = findSlot(hdr, slots, oldSlots[n].key, true)) != -1)) {
+                slots[slot] = oldSlots[n];
+            }
+        }
+
+        // The journal still applies to the grown table
+        hdr->generation = oldHdr->generation;
+    }
+
+    return hdr;
+}
+
+static int writeAll(int fd, const void *buf, size_t len)
+{
+    const char *pos = buf;
+
+    while (len != 0) {
+        ssize_t n = write(fd, pos, len);
+        if (n <= 0) {
+            return -1;
+        }
+        pos += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+// Sync the directory of the file, so that a rename is durable
+static int syncDir(const char *path)
+{
+    char dirPath[PATH_MAX];
+    const char *slash = strrchr(path, '/');
+    int fd, ret;
+
+    if (slash == NULL) {
+        strcpy(dirPath, ".");
+    } else if (slash == path) {
+        strcpy(dirPath, "/");
+    } else {
+        snprintf(dirPath, sizeof (dirPath), "%.*s", (int) (slash - path), path);
+    }
+
+    if ((fd = open(dirPath, (O_RDONLY | O_DIRECTORY | O_CLOEXEC))) == -1) {
+        return -1;
+    }
+    ret = fsync(fd);
+    close(fd);
+
+    return ret;
+}
+
+// Write the table to the snapshot file. The file is written
+// under a temp name, and renamed over the old one once it's
+// complete and synced, so a crash leaves either the old or
+// the new snapshot, never a mix of the two.
+static int writeSnapshot(const char *path, const PersistHdr *hdr)
+{
+    char tmpPath[PATH_MAX];
+    int fd;
+
+    snprintf(tmpPath, sizeof (tmpPath), "%s.tmp", path);
+
+    if ((fd = open(tmpPath, (O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC), 0600)) == -1) {
+        return -1;
+    }
+
+    if ((writeAll(fd, hdr, tableSize(hdr->capacity)) != 0) || (fdatasync(fd) != 0)) {
+        close(fd);
+        unlink(tmpPath);
+        return -1;
+    }
+    close(fd);
+
+    if (rename(tmpPath, path) != 0) {
+        unlink(tmpPath);
+        return -1;
+    }
+
+    return syncDir(path);
+}
+
+// Empty the journal, and start it with the generation of the
+// current snapshot
+static int resetJournal(PersistStore *ps)
+{
+    PersistJournalHdr journalHdr = {
+        .magic = PERSIST_MAGIC,
+        .version = PERSIST_VERSION,
+        .generation = ps->hdr->generation,
+    };
+
+    if ((ftruncate(ps->journalFd, 0) != 0) ||
+        (writeAll(ps->journalFd, &journalHdr, sizeof (journalHdr)) != 0) ||
+        (fdatasync(ps->journalFd) != 0)) {
+        return -1;
+    }
+
+    ps->journalGen = journalHdr.generation;
+    ps->journalLen = sizeof (journalHdr);
+
+    return 0;
+}
+
+// Apply the records of the journal to the table, if they
+// belong to its generation. A record that fails its check was
+// torn by a crash while it was being written, and ends the
+// journal.
+static size_t replayJournal(PersistStore *ps)
+{
+    PersistRecord records[256];
+    PersistJournalHdr journalHdr;
+    size_t numReplayed = 0;
+    ssize_t len;
+
+    if ((read(ps->journalFd, &journalHdr, sizeof (journalHdr)) != sizeof (journalHdr)) ||
+        (journalHdr.magic != PERSIST_MAGIC) || (journalHdr.version != PERSIST_VERSION) ||
+        (journalHdr.generation != ps->hdr->generation)) {
+        return 0;
+    }
+
+    while ((len = read(ps->journalFd, records, sizeof (records))) > 0) {
+        size_t numRecords = len / sizeof (PersistRecord);
+
+        for (size_t n = 0; n < numRecords; n++) {
+            const PersistRecord *rec = &records[n];
+            int32_t slot;
+
+            if ((rec->key == 0) || (rec->check != recordCheck(rec->key, rec->value))) {
+                return numReplayed;
+            }
+
+            if ((slot = findSlot(ps->hdr, ps->slots, rec->key, true)) != -1) {
+                ps->slots[slot].value = rec->value;
+                ps->slots[slot].valid = 1;
+                numReplayed++;
+            }
+        }
+    }
+
+    return numReplayed;
+}
+
+int persistOpen(PersistStore *ps, const char *path, size_t numKeys)
+{
+    PersistHdr *oldHdr;
+    size_t oldSize = 0;
+    size_t needed;
+    uint32_t capacity = PERSIST_MIN_CAPACITY;
+    bool grown;
+
+    memset(ps, 0, sizeof (*ps));
+    pthread_mutex_init(&ps->lock, NULL);
+    ps->journalFd = -1;
+
+    if (((ps->path = strdup(path)) == NULL) ||
+        ((ps->journalPath = malloc(strlen(path) + sizeof (".journal"))) == NULL)) {
+        return -1;
+    }
+    sprintf(ps->journalPath, "%s.journal", path);
+
+    // Grow the table if it doesn't have room for the
+    // new keys; the keys it already holds are kept.
+    oldHdr = mapSnapshot(path, &oldSize);
+    needed = numKeys + ((oldHdr != NULL) ? oldHdr->count : 0);
+    while ((((size_t) capacity / 4) * 3) < (needed * 2)) {
+        capacity *= 2;
+    }
+
+    grown = (oldHdr == NULL) || (oldHdr->capacity < capacity);
+    ps->hdr = newTable(capacity, oldHdr);
+    if (oldHdr != NULL) {
+        munmap(oldHdr, oldSize);
+    }
+    if (ps->hdr == NULL) {
+        return -1;
+    }
+    ps->slots = (PersistSlot *) (ps->hdr + 1);
+
+    if ((ps->journalFd = open(ps->journalPath, (O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC), 0600)) == -1) {
+        return -1;
+    }
+
+    ps->maxPending = PERSIST_MIN_PENDING;
+    if ((ps->pending = calloc(ps->maxPending, sizeof (PersistRecord))) == NULL) {
+        return -1;
+    }
+
+    // Fold the journal into a new snapshot, so it starts
+    // out empty.
+    if ((replayJournal(ps) != 0) || grown) {
+        return persistSnapshot(ps);
+    }
+
+    return resetJournal(ps);
+}
+
+void persistClose(PersistStore *ps)
+{
+    if (ps->journalFd != -1) {
+        close(ps->journalFd);
+    }
+    free(ps->pending);
+    free(ps->hdr);
+    free(ps->journalPath);
+    free(ps->path);
+    pthread_mutex_destroy(&ps->lock);
+    memset(ps, 0, sizeof (*ps));
+    ps->journalFd = -1;
+}
+
+int32_t persistSlot(PersistStore *ps, uint64_t key)
+{
+    int32_t slot;
+
+    pthread_mutex_lock(&ps->lock);
+    slot = findSlot(ps->hdr, ps->slots, key, true);
+    pthread_mutex_unlock(&ps->lock);
+
+    return slot;
+}
+
+bool persistGet(PersistStore *ps, int32_t slot, int32_t *value)
+{
+    bool valid;
+
+    pthread_mutex_lock(&ps->lock);
+    valid = (ps->slots[slot].valid != 0);
+    *value = ps->slots[slot].value;
+    pthread_mutex_unlock(&ps->lock);
+
+    return valid;
+}
+
+void persistPut(PersistStore *ps, int32_t slot, int32_t value)
+{
+    PersistSlot *pslot = &ps->slots[slot];
+    PersistRecord *rec;
+
+    pthread_mutex_lock(&ps->lock);
+
+    pslot->value = value;
+    pslot->valid = 1;
+
+    if (ps->numPending == ps->maxPending) {
+        PersistRecord *pending = realloc(ps->pending, (2 * ps->maxPending * sizeof (PersistRecord)));
+        if (pending == NULL) {
+            // The value is still saved by the next snapshot
+            pthread_mutex_unlock(&ps->lock);
+            return;
+        }
+        ps->pending = pending;
+        ps->maxPending *= 2;
+    }
+
+    rec = &ps->pending[ps->numPending++];
+    rec->key = pslot->key;
+    rec->value = value;
+    rec->check = recordCheck(pslot->key, value);
+
+    pthread_mutex_unlock(&ps->lock);
+}
+
+void persistSet(PersistStore *ps, int32_t slot, int32_t value)
+{
+    pthread_mutex_lock(&ps->lock);
+    ps->slots[slot].value = value;
+    ps->slots[slot].valid = 1;
+    pthread_mutex_unlock(&ps->lock);
+}
+
+int persistFlush(PersistStore *ps)
+{
+    const char *buf;
+    size_t len;
+    int ret = 0;
+
+    pthread_mutex_lock(&ps->lock);
+
+    buf = (const char *) ps->pending;
+    len = ps->numPending * sizeof (PersistRecord);
+
+    // The journal must be reset if that failed after
+    // the last snapshot; records appended to one of an
+    // older generation are not replayed.
+    if ((len != 0) && (ps->journalGen != ps->hdr->generation) && (resetJournal(ps) != 0)) {
+        ret = -1;
+    } else if (len != 0) {
+        if ((writeAll(ps->journalFd, buf, len) != 0) || (fdatasync(ps->journalFd) != 0)) {
+            ret = -1;
+        }
+        ps->journalLen += len;
+    }
+
+    // On error the records are dropped; their values
+    // are still saved by the next snapshot.
+    ps->numPending = 0;
+
+    pthread_mutex_unlock(&ps->lock);
+
+    return ret;
+}
+
+int persistSnapshot(PersistStore *ps)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&ps->lock);
+
+    ps->hdr->generation++;
+
+    if (writeSnapshot(ps->path, ps->hdr) != 0) {
+        ps->hdr->generation--;
+        ret = -1;
+    } else {
+        // The snapshot holds the values of the pending
+        // records too, so they are no longer needed.
+        ps->numPending = 0;
+        ret = resetJournal(ps);
+    }
+
+    pthread_mutex_unlock(&ps->lock);
+
+    return ret;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+// Persistent store of named integer values, that survive the
+// restarts of the subagent.
+//
+// The values live in memory, in an open addressing hash table
+// of {key, value} slots, that is saved as a whole in a snapshot
+// file, so restoring them at startup only takes one read. The
+// changes that must not be lost are also appended to a journal
+// file, in batches: persistPut() only buffers the record, and
+// persistFlush() writes all the buffered records with one
+// write() and one fdatasync().
+//
+// A snapshot is written to a temp file, synced, and renamed
+// over the previous one, so the snapshot file always holds a
+// consistent image of the table. Each snapshot has a new
+// generation number, that is also written at the start of the
+// journal once it's emptied; at startup the journal is only
+// replayed if its generation matches the snapshot's, so a crash
+// between the rename and the emptying of the journal doesn't
+// replay records older than the snapshot.
+//
+// The keys are 64-bit hashes of the value names; 0 is not a
+// valid key. The slot of a key never moves once assigned, so
+// callers can look up their slots once, and use them from
+// then on.
+#define PERSIST_MAGIC       0x54534550  // "PEST"
+#define PERSIST_VERSION     2
+
+typedef struct PersistHdr {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;          // number of slots; power of 2
+    uint32_t count;             // number of slots in use
+    uint64_t generation;        // of the snapshot
+} PersistHdr;
+
+typedef struct PersistSlot {
+    uint64_t key;               // 0 means the slot is empty
+    int32_t value;
+    uint32_t valid;             // the value has been set
+} PersistSlot;
+
+// Header of the journal, the generation of the snapshot the
+// records apply to
+typedef struct PersistJournalHdr {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t generation;
+} PersistJournalHdr;
+
+// Journal record; check detects a torn write at the
+// end of the journal.
+typedef struct PersistRecord {
+    uint64_t key;
+    int32_t value;
+    uint32_t check;
+} PersistRecord;
+
+typedef struct PersistStore {
+    pthread_mutex_t lock;
+    char *path;
+    char *journalPath;
+    PersistHdr *hdr;            // the table, followed by its slots
+    PersistSlot *slots;
+    int journalFd;
+    uint64_t journalGen;        // generation in the journal header
+    size_t journalLen;          // bytes in the journal file
+    PersistRecord *pending;     // records not written yet
+    size_t numPending;
+    size_t maxPending;
+} PersistStore;
+
+// Open the store, creating its files if needed, with room
+// for at least numKeys keys besides the ones already in it,
+// and replay the journal. Returns -1 on error.
+extern int persistOpen(PersistStore *ps, const char *path, size_t numKeys);
+
+// Close the store, and free its resources
+extern void persistClose(PersistStore *ps);
+
+// Get the slot of the specified key, adding it if needed.
+// Returns -1 if the store is full.
+extern int32_t persistSlot(PersistStore *ps, uint64_t key);
+
+// Get the value in the slot. Returns false if it was never
+// set.
+extern bool persistGet(PersistStore *ps, int32_t slot, int32_t *value);
+
+// Set the value in the slot, and add it to the journal
+extern void persistPut(PersistStore *ps, int32_t slot, int32_t value);
+
+// Set the value in the slot, without adding it to the
+// journal; it's saved by the next snapshot.
+extern void persistSet(PersistStore *ps, int32_t slot, int32_t value);
+
+// Write the pending records to the journal, and sync it.
+// Returns -1 on error.
+extern int persistFlush(PersistStore *ps);
+
+// Write a new snapshot of the table, and empty the journal.
+// Returns -1 on error.
+extern int persistSnapshot(PersistStore *ps);
+
+__END_DECLS
@@ -0,0 +1,332 @@
+#define _GNU_SOURCE     // pipe2()
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "provider.h"
+
+extern char **environ;
+
+// Queue of the providers to read, served by the worker thread
+typedef struct ProviderQueue {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    Provider *head;
+    Provider *tail;
+    ProviderNotifyFunc *notifyFunc;
+} ProviderQueue;
+
+static ProviderQueue providerQueue = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+// All the providers, for the initial read
+static Provider **providers;
+static size_t numProviders;
+
+static uint64_t nowMsec(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t) now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+static bool parseValue(const char *buf, int *value)
+{
+    char *end;
+    long val;
+
+    errno = 0;
+    val = strtol(buf, &end, 10);
+
+    if ((end == buf) || (errno != 0) || (val < INT32_MIN) || (val > INT32_MAX)) {
+        return false;
+    }
+
+    *value = (int) val;
+
+    return true;
+}
+
+// Start the shell command in its own process group, with its
+// stdout redirected to the pipe
+static pid_t spawnCommand(const char *command, int outFd)
+{
+    char *argv[] = { "sh", "-c", (char *) command, NULL };
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    sigset_t sigMask, sigDefault;
+    pid_t pid;
+    int err;
+
+    // The command must not inherit the signals blocked, or
+    // ignored, by the subagent
+    sigemptyset(&sigMask);
+    sigemptyset(&sigDefault);
+    sigaddset(&sigDefault, SIGUSR1);
+    sigaddset(&sigDefault, SIGTERM);
+    sigaddset(&sigDefault, SIGINT);
+    sigaddset(&sigDefault, SIGPIPE);
+    sigaddset(&sigDefault, SIGCHLD);
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, outFd, STDOUT_FILENO);
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, (POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP));
+    posix_spawnattr_setsigmask(&attr, &sigMask);
+    posix_spawnattr_setsigdefault(&attr, &sigDefault);
+    posix_spawnattr_setpgroup(&attr, 0);
+
+    err = posix_spawn(&pid, "/bin/sh", &actions, &attr, argv, environ);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+
+    return (err == 0) ? pid : -1;
+}
+
+// Wait until the deadline for the command to exit. If it
+// doesn't, or its output wasn't closed in time, it's killed
+// with the commands it started. Returns true if it exited
+// with status 0.
+static bool reapCommand(pid_t pid, uint64_t deadline, bool timedOut)
+{
+    int status;
+    pid_t ret;
+
+    if (!timedOut) {
+        while (((ret = waitpid(pid, &status, WNOHANG)) == 0) && (nowMsec() < deadline)) {
+            struct timespec delay = { 0, 1000000 };
+            nanosleep(&delay, NULL);
+        }
+
+        if (ret != 0) {
+            return (ret == pid) && WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+        }
+    }
+
+    // The command isn't reaped yet, so its process group
+    // can't have been reused
+    kill(-pid, SIGKILL);
+    while ((waitpid(pid, &status, 0) == -1) && (errno == EINTR)) {
+        ;
+    }
+
+    return false;
+}
+
+bool providerReadCommand(const char *command, uint64_t timeout, int *value)
+{
+    uint64_t deadline = nowMsec() + timeout;
+    char buf[64];
+    size_t len = 0;
+    int pipeFds[2];
+    bool timedOut = true;
+    bool ok;
+    pid_t pid;
+
+    if (pipe2(pipeFds, O_CLOEXEC) != 0) {
+        return false;
+    }
+
+    pid = spawnCommand(command, pipeFds[1]);
+    close(pipeFds[1]);
+
+    if (pid == -1) {
+        close(pipeFds[0]);
+        return false;
+    }
+
+    // Read the output until EOF, or the deadline; only the
+    // start of it is kept.
+    while (true) {
+        struct pollfd pfd = { .fd = pipeFds[0], .events = POLLIN };
+        uint64_t now = nowMsec();
+        char discard[256];
+        ssize_t s;
+        int ret;
+
+        if (now >= deadline) {
+            break;
+        } else if ((ret = poll(&pfd, 1, (int) (deadline - now))) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        } else if (ret == 0) {
+            break;
+        }
+
+        if (len < (sizeof (buf) - 1)) {
+            s = read(pipeFds[0], &buf[len], (sizeof (buf) - 1 - len));
+            len += (s > 0) ? (size_t) s : 0;
+        } else {
+            s = read(pipeFds[0], discard, sizeof (discard));
+        }
+
+        if (s == 0) {
+            timedOut = false;
+            break;      // EOF
+        } else if ((s == -1) && (errno != EINTR)) {
+            break;
+        }
+    }
+    close(pipeFds[0]);
+    buf[len] = '\0';
+
+    ok = (len != 0) && parseValue(buf, value);
+
+    // The command must also succeed, in time
+    if (!reapCommand(pid, deadline, timedOut)) {
+        ok = false;
+    }
+
+    return ok;
+}
+
+bool providerReadFile(const char *path, uint64_t timeout, int *value)
+{
+    char buf[64];
+    ssize_t len;
+    int fd;
+
+    if ((fd = open(path, (O_RDONLY | O_CLOEXEC))) == -1) {
+        return false;
+    }
+
+    len = read(fd, buf, (sizeof (buf) - 1));
+    close(fd);
+
+    if (len <= 0) {
+        return false;
+    }
+    buf[len] = '\0';
+
+    return parseValue(buf, value);
+}
+
+Provider *providerCreate(ProviderReadFunc *readFunc, const char *arg, uint64_t ttl, uint64_t timeout)
+{
+    Provider *provider, **list;
+
+    if ((list = realloc(providers, ((numProviders + 1) * sizeof (Provider *)))) == NULL) {
+        return NULL;
+    }
+    providers = list;
+
+    if ((provider = calloc(1, sizeof (Provider))) == NULL) {
+        return NULL;
+    }
+
+    provider->readFunc = readFunc;
+    provider->arg = arg;
+    provider->ttl = ttl;
+    provider->timeout = timeout;
+
+    providers[numProviders++] = provider;
+
+    return provider;
+}
+
+// Queue a read of the provider, unless one is already
+// queued or in progress.
+static void providerQueueRead(Provider *provider)
+{
+    ProviderQueue *queue = &providerQueue;
+
+    if (atomic_exchange(&provider->busy, true)) {
+        return;     // deduplicated
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    provider->next = NULL;
+    if (queue->tail != NULL) {
+        queue->tail->next = provider;
+    } else {
+        queue->head = provider;
+    }
+    queue->tail = provider;
+    pthread_cond_signal(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static void *providerTask(void *arg)
+{
+    ProviderQueue *queue = &providerQueue;
+
+    while (true) {
+        Provider *provider;
+        int value;
+
+        pthread_mutex_lock(&queue->lock);
+        while (queue->head == NULL) {
+            pthread_cond_wait(&queue->cond, &queue->lock);
+        }
+        provider = queue->head;
+        if ((queue->head = provider->next) == NULL) {
+            queue->tail = NULL;
+        }
+        pthread_mutex_unlock(&queue->lock);
+
+        // On failure the cached value is kept, and the
+        // next request queues another read.
+        if (provider->readFunc(provider->arg, provider->timeout, &value)) {
+            atomic_store(&provider->value, value);
+            atomic_store(&provider->readTime, nowMsec());
+            atomic_store(&provider->fresh, true);
+            atomic_fetch_add(&provider->reads, 1);
+            atomic_store(&provider->busy, false);
+            if (queue->notifyFunc != NULL) {
+                queue->notifyFunc();
+            }
+        } else {
+            atomic_fetch_add(&provider->failures, 1);
+            atomic_store(&provider->busy, false);
+        }
+    }
+
+    return NULL;
+}
+
+int providerStart(ProviderNotifyFunc *notifyFunc)
+{
+    pthread_t thread;
+
+    providerQueue.notifyFunc = notifyFunc;
+
+    if (pthread_create(&thread, NULL, providerTask, NULL) != 0) {
+        return -1;
+    }
+
+    for (size_t n = 0; n < numProviders; n++) {
+        providerQueueRead(providers[n]);
+    }
+
+    return 0;
+}
+
+bool providerGet(Provider *provider, int *value)
+{
+    uint64_t readTime = atomic_load(&provider->readTime);
+
+    if ((readTime == 0) || ((nowMsec() - readTime) >= provider->ttl)) {
+        providerQueueRead(provider);
+    }
+
+    if (readTime == 0) {
+        return false;
+    }
+
+    *value = atomic_load(&provider->value);
+
+    return true;
+}
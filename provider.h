@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+// Lazy value providers, for the objects whose values are
+// expensive to read (e.g. an I2C sensor, or a command that
+// takes tens of msec). The value of a provider is only read
+// when it's requested and the cached value is older than the
+// provider's TTL. The reads are done by a worker thread, so
+// the requester never blocks: it's served the cached value,
+// stale or not, and concurrent requests for a stale value
+// result in a single read.
+
+// Read the value of a provider, within the timeout (msec).
+// Returns false on error.
+typedef bool (ProviderReadFunc)(const char *arg, uint64_t timeout, int *value);
+
+typedef struct Provider {
+    ProviderReadFunc *readFunc;
+    const char *arg;
+    uint64_t ttl;                   // msec
+    uint64_t timeout;               // msec
+    atomic_int value;               // cached value
+    _Atomic uint64_t readTime;      // when the value was read (msec); 0 means never
+    atomic_bool busy;               // a read is queued or in progress
+    atomic_bool fresh;              // a new value was read
+    atomic_ulong reads;
+    atomic_ulong failures;
+    struct Provider *next;          // in the worker's queue
+} Provider;
+
+// Called by the worker after each successful read
+typedef void (ProviderNotifyFunc)(void);
+
+// Built-in read functions: run a shell command, or read a
+// file (e.g. a sysfs attribute), and parse the integer at
+// the start of its output. A command that doesn't exit within
+// the timeout is killed, along with the commands it started,
+// and the read fails. The timeout doesn't apply to the files.
+extern bool providerReadCommand(const char *command, uint64_t timeout, int *value);
+extern bool providerReadFile(const char *path, uint64_t timeout, int *value);
+
+extern Provider *providerCreate(ProviderReadFunc *readFunc, const char *arg, uint64_t ttl, uint64_t timeout);
+
+// Start the worker thread, and queue the initial read of
+// all the providers created so far.
+extern int providerStart(ProviderNotifyFunc *notifyFunc);
+
+// Get the cached value, and queue a read if it's older than
+// the TTL. Returns false if no value was read yet. Never
+// blocks.
+extern bool providerGet(Provider *provider, int *value);
+
+__END_DECLS
@@ -0,0 +1,180 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+
+#include "shmRing.h"
+
+struct ShmRing {
+    ShmRingHdr *hdr;
+    ShmRingRecord *records;
+    uint64_t mask;
+    int eventFd;                // signaled when there are records to drain
+    int drainedFd;              // signaled when the ring has been drained
+};
+
+static bool shmRingEmpty(const ShmRing *ring)
+{
+    uint64_t head = atomic_load_explicit(&ring->hdr->head, memory_order_relaxed);
+
+    return (atomic_load_explicit(&ring->records[head & ring->mask].seq, memory_order_acquire) != (head + 1));
+}
+
+ShmRing *shmRingCreate(const char *shmName, uint32_t numRecords, uint32_t numObjects)
+{
+    ShmRing *ring;
+    uint64_t objectsOffset, recordsOffset, size;
+    uint32_t n = 1;
+    int fd;
+
+    while (n < numRecords) {
+        n *= 2;
+    }
+
+    objectsOffset = sizeof (ShmRingHdr);
+    recordsOffset = (objectsOffset + (numObjects * sizeof (ShmRingObject)) + 63) & ~63ul;
+    size = recordsOffset + (n * sizeof (ShmRingRecord));
+
+    if ((ring = calloc(1, sizeof (ShmRing))) == NULL) {
+        return NULL;
+    }
+
+    // Start from scratch, as producers of a previous
+    // instance may still have the old ring mapped
+    shm_unlink(shmName);
+
+    if ((fd = shm_open(shmName, (O_RDWR | O_CREAT | O_EXCL), 0660)) == -1) {
+        free(ring);
+        return NULL;
+    }
+
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        free(ring);
+        return NULL;
+    }
+
+    ring->hdr = mmap(NULL, size, (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (ring->hdr == MAP_FAILED) {
+        free(ring);
+        return NULL;
+    }
+
+    ring->hdr->numRecords = n;
+    ring->hdr->numObjects = numObjects;
+    ring->hdr->objectsOffset = objectsOffset;
+    ring->hdr->recordsOffset = recordsOffset;
+    ring->records = shmRingRecords(ring->hdr);
+    ring->mask = n - 1;
+    ring->eventFd = -1;
+    ring->drainedFd = -1;
+
+    // Slot n is free for the record at position n
+    for (uint64_t pos = 0; pos < n; pos++) {
+        atomic_init(&ring->records[pos].seq, pos);
+    }
+
+    return ring;
+}
+
+void shmRingSetObject(ShmRing *ring, uint32_t n, const char *name, uint32_t objectId)
+{
+    ShmRingObject *object = (ShmRingObject *) ((char *) ring->hdr + ring->hdr->objectsOffset) + n;
+
+    strncpy(object->name, name, (SHM_RING_NAME_LEN - 1));
+    object->objectId = objectId;
+}
+
+// Wait on the futex for the producers to add records, and
+// forward the wake up to the eventfd polled by the MIB update
+// task. A futex can't be polled, hence this thread.
+static void *shmRingWaitTask(void *arg)
+{
+    ShmRing *ring = arg;
+    ShmRingHdr *hdr = ring->hdr;
+
+    while (true) {
+        const uint64_t one = 1;
+        uint64_t count;
+
+        atomic_store_explicit(&hdr->waiting, 1, memory_order_relaxed);
+
+        // Pairs with the fence in shmRingPut()
+        atomic_thread_fence(memory_order_seq_cst);
+
+        if (shmRingEmpty(ring)) {
+            // Returns right away if a producer already
+            // cleared the waiting flag
+            syscall(SYS_futex, &hdr->waiting, FUTEX_WAIT, 1, NULL, NULL, 0);
+            continue;
+        }
+
+        atomic_store_explicit(&hdr->waiting, 0, memory_order_relaxed);
+
+        // Let the MIB update task drain the ring, and
+        // wait for it to be done.
+        if ((write(ring->eventFd, &one, sizeof (one)) != sizeof (one)) ||
+            ((read(ring->drainedFd, &count, sizeof (count)) < 0) && (errno != EINTR))) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+int shmRingStart(ShmRing *ring)
+{
+    pthread_t thread;
+
+    ring->hdr->magic = SHM_RING_MAGIC;
+    ring->hdr->version = SHM_RING_VERSION;
+
+    if (((ring->eventFd = eventfd(0, (EFD_NONBLOCK | EFD_CLOEXEC))) == -1) ||
+        ((ring->drainedFd = eventfd(0, EFD_CLOEXEC)) == -1) ||
+        (pthread_create(&thread, NULL, shmRingWaitTask, ring) != 0)) {
+        return -1;
+    }
+
+    return ring->eventFd;
+}
+
+size_t shmRingDrain(ShmRing *ring, ShmRingRecordFunc *recordFunc)
+{
+    const uint64_t one = 1;
+    uint64_t head = atomic_load_explicit(&ring->hdr->head, memory_order_relaxed);
+    uint64_t count;
+    size_t numRecords;
+
+    if (read(ring->eventFd, &count, sizeof (count)) < 0) {
+        return 0;   // nothing to drain
+    }
+
+    // Drain at most one ring's worth of records, so that
+    // fast producers can't keep us here forever
+    for (numRecords = 0; numRecords <= ring->mask; numRecords++) {
+        ShmRingRecord *rec = &ring->records[head & ring->mask];
+
+        if (atomic_load_explicit(&rec->seq, memory_order_acquire) != (head + 1)) {
+            break;
+        }
+
+        recordFunc(rec->objectId, rec->value, rec->timestamp);
+
+        // Free the slot for the record at position
+        // head + numRecords
+        atomic_store_explicit(&rec->seq, (head + ring->mask + 1), memory_order_release);
+        head++;
+    }
+
+    atomic_store_explicit(&ring->hdr->head, head, memory_order_relaxed);
+
+    // Let the wait task go back to waiting
+    if (write(ring->drainedFd, &one, sizeof (one)) != sizeof (one)) {
+        // Can't happen: an eventfd write only fails on
+        // counter overflow
+    }
+
+    return numRecords;
+}
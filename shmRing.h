@@ -0,0 +1,192 @@
+#pragma once
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/cdefs.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+__BEGIN_DECLS
+
+// Shared memory ingest channel, used by high-rate producers to
+// update the values of the read-only MIB objects without going
+// through the data file.
+//
+// The subagent creates a POSIX shared memory object with a ring
+// of {objectId, value, timestamp} records, and a directory that
+// maps the object names (as used in the data file) to their
+// objectId. Any number of producers can add records to the
+// ring concurrently; each record slot carries a sequence number
+// that tells whether it's free or holds a record, so the ring
+// needs no locks. The MIB update task drains the ring in
+// batches. A producer only wakes up the subagent (via a futex)
+// when it's waiting for new records.
+//
+// The producer side is implemented by the inline functions
+// below, so a producer only needs to include this header:
+//
+//     ShmRingHdr *ring = shmRingOpen("/snmpSubagent");
+//     int32_t id = shmRingLookup(ring, "ac1Temp");
+//     shmRingPut(ring, id, 21, 0);
+
+#define SHM_RING_MAGIC      0x474e4952  // "RING"
+#define SHM_RING_VERSION    1
+#define SHM_RING_NAME_LEN   64
+
+typedef struct ShmRingRecord {
+    _Atomic uint64_t seq;       // position + 1 when it holds a record
+    uint32_t objectId;
+    int32_t value;
+    uint64_t timestamp;         // producer defined; e.g. CLOCK_REALTIME nsec
+} ShmRingRecord;
+
+typedef struct ShmRingObject {
+    char name[SHM_RING_NAME_LEN];
+    uint32_t objectId;
+} ShmRingObject;
+
+typedef struct ShmRingHdr {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numRecords;        // power of 2
+    uint32_t numObjects;
+    uint64_t objectsOffset;     // ShmRingObject[numObjects]
+    uint64_t recordsOffset;     // ShmRingRecord[numRecords]
+
+    // Written by the producers
+    _Atomic uint64_t tail __attribute__ ((aligned(64)));
+    _Atomic uint64_t dropped;   // records dropped because the ring was full
+
+    // Written by the subagent
+    _Atomic uint64_t head __attribute__ ((aligned(64)));
+    _Atomic uint32_t waiting;   // futex: the subagent waits for records
+} ShmRingHdr;
+
+static inline ShmRingRecord *shmRingRecords(const ShmRingHdr *ring)
+{
+    return (ShmRingRecord *) ((char *) ring + ring->recordsOffset);
+}
+
+// Producer: map the ring created by the subagent. Returns
+// NULL on error.
+static inline ShmRingHdr *shmRingOpen(const char *shmName)
+{
+    ShmRingHdr *ring;
+    struct stat statBuf;
+    int fd;
+
+    if ((fd = shm_open(shmName, O_RDWR, 0)) == -1) {
+        return NULL;
+    }
+
+    if ((fstat(fd, &statBuf) != 0) || (statBuf.st_size < (off_t) sizeof (ShmRingHdr))) {
+        close(fd);
+        return NULL;
+    }
+
+    ring = mmap(NULL, statBuf.st_size, (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (ring == MAP_FAILED) {
+        return NULL;
+    }
+
+    if ((ring->magic != SHM_RING_MAGIC) || (ring->version != SHM_RING_VERSION)) {
+        munmap(ring, statBuf.st_size);
+        return NULL;
+    }
+
+    return ring;
+}
+
+// Producer: get the objectId of the specified object. Returns
+// -1 if the object can't be updated through the ring.
+static inline int32_t shmRingLookup(const ShmRingHdr *ring, const char *name)
+{
+    const ShmRingObject *objects = (const ShmRingObject *) ((const char *) ring + ring->objectsOffset);
+
+    for (uint32_t n = 0; n < ring->numObjects; n++) {
+        if (strncmp(objects[n].name, name, SHM_RING_NAME_LEN) == 0) {
+            return objects[n].objectId;
+        }
+    }
+
+    return -1;
+}
+
+// Producer: add a record to the ring. Returns -1 if the ring
+// is full, in which case the record is dropped.
+static inline int shmRingPut(ShmRingHdr *ring, uint32_t objectId, int32_t value, uint64_t timestamp)
+{
+    ShmRingRecord *records = shmRingRecords(ring);
+    uint64_t mask = ring->numRecords - 1;
+    uint64_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    ShmRingRecord *rec;
+
+    // Claim the slot at the tail of the ring
+    while (true) {
+        int64_t diff;
+
+        rec = &records[pos & mask];
+        diff = (int64_t) (atomic_load_explicit(&rec->seq, memory_order_acquire) - pos);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->tail, &pos, (pos + 1), memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // The subagent didn't drain this slot yet
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            return -1;
+        } else {
+            // Another producer claimed it
+            pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        }
+    }
+
+    rec->objectId = objectId;
+    rec->value = value;
+    rec->timestamp = timestamp;
+    atomic_store_explicit(&rec->seq, (pos + 1), memory_order_release);
+
+    // Wake up the subagent, if it's waiting. The fence orders
+    // the store of the record before the load of the waiting
+    // flag; it pairs with the one in the subagent.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ring->waiting, memory_order_relaxed) &&
+        atomic_exchange_explicit(&ring->waiting, 0, memory_order_relaxed)) {
+        syscall(SYS_futex, &ring->waiting, FUTEX_WAKE, 1, NULL, NULL, 0);
+    }
+
+    return 0;
+}
+
+// Subagent side
+
+typedef struct ShmRing ShmRing;
+
+// Called for each record drained from the ring
+typedef void (ShmRingRecordFunc)(uint32_t objectId, int32_t value, uint64_t timestamp);
+
+// Create the ring, with room for numRecords (rounded up to a
+// power of 2) records and numObjects directory entries.
+extern ShmRing *shmRingCreate(const char *shmName, uint32_t numRecords, uint32_t numObjects);
+
+// Set the n-th entry of the object directory
+extern void shmRingSetObject(ShmRing *ring, uint32_t n, const char *name, uint32_t objectId);
+
+// Start waiting for records. Returns the file descriptor that
+// becomes readable when the ring has records to drain.
+extern int shmRingStart(ShmRing *ring);
+
+// Drain the records currently in the ring. Returns the number
+// of records drained.
+extern size_t shmRingDrain(ShmRing *ring, ShmRingRecordFunc *recordFunc);
+
+__END_DECLS
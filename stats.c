@@ -0,0 +1,95 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats.h"
+
+const char *statsCounterNames[NUM_STATS_COUNTERS] = {
+    [STATS_DATA_PASSES] = "dataPasses",
+    [STATS_DATA_RECORDS] = "dataRecords",
+    [STATS_RECORDS_REJECTED] = "recordsRejected",
+    [STATS_SHM_RECORDS] = "shmRecords",
+    [STATS_SOCKET_MSGS] = "socketMsgs",
+    [STATS_PUBLISHES] = "publishes",
+    [STATS_GET_REQUESTS] = "getRequests",
+    [STATS_GETNEXT_REQUESTS] = "getNextRequests",
+    [STATS_SET_REQUESTS] = "setRequests",
+    [STATS_REQUEST_ERRORS] = "requestErrors",
+    [STATS_SCHED_REFRESHES] = "schedRefreshes",
+    [STATS_SCHED_COALESCED] = "schedCoalesced",
+    [STATS_SCHED_DEFERRED] = "schedDeferred",
+};
+
+const char *statsHistNames[NUM_STATS_HISTS] = {
+    [STATS_PARSE_TIME] = "parseTime",
+    [STATS_UPDATE_LATENCY] = "updateLatency",
+    [STATS_REQUEST_TIME] = "requestTime",
+};
+
+__thread StatsBlock *statsThreadBlock;
+
+// The blocks of all the threads. Blocks are never freed, so
+// the list can be walked without holding the lock.
+static StatsBlock *_Atomic statsBlocks;
+
+static pthread_mutex_t lastErrorLock = PTHREAD_MUTEX_INITIALIZER;
+static char lastError[256];
+static time_t lastErrorTime;
+
+StatsBlock *statsBlockGet(void)
+{
+    static StatsBlock fallbackBlock;
+    StatsBlock *block;
+
+    if ((block = calloc(1, sizeof (StatsBlock))) == NULL) {
+        // Share a block; the counts may be off, but
+        // the callers don't have to check
+        statsThreadBlock = &fallbackBlock;
+        return statsThreadBlock;
+    }
+
+    block->next = atomic_load(&statsBlocks);
+    while (!atomic_compare_exchange_weak(&statsBlocks, &block->next, block)) {
+        ;
+    }
+
+    statsThreadBlock = block;
+
+    return block;
+}
+
+void statsError(const char *msg)
+{
+    pthread_mutex_lock(&lastErrorLock);
+    snprintf(lastError, sizeof (lastError), "%s", msg);
+    lastErrorTime = time(NULL);
+    pthread_mutex_unlock(&lastErrorLock);
+}
+
+void statsRead(StatsTotals *totals)
+{
+    memset(totals, 0, sizeof (*totals));
+
+    for (StatsBlock *block = atomic_load(&statsBlocks); block != NULL; block = block->next) {
+        for (int n = 0; n < NUM_STATS_COUNTERS; n++) {
+            totals->counters[n] += atomic_load_explicit(&block->counters[n], memory_order_relaxed);
+        }
+        for (int h = 0; h < NUM_STATS_HISTS; h++) {
+            for (int b = 0; b < STATS_NUM_BUCKETS; b++) {
+                unsigned long count = atomic_load_explicit(&block->buckets[h][b], memory_order_relaxed);
+                totals->buckets[h][b] += count;
+                totals->counts[h] += count;
+            }
+            totals->sums[h] += atomic_load_explicit(&block->sums[h], memory_order_relaxed);
+        }
+    }
+}
+
+void statsLastError(char *buf, size_t len, time_t *when)
+{
+    pthread_mutex_lock(&lastErrorLock);
+    snprintf(buf, len, "%s", lastError);
+    *when = lastErrorTime;
+    pthread_mutex_unlock(&lastErrorLock);
+}
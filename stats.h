@@ -0,0 +1,140 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <time.h>
+
+__BEGIN_DECLS
+
+// Self-monitoring counters and latency histograms. Each thread
+// updates its own block of counters, with plain (uncontended)
+// relaxed stores, and the blocks of all the threads are only
+// summed up when the statistics are read.
+
+typedef enum StatsCounter {
+    STATS_DATA_PASSES,          // passes over the data file
+    STATS_DATA_RECORDS,         // records read from the data and delta files
+    STATS_RECORDS_REJECTED,     // invalid or unsupported records
+    STATS_SHM_RECORDS,          // records drained from the shm ring
+    STATS_SOCKET_MSGS,          // datagrams read from the update socket
+    STATS_PUBLISHES,            // generations of values published
+    STATS_GET_REQUESTS,
+    STATS_GETNEXT_REQUESTS,
+    STATS_SET_REQUESTS,
+    STATS_REQUEST_ERRORS,       // varbinds that got an error
+    STATS_SCHED_REFRESHES,      // staged values applied when due
+    STATS_SCHED_COALESCED,      // staged values replaced before being applied
+    STATS_SCHED_DEFERRED,       // data file records not parsed, as not due
+    NUM_STATS_COUNTERS
+} StatsCounter;
+
+typedef enum StatsHist {
+    STATS_PARSE_TIME,           // time to parse the data file (usec)
+    STATS_UPDATE_LATENCY,       // time from an update to its publication (usec)
+    STATS_REQUEST_TIME,         // time to serve a request (usec)
+    NUM_STATS_HISTS
+} StatsHist;
+
+// HDR-style log buckets: STATS_SUB_BUCKETS linear sub-buckets
+// per power of 2, so the bucket width is within 12.5% of its
+// values, from 0 up to 2^32 usec.
+#define STATS_SUB_BITS      3
+#define STATS_SUB_BUCKETS   (1 << STATS_SUB_BITS)
+#define STATS_NUM_BUCKETS   ((32 - STATS_SUB_BITS + 1) * STATS_SUB_BUCKETS)
+
+typedef struct StatsBlock {
+    atomic_ulong counters[NUM_STATS_COUNTERS];
+    atomic_ulong buckets[NUM_STATS_HISTS][STATS_NUM_BUCKETS];
+    atomic_ulong sums[NUM_STATS_HISTS];
+    struct StatsBlock *next;
+} StatsBlock;
+
+typedef struct StatsTotals {
+    unsigned long counters[NUM_STATS_COUNTERS];
+    unsigned long buckets[NUM_STATS_HISTS][STATS_NUM_BUCKETS];
+    unsigned long counts[NUM_STATS_HISTS];
+    unsigned long sums[NUM_STATS_HISTS];
+} StatsTotals;
+
+extern const char *statsCounterNames[NUM_STATS_COUNTERS];
+extern const char *statsHistNames[NUM_STATS_HISTS];
+
+extern __thread StatsBlock *statsThreadBlock;
+
+// Get the calling thread's block, creating it on first use
+extern StatsBlock *statsBlockGet(void);
+
+static inline void statsBump(atomic_ulong *counter, unsigned long n)
+{
+    // Only the owner thread writes to its block
+    atomic_store_explicit(counter, (atomic_load_explicit(counter, memory_order_relaxed) + n), memory_order_relaxed);
+}
+
+static inline void statsAdd(StatsCounter counter, unsigned long n)
+{
+    StatsBlock *block = (statsThreadBlock != NULL) ? statsThreadBlock : statsBlockGet();
+
+    statsBump(&block->counters[counter], n);
+}
+
+static inline void statsInc(StatsCounter counter)
+{
+    statsAdd(counter, 1);
+}
+
+static inline unsigned statsBucket(uint64_t usec)
+{
+    unsigned msb;
+
+    if (usec < STATS_SUB_BUCKETS) {
+        return usec;
+    } else if (usec >= (1ull << 32)) {
+        return (STATS_NUM_BUCKETS - 1);
+    }
+
+    msb = 63 - __builtin_clzll(usec);
+
+    return ((msb - STATS_SUB_BITS + 1) * STATS_SUB_BUCKETS) + ((usec >> (msb - STATS_SUB_BITS)) & (STATS_SUB_BUCKETS - 1));
+}
+
+// Lowest value of the bucket
+static inline uint64_t statsBucketLow(unsigned bucket)
+{
+    unsigned msb;
+
+    if (bucket < STATS_SUB_BUCKETS) {
+        return bucket;
+    }
+
+    msb = (bucket / STATS_SUB_BUCKETS) + STATS_SUB_BITS - 1;
+
+    return (uint64_t) (STATS_SUB_BUCKETS + (bucket % STATS_SUB_BUCKETS)) << (msb - STATS_SUB_BITS);
+}
+
+static inline void statsRecord(StatsHist hist, uint64_t usec)
+{
+    StatsBlock *block = (statsThreadBlock != NULL) ? statsThreadBlock : statsBlockGet();
+
+    statsBump(&block->buckets[hist][statsBucket(usec)], 1);
+    statsBump(&block->sums[hist], usec);
+}
+
+// Elapsed time between two CLOCK_MONOTONIC readings, in usec
+static inline uint64_t statsUsec(const struct timespec *start, const struct timespec *end)
+{
+    int64_t usec = ((int64_t) (end->tv_sec - start->tv_sec) * 1000000) + ((end->tv_nsec - start->tv_nsec) / 1000);
+
+    return (usec > 0) ? (uint64_t) usec : 0;
+}
+
+// Keep the message as the last error
+extern void statsError(const char *msg);
+
+// Sum up the blocks of all the threads
+extern void statsRead(StatsTotals *totals);
+
+// Get the last error, and the time it happened (0 if none)
+extern void statsLastError(char *buf, size_t len, time_t *when);
+
+__END_DECLS
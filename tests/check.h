@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdio.h>
+
+// The checks of the tests: a failed check is reported, with
+// its location, and counted, and the test goes on. Each test
+// ends with "return checkResult(__FILE__);".
+
+static int numFailures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, __func__, #cond); \
+            numFailures++; \
+        } \
+    } while (0)
+
+// Print whether the test passed, and return its exit status
+static inline int checkResult(const char *file)
+{
+    printf("%s: %s\n", file, (numFailures == 0) ? "PASS" : "FAIL");
+
+    return (numFailures == 0) ? 0 : 1;
+}
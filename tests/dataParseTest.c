@@ -0,0 +1,117 @@
+// Tests of the data file parsing: the split of the buffers in
+// lines, whatever their length, and the decoding of the
+// values, which must reject what sscanf() would silently
+// accept, or truncate.
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "dataParse.h"
+
+typedef struct Lines {
+    char text[8][512];
+    size_t num;
+} Lines;
+
+static void addLine(void *arg, const char *line, const char *eol)
+{
+    Lines *lines = arg;
+
+    if (lines->num < 8) {
+        snprintf(lines->text[lines->num++], sizeof (lines->text[0]), "%.*s", (int) (eol - line), line);
+    }
+}
+
+static void testLines(void)
+{
+    static const char text[] = "a,1\n# comment\n\n\r\nb,2\r\nc,3";
+    char longLine[400];
+    char buf[512];
+    Lines lines = { 0 };
+
+    CHECK(parseLines(text, strlen(text), addLine, &lines) == 3);
+    CHECK(lines.num == 3);
+    CHECK(strcmp(lines.text[0], "a,1") == 0);
+    CHECK(strcmp(lines.text[1], "b,2\r") == 0);     // the '\r' is left to the value parser
+    CHECK(strcmp(lines.text[2], "c,3") == 0);       // no newline at the end
+
+    // Only the first len bytes are parsed
+    lines.num = 0;
+    CHECK(parseLines(text, 2, addLine, &lines) == 1);
+    CHECK(strcmp(lines.text[0], "a,") == 0);
+
+    lines.num = 0;
+    CHECK(parseLines(text, 0, addLine, &lines) == 0);
+    CHECK(lines.num == 0);
+
+    // A line longer than the 256 bytes of the old fgets()
+    // buffer isn't split
+    memset(longLine, 'x', (sizeof (longLine) - 1));
+    longLine[sizeof (longLine) - 1] = '\0';
+    snprintf(buf, sizeof (buf), "%s,1\nd,4\n", longLine);
+    lines.num = 0;
+    CHECK(parseLines(buf, strlen(buf), addLine, &lines) == 2);
+    CHECK(strlen(lines.text[0]) == (strlen(longLine) + 2));
+    CHECK(strcmp(lines.text[1], "d,4") == 0);
+}
+
+static bool parseIntStr(const char *str, int *value)
+{
+    return parseInt(str, (str + strlen(str)), value);
+}
+
+static bool parseUintStr(const char *str, uint64_t maxValue, uint64_t *value)
+{
+    return parseUint(str, (str + strlen(str)), maxValue, value);
+}
+
+static void testInt(void)
+{
+    static const char *invalid[] = {
+        "", " ", "-", "+", "a1", "1a", "1 2", "0x10", "1.5", "--1", "2147483648", "-2147483649", "99999999999999999999",
+    };
+    int value;
+
+    CHECK(parseIntStr("0", &value) && (value == 0));
+    CHECK(parseIntStr("42", &value) && (value == 42));
+    CHECK(parseIntStr("-7", &value) && (value == -7));
+    CHECK(parseIntStr("+3", &value) && (value == 3));
+    CHECK(parseIntStr(" \t12 \t\r", &value) && (value == 12));
+    CHECK(parseIntStr("007", &value) && (value == 7));
+    CHECK(parseIntStr("2147483647", &value) && (value == INT_MAX));
+    CHECK(parseIntStr("-2147483648", &value) && (value == INT_MIN));
+
+    for (size_t n = 0; n < (sizeof (invalid) / sizeof (invalid[0])); n++) {
+        value = 1234;
+        CHECK(!parseIntStr(invalid[n], &value));
+        CHECK(value == 1234);   // unchanged
+    }
+
+    // The value ends where the line ends
+    CHECK(parseInt("123,456", ("123,456" + 3), &value) && (value == 123));
+}
+
+static void testUint(void)
+{
+    uint64_t value;
+
+    CHECK(parseUintStr("0", UINT32_MAX, &value) && (value == 0));
+    CHECK(parseUintStr(" +4294967295\r", UINT32_MAX, &value) && (value == UINT32_MAX));
+    CHECK(!parseUintStr("4294967296", UINT32_MAX, &value));
+    CHECK(parseUintStr("18446744073709551615", UINT64_MAX, &value) && (value == UINT64_MAX));
+    CHECK(!parseUintStr("18446744073709551616", UINT64_MAX, &value));
+    CHECK(!parseUintStr("-1", UINT64_MAX, &value));
+    CHECK(!parseUintStr("", UINT64_MAX, &value));
+    CHECK(!parseUintStr("12x", UINT64_MAX, &value));
+}
+
+int main(void)
+{
+    testLines();
+    testInt();
+    testUint();
+
+    return checkResult(__FILE__);
+}
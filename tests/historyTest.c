@@ -0,0 +1,119 @@
+// Tests of the sample history: the rolling aggregates of each
+// value must match the ones computed from scratch over the same
+// window, through the wrap of the ring and with the values
+// interleaved, for any depth and any sequence of samples.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "history.h"
+
+#define NUM_VALUES      7
+#define NUM_SAMPLES     5000
+
+// Aggregates of the last count of the given samples
+static void bruteAggr(const int *samples, unsigned count, HistoryAggr *aggr)
+{
+    long long sum = 0;
+
+    aggr->count = count;
+    aggr->min = aggr->max = samples[0];
+    for (unsigned n = 0; n < count; n++) {
+        sum += samples[n];
+        aggr->min = (samples[n] < aggr->min) ? samples[n] : aggr->min;
+        aggr->max = (samples[n] > aggr->max) ? samples[n] : aggr->max;
+    }
+    aggr->mean = (int) ((sum >= 0) ? ((sum + (count / 2)) / count) : ((sum - (count / 2)) / count));
+}
+
+static void testInit(void)
+{
+    History history;
+
+    CHECK(historyInit(&history, 10, 0) != 0);
+    CHECK(historyInit(&history, 10, (HISTORY_MAX_DEPTH + 1)) != 0);
+
+    CHECK(historyInit(&history, 10, 300) == 0);
+    CHECK(history.arenaSize == (10 * ((300 * 8) + sizeof (HistoryHdr))));
+}
+
+static void testEmpty(void)
+{
+    History history;
+    HistoryAggr aggr;
+
+    CHECK(historyInit(&history, 2, 5) == 0);
+
+    memset(&aggr, 0xff, sizeof (aggr));
+    historyAggr(&history, 1, &aggr);
+    CHECK((aggr.count == 0) && (aggr.min == 0) && (aggr.max == 0) && (aggr.mean == 0));
+}
+
+// Each kind of sequence makes the queues behave differently:
+// the monotonic ones keep a single candidate in one queue and
+// all of them in the other, and the random ones a few of each
+static int sampleValue(unsigned kind, unsigned n, unsigned *seed)
+{
+    switch (kind) {
+    case 0:
+        return (int) n;
+    case 1:
+        return -(int) n;
+    case 2:
+        return 42;
+    case 3:
+        return (rand_r(seed) % 21) - 10;
+    default:
+        return (rand_r(seed) % 2000001) - 1000000;
+    }
+}
+
+static void testAggr(unsigned depth, unsigned kind)
+{
+    History history;
+    int *samples = malloc(NUM_VALUES * NUM_SAMPLES * sizeof (int));
+    unsigned seed = depth + kind;
+
+    CHECK(historyInit(&history, NUM_VALUES, depth) == 0);
+
+    for (unsigned n = 0; n < NUM_SAMPLES; n++) {
+        for (unsigned v = 0; v < NUM_VALUES; v++) {
+            unsigned count = ((n + 1) < depth) ? (n + 1) : depth;
+            HistoryAggr aggr, expected;
+            int *valueSamples = &samples[v * NUM_SAMPLES];
+
+            valueSamples[n] = sampleValue(kind, n, &seed);
+            historyAdd(&history, v, valueSamples[n]);
+
+            historyAggr(&history, v, &aggr);
+            bruteAggr(&valueSamples[n + 1 - count], count, &expected);
+            if ((aggr.count != expected.count) || (aggr.min != expected.min) || (aggr.max != expected.max) ||
+                (aggr.mean != expected.mean)) {
+                fprintf(stderr, "%s: depth %u, kind %u, value %u, sample %u: got %u/%d/%d/%d, expected %u/%d/%d/%d\n",
+                        __func__, depth, kind, v, n, aggr.count, aggr.min, aggr.max, aggr.mean,
+                        expected.count, expected.min, expected.max, expected.mean);
+                numFailures++;
+                free(samples);
+                return;
+            }
+        }
+    }
+
+    free(samples);
+}
+
+int main(void)
+{
+    static const unsigned depths[] = { 1, 2, 3, 17, 300, NUM_SAMPLES };
+
+    testInit();
+    testEmpty();
+    for (size_t n = 0; n < (sizeof (depths) / sizeof (depths[0])); n++) {
+        for (unsigned kind = 0; kind < 5; kind++) {
+            testAggr(depths[n], kind);
+        }
+    }
+
+    return checkResult(__FILE__);
+}
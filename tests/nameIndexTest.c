@@ -0,0 +1,95 @@
+// Tests of the name index: every name added is found, also in
+// place in a larger buffer, and the names that weren't added,
+// the prefixes and extensions of the ones that were, and the
+// duplicates, are not.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "nameIndex.h"
+
+#define NUM_NAMES   10000
+
+static char names[NUM_NAMES][32];
+
+static void testEmpty(void)
+{
+    NameIndex idx = { 0 };
+
+    // Not even initialized
+    CHECK(nameIndexFind(&idx, "ac1Temp", 7) == NULL);
+
+    CHECK(nameIndexInit(&idx, 0) == 0);
+    CHECK(nameIndexFind(&idx, "ac1Temp", 7) == NULL);
+    CHECK(nameIndexFind(&idx, "", 0) == NULL);
+    nameIndexFree(&idx);
+}
+
+static void testFind(void)
+{
+    NameIndex idx;
+    char line[64];
+
+    CHECK(nameIndexInit(&idx, NUM_NAMES) == 0);
+
+    for (size_t n = 0; n < NUM_NAMES; n++) {
+        snprintf(names[n], sizeof (names[n]), "sensor%zuTemp", n);
+        CHECK(nameIndexAdd(&idx, names[n], &names[n]) == 0);
+    }
+
+    for (size_t n = 0; n < NUM_NAMES; n++) {
+        // The name of a data file line, which isn't
+        // null-terminated
+        size_t len = strlen(names[n]);
+
+        snprintf(line, sizeof (line), "%s,%zu\n", names[n], n);
+        CHECK(nameIndexFind(&idx, line, len) == &names[n]);
+
+        // A prefix, and an extension, of the name
+        CHECK(nameIndexFind(&idx, line, (len - 1)) != &names[n]);
+        CHECK(nameIndexFind(&idx, line, (len + 1)) == NULL);
+    }
+
+    CHECK(nameIndexFind(&idx, "sensorTemp", 10) == NULL);
+    CHECK(nameIndexFind(&idx, "", 0) == NULL);
+
+    // Duplicates are rejected, and don't replace the item
+    snprintf(line, sizeof (line), "%s", names[42]);
+    CHECK(nameIndexAdd(&idx, line, NULL) != 0);
+    CHECK(nameIndexFind(&idx, names[42], strlen(names[42])) == &names[42]);
+
+    nameIndexFree(&idx);
+}
+
+static void testFull(void)
+{
+    NameIndex idx;
+    size_t n;
+
+    CHECK(nameIndexInit(&idx, 5) == 0);
+
+    // Exactly maxNames names fit, in at most half of the slots
+    for (n = 0; n < NUM_NAMES; n++) {
+        if (nameIndexAdd(&idx, names[n], &names[n]) != 0) {
+            break;
+        }
+    }
+    CHECK(n == 5);
+    CHECK((2 * n) <= (idx.mask + 1));
+
+    for (size_t k = 0; k < n; k++) {
+        CHECK(nameIndexFind(&idx, names[k], strlen(names[k])) == &names[k]);
+    }
+
+    nameIndexFree(&idx);
+}
+
+int main(void)
+{
+    testEmpty();
+    testFind();
+    testFull();
+
+    return checkResult(__FILE__);
+}
@@ -0,0 +1,285 @@
+// Restart and crash tests of the persistent store: the values
+// must survive a restart, and a crash at any point must leave
+// the store in a state that's consistent with what was synced.
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "persist.h"
+
+#define NUM_KEYS        64
+#define NUM_KILLS       20
+
+static char dirPath[PATH_MAX];
+static char statePath[PATH_MAX + 8];
+static char journalPath[PATH_MAX + 24];
+static char tmpPath[PATH_MAX + 24];
+
+static uint64_t testKey(int n)
+{
+    return 0x1000 + n;
+}
+
+static void removeFiles(void)
+{
+    unlink(statePath);
+    unlink(journalPath);
+    unlink(tmpPath);
+}
+
+static int32_t getValue(PersistStore *ps, int n)
+{
+    int32_t value;
+
+    if (!persistGet(ps, persistSlot(ps, testKey(n)), &value)) {
+        return -1;
+    }
+
+    return value;
+}
+
+static void putValues(PersistStore *ps, int32_t value)
+{
+    for (int n = 0; n < NUM_KEYS; n++) {
+        persistPut(ps, persistSlot(ps, testKey(n)), value);
+    }
+}
+
+static void checkValues(PersistStore *ps, int32_t value)
+{
+    for (int n = 0; n < NUM_KEYS; n++) {
+        CHECK(getValue(ps, n) == value);
+    }
+}
+
+static size_t fileSize(const char *path)
+{
+    struct stat statBuf;
+
+    return (stat(path, &statBuf) == 0) ? (size_t) statBuf.st_size : 0;
+}
+
+static void *readFile(const char *path, size_t *len)
+{
+    FILE *fp = fopen(path, "r");
+    void *buf;
+
+    *len = fileSize(path);
+    if ((fp == NULL) || ((buf = malloc(*len + 1)) == NULL) || (fread(buf, 1, *len, fp) != *len)) {
+        abort();
+    }
+    fclose(fp);
+
+    return buf;
+}
+
+static void writeFile(const char *path, const void *buf, size_t len)
+{
+    FILE *fp = fopen(path, "w");
+
+    if ((fp == NULL) || (fwrite(buf, 1, len, fp) != len)) {
+        abort();
+    }
+    fclose(fp);
+}
+
+// The journaled values are replayed after a restart
+static void testJournalReplay(void)
+{
+    PersistStore ps;
+
+    removeFiles();
+    CHECK(persistOpen(&ps, statePath, NUM_KEYS) == 0);
+    checkValues(&ps, -1);
+    putValues(&ps, 7);
+    CHECK(persistFlush(&ps) == 0);
+    persistClose(&ps);
+
+    CHECK(persistOpen(&ps, statePath, NUM_KEYS) == 0);
+    checkValues(&ps, 7);
+
+    // ... and folded into a new snapshot
+    CHECK(fileSize(journalPath) == sizeof (PersistJournalHdr));
+    persistClose(&ps);
+}
+
+// The values set without journaling are saved by a snapshot
+static void testSnapshot(void)
+{
+    PersistStore ps;
+
+    removeFiles();
+    CHECK(persistOpen(&ps, statePath, NUM_KEYS) == 0);
+    for (int n = 0; n < NUM_KEYS; n++) {
+        persistSet(&ps, persistSlot(&ps, testKey(n)), 11);
+    }
+    CHECK(persistSnapshot(&ps) == 0);
+    CHECK(fileSize(journalPath) == sizeof (PersistJournalHdr));
+    persistClose(&ps);
+
+    CHECK(persistOpen(&ps, statePath, NUM_KEYS) == 0);
+    checkValues(&ps, 11);
+    persistClose(&ps);
+}
+
+// A crash after the new snapshot is renamed in place, but
+// before the journal is emptied, must not replay the older
+// records of the journal over the snapshot.
+static void testCrashBeforeJournalReset(void)
+{
+    PersistStore ps;
+    size_t len;
+    void *journal;
+
+    removeFiles();
+    CHECK(persistOpen(&ps, statePath, NUM_KEYS) == 0);
+    putValues(&ps, 1);
+    CHECK(persistFlush(&ps) == 0);
+    journal = readFile(journalPath, &len);
+
+    for (int n = 0; n < NUM_KEYS; n++) {
+        persistSet(&ps, persistSlot(&ps, testKey(n)), 2);
+    }
+    CHECK(persistSnapshot(&ps) == 0);
+    persistClose(&ps);
+
+    writeFile(journalPath, journal, len);
+    free(journal);
+
+    CHECK(persistOpen(&ps, statePath, NUM_KEYS) == 0);
+    checkValues(&ps, 2);
+    persistClose(&ps);
+}
+
+// A crash while the new snapshot is written leaves a partial
+// temp file, which is ignored: the old snapshot and its
+// journal are used.
+static void testCrashDuringSnapshot(void)
+{
+    PersistStore ps;
+    size_t len;
+    void *snapshot;
+
+    removeFiles();
+    CHECK(persistOpen(&ps, statePath, NUM_KEYS) == 0);
+    putValues(&ps, 3);
+    CHECK(persistSnapshot(&ps) == 0);
+    putValues(&ps, 4);
+    CHECK(persistFlush(&ps) == 0);
+    persistClose(&ps);
+
+    snapshot = readFile(statePath, &len);
+    memset(snapshot, 0xff, (len / 2));
+    writeFile(tmpPath, snapshot, (len / 2));
+    free(snapshot);
+
+    CHECK(persistOpen(&ps, statePath, NUM_KEYS) == 0);
+    checkValues(&ps, 4);
+    persistClose(&ps);
+}
+
+// A record torn by a crash ends the journal; the ones
+// before it are replayed.
+static void testTornRecord(void)
+{
+    PersistStore ps;
+    PersistRecord rec = { .key = testKey(0), .value = 99, .check = 0 };
+    int fd;
+
+    removeFiles();
+    CHECK(persistOpen(&ps, statePath, NUM_KEYS) == 0);
+    putValues(&ps, 5);
+    CHECK(persistFlush(&ps) == 0);
+    persistClose(&ps);
+
+    CHECK((fd = open(journalPath, (O_WRONLY | O_APPEND))) != -1);
+    CHECK(write(fd, &rec, (sizeof (rec) / 2)) == (sizeof (rec) / 2));
+    close(fd);
+
+    CHECK(persistOpen(&ps, statePath, NUM_KEYS) == 0);
+    checkValues(&ps, 5);
+    persistClose(&ps);
+}
+
+// Kill a child that keeps changing, flushing, and snapshotting
+// the values at random points. After each kill, every value
+// must be at least the last one the child reported as synced,
+// and at most the last one it set.
+static void testKill(void)
+{
+    volatile int32_t *progress = mmap(NULL, (2 * sizeof (int32_t)), (PROT_READ | PROT_WRITE), (MAP_SHARED | MAP_ANONYMOUS), -1, 0);
+
+    CHECK(progress != MAP_FAILED);
+    removeFiles();
+    srandom(time(NULL));
+
+    for (int numKills = 0; numKills < NUM_KILLS; numKills++) {
+        struct timespec delay = { 0, ((random() % 20) + 1) * 1000000 };
+        PersistStore ps;
+        pid_t pid;
+        int status;
+
+        if ((pid = fork()) == 0) {
+            if (persistOpen(&ps, statePath, NUM_KEYS) != 0) {
+                _exit(1);
+            }
+            for (int32_t value = progress[0] + 1; ; value++) {
+                progress[1] = value;
+                putValues(&ps, value);
+                if (((value % 8) == 0) ? (persistSnapshot(&ps) != 0) : (persistFlush(&ps) != 0)) {
+                    _exit(1);
+                }
+                progress[0] = value;
+            }
+        }
+
+        CHECK(pid != -1);
+        nanosleep(&delay, NULL);
+        kill(pid, SIGKILL);
+        CHECK(waitpid(pid, &status, 0) == pid);
+        CHECK(WIFSIGNALED(status));
+
+        CHECK(persistOpen(&ps, statePath, NUM_KEYS) == 0);
+        for (int n = 0; n < NUM_KEYS; n++) {
+            int32_t value = getValue(&ps, n);
+            CHECK((value >= progress[0]) && (value <= progress[1]));
+        }
+        persistClose(&ps);
+    }
+}
+
+int main(void)
+{
+    const char *tmpDir = getenv("TMPDIR");
+
+    snprintf(dirPath, sizeof (dirPath), "%s/persistTest.XXXXXX", (tmpDir != NULL) ? tmpDir : "/tmp");
+    if (mkdtemp(dirPath) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(statePath, sizeof (statePath), "%s/state", dirPath);
+    snprintf(journalPath, sizeof (journalPath), "%s.journal", statePath);
+    snprintf(tmpPath, sizeof (tmpPath), "%s.tmp", statePath);
+
+    testJournalReplay();
+    testSnapshot();
+    testCrashBeforeJournalReset();
+    testCrashDuringSnapshot();
+    testTornRecord();
+    testKill();
+
+    removeFiles();
+    rmdir(dirPath);
+
+    return checkResult(__FILE__);
+}
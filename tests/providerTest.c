@@ -0,0 +1,103 @@
+// Test of the command providers: the value is parsed from the
+// output of the command, which must succeed, and a command that
+// doesn't exit within the timeout is killed, along with the
+// commands it started, without waiting for them.
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "provider.h"
+
+static uint64_t nowMsec(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t) now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+// Is the process alive? An orphan that was killed may stay a
+// zombie until it's reaped by init.
+static bool isRunning(int pid)
+{
+    char path[64], state = 'X';
+    FILE *fp;
+
+    snprintf(path, sizeof (path), "/proc/%d/stat", pid);
+    if ((fp = fopen(path, "r")) == NULL) {
+        return false;
+    }
+    if (fscanf(fp, "%*d %*s %c", &state) != 1) {
+        state = 'X';
+    }
+    fclose(fp);
+
+    return (state != 'Z') && (state != 'X');
+}
+
+static void testOutput(void)
+{
+    int value = 0;
+
+    CHECK(providerReadCommand("echo 42", 1000, &value) && (value == 42));
+    CHECK(providerReadCommand("printf '%s' -7", 1000, &value) && (value == -7));
+
+    // Only the start of a long output is parsed
+    CHECK(providerReadCommand("echo 123; seq 1 100000", 5000, &value) && (value == 123));
+
+    // Failures
+    CHECK(!providerReadCommand("echo 42; exit 1", 1000, &value));
+    CHECK(!providerReadCommand("echo abc", 1000, &value));
+    CHECK(!providerReadCommand("true", 1000, &value));
+    CHECK(!providerReadCommand("kill -9 $$", 1000, &value));
+}
+
+static void testTimeout(void)
+{
+    char pidFile[] = "/tmp/providerTestXXXXXX";
+    char command[128];
+    uint64_t start;
+    int value = 0;
+    FILE *fp;
+    int fd;
+    int pid = 0;
+
+    // The command keeps writing, but never exits
+    start = nowMsec();
+    CHECK(!providerReadCommand("while true; do echo 1; done", 200, &value));
+    CHECK((nowMsec() - start) < 2000);
+
+    // The command exits, but leaves a command holding its
+    // output open: it's killed too
+    CHECK((fd = mkstemp(pidFile)) != -1);
+    close(fd);
+    snprintf(command, sizeof (command), "sleep 30 & echo $! > %s; echo 5", pidFile);
+    start = nowMsec();
+    CHECK(!providerReadCommand(command, 200, &value));
+    CHECK((nowMsec() - start) < 2000);
+
+    CHECK((fp = fopen(pidFile, "r")) != NULL);
+    if (fp != NULL) {
+        CHECK(fscanf(fp, "%d", &pid) == 1);
+        fclose(fp);
+    }
+    usleep(50000);
+    CHECK((pid > 0) && !isRunning(pid));
+    unlink(pidFile);
+
+    // The command closes its output, but doesn't exit
+    start = nowMsec();
+    CHECK(!providerReadCommand("echo 5; exec >&-; sleep 30", 200, &value));
+    CHECK((nowMsec() - start) < 2000);
+}
+
+int main(void)
+{
+    testOutput();
+    testTimeout();
+
+    return checkResult(__FILE__);
+}
@@ -0,0 +1,193 @@
+// Tests of the self-monitoring statistics, meant to be run
+// under the ThreadSanitizer: the bucket math of the latency
+// histograms, and the per-thread counters, which must add up
+// exactly once the writers are done, and never go backwards
+// while they are read concurrently.
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "stats.h"
+
+#define NUM_WRITERS     8
+#define NUM_UPDATES     100000
+
+static atomic_bool writersDone;
+
+static void checkBucket(uint64_t usec)
+{
+    unsigned bucket = statsBucket(usec);
+    uint64_t low = statsBucketLow(bucket);
+
+    if (usec >= (1ull << 32)) {
+        CHECK(bucket == (STATS_NUM_BUCKETS - 1));
+        return;
+    }
+
+    CHECK(bucket < STATS_NUM_BUCKETS);
+    CHECK(low <= usec);
+    if (bucket < (STATS_NUM_BUCKETS - 1)) {
+        uint64_t high = statsBucketLow(bucket + 1);
+
+        CHECK(usec < high);
+        // Within 12.5% of the values of the bucket
+        CHECK(((high - low) == 1) || ((8 * (high - low)) <= low));
+    }
+}
+
+static void testBuckets(void)
+{
+    unsigned last = 0;
+
+    for (uint64_t usec = 0; usec < (1 << 16); usec++) {
+        unsigned bucket = statsBucket(usec);
+
+        checkBucket(usec);
+        CHECK((bucket == last) || (bucket == (last + 1)));
+        last = bucket;
+    }
+
+    for (unsigned shift = 16; shift < 40; shift++) {
+        uint64_t pow = 1ull << shift;
+
+        checkBucket(pow - 1);
+        checkBucket(pow);
+        checkBucket(pow + 1);
+        checkBucket(pow + (pow / 3));
+    }
+    checkBucket(UINT64_MAX);
+
+    // Each bucket starts where the previous one ends
+    for (unsigned bucket = 0; bucket < STATS_NUM_BUCKETS; bucket++) {
+        CHECK(statsBucket(statsBucketLow(bucket)) == bucket);
+    }
+    CHECK(statsBucket((1ull << 32) - 1) == (STATS_NUM_BUCKETS - 1));
+}
+
+static void testNames(void)
+{
+    for (int n = 0; n < NUM_STATS_COUNTERS; n++) {
+        CHECK(statsCounterNames[n] != NULL);
+        for (int k = 0; (k < n) && (statsCounterNames[n] != NULL); k++) {
+            CHECK(strcmp(statsCounterNames[n], statsCounterNames[k]) != 0);
+        }
+    }
+    for (int n = 0; n < NUM_STATS_HISTS; n++) {
+        CHECK(statsHistNames[n] != NULL);
+    }
+}
+
+static void *writerTask(void *arg)
+{
+    uintptr_t id = (uintptr_t) arg;
+
+    for (unsigned long n = 0; n < NUM_UPDATES; n++) {
+        statsInc(STATS_GET_REQUESTS);
+        statsAdd(STATS_DATA_RECORDS, 3);
+        statsRecord(STATS_REQUEST_TIME, (n % 1000));
+        if ((n % 10000) == 0) {
+            char msg[64];
+
+            snprintf(msg, sizeof (msg), "writer %lu update %lu", (unsigned long) id, n);
+            statsError(msg);
+        }
+    }
+
+    return NULL;
+}
+
+// Read the totals while the writers run: each one must be at
+// least the previous one
+static void *readerTask(void *arg)
+{
+    unsigned long lastGets = 0, lastRecords = 0, lastCount = 0;
+    StatsTotals *totals = malloc(sizeof (StatsTotals));
+    char msg[256];
+    time_t when;
+
+    while (!atomic_load(&writersDone)) {
+        statsRead(totals);
+
+        CHECK(totals->counters[STATS_GET_REQUESTS] >= lastGets);
+        CHECK(totals->counters[STATS_DATA_RECORDS] >= lastRecords);
+        CHECK(totals->counts[STATS_REQUEST_TIME] >= lastCount);
+        CHECK(totals->counters[STATS_GET_REQUESTS] <= (NUM_WRITERS * NUM_UPDATES));
+        lastGets = totals->counters[STATS_GET_REQUESTS];
+        lastRecords = totals->counters[STATS_DATA_RECORDS];
+        lastCount = totals->counts[STATS_REQUEST_TIME];
+
+        statsLastError(msg, sizeof (msg), &when);
+        CHECK((msg[0] == '\0') || (strncmp(msg, "writer ", 7) == 0));
+    }
+
+    free(totals);
+
+    return NULL;
+}
+
+static void testThreads(void)
+{
+    pthread_t writers[NUM_WRITERS], reader;
+    StatsTotals *totals = malloc(sizeof (StatsTotals));
+    unsigned long sum = 0;
+    char msg[256];
+    time_t when;
+
+    pthread_create(&reader, NULL, readerTask, NULL);
+    for (uintptr_t n = 0; n < NUM_WRITERS; n++) {
+        pthread_create(&writers[n], NULL, writerTask, (void *) n);
+    }
+    for (int n = 0; n < NUM_WRITERS; n++) {
+        pthread_join(writers[n], NULL);
+    }
+    atomic_store(&writersDone, true);
+    pthread_join(reader, NULL);
+
+    // The blocks of the threads that exited still count
+    statsRead(totals);
+    CHECK(totals->counters[STATS_GET_REQUESTS] == (NUM_WRITERS * NUM_UPDATES));
+    CHECK(totals->counters[STATS_DATA_RECORDS] == (3 * NUM_WRITERS * NUM_UPDATES));
+    CHECK(totals->counters[STATS_SET_REQUESTS] == 0);
+    CHECK(totals->counts[STATS_REQUEST_TIME] == (NUM_WRITERS * NUM_UPDATES));
+    CHECK(totals->counts[STATS_PARSE_TIME] == 0);
+    for (unsigned long n = 0; n < NUM_UPDATES; n++) {
+        sum += (n % 1000);
+    }
+    CHECK(totals->sums[STATS_REQUEST_TIME] == (NUM_WRITERS * sum));
+    CHECK(totals->buckets[STATS_REQUEST_TIME][statsBucket(0)] == (NUM_WRITERS * (NUM_UPDATES / 1000)));
+
+    statsLastError(msg, sizeof (msg), &when);
+    CHECK(strncmp(msg, "writer ", 7) == 0);
+    CHECK(when != 0);
+
+    free(totals);
+}
+
+static void testLastError(void)
+{
+    char longMsg[400], msg[256];
+    time_t when;
+
+    memset(longMsg, 'e', (sizeof (longMsg) - 1));
+    longMsg[sizeof (longMsg) - 1] = '\0';
+    statsError(longMsg);
+
+    statsLastError(msg, sizeof (msg), &when);
+    CHECK(strlen(msg) == 255);
+
+    statsLastError(msg, 8, &when);
+    CHECK(strcmp(msg, "eeeeeee") == 0);
+}
+
+int main(void)
+{
+    testBuckets();
+    testNames();
+    testThreads();
+    testLastError();
+
+    return checkResult(__FILE__);
+}
@@ -0,0 +1,178 @@
+// Stress test of the ValueStore, meant to be run under the
+// ThreadSanitizer: a writer publishes generations that change
+// a few values, many values, or all of them, in two columns
+// of different value sizes, while a reader checks that each
+// snapshot is exactly one published generation, in both
+// columns, and that the generations never go backwards.
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "valueStore.h"
+
+#define NUM_VALUES      4096
+#define NUM_GENS        20000
+#define NUM_COLUMNS     2
+
+typedef struct StressTest {
+    ValueStore store;
+    size_t valueSizes[NUM_COLUMNS];
+    atomic_bool done;
+} StressTest;
+
+static uint32_t mix(uint64_t x)
+{
+    x *= 0x9e3779b97f4a7c15ull;
+    return (uint32_t) (x >> 32) ^ (uint32_t) x;
+}
+
+// Each value is filled with copies of a 32-bit word, so that
+// a torn value is detected too
+static void setValue(void *values, size_t valueSize, size_t index, uint32_t word)
+{
+    uint32_t *value = (uint32_t *) ((char *) values + (index * valueSize));
+
+    for (size_t n = 0; n < (valueSize / sizeof (uint32_t)); n++) {
+        value[n] = word;
+    }
+}
+
+// Apply the changes of a generation to the values of a
+// column, marking them in the store if any. The first value
+// holds the generation.
+static void applyGen(void *values, size_t valueSize, unsigned long gen, ValueStore *vs, unsigned column)
+{
+    size_t maxDirty = (NUM_VALUES / 8);
+
+    if ((gen % 97) == 0) {
+        for (size_t index = 1; index < NUM_VALUES; index++) {
+            setValue(values, valueSize, index, mix((gen << 16) + index));
+        }
+        if ((vs != NULL) && (column == 0)) {
+            valueStoreMarkAll(vs);
+        }
+    } else {
+        // Every 13th generation changes more values
+        // than the store lists
+        size_t count = ((gen % 13) == 0) ? (maxDirty + 8) : ((gen % 7) + 1);
+
+        for (size_t n = 0; n < count; n++) {
+            size_t index = 1 + (mix((gen << 16) + (column << 8) + n) % (NUM_VALUES - 1));
+
+            setValue(values, valueSize, index, mix((gen << 32) + index));
+            if (vs != NULL) {
+                valueStoreMarkColumn(vs, column, index);
+            }
+        }
+    }
+
+    setValue(values, valueSize, 0, gen);
+    if (vs != NULL) {
+        valueStoreMarkColumn(vs, column, 0);
+    }
+}
+
+static void *writerTask(void *arg)
+{
+    StressTest *test = arg;
+
+    for (unsigned long gen = 1; gen <= NUM_GENS; gen++) {
+        for (unsigned column = 0; column < NUM_COLUMNS; column++) {
+            applyGen(valueStoreWork(&test->store, column), test->valueSizes[column], gen, &test->store, column);
+        }
+        valueStorePublish(&test->store);
+    }
+
+    atomic_store(&test->done, true);
+
+    return NULL;
+}
+
+static void *readerTask(void *arg)
+{
+    StressTest *test = arg;
+    void *models[NUM_COLUMNS];
+    unsigned long lastGen = 0;
+    unsigned long numReads = 0;
+
+    for (unsigned column = 0; column < NUM_COLUMNS; column++) {
+        models[column] = calloc(NUM_VALUES, test->valueSizes[column]);
+    }
+
+    while (!atomic_load(&test->done)) {
+        const void *values = valueStoreSnapshot(&test->store);
+        unsigned long gen = *(const uint32_t *) values;
+
+        CHECK(gen >= lastGen);
+
+        if (gen > lastGen) {
+            for (lastGen++; lastGen <= gen; lastGen++) {
+                for (unsigned column = 0; column < NUM_COLUMNS; column++) {
+                    applyGen(models[column], test->valueSizes[column], lastGen, NULL, column);
+                }
+            }
+            lastGen = gen;
+
+            // All the columns are of the same generation
+            for (unsigned column = 0; column < NUM_COLUMNS; column++) {
+                CHECK(memcmp(valueStoreColumn(&test->store, column), models[column],
+                             (NUM_VALUES * test->valueSizes[column])) == 0);
+            }
+        }
+
+        // Hold on to the snapshot now and then, so that
+        // the writer gets back buffers that are many
+        // generations old.
+        if ((++numReads % 64) == 0) {
+            usleep(200);
+        }
+    }
+
+    for (unsigned column = 0; column < NUM_COLUMNS; column++) {
+        free(models[column]);
+    }
+
+    return NULL;
+}
+
+static void stressTest(size_t valueSize, size_t valueSize2)
+{
+    StressTest test = { .valueSizes = { valueSize, valueSize2 } };
+    pthread_t writer, reader;
+
+    CHECK(valueStoreInit(&test.store, NUM_VALUES, valueSize) == 0);
+    CHECK(valueStoreAddColumn(&test.store, NUM_VALUES, valueSize2) == 1);
+    atomic_init(&test.done, false);
+
+    CHECK(pthread_create(&reader, NULL, readerTask, &test) == 0);
+    CHECK(pthread_create(&writer, NULL, writerTask, &test) == 0);
+    pthread_join(writer, NULL);
+    pthread_join(reader, NULL);
+
+    // The last generation is complete
+    valueStoreSnapshot(&test.store);
+    for (unsigned column = 0; column < NUM_COLUMNS; column++) {
+        void *model = calloc(NUM_VALUES, test.valueSizes[column]);
+
+        for (unsigned long gen = 1; gen <= NUM_GENS; gen++) {
+            applyGen(model, test.valueSizes[column], gen, NULL, column);
+        }
+        CHECK(memcmp(valueStoreColumn(&test.store, column), model, (NUM_VALUES * test.valueSizes[column])) == 0);
+        free(model);
+    }
+
+    // Columns can't be added once a generation was published
+    CHECK(valueStoreAddColumn(&test.store, NUM_VALUES, valueSize) == -1);
+}
+
+int main(void)
+{
+    stressTest(sizeof (uint32_t), sizeof (uint64_t));
+    stressTest(sizeof (uint64_t), 24);
+    stressTest(24, sizeof (uint32_t));
+
+    return checkResult(__FILE__);
+}
@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "timerWheel.h"
+
+#define TW_MASK     (TW_SIZE - 1)
+
+int timerWheelInit(TimerWheel *tw, size_t numTimers, uint64_t now)
+{
+    tw->now = now;
+    tw->numArmed = 0;
+
+    // All bits set is TW_NONE
+    memset(tw->level0, 0xff, sizeof (tw->level0));
+    memset(tw->level1, 0xff, sizeof (tw->level1));
+
+    if (((tw->next = calloc((numTimers + 1), sizeof (uint32_t))) == NULL) ||
+        ((tw->expires = calloc((numTimers + 1), sizeof (uint64_t))) == NULL)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void timerWheelInsert(TimerWheel *tw, uint32_t timer)
+{
+    uint64_t expires = tw->expires[timer];
+    uint32_t *bucket;
+
+    if ((expires - tw->now) < TW_SIZE) {
+        bucket = &tw->level0[expires & TW_MASK];
+    } else if (((expires >> TW_BITS) - (tw->now >> TW_BITS)) < TW_SIZE) {
+        bucket = &tw->level1[(expires >> TW_BITS) & TW_MASK];
+    } else {
+        // Too far out: park it in the last level 1 bucket,
+        // and insert it again when that bucket is cascaded
+        bucket = &tw->level1[((tw->now >> TW_BITS) + TW_MASK) & TW_MASK];
+    }
+
+    tw->next[timer] = *bucket;
+    *bucket = timer;
+}
+
+void timerWheelArm(TimerWheel *tw, uint32_t timer, uint64_t expires)
+{
+    // The bucket of the current tick has already fired
+    tw->expires[timer] = (expires > tw->now) ? expires : (tw->now + 1);
+    timerWheelInsert(tw, timer);
+    tw->numArmed++;
+}
+
+void timerWheelAdvance(TimerWheel *tw, uint64_t now, TimerWheelFunc *fireFunc)
+{
+    while (tw->now < now) {
+        uint64_t tick = tw->now + 1;
+        uint32_t timer;
+
+        if (tw->numArmed == 0) {
+            tw->now = now;  // nothing to do
+            break;
+        }
+
+        tw->now = tick;
+
+        // Cascade the level 1 bucket that covers the next
+        // TW_SIZE ticks down to level 0; the timers due at
+        // this very tick land in its level 0 bucket.
+        if ((tick & TW_MASK) == 0) {
+            uint32_t *bucket = &tw->level1[(tick >> TW_BITS) & TW_MASK];
+            timer = *bucket;
+            *bucket = TW_NONE;
+            while (timer != TW_NONE) {
+                uint32_t next = tw->next[timer];
+                timerWheelInsert(tw, timer);
+                timer = next;
+            }
+        }
+
+        // Fire the timers of this tick. The fire function
+        // may arm them again.
+        timer = tw->level0[tick & TW_MASK];
+        tw->level0[tick & TW_MASK] = TW_NONE;
+        while (timer != TW_NONE) {
+            uint32_t next = tw->next[timer];
+            tw->numArmed--;
+            fireFunc(timer);
+            timer = next;
+        }
+    }
+}
+
+uint64_t timerWheelTimeout(const TimerWheel *tw)
+{
+    uint64_t tick;
+
+    if (tw->numArmed == 0) {
+        return UINT64_MAX;
+    }
+
+    // Scan level 0 up to the next cascade
+    for (tick = (tw->now + 1); (tick & TW_MASK) != 0; tick++) {
+        if (tw->level0[tick & TW_MASK] != TW_NONE) {
+            break;
+        }
+    }
+
+    return (tick - tw->now);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+// Hierarchical timer wheel, with two levels of TW_SIZE buckets.
+// Level 0 holds the timers that expire within the next TW_SIZE
+// ticks, one bucket per tick; level 1 holds the later ones, one
+// bucket per TW_SIZE ticks, and its buckets are cascaded down to
+// level 0 as time advances. Arming a timer, and firing it, are
+// O(1), and advancing the wheel only visits the buckets of the
+// ticks that elapsed.
+//
+// The timers are identified by their index, and linked through
+// arrays rather than pointers; a timer MUST NOT be armed again
+// before it fires.
+#define TW_BITS     8
+#define TW_SIZE     (1u << TW_BITS)
+#define TW_NONE     UINT32_MAX
+
+typedef struct TimerWheel {
+    uint64_t now;               // current tick
+    uint32_t *next;             // next timer in the same bucket
+    uint64_t *expires;          // tick at which each timer expires
+    size_t numArmed;
+    uint32_t level0[TW_SIZE];
+    uint32_t level1[TW_SIZE];
+} TimerWheel;
+
+// Called for each timer that expires
+typedef void (TimerWheelFunc)(uint32_t timer);
+
+extern int timerWheelInit(TimerWheel *tw, size_t numTimers, uint64_t now);
+
+// Arm the timer to expire at the specified tick
+extern void timerWheelArm(TimerWheel *tw, uint32_t timer, uint64_t expires);
+
+// Advance the wheel to the specified tick, firing all the
+// timers that expired
+extern void timerWheelAdvance(TimerWheel *tw, uint64_t now, TimerWheelFunc *fireFunc);
+
+// Get the number of ticks until the wheel needs to be advanced
+// again, or UINT64_MAX if no timer is armed
+extern uint64_t timerWheelTimeout(const TimerWheel *tw);
+
+__END_DECLS
@@ -0,0 +1,196 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "trapQueue.h"
+
+// Per alarm coalescing state, kept in an open addressing
+// hash table indexed by the alarm source.
+typedef struct TrapUnit {
+    size_t key;                 // alarm source + 1; 0 means the slot is empty
+    int acUnit;                 // A/C unit reported in the traps
+    bool pending;               // the alarm has a trap in the queue
+    int pendingState;           // alarm state of the pending trap
+    bool sent;                  // a trap has been sent for the alarm
+    int sentState;              // alarm state of the last trap sent
+    uint64_t sentTime;          // when the last trap was sent (msec)
+} TrapUnit;
+
+// The queue is a bounded ring of alarms with a pending trap.
+// It is filled by the MIB update task and drained by the AgentX
+// thread; the lock is only held for a few instructions at a
+// time, and never while a trap is being sent.
+typedef struct TrapQueue {
+    pthread_mutex_t lock;
+    TrapUnit **ring;
+    size_t capacity;
+    size_t head;                // next entry to send
+    size_t count;               // number of pending entries
+    TrapUnit *units;
+    size_t unitMask;            // number of unit slots - 1
+    unsigned rate;              // token bucket fill rate (traps/sec)
+    unsigned burst;             // token bucket size
+    double tokens;
+    uint64_t lastFill;          // when the bucket was last filled (msec)
+    unsigned window;            // coalescing window (msec)
+    TrapQueueStats stats;
+} TrapQueue;
+
+static TrapQueue trapQueue = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static uint64_t nowMsec(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t) now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+int trapQueueInit(size_t capacity, size_t numAlarms, unsigned rate, unsigned burst, unsigned window)
+{
+    TrapQueue *tq = &trapQueue;
+    size_t numSlots = 16;
+
+    // Keep the load factor at or below 50%
+    while (numSlots < (2 * numAlarms)) {
+        numSlots *= 2;
+    }
+
+    if (((tq->ring = calloc(capacity, sizeof (TrapUnit *))) == NULL) ||
+        ((tq->units = calloc(numSlots, sizeof (TrapUnit))) == NULL)) {
+        return -1;
+    }
+
+    tq->capacity = capacity;
+    tq->unitMask = numSlots - 1;
+    tq->rate = rate;
+    tq->burst = (burst != 0) ? burst : 1;
+    tq->tokens = tq->burst;
+    tq->lastFill = nowMsec();
+    tq->window = window;
+
+    return 0;
+}
+
+// Find (or add) the coalescing state of the alarm. Returns
+// NULL if the table is full.
+static TrapUnit *trapUnitGet(TrapQueue *tq, size_t source, int acUnit)
+{
+    size_t key = source + 1;
+    size_t start = ((uint32_t) key * 2654435761u) & tq->unitMask;
+    size_t n = start;
+
+    do {
+        TrapUnit *unit = &tq->units[n];
+        if (unit->key == key) {
+            unit->acUnit = acUnit;
+            return unit;
+        } else if (unit->key == 0) {
+            unit->key = key;
+            unit->acUnit = acUnit;
+            return unit;
+        }
+        n = (n + 1) & tq->unitMask;
+    } while (n != start);
+
+    return NULL;
+}
+
+void trapQueuePut(size_t source, int acUnit, int alarmState)
+{
+    TrapQueue *tq = &trapQueue;
+    TrapUnit *unit;
+
+    pthread_mutex_lock(&tq->lock);
+
+    if ((unit = trapUnitGet(tq, source, acUnit)) == NULL) {
+        tq->stats.dropped++;
+    } else if (unit->pending) {
+        // Merge with the pending trap
+        unit->pendingState = alarmState;
+        tq->stats.coalesced++;
+    } else if (unit->sent && (unit->sentState == alarmState) && ((nowMsec() - unit->sentTime) < tq->window)) {
+        // Same state that was just sent
+        tq->stats.coalesced++;
+    } else if (tq->count == tq->capacity) {
+        tq->stats.dropped++;
+    } else {
+        unit->pending = true;
+        unit->pendingState = alarmState;
+        tq->ring[(tq->head + tq->count) % tq->capacity] = unit;
+        tq->count++;
+        tq->stats.queued++;
+    }
+
+    pthread_mutex_unlock(&tq->lock);
+}
+
+size_t trapQueueDrain(TrapSendFunc *sendFunc)
+{
+    TrapQueue *tq = &trapQueue;
+    size_t pending;
+
+    while (true) {
+        uint64_t now = nowMsec();
+        TrapUnit *unit;
+        int acUnit, alarmState;
+        bool send;
+
+        pthread_mutex_lock(&tq->lock);
+
+        // Refill the token bucket
+        if (tq->rate != 0) {
+            tq->tokens += ((double) (now - tq->lastFill) * tq->rate) / 1000.0;
+            if (tq->tokens > tq->burst) {
+                tq->tokens = tq->burst;
+            }
+            tq->lastFill = now;
+        }
+
+        if ((tq->count == 0) || ((tq->rate != 0) && (tq->tokens < 1.0))) {
+            pending = tq->count;
+            pthread_mutex_unlock(&tq->lock);
+            break;
+        }
+
+        unit = tq->ring[tq->head];
+        tq->head = (tq->head + 1) % tq->capacity;
+        tq->count--;
+
+        unit->pending = false;
+        acUnit = unit->acUnit;
+        alarmState = unit->pendingState;
+
+        // The pending trap may have flapped back to the
+        // state that was last sent.
+        send = !unit->sent || (unit->sentState != alarmState) || ((now - unit->sentTime) >= tq->window);
+        if (send) {
+            unit->sent = true;
+            unit->sentState = alarmState;
+            unit->sentTime = now;
+            tq->tokens -= 1.0;
+            tq->stats.sent++;
+        } else {
+            tq->stats.coalesced++;
+        }
+
+        pthread_mutex_unlock(&tq->lock);
+
+        if (send) {
+            sendFunc(acUnit, alarmState);
+        }
+    }
+
+    return pending;
+}
+
+void trapQueueGetStats(TrapQueueStats *stats)
+{
+    pthread_mutex_lock(&trapQueue.lock);
+    *stats = trapQueue.stats;
+    pthread_mutex_unlock(&trapQueue.lock);
+}
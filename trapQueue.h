@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+typedef struct TrapQueueStats {
+    unsigned long queued;       // transitions added to the queue
+    unsigned long sent;         // traps sent
+    unsigned long coalesced;    // transitions merged with a pending or recently sent one
+    unsigned long dropped;      // transitions dropped because the queue was full
+} TrapQueueStats;
+
+// Function used to send the trap for a change in the
+// state of an alarm of an A/C unit.
+typedef int (TrapSendFunc)(int acUnit, int alarmState);
+
+// Create the trap queue, with room for up to capacity pending
+// traps. The queue keeps track of up to numAlarms distinct
+// alarms for coalescing. The traps are sent at a maximum rate
+// of rate traps/sec, with bursts of up to burst traps; a rate
+// of 0 means no rate limit. A transition to the same state
+// last sent for an alarm within window msec is coalesced.
+extern int trapQueueInit(size_t capacity, size_t numAlarms, unsigned rate, unsigned burst, unsigned window);
+
+// Queue the trap for a change in the state of an alarm. The
+// source identifies the alarm, and acUnit is the A/C unit it
+// reports, so that alarms bound to the same unit (e.g. a
+// scalar and a row of the acUnitTable) are queued, and
+// coalesced, on their own. If the alarm already has a pending
+// trap, its state is simply updated.
+extern void trapQueuePut(size_t source, int acUnit, int alarmState);
+
+// Send the pending traps, as allowed by the rate limit.
+// Returns the number of traps still pending.
+extern size_t trapQueueDrain(TrapSendFunc *sendFunc);
+
+extern void trapQueueGetStats(TrapQueueStats *stats);
+
+__END_DECLS
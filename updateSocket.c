@@ -0,0 +1,88 @@
+#define _GNU_SOURCE     // recvmmsg()
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "updateSocket.h"
+
+// Max number of recvmmsg() calls per updateSocketRecv(), so
+// that a collector that never stops sending can't keep the
+// caller from its other work
+#define MAX_BATCHES     16
+
+int updateSocketOpen(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int fd;
+
+    if (strlen(path) >= sizeof (addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    if ((fd = socket(AF_UNIX, (SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC), 0)) == -1) {
+        return -1;
+    }
+
+    // Remove the socket left behind by a previous instance
+    unlink(path);
+
+    if ((bind(fd, (struct sockaddr *) &addr, sizeof (addr)) != 0) ||
+        (chmod(path, 0660) != 0)) {
+        int errNo = errno;
+        close(fd);
+        errno = errNo;
+        return -1;
+    }
+
+    return fd;
+}
+
+ssize_t updateSocketRecv(int fd, UpdateSocketMsgFunc *msgFunc, size_t *numTruncated)
+{
+    static char bufs[UPDATE_SOCKET_BATCH][UPDATE_SOCKET_MSG_SIZE];
+    struct iovec iovs[UPDATE_SOCKET_BATCH];
+    struct mmsghdr msgs[UPDATE_SOCKET_BATCH];
+    ssize_t numMsgs = 0;
+
+    for (int batch = 0; batch < MAX_BATCHES; batch++) {
+        int n;
+
+        for (int m = 0; m < UPDATE_SOCKET_BATCH; m++) {
+            iovs[m].iov_base = bufs[m];
+            iovs[m].iov_len = sizeof (bufs[m]);
+            memset(&msgs[m].msg_hdr, 0, sizeof (msgs[m].msg_hdr));
+            msgs[m].msg_hdr.msg_iov = &iovs[m];
+            msgs[m].msg_hdr.msg_iovlen = 1;
+        }
+
+        if ((n = recvmmsg(fd, msgs, UPDATE_SOCKET_BATCH, MSG_DONTWAIT, NULL)) == -1) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) {
+                break;
+            }
+            return -1;
+        }
+
+        for (int m = 0; m < n; m++) {
+            if (msgs[m].msg_hdr.msg_flags & MSG_TRUNC) {
+                (*numTruncated)++;
+            } else {
+                msgFunc(bufs[m], msgs[m].msg_len);
+            }
+        }
+
+        numMsgs += n;
+
+        if (n < UPDATE_SOCKET_BATCH) {
+            break;      // drained
+        }
+    }
+
+    return numMsgs;
+}
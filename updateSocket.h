@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+__BEGIN_DECLS
+
+// Local datagram socket used by collectors to stream batches
+// of updates to the subagent. Each datagram is one batch.
+#define UPDATE_SOCKET_MSG_SIZE  65536   // max datagram size
+#define UPDATE_SOCKET_BATCH     32      // datagrams per recvmmsg()
+
+// Called for each datagram received
+typedef void (UpdateSocketMsgFunc)(const char *buf, size_t len);
+
+// Bind a non-blocking Unix datagram socket to the specified
+// path. Returns the socket, or -1 on error.
+extern int updateSocketOpen(const char *path);
+
+// Receive the pending datagrams, in batches, and pass each
+// one to msgFunc. The datagrams that were truncated are
+// dropped, and counted in numTruncated. Returns the number
+// of datagrams received, or -1 on error.
+extern ssize_t updateSocketRecv(int fd, UpdateSocketMsgFunc *msgFunc, size_t *numTruncated);
+
+__END_DECLS
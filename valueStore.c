@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "valueStore.h"
+
+// Set in the middle index when it holds a generation
+// the reader has not seen yet.
+#define VS_FRESH    0x4
+
+// Minimum number of changed values listed per generation;
+// above 1/8 of the values, copying them all is as cheap.
+#define VS_MIN_DIRTY    64
+
+int valueStoreInit(ValueStore *vs, size_t numValues, size_t valueSize)
+{
+    memset(vs, 0, sizeof (*vs));
+
+    vs->back = 0;
+    atomic_init(&vs->middle, 1);
+    vs->front = 2;
+
+    return (valueStoreAddColumn(vs, numValues, valueSize) == 0) ? 0 : -1;
+}
+
+int valueStoreAddColumn(ValueStore *vs, size_t numValues, size_t valueSize)
+{
+    ValueStoreColumn *col;
+
+    if ((vs->numColumns == VS_MAX_COLUMNS) || (vs->generation != 0)) {
+        return -1;
+    }
+    col = &vs->columns[vs->numColumns];
+
+    col->numValues = numValues;
+    col->valueSize = valueSize;
+
+    // Allocate one extra value, so that an empty
+    // column still has valid buffers.
+    if ((col->work = calloc((numValues + 1), valueSize)) == NULL) {
+        return -1;
+    }
+    for (int n = 0; n < 3; n++) {
+        if ((col->buf[n] = calloc((numValues + 1), valueSize)) == NULL) {
+            return -1;
+        }
+    }
+
+    col->maxDirty = (numValues / 8) > VS_MIN_DIRTY ? (numValues / 8) : VS_MIN_DIRTY;
+    for (int n = 0; n < VS_DIRTY_DEPTH; n++) {
+        if ((col->dirty[n].indexes = calloc(col->maxDirty, sizeof (uint32_t))) == NULL) {
+            return -1;
+        }
+    }
+    if ((col->marked = calloc(((numValues / 64) + 1), sizeof (uint64_t))) == NULL) {
+        return -1;
+    }
+
+    return vs->numColumns++;
+}
+
+// Copy the listed values of the working copy to the buffer
+static void copyValues(const ValueStoreColumn *col, void *buf, const uint32_t *indexes, size_t numIndexes)
+{
+    size_t size = col->valueSize;
+
+    switch (size) {
+    case sizeof (uint32_t):
+        for (size_t n = 0; n < numIndexes; n++) {
+            ((uint32_t *) buf)[indexes[n]] = ((const uint32_t *) col->work)[indexes[n]];
+        }
+        break;
+    case sizeof (uint64_t):
+        for (size_t n = 0; n < numIndexes; n++) {
+            ((uint64_t *) buf)[indexes[n]] = ((const uint64_t *) col->work)[indexes[n]];
+        }
+        break;
+    default:
+        for (size_t n = 0; n < numIndexes; n++) {
+            memcpy(((char *) buf + (indexes[n] * size)), ((const char *) col->work + (indexes[n] * size)), size);
+        }
+        break;
+    }
+}
+
+// Bring the back buffer of a column up to date with the
+// working copy, and start the marks of the next generation
+static void publishColumn(ValueStore *vs, ValueStoreColumn *col, unsigned long generation)
+{
+    unsigned long bufGen = vs->bufGen[vs->back];
+    void *buf = col->buf[vs->back];
+    ValueStoreDirty *dirty;
+    bool copyAll;
+
+    // The buffer needs the changes of the generations
+    // after the one it holds, up to this one; it's copied
+    // whole if it was never written, or their marks are
+    // no longer all kept.
+    copyAll = (bufGen == 0) || ((generation - bufGen) > VS_DIRTY_DEPTH);
+    for (unsigned long gen = bufGen + 1; !copyAll && (gen <= generation); gen++) {
+        copyAll = col->dirty[gen % VS_DIRTY_DEPTH].all;
+    }
+
+    if (copyAll) {
+        memcpy(buf, col->work, (col->numValues * col->valueSize));
+    } else {
+        for (unsigned long gen = bufGen + 1; gen <= generation; gen++) {
+            dirty = &col->dirty[gen % VS_DIRTY_DEPTH];
+            copyValues(col, buf, dirty->indexes, dirty->numIndexes);
+        }
+    }
+
+    dirty = &col->dirty[generation % VS_DIRTY_DEPTH];
+    for (size_t n = 0; n < dirty->numIndexes; n++) {
+        col->marked[dirty->indexes[n] / 64] = 0;
+    }
+    if (dirty->all) {
+        memset(col->marked, 0, (((col->numValues / 64) + 1) * sizeof (uint64_t)));
+    }
+    dirty = &col->dirty[(generation + 1) % VS_DIRTY_DEPTH];
+    dirty->numIndexes = 0;
+    dirty->all = false;
+}
+
+void valueStorePublish(ValueStore *vs)
+{
+    unsigned long generation = vs->generation + 1;
+
+    for (unsigned n = 0; n < vs->numColumns; n++) {
+        publishColumn(vs, &vs->columns[n], generation);
+    }
+    vs->bufGen[vs->back] = generation;
+
+    // The release ordering makes the values written above
+    // visible to the reader that picks up this buffer; the
+    // buffers of all the columns are swapped at once.
+    vs->back = atomic_exchange_explicit(&vs->middle, (vs->back | VS_FRESH), memory_order_acq_rel) & ~VS_FRESH;
+    vs->generation = generation;
+}
+
+const void *valueStoreSnapshot(ValueStore *vs)
+{
+    if (atomic_load_explicit(&vs->middle, memory_order_acquire) & VS_FRESH) {
+        vs->front = atomic_exchange_explicit(&vs->middle, vs->front, memory_order_acq_rel) & ~VS_FRESH;
+    }
+
+    return vs->columns[0].buf[vs->front];
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+// Triple-buffered store for the values of the read-only MIB
+// objects, shared between a single writer (the MIB update
+// task) and a single reader (the AgentX thread) without any
+// locks. The values are kept in one or more columns, each of
+// values of the same size.
+//
+// The writer updates its private working copy of the values
+// and, at the end of each pass, brings the back buffers of all
+// the columns up to date and atomically swaps them with the
+// middle ones, with a single buffer index shared by the
+// columns. The reader atomically swaps the front buffers with
+// the middle ones when a new generation has been published.
+// Each side only ever touches the buffers it owns, so the
+// reader always sees one complete and consistent generation
+// of values, across all the columns.
+//
+// The writer marks the values it changes, so that bringing the
+// back buffers up to date only copies the values changed since
+// the generation they hold; the marks of the last few
+// generations are kept for that. The whole working copy of a
+// column is copied when the buffer is older than that, or when
+// too many of its values changed.
+#define VS_DIRTY_DEPTH  4
+#define VS_MAX_COLUMNS  4
+
+typedef struct ValueStoreDirty {
+    uint32_t *indexes;          // of the values changed in the generation
+    size_t numIndexes;
+    bool all;                   // too many to list
+} ValueStoreDirty;
+
+typedef struct ValueStoreColumn {
+    size_t numValues;
+    size_t valueSize;           // size of each value, in bytes
+    void *work;                 // writer's working copy
+    void *buf[3];
+    ValueStoreDirty dirty[VS_DIRTY_DEPTH];  // by generation
+    size_t maxDirty;            // values listed per generation
+    uint64_t *marked;           // bitmap of the values listed in the next generation
+} ValueStoreColumn;
+
+typedef struct ValueStore {
+    ValueStoreColumn columns[VS_MAX_COLUMNS];
+    unsigned numColumns;
+    unsigned back;              // owned by the writer
+    unsigned front;             // owned by the reader
+    atomic_uint middle;         // buffer index | VS_FRESH
+    unsigned long generation;   // number of generations published
+    unsigned long bufGen[3];    // generation in each buffer; owned by the writer
+} ValueStore;
+
+// Init the store, with a first column of numValues values
+extern int valueStoreInit(ValueStore *vs, size_t numValues, size_t valueSize);
+
+// Add a column, before the first publish. Returns its index,
+// or -1 on error.
+extern int valueStoreAddColumn(ValueStore *vs, size_t numValues, size_t valueSize);
+
+// Writer: the working copy of a column
+static inline void *valueStoreWork(ValueStore *vs, unsigned column)
+{
+    return vs->columns[column].work;
+}
+
+// Writer: mark a value of a column as changed in the working copy
+static inline void valueStoreMarkColumn(ValueStore *vs, unsigned column, size_t index)
+{
+    ValueStoreColumn *col = &vs->columns[column];
+    ValueStoreDirty *dirty = &col->dirty[(vs->generation + 1) % VS_DIRTY_DEPTH];
+    uint64_t bit = 1ull << (index % 64);
+
+    if (dirty->all || (col->marked[index / 64] & bit)) {
+        return;
+    }
+
+    if (dirty->numIndexes == col->maxDirty) {
+        dirty->all = true;
+        return;
+    }
+
+    col->marked[index / 64] |= bit;
+    dirty->indexes[dirty->numIndexes++] = index;
+}
+
+// Writer: mark a value of the first column as changed
+static inline void valueStoreMark(ValueStore *vs, size_t index)
+{
+    valueStoreMarkColumn(vs, 0, index);
+}
+
+// Writer: mark all the values of all the columns as changed
+static inline void valueStoreMarkAll(ValueStore *vs)
+{
+    for (unsigned n = 0; n < vs->numColumns; n++) {
+        vs->columns[n].dirty[(vs->generation + 1) % VS_DIRTY_DEPTH].all = true;
+    }
+}
+
+// Writer: publish the marked changes of the working copy of
+// all the columns, as one generation
+extern void valueStorePublish(ValueStore *vs);
+
+// Reader: get the latest published generation of values, and
+// return its first column. The returned array stays valid,
+// and unchanged, until the next call.
+extern const void *valueStoreSnapshot(ValueStore *vs);
+
+// Reader: a column of the generation got by the last call of
+// valueStoreSnapshot()
+static inline const void *valueStoreColumn(const ValueStore *vs, unsigned column)
+{
+    return vs->columns[column].buf[vs->front];
+}
+
+__END_DECLS